@@ -0,0 +1,46 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/* Global allocation operators counting the allocations for the benchmarks.
+ * Only linked into the fem2a executable: libfem2a and its users keep the
+ * allocator of the C++ library. */
+namespace FEM2A {
+    namespace Bench {
+        /* number of calls to operator new since the start of the program */
+        std::atomic< long > nb_allocations( 0 );
+    }
+}
+
+void* operator new( std::size_t size )
+{
+    ++FEM2A::Bench::nb_allocations;
+    void* p = std::malloc( size > 0 ? size : 1 );
+    if ( p == NULL ) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[]( std::size_t size )
+{
+    return ::operator new( size );
+}
+
+void operator delete( void* p ) noexcept
+{
+    std::free( p );
+}
+
+void operator delete[]( void* p ) noexcept
+{
+    ::operator delete( p );
+}
+
+void operator delete( void* p, std::size_t ) noexcept
+{
+    ::operator delete( p );
+}
+
+void operator delete[]( void* p, std::size_t ) noexcept
+{
+    ::operator delete( p );
+}
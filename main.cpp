@@ -7,6 +7,8 @@
 #include "src/solver.h"
 #include "src/tests.h"
 #include "src/simu.h"
+#include "src/bench.h"
+#include "src/server.h"
 
 /* Global variables */
 std::vector< std::string > arguments;
@@ -39,6 +41,31 @@ void run_tests()
     const bool t_ass_elmt_matrix = false;
     //const bool t_pure_dirichlet_pb = true;
     const bool t_ass_elmt_vector = false;
+    const bool t_solver_config = false;
+    const bool t_solver_progress = false;
+    const bool t_mass_matrix = false;
+    const bool t_explicit_heat = false;
+    const bool t_sweep = false;
+    const bool t_matrix_free = false;
+    const bool t_mixed_precision = false;
+    const bool t_streaming = false;
+    const bool t_schwarz = false;
+    const bool t_small_matrix = false;
+    const bool t_assembler = false;
+    const bool t_incremental = false;
+    const bool t_material_table = false;
+    const bool t_vtu = false;
+    const bool t_async_writer = false;
+    const bool t_archive = false;
+    const bool t_library = false;
+    const bool t_server = false;
+    const bool t_system_cache = false;
+    const bool t_adjoint = false;
+    const bool t_reduced_basis = false;
+    const bool t_pipeline = false;
+    const bool t_scheduler = false;
+    const bool t_deterministic = false;
+    const bool t_allocator = false;
     
 
     
@@ -54,6 +81,31 @@ void run_tests()
     if( t_ass_elmt_matrix ) Tests::test_ass_elmt_matrix();
     //if( t_pure_dirichlet_pb ) Tests::test_pure_dirichlet_pb() ;
     //if( t_ass_elmt_vector ) Tests::test_ass_elmt_vector();
+    if( t_solver_config ) Tests::test_solver_config();
+    if( t_solver_progress ) Tests::test_solver_progress();
+    if( t_mass_matrix ) Tests::test_mass_matrix();
+    if( t_explicit_heat ) Tests::test_explicit_heat();
+    if( t_sweep ) Tests::test_sweep();
+    if( t_matrix_free ) Tests::test_matrix_free();
+    if( t_mixed_precision ) Tests::test_mixed_precision();
+    if( t_streaming ) Tests::test_streaming_assembly();
+    if( t_schwarz ) Tests::test_schwarz();
+    if( t_small_matrix ) Tests::test_small_matrix();
+    if( t_assembler ) Tests::test_assembler();
+    if( t_incremental ) Tests::test_incremental_assembly();
+    if( t_material_table ) Tests::test_material_table();
+    if( t_vtu ) Tests::test_vtu();
+    if( t_async_writer ) Tests::test_async_writer();
+    if( t_archive ) Tests::test_archive();
+    if( t_library ) Tests::test_library();
+    if( t_server ) Tests::test_server();
+    if( t_system_cache ) Tests::test_system_cache();
+    if( t_adjoint ) Tests::test_adjoint();
+    if( t_reduced_basis ) Tests::test_reduced_basis();
+    if( t_pipeline ) Tests::test_pipeline();
+    if( t_scheduler ) Tests::test_scheduler();
+    if( t_deterministic ) Tests::test_deterministic();
+    if( t_allocator ) Tests::test_allocator();
     
 }
 
@@ -63,16 +115,211 @@ void run_simu()
     const bool simu_pure_dirichlet = false;
     const bool simu_source_dirichlet = false;
     const bool simu_sinus_dirichlet = true;
+    const bool simu_geothermie_transient = false;
+    const bool simu_geothermie_explicit = false;
+    const bool simu_sinus_sweep = false;
     const bool verbose = flag_is_used( "-v", arguments )
         || flag_is_used( "--verbose", arguments );
+    const SolverConfig solver_config = SolverConfig::from_arguments( arguments );
 
     if( simu_sinus_dirichlet ) { 
-        //Simu::pure_dirichlet_pb("data/square.mesh", verbose);
-        //Simu::source_dirichlet_pb("data/square.mesh", verbose);
-        Simu::sinus_dirichlet_pb("data/square_fine.mesh", verbose);
+        //Simu::pure_dirichlet_pb("data/square.mesh", verbose, solver_config);
+        //Simu::source_dirichlet_pb("data/square.mesh", verbose, solver_config);
+        Simu::sinus_dirichlet_pb("data/square_fine.mesh", verbose, solver_config);
+    }
+    if( simu_geothermie_transient ) {
+        Simu::geothermie_transient_pb("data/geothermie_4.mesh", verbose, solver_config,
+            flag_is_used( "--vtu", arguments ));
+    }
+    if( simu_geothermie_explicit ) {
+        Simu::geothermie_explicit_pb("data/geothermie_4.mesh", verbose);
+    }
+    if( simu_sinus_sweep ) {
+        Simu::sinus_sweep_pb("data/square_fine.mesh", verbose, solver_config);
     }
 }
 
+/* value following flag in the arguments, or default_value */
+std::string flag_value(
+    const std::string& flag,
+    const std::string& default_value,
+    const std::vector< std::string >& arguments )
+{
+    for( int i = 0; i + 1 < arguments.size(); ++i ) {
+        if( flag == arguments[i] ) {
+            return arguments[i + 1];
+        }
+    }
+    return default_value;
+}
+
+void run_bench()
+{
+    /* --bench <name> runs a single benchmark, all of them by default */
+    const std::string selected = flag_value( "--bench", "all", arguments );
+    const bool bench_matrix_free = selected == "all" || selected == "matrix-free";
+    const bool bench_mixed_precision = selected == "all" || selected == "mixed";
+    const bool bench_streaming = selected == "all" || selected == "streaming";
+    const bool bench_schwarz = selected == "all" || selected == "schwarz";
+    const bool bench_small_matrix = selected == "all" || selected == "small-matrix";
+    const bool bench_assembler = selected == "all" || selected == "assembler";
+    const bool bench_incremental = selected == "all" || selected == "incremental";
+    const bool bench_material = selected == "all" || selected == "material";
+    const bool bench_vtu = selected == "all" || selected == "vtu";
+    const bool bench_async = selected == "all" || selected == "async";
+    const bool bench_archive = selected == "all" || selected == "archive";
+    const bool bench_serve = selected == "all" || selected == "serve";
+    const bool bench_system_cache = selected == "all" || selected == "system-cache";
+    const bool bench_adjoint = selected == "all" || selected == "adjoint";
+    const bool bench_reduced_basis = selected == "all" || selected == "reduced-basis";
+    const bool bench_pipeline = selected == "all" || selected == "pipeline";
+    const bool bench_scheduler = selected == "all" || selected == "scheduler";
+    const bool bench_deterministic = selected == "all" || selected == "deterministic";
+    const bool bench_allocator = selected == "all" || selected == "allocator";
+    const bool bench_tolerance = selected == "all" || selected == "tolerance";
+    const bool verbose = flag_is_used( "-v", arguments )
+        || flag_is_used( "--verbose", arguments );
+    const int grid = atoi( flag_value( "--grid", "300", arguments ).c_str() );
+    const std::string mesh = flag_value( "--mesh", "data/geothermie_0_1.mesh", arguments );
+
+    if( bench_matrix_free ) {
+        Bench::matrix_free_pb( grid, verbose );
+    }
+    if( bench_mixed_precision ) {
+        Bench::mixed_precision_pb( "data/mug_0_2.mesh", 1e-10, verbose );
+        Bench::mixed_precision_pb( "data/geothermie_0_1.mesh", 1e-10, verbose );
+    }
+    if( bench_streaming ) {
+        Bench::streaming_pb( mesh, flag_is_used( "--in-core", arguments ), verbose );
+    }
+    if( bench_schwarz ) {
+        Bench::schwarz_pb( grid, verbose );
+    }
+    if( bench_small_matrix ) {
+        Bench::small_matrix_pb( grid, verbose );
+    }
+    if( bench_assembler ) {
+        Bench::assembler_pb( grid, verbose );
+    }
+    if( bench_incremental ) {
+        Bench::incremental_pb( grid, verbose );
+    }
+    if( bench_material ) {
+        Bench::material_pb( grid, verbose );
+    }
+    if( bench_vtu ) {
+        Bench::vtu_pb( grid, verbose );
+    }
+    if( bench_async ) {
+        Bench::async_writer_pb( grid, verbose );
+    }
+    if( bench_archive ) {
+        Bench::archive_pb( grid, verbose );
+    }
+    if( bench_serve ) {
+        Bench::serve_pb( grid, verbose );
+    }
+    if( bench_system_cache ) {
+        Bench::system_cache_pb( grid, verbose );
+    }
+    if( bench_adjoint ) {
+        Bench::adjoint_pb( "data/geothermie_0_5.mesh", verbose );
+    }
+    if( bench_reduced_basis ) {
+        /* the snapshots are full solves: at most a 150 x 150 grid */
+        Bench::reduced_basis_pb( std::min( grid, 150 ), 40, verbose );
+    }
+    if( bench_pipeline ) {
+        Bench::pipeline_pb( "data", 3, verbose );
+    }
+    if( bench_scheduler ) {
+        Bench::scheduler_pb( grid, verbose );
+    }
+    if( bench_deterministic ) {
+        Bench::deterministic_pb( grid, verbose );
+    }
+    if( bench_allocator ) {
+        Bench::allocator_pb( grid, verbose );
+    }
+    if( bench_tolerance ) {
+        Bench::tolerance_pb( "data/geothermie_0_1.mesh",
+            atof( flag_value( "--tol-mesh", "1e-5", arguments ).c_str() ), verbose );
+    }
+}
+
+/* --serve, --job and --submit: the solver daemon and its clients */
+int run_server()
+{
+    const std::string socket_path = flag_value( "--socket", "fem2a.sock", arguments );
+    if( flag_is_used( "--job", arguments ) ) {
+        /* a single job in this process, as the daemon would run it */
+        JobDescription job;
+        std::string error;
+        if( !job.parse( flag_value( "--job", "", arguments ), error ) ) {
+            std::cout << "error " << error << std::endl;
+            return 1;
+        }
+        JobRunner runner;
+        std::unique_ptr< SystemCache > cache;
+        if( flag_is_used( "--system-cache", arguments ) ) {
+            cache.reset( new SystemCache( flag_value( "--system-cache", "fem2a_cache", arguments ) ) );
+            runner.set_system_cache( cache.get() );
+        }
+        const JobResult result = runner.run( job );
+        std::cout << result.to_string() << std::endl;
+        return result.ok ? 0 : 1;
+    }
+    if( flag_is_used( "--submit", arguments ) ) {
+        std::vector< std::string > lines( 1, flag_value( "--submit", "", arguments ) );
+        std::vector< std::string > answers;
+        if( !submit_jobs( socket_path, lines, answers ) ) {
+            std::cout << "error cannot reach the server at " << socket_path << std::endl;
+            return 1;
+        }
+        std::cout << answers[0] << std::endl;
+        return answers[0].compare( 0, 2, "ok" ) == 0 ? 0 : 1;
+    }
+    JobRunner runner;
+    std::unique_ptr< SystemCache > cache;
+    if( flag_is_used( "--system-cache", arguments ) ) {
+        cache.reset( new SystemCache( flag_value( "--system-cache", "fem2a_cache", arguments ) ) );
+        runner.set_system_cache( cache.get() );
+    }
+    SolverServer server( runner, atoi( flag_value( "--workers", "0", arguments ).c_str() ) );
+    if( !server.listen( socket_path ) ) {
+        std::cout << "cannot listen on " << socket_path << std::endl;
+        return 1;
+    }
+    std::cout << "listening on " << socket_path << " with "
+        << server.nb_workers() << " workers" << std::endl;
+    server.wait();
+    return 0;
+}
+
+/* --batch: every mesh of a directory through the load/assemble/solve/write pipeline */
+int run_batch()
+{
+    const std::string directory = flag_value( "--batch", "data", arguments );
+    const std::vector< std::string > meshes = MeshPipeline::list_meshes( directory );
+    if( meshes.empty() ) {
+        std::cout << "no .mesh file in " << directory << std::endl;
+        return 1;
+    }
+    PipelineConfig config;
+    config.output_directory = flag_value( "--out", "", arguments );
+    config.vtu = flag_is_used( "--vtu", arguments );
+    config.solve_threads = atoi( flag_value( "--solve-threads", "1", arguments ).c_str() );
+    MeshPipeline pipeline( config );
+    const bool ok = pipeline.run( meshes );
+    for( int i = 0; i < pipeline.results().size(); ++i ) {
+        const PipelineResult& result = pipeline.results()[i];
+        std::cout << result.filename << ": " << ( result.ok ? "ok" : result.error )
+            << ", " << result.nb_vertices << " vertices, " << result.iterations << " iterations" << std::endl;
+    }
+    std::cout << pipeline.report() << std::endl;
+    return ok ? 0 : 1;
+}
+
 int main( int argc, const char * argv[] )
 {
     /* Command line parsing */
@@ -88,10 +335,46 @@ int main( int argc, const char * argv[] )
         std::cout << " -h, --help:        show usage" << std::endl;
         std::cout << " -t, --run-tests:   run the tests" << std::endl;
         std::cout << " -s, --run-simu:    run the simulations" << std::endl;
+        std::cout << " -b, --run-bench:   run the benchmarks" << std::endl;
+        std::cout << " --bench <name>:    matrix-free, mixed, streaming, schwarz," << std::endl
+            << "                    small-matrix, assembler, incremental, material," << std::endl
+            << "                    vtu, async, archive, serve, system-cache," << std::endl
+            << "                    adjoint, reduced-basis, pipeline, scheduler," << std::endl
+            << "                    deterministic, allocator, tolerance" << std::endl;
+        std::cout << " --grid <n>:        benchmarks on a n x n grid (300)" << std::endl;
+        std::cout << " --mesh <file>:     mesh of the streaming benchmark" << std::endl;
+        std::cout << " --in-core:         streaming benchmark with Mesh::load" << std::endl;
         std::cout << " -v, --verbose:     print lots of details" << std::endl;
+        std::cout << " --solver <name>:   default, cg, bicgstab, gmres or pcg" << std::endl;
+        std::cout << " --precond <name>:  none, jacobi or ssor" << std::endl;
+        std::cout << " --tol <value>:     relative residual threshold (1e-12)" << std::endl;
+        std::cout << " --tol-mesh <c>:    threshold c*h^2 tied to the mesh size h" << std::endl;
+        std::cout << " --max-iter <n>:    maximum number of iterations (1e6)" << std::endl;
+        std::cout << " --auto-tune:       pick and cache the fastest solver" << std::endl;
+        std::cout << " --mixed:           float PCG refined in double (with pcg)" << std::endl;
+        std::cout << " --vtu:             transient simulation saved as .vtu + .pvd" << std::endl;
+        std::cout << " --serve:           solver daemon on a Unix socket" << std::endl;
+        std::cout << " --socket <path>:   socket of the daemon (fem2a.sock)" << std::endl;
+        std::cout << " --workers <n>:     jobs solved concurrently by the daemon" << std::endl;
+        std::cout << " --submit <job>:    sends a job to the daemon, e.g." << std::endl
+            << "                    \"mesh=data/square.mesh f=1 g=1:0 out=u.bb\"" << std::endl;
+        std::cout << " --job <job>:       runs a job without the daemon" << std::endl;
+        std::cout << " --system-cache <dir>: assembled systems kept on disk (--job, --serve)" << std::endl;
+        std::cout << " --batch <dir>:     solves f = 1, u = 0 on every .mesh of dir" << std::endl;
+        std::cout << " --out <dir>:       solutions of --batch, as .bb (add --vtu for .vtu)" << std::endl;
+        std::cout << " --solve-threads <n>: meshes solved concurrently by --batch (1)" << std::endl;
         return 0;
     }
 
+    if( flag_is_used( "--batch", arguments ) ) {
+        return run_batch();
+    }
+
+    if( flag_is_used( "--serve", arguments ) || flag_is_used( "--job", arguments )
+        || flag_is_used( "--submit", arguments ) ) {
+        return run_server();
+    }
+
     /* Run the tests if asked */
     if( flag_is_used("-t", arguments)
         || flag_is_used("--run-tests", arguments) ) {
@@ -104,5 +387,11 @@ int main( int argc, const char * argv[] )
         run_simu();
     }
 
+    /* Run the benchmarks if asked */
+    if( flag_is_used("-b", arguments)
+        || flag_is_used("--run-bench", arguments) ) {
+        run_bench();
+    }
+
     return 0;
 }
@@ -0,0 +1,150 @@
+#include "adjoint.h"
+#include "material.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace FEM2A {
+
+    /****************************************************************/
+    /* Implementation of LinearFunctional */
+    /****************************************************************/
+    LinearFunctional::LinearFunctional()
+        : constant( 0. )
+    {
+    }
+
+    void LinearFunctional::add( int vertex_index, double weight )
+    {
+        vertices.push_back( vertex_index ) ;
+        weights.push_back( weight ) ;
+    }
+
+    void LinearFunctional::add( const LinearFunctional& other, double factor )
+    {
+        for( int i = 0; i < other.vertices.size(); ++i ) {
+            add( other.vertices[i], factor * other.weights[i] ) ;
+        }
+        constant += factor * other.constant ;
+    }
+
+    double LinearFunctional::evaluate( const double* u ) const
+    {
+        double value = constant ;
+        for( int i = 0; i < vertices.size(); ++i ) value += weights[i] * u[vertices[i]] ;
+        return value ;
+    }
+
+    void LinearFunctional::gradient( int nb_vertices, std::vector< double >& c ) const
+    {
+        c.assign( nb_vertices, 0. ) ;
+        for( int i = 0; i < vertices.size(); ++i ) c[vertices[i]] += weights[i] ;
+    }
+
+    static double cross( vertex a, vertex b, vertex c )
+    {
+        return ( b.x - a.x ) * ( c.y - a.y ) - ( b.y - a.y ) * ( c.x - a.x ) ;
+    }
+
+    LinearFunctional probe_functional( const Mesh& M, vertex p )
+    {
+        LinearFunctional J ;
+        for( int t = 0; t < M.nb_triangles(); ++t ) {
+            const vertex a = M.get_triangle_vertex( t, 0 ) ;
+            const vertex b = M.get_triangle_vertex( t, 1 ) ;
+            const vertex c = M.get_triangle_vertex( t, 2 ) ;
+            const double area = cross( a, b, c ) ;
+            if( area == 0. ) continue ;
+            /* barycentric coordinates, the P1 shape functions at p */
+            const double l1 = cross( a, p, c ) / area ;
+            const double l2 = cross( a, b, p ) / area ;
+            const double l0 = 1. - l1 - l2 ;
+            const double eps = -1e-12 ;
+            if( l0 < eps || l1 < eps || l2 < eps ) continue ;
+            J.add( M.get_triangle_vertex_index( t, 0 ), l0 ) ;
+            J.add( M.get_triangle_vertex_index( t, 1 ), l1 ) ;
+            J.add( M.get_triangle_vertex_index( t, 2 ), l2 ) ;
+            break ;
+        }
+        return J ;
+    }
+
+    LinearFunctional flux_functional( const Mesh& M, int edge_attribute, const ScalarField& g )
+    {
+        LinearFunctional J ;
+        std::vector< bool > seen( M.nb_vertices(), false ) ;
+        for( int e = 0; e < M.nb_edges(); ++e ) {
+            if( M.get_edge_attribute( e ) != edge_attribute ) continue ;
+            for( int k = 0; k < 2; ++k ) {
+                const int v = M.get_edge_vertex_index( e, k ) ;
+                if( seen[v] ) continue ;
+                seen[v] = true ;
+                J.add( v, -dirichlet_penalty ) ;
+                J.constant += dirichlet_penalty * g( M.get_vertex( v ) ) ;
+            }
+        }
+        return J ;
+    }
+
+    /****************************************************************/
+    /* Implementation of AdjointSensitivity */
+    /****************************************************************/
+    AdjointSensitivity::AdjointSensitivity( PoissonProblem& problem )
+        : problem_( problem ), iterations_( 0 )
+    {
+    }
+
+    bool AdjointSensitivity::compute( const LinearFunctional& J )
+    {
+        const Mesh& M = problem_.mesh() ;
+        J.gradient( M.nb_vertices(), c_ ) ;
+        const bool converged = problem_.solve_adjoint( c_, lambda_ ) ;
+        iterations_ = problem_.iterations() ;
+
+        /* dK/dk_a is the stiffness of attribute a with k = 1 for a
+         * constant material, with its own k(x) for a scaled function */
+        const MaterialTable& materials = problem_.diffusion() ;
+        const MaterialTable unit( 1. ) ;
+        const Quadrature quadrature = Quadrature::get_quadrature( 2 ) ;
+        const ShapeFunctions shape_functions( 2, 1 ) ;
+        const double* u = problem_.solution() ;
+        int attribute_max = 0 ;
+        for( int t = 0; t < M.nb_triangles(); ++t ) {
+            attribute_max = std::max( attribute_max, M.get_triangle_attribute( t ) ) ;
+        }
+        gradient_.assign( attribute_max + 1, 0. ) ;
+        Mat< 3, 3 > Ke ;
+        for( int t = 0; t < M.nb_triangles(); ++t ) {
+            const int attribute = M.get_triangle_attribute( t ) ;
+            assert( attribute >= 0 ) ;
+            const ElementMapping mapping( M, false, t ) ;
+            assemble_elementary_matrix( mapping, shape_functions, quadrature,
+                materials.is_constant( attribute ) ? unit : materials, attribute, Ke ) ;
+            double sum = 0. ;
+            for( int i = 0; i < 3; ++i ) {
+                const double lambda_i = lambda_[M.get_triangle_vertex_index( t, i )] ;
+                for( int j = 0; j < 3; ++j ) {
+                    sum += lambda_i * Ke( i, j ) * u[M.get_triangle_vertex_index( t, j )] ;
+                }
+            }
+            gradient_[attribute] -= sum ;
+        }
+        return converged ;
+    }
+
+    const std::vector< double >& AdjointSensitivity::gradient() const
+    {
+        return gradient_ ;
+    }
+
+    const std::vector< double >& AdjointSensitivity::adjoint() const
+    {
+        return lambda_ ;
+    }
+
+    int AdjointSensitivity::iterations() const
+    {
+        return iterations_ ;
+    }
+
+}
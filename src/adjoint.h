@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "problem.h"
+
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief LinearFunctional is an output J(u) = sum_i weight_i u_i +
+     *        constant of a P1 solution, stored by its non-zero weights.
+     */
+    struct LinearFunctional {
+        LinearFunctional() ;
+
+        void add( int vertex_index, double weight ) ;
+        /* this += factor * other */
+        void add( const LinearFunctional& other, double factor = 1. ) ;
+
+        double evaluate( const double* u ) const ;
+
+        /* dJ/du as a vector of nb_vertices values */
+        void gradient( int nb_vertices, std::vector< double >& c ) const ;
+
+        std::vector< int > vertices ;
+        std::vector< double > weights ;
+        double constant ;
+    } ;
+
+    /**
+     * \brief Value of u at the point p: P1 interpolation in the triangle
+     *        containing p. Empty if p is outside the mesh.
+     */
+    LinearFunctional probe_functional( const Mesh& M, vertex p ) ;
+
+    /**
+     * \brief Flux int k grad u . n (n the outward normal) through the
+     *        Dirichlet edges of attribute edge_attribute, where u = g is
+     *        imposed by penalty: the reactions dirichlet_penalty *
+     *        ( g(v) - u_v ) summed over the vertices of these edges.
+     */
+    LinearFunctional flux_functional( const Mesh& M, int edge_attribute, const ScalarField& g ) ;
+
+    /**
+     * \brief Gradient of an output J(u) of a solved PoissonProblem with
+     *        respect to the diffusion of every triangle attribute, with one
+     *        adjoint solve (instead of one solve per attribute with
+     *        finite differences).
+     *
+     * K(k) u = F with K = sum_a K_a, K_a being the stiffness of the
+     * triangles of attribute a. The adjoint lambda solves K lambda = dJ/du
+     * (K is symmetric), then dJ/dp_a = - lambda^T (dK_a/dp_a) u, computed
+     * by one loop over the elements. The parameter p_a is:
+     *   - the value k_a for a constant material;
+     *   - a scale factor s (k = s k(x), at s = 1) for a function material.
+     * F and the Dirichlet penalties do not depend on k.
+     */
+    class AdjointSensitivity {
+        public:
+            /**
+             * \param problem Solved (its solution is differentiated),
+             *        must outlive this object
+             */
+            explicit AdjointSensitivity( PoissonProblem& problem ) ;
+
+            /**
+             * \brief Solves the adjoint system of J and computes the
+             *        gradient, one value per triangle attribute from 0 to
+             *        the largest one (0 for the attributes not in the mesh).
+             * \return false if the adjoint solve has not converged
+             */
+            bool compute( const LinearFunctional& J ) ;
+
+            const std::vector< double >& gradient() const ;
+            const std::vector< double >& adjoint() const ;
+            int iterations() const ;
+
+        private:
+            PoissonProblem& problem_ ;
+            std::vector< double > c_ ;
+            std::vector< double > lambda_ ;
+            std::vector< double > gradient_ ;
+            int iterations_ ;
+    } ;
+
+}
@@ -0,0 +1,369 @@
+#include "allocator.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <new>
+#include <sstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace FEM2A {
+
+    static char* align_up( char* p, size_t alignment )
+    {
+        const uintptr_t address = reinterpret_cast< uintptr_t >( p ) ;
+        return p + ( alignment - address % alignment ) % alignment ;
+    }
+
+    static size_t round_up( size_t nb_bytes, size_t alignment )
+    {
+        return ( nb_bytes + alignment - 1 ) / alignment * alignment ;
+    }
+
+    static size_t page_size()
+    {
+        static const size_t size = sysconf( _SC_PAGESIZE ) ;
+        return size ;
+    }
+
+    /* anonymous pages, not touched yet */
+    static void* map_pages( size_t nb_bytes )
+    {
+        void* p = mmap( NULL, nb_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) ;
+        return p == MAP_FAILED ? NULL : p ;
+    }
+
+    /****************************************************************/
+    /* Implementation of MemoryResource */
+    /****************************************************************/
+    static std::atomic< MemoryResource* > chosen_default( NULL ) ;
+
+    MemoryResource::MemoryResource()
+        : allocated_( 0 ), peak_( 0 ), nb_allocations_( 0 )
+    {
+    }
+
+    MemoryResource::~MemoryResource()
+    {
+    }
+
+    void* MemoryResource::allocate( size_t nb_bytes, size_t alignment )
+    {
+        void* p = do_allocate( nb_bytes, alignment ) ;
+        if( p == NULL ) throw std::bad_alloc() ;
+        ++nb_allocations_ ;
+        const size_t allocated = allocated_ += nb_bytes ;
+        size_t peak = peak_ ;
+        while( allocated > peak && !peak_.compare_exchange_weak( peak, allocated ) ) {}
+        return p ;
+    }
+
+    void MemoryResource::deallocate( void* p, size_t nb_bytes, size_t alignment )
+    {
+        if( p == NULL ) return ;
+        do_deallocate( p, nb_bytes, alignment ) ;
+        allocated_ -= nb_bytes ;
+    }
+
+    size_t MemoryResource::allocated_bytes() const
+    {
+        return allocated_ ;
+    }
+
+    size_t MemoryResource::peak_bytes() const
+    {
+        return peak_ ;
+    }
+
+    long MemoryResource::nb_allocations() const
+    {
+        return nb_allocations_ ;
+    }
+
+    size_t MemoryResource::reserved_bytes() const
+    {
+        return allocated_ ;
+    }
+
+    std::string MemoryResource::report() const
+    {
+        std::ostringstream out ;
+        out << name() << ": " << nb_allocations() << " allocations, " << allocated_bytes()
+            << " bytes allocated (peak " << peak_bytes() << "), " << reserved_bytes() << " bytes reserved" ;
+        return out.str() ;
+    }
+
+    MemoryResource& MemoryResource::heap()
+    {
+        static HeapResource resource ;
+        return resource ;
+    }
+
+    MemoryResource& MemoryResource::default_resource()
+    {
+        MemoryResource* chosen = chosen_default ;
+        if( chosen != NULL ) return *chosen ;
+        /* never destroyed: containers may outlive the static objects */
+        static MemoryResource* from_environment = []() -> MemoryResource* {
+            const char* name = getenv( "FEM2A_ALLOCATOR" ) ;
+            const std::string allocator = name != NULL ? name : "" ;
+            if( allocator == "arena" ) return new ArenaResource ;
+            if( allocator == "huge-pages" ) return new HugePageResource ;
+            if( allocator == "numa" ) return new NumaResource ;
+            return &heap() ;
+        }() ;
+        return *from_environment ;
+    }
+
+    void MemoryResource::set_default( MemoryResource* resource )
+    {
+        chosen_default = resource ;
+    }
+
+    /****************************************************************/
+    /* Implementation of HeapResource */
+    /****************************************************************/
+    const char* HeapResource::name() const
+    {
+        return "heap" ;
+    }
+
+    void* HeapResource::do_allocate( size_t nb_bytes, size_t alignment )
+    {
+        if( alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ) {
+            return ::operator new( nb_bytes, std::align_val_t( alignment ) ) ;
+        }
+        return ::operator new( nb_bytes ) ;
+    }
+
+    void HeapResource::do_deallocate( void* p, size_t, size_t alignment )
+    {
+        if( alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ) {
+            ::operator delete( p, std::align_val_t( alignment ) ) ;
+            return ;
+        }
+        ::operator delete( p ) ;
+    }
+
+    /****************************************************************/
+    /* Implementation of ArenaResource */
+    /****************************************************************/
+    ArenaResource::ArenaResource( size_t chunk_bytes )
+        : chunk_bytes_( chunk_bytes ), free_blocks_( MAX_REUSED / 8 + 1 ),
+        free_medium_blocks_( 8 * sizeof( size_t ) ), next_( NULL ), end_( NULL ), reserved_( 0 )
+    {
+    }
+
+    ArenaResource::~ArenaResource()
+    {
+        release() ;
+    }
+
+    const char* ArenaResource::name() const
+    {
+        return "arena" ;
+    }
+
+    size_t ArenaResource::reserved_bytes() const
+    {
+        std::lock_guard< std::mutex > lock( mutex_ ) ;
+        return reserved_ ;
+    }
+
+    void ArenaResource::release()
+    {
+        std::lock_guard< std::mutex > lock( mutex_ ) ;
+        for( int c = 0; c < chunks_.size(); ++c ) {
+            unmap_chunk( chunks_[c].data, chunks_[c].size ) ;
+        }
+        for( std::map< void*, size_t >::const_iterator it = large_.begin(); it != large_.end(); ++it ) {
+            unmap_chunk( it->first, it->second ) ;
+        }
+        chunks_.clear() ;
+        large_.clear() ;
+        for( int k = 0; k < free_blocks_.size(); ++k ) free_blocks_[k].clear() ;
+        for( int k = 0; k < free_medium_blocks_.size(); ++k ) free_medium_blocks_[k].clear() ;
+        next_ = end_ = NULL ;
+        reserved_ = 0 ;
+    }
+
+    void* ArenaResource::do_allocate( size_t nb_bytes, size_t alignment )
+    {
+        const size_t chunk_alignment = this->chunk_alignment() ;
+        assert( alignment <= chunk_alignment ) ;
+        if( nb_bytes > chunk_bytes_ / 2 ) {
+            const size_t size = round_up( nb_bytes, chunk_alignment ) ;
+            void* p = map_chunk( size ) ;
+            if( p == NULL ) return NULL ;
+            std::lock_guard< std::mutex > lock( mutex_ ) ;
+            large_[p] = size ;
+            reserved_ += size ;
+            return p ;
+        }
+        /* the small blocks aligned on 8 bytes, the medium ones as malloc:
+         * a freed block serves any allocation of its class */
+        const size_t block_alignment = nb_bytes <= MAX_REUSED ? 8 : alignof( max_align_t ) ;
+        const bool reusable = alignment <= block_alignment ;
+        alignment = std::max( alignment, block_alignment ) ;
+        std::unique_lock< std::mutex > lock( mutex_ ) ;
+        std::vector< char* >& blocks = free_list( nb_bytes, nb_bytes ) ;
+        if( reusable && !blocks.empty() ) {
+            char* p = blocks.back() ;
+            blocks.pop_back() ;
+            return p ;
+        }
+        char* p = next_ == NULL ? NULL : align_up( next_, alignment ) ;
+        while( p == NULL || p + nb_bytes > end_ ) {
+            /* mapped unlocked: the first touch of NumaResource runs tasks
+             * which may allocate from this arena */
+            lock.unlock() ;
+            Chunk chunk ;
+            chunk.size = round_up( chunk_bytes_, chunk_alignment ) ;
+            chunk.data = static_cast< char* >( map_chunk( chunk.size ) ) ;
+            if( chunk.data == NULL ) return NULL ;
+            lock.lock() ;
+            /* the rest of the current chunk is left unused */
+            chunks_.push_back( chunk ) ;
+            reserved_ += chunk.size ;
+            next_ = chunk.data ;
+            end_ = chunk.data + chunk.size ;
+            p = align_up( next_, alignment ) ;
+        }
+        next_ = p + nb_bytes ;
+        return p ;
+    }
+
+    std::vector< char* >& ArenaResource::free_list( size_t nb_bytes, size_t& block_bytes )
+    {
+        if( nb_bytes <= MAX_REUSED ) {
+            block_bytes = round_up( nb_bytes, 8 ) ;
+            return free_blocks_[block_bytes / 8] ;
+        }
+        int k = 0 ;
+        while( ( (size_t)1 << k ) < nb_bytes ) ++k ;
+        block_bytes = (size_t)1 << k ;
+        return free_medium_blocks_[k] ;
+    }
+
+    void ArenaResource::do_deallocate( void* p, size_t nb_bytes, size_t )
+    {
+        std::lock_guard< std::mutex > lock( mutex_ ) ;
+        if( nb_bytes <= chunk_bytes_ / 2 ) {
+            size_t block_bytes ;
+            free_list( nb_bytes, block_bytes ).push_back( static_cast< char* >( p ) ) ;
+            return ;
+        }
+        std::map< void*, size_t >::iterator it = large_.find( p ) ;
+        if( it == large_.end() ) return ;
+        unmap_chunk( it->first, it->second ) ;
+        reserved_ -= it->second ;
+        large_.erase( it ) ;
+    }
+
+    void* ArenaResource::map_chunk( size_t nb_bytes )
+    {
+        return malloc( nb_bytes ) ;
+    }
+
+    void ArenaResource::unmap_chunk( void* p, size_t )
+    {
+        free( p ) ;
+    }
+
+    size_t ArenaResource::chunk_alignment() const
+    {
+        /* malloc aligns for any fundamental type */
+        return alignof( max_align_t ) ;
+    }
+
+    /****************************************************************/
+    /* Implementation of HugePageResource */
+    /****************************************************************/
+    HugePageResource::HugePageResource( size_t chunk_bytes )
+        : ArenaResource( round_up( chunk_bytes, HUGE_PAGE ) )
+    {
+    }
+
+    HugePageResource::~HugePageResource()
+    {
+        /* ~ArenaResource would call the free() of the base class */
+        release() ;
+    }
+
+    const char* HugePageResource::name() const
+    {
+        return "huge pages" ;
+    }
+
+    void* HugePageResource::map_chunk( size_t nb_bytes )
+    {
+        /* one huge page more, to cut an aligned range */
+        const size_t mapped = nb_bytes + HUGE_PAGE ;
+        char* raw = static_cast< char* >( map_pages( mapped ) ) ;
+        if( raw == NULL ) return NULL ;
+        char* aligned = align_up( raw, HUGE_PAGE ) ;
+        if( aligned > raw ) munmap( raw, aligned - raw ) ;
+        char* end = aligned + nb_bytes ;
+        if( raw + mapped > end ) munmap( end, raw + mapped - end ) ;
+#ifdef MADV_HUGEPAGE
+        madvise( aligned, nb_bytes, MADV_HUGEPAGE ) ;
+#endif
+        return aligned ;
+    }
+
+    void HugePageResource::unmap_chunk( void* p, size_t nb_bytes )
+    {
+        munmap( p, nb_bytes ) ;
+    }
+
+    size_t HugePageResource::chunk_alignment() const
+    {
+        return HUGE_PAGE ;
+    }
+
+    /****************************************************************/
+    /* Implementation of NumaResource */
+    /****************************************************************/
+    NumaResource::NumaResource( size_t chunk_bytes )
+        : ArenaResource( chunk_bytes )
+    {
+    }
+
+    NumaResource::~NumaResource()
+    {
+        release() ;
+    }
+
+    const char* NumaResource::name() const
+    {
+        return "numa first touch" ;
+    }
+
+    void* NumaResource::map_chunk( size_t nb_bytes )
+    {
+        char* p = static_cast< char* >( map_pages( nb_bytes ) ) ;
+        if( p == NULL ) return NULL ;
+        /* 16 pages per task, as the loops reading the arrays are split */
+        const size_t page = page_size() ;
+        ThreadPool::current().parallel_for( nb_bytes / page, 16, [p, page]( int begin, int end ) {
+            for( int k = begin; k < end; ++k ) p[(size_t)k * page] = 0 ;
+        } ) ;
+        return p ;
+    }
+
+    void NumaResource::unmap_chunk( void* p, size_t nb_bytes )
+    {
+        munmap( p, nb_bytes ) ;
+    }
+
+    size_t NumaResource::chunk_alignment() const
+    {
+        return page_size() ;
+    }
+
+}
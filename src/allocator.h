@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief MemoryResource provides the memory of the arrays of Mesh,
+     *        SparseMatrix and Quadrature, through Allocator.
+     *
+     * A container keeps the resource it was built with: the resource must
+     * outlive it. The resources are thread-safe. Each of them counts the
+     * bytes allocated (current and peak) and the calls, so the effect of a
+     * resource on a run can be measured.
+     */
+    class MemoryResource {
+        public:
+            MemoryResource() ;
+            virtual ~MemoryResource() ;
+
+            void* allocate( size_t nb_bytes, size_t alignment ) ;
+            /* nb_bytes and alignment of the allocation */
+            void deallocate( void* p, size_t nb_bytes, size_t alignment ) ;
+
+            virtual const char* name() const = 0 ;
+
+            /* bytes allocated and not deallocated, and their peak */
+            size_t allocated_bytes() const ;
+            size_t peak_bytes() const ;
+            long nb_allocations() const ;
+            /* bytes taken from the system, allocated_bytes() by default */
+            virtual size_t reserved_bytes() const ;
+            /* a line with the counters */
+            std::string report() const ;
+
+            /* operator new and delete */
+            static MemoryResource& heap() ;
+
+            /**
+             * \brief Resource of the containers built without one: heap(),
+             *        or a process-wide arena, huge-page or NUMA resource if
+             *        FEM2A_ALLOCATOR is set to arena, huge-pages or numa.
+             *        These are never released: they reuse the freed blocks
+             *        (see ArenaResource), so they hold about the peak of
+             *        each block size rather than every block ever made.
+             */
+            static MemoryResource& default_resource() ;
+            /* NULL goes back to the choice of FEM2A_ALLOCATOR */
+            static void set_default( MemoryResource* resource ) ;
+
+        protected:
+            virtual void* do_allocate( size_t nb_bytes, size_t alignment ) = 0 ;
+            virtual void do_deallocate( void* p, size_t nb_bytes, size_t alignment ) = 0 ;
+
+        private:
+            MemoryResource( const MemoryResource& ) ;
+            MemoryResource& operator=( const MemoryResource& ) ;
+
+            std::atomic< size_t > allocated_ ;
+            std::atomic< size_t > peak_ ;
+            std::atomic< long > nb_allocations_ ;
+    } ;
+
+    /**
+     * \brief HeapResource allocates with operator new (the aligned one
+     *        for over-aligned types): the behaviour of std::allocator.
+     */
+    class HeapResource : public MemoryResource {
+        public:
+            const char* name() const ;
+
+        protected:
+            void* do_allocate( size_t nb_bytes, size_t alignment ) ;
+            void do_deallocate( void* p, size_t nb_bytes, size_t alignment ) ;
+    } ;
+
+    /**
+     * \brief ArenaResource is a bump allocator for the data of one run:
+     *        the blocks are cut one after the other in large chunks, so
+     *        that the rows of a matrix built together are close and cost
+     *        no heap call. Deallocated blocks are kept in free lists for
+     *        the next allocation of the same class: multiples of 8 bytes
+     *        up to MAX_REUSED (the old buffer of a growing row serves the
+     *        next row), powers of 2 above, up to half a chunk. Blocks are
+     *        not merged: the arena holds the peak of each class until
+     *        release() or the destructor give the chunks back. Blocks
+     *        larger than half a chunk get a chunk of their own, unmapped
+     *        at once by deallocate().
+     */
+    class ArenaResource : public MemoryResource {
+        public:
+            explicit ArenaResource( size_t chunk_bytes = 16 << 20 ) ;
+            ~ArenaResource() ;
+
+            const char* name() const ;
+            size_t reserved_bytes() const ;
+
+            /* frees every chunk: no container may use the arena anymore */
+            void release() ;
+
+            static const size_t MAX_REUSED = 512 ;
+
+        protected:
+            void* do_allocate( size_t nb_bytes, size_t alignment ) ;
+            void do_deallocate( void* p, size_t nb_bytes, size_t alignment ) ;
+
+            /* memory of a chunk, nb_bytes a multiple of chunk_alignment() */
+            virtual void* map_chunk( size_t nb_bytes ) ;
+            virtual void unmap_chunk( void* p, size_t nb_bytes ) ;
+            virtual size_t chunk_alignment() const ;
+
+        private:
+            struct Chunk {
+                char* data ;
+                size_t size ;
+            } ;
+
+            /* free list of the blocks of nb_bytes, and their size */
+            std::vector< char* >& free_list( size_t nb_bytes, size_t& block_bytes ) ;
+
+            size_t chunk_bytes_ ;
+            mutable std::mutex mutex_ ;
+            std::vector< Chunk > chunks_ ;        /* shared chunks */
+            std::map< void*, size_t > large_ ;    /* blocks with their own chunk */
+            /* deallocated blocks of 8 k bytes, k <= MAX_REUSED / 8 */
+            std::vector< std::vector< char* > > free_blocks_ ;
+            /* deallocated blocks of 2^k bytes, MAX_REUSED < 2^k */
+            std::vector< std::vector< char* > > free_medium_blocks_ ;
+            char* next_ ;                         /* free space of the last chunk */
+            char* end_ ;
+            size_t reserved_ ;
+    } ;
+
+    /**
+     * \brief HugePageResource is an arena whose chunks are 2 MB aligned
+     *        anonymous mappings advised as transparent huge pages
+     *        (madvise MADV_HUGEPAGE, Linux): the mesh and the matrix need
+     *        far fewer TLB entries. Whether the kernel backs them with
+     *        huge pages depends on /sys/kernel/mm/transparent_hugepage.
+     */
+    class HugePageResource : public ArenaResource {
+        public:
+            explicit HugePageResource( size_t chunk_bytes = 32 << 20 ) ;
+            ~HugePageResource() ;
+
+            const char* name() const ;
+
+            static const size_t HUGE_PAGE = 2 << 20 ;
+
+        protected:
+            void* map_chunk( size_t nb_bytes ) ;
+            void unmap_chunk( void* p, size_t nb_bytes ) ;
+            size_t chunk_alignment() const ;
+    } ;
+
+    /**
+     * \brief NumaResource is an arena whose chunks are placed by first
+     *        touch: a chunk is mapped without being touched, then its pages
+     *        are touched by the threads of the current ThreadPool, split
+     *        as parallel_for splits a loop. A page lands on the NUMA node
+     *        of the thread touching it first (pin the threads with
+     *        FEM2A_PIN_THREADS=1), instead of the node of the thread which
+     *        happens to fill the array. The ranges of a loop go to
+     *        whichever thread steals them, so the pages are spread over
+     *        the nodes of the pool like an interleave rather than bound to
+     *        their reader.
+     */
+    class NumaResource : public ArenaResource {
+        public:
+            explicit NumaResource( size_t chunk_bytes = 16 << 20 ) ;
+            ~NumaResource() ;
+
+            const char* name() const ;
+
+        protected:
+            void* map_chunk( size_t nb_bytes ) ;
+            void unmap_chunk( void* p, size_t nb_bytes ) ;
+            size_t chunk_alignment() const ;
+    } ;
+
+    /**
+     * \brief Allocator gives the memory of a MemoryResource to a standard
+     *        container. A default constructed allocator uses
+     *        MemoryResource::default_resource(). Moves and swaps take the
+     *        allocator along; a copy assignment keeps its own.
+     */
+    template< class T >
+    class Allocator {
+        public:
+            typedef T value_type ;
+            typedef std::false_type propagate_on_container_copy_assignment ;
+            typedef std::true_type propagate_on_container_move_assignment ;
+            typedef std::true_type propagate_on_container_swap ;
+
+            Allocator() : resource_( &MemoryResource::default_resource() ) {}
+            explicit Allocator( MemoryResource& resource ) : resource_( &resource ) {}
+            template< class U >
+            Allocator( const Allocator< U >& other ) : resource_( &other.resource() ) {}
+
+            T* allocate( size_t n )
+            {
+                return static_cast< T* >( resource_->allocate( n * sizeof( T ), alignof( T ) ) ) ;
+            }
+
+            void deallocate( T* p, size_t n )
+            {
+                resource_->deallocate( p, n * sizeof( T ), alignof( T ) ) ;
+            }
+
+            MemoryResource& resource() const { return *resource_ ; }
+
+        private:
+            MemoryResource* resource_ ;
+    } ;
+
+    template< class T, class U >
+    bool operator==( const Allocator< T >& a, const Allocator< U >& b )
+    {
+        return &a.resource() == &b.resource() ;
+    }
+
+    template< class T, class U >
+    bool operator!=( const Allocator< T >& a, const Allocator< U >& b )
+    {
+        return !( a == b ) ;
+    }
+
+    /* a std::vector in the memory of a MemoryResource */
+    template< class T >
+    using ResourceVector = std::vector< T, Allocator< T > > ;
+
+}
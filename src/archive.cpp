@@ -0,0 +1,183 @@
+#include "archive.h"
+#include "compression.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace FEM2A {
+
+    static const char archive_magic[8] = { 'F', 'E', 'M', '2', 'A', 'S', 'A', '1' } ;
+    static const uint64_t archive_header_size = 24 ;
+    static const uint64_t archive_footer_size = 24 ;
+
+    template< class T >
+    static void write_pod( std::ostream& out, const T& value )
+    {
+        out.write( reinterpret_cast< const char* >( &value ), sizeof( T ) ) ;
+    }
+
+    template< class T >
+    static bool read_pod( std::istream& in, T& value )
+    {
+        return (bool)in.read( reinterpret_cast< char* >( &value ), sizeof( T ) ) ;
+    }
+
+    /****************************************************************/
+    /* Implementation of SolutionArchiveWriter */
+    /****************************************************************/
+    SolutionArchiveWriter::SolutionArchiveWriter( const std::string& filename,
+        size_t nb_values, int keyframe_interval )
+        : out_( filename.c_str(), std::ios::binary | std::ios::trunc ),
+        nb_values_( nb_values ), keyframe_interval_( keyframe_interval > 0 ? keyframe_interval : 1 ),
+        offset_( archive_header_size ), closed_( false )
+    {
+        out_.write( archive_magic, 8 ) ;
+        write_pod( out_, (uint64_t)nb_values_ ) ;
+        write_pod( out_, (uint64_t)keyframe_interval_ ) ;
+    }
+
+    SolutionArchiveWriter::~SolutionArchiveWriter()
+    {
+        close() ;
+    }
+
+    bool SolutionArchiveWriter::is_open() const
+    {
+        return out_.is_open() && out_.good() && !closed_ ;
+    }
+
+    bool SolutionArchiveWriter::append( const std::vector< double >& x, double time )
+    {
+        assert( x.size() == nb_values_ ) ;
+        if( !is_open() ) return false ;
+        const bool keyframe = index_.size() % keyframe_interval_ == 0 ;
+        compress_doubles( x.data(), keyframe ? NULL : previous_.data(), nb_values_, buffer_ ) ;
+        out_.write( buffer_.data(), buffer_.size() ) ;
+        Entry e ;
+        e.offset = offset_ ;
+        e.size = buffer_.size() ;
+        e.time = time ;
+        index_.push_back( e ) ;
+        offset_ += buffer_.size() ;
+        previous_ = x ;
+        return out_.good() ;
+    }
+
+    bool SolutionArchiveWriter::close()
+    {
+        if( closed_ ) return true ;
+        closed_ = true ;
+        if( !out_.is_open() ) return false ;
+        for( int k = 0; k < index_.size(); ++k ) {
+            write_pod( out_, index_[k].offset ) ;
+            write_pod( out_, index_[k].size ) ;
+            write_pod( out_, index_[k].time ) ;
+        }
+        write_pod( out_, (uint64_t)index_.size() ) ;
+        write_pod( out_, offset_ ) ;
+        out_.write( archive_magic, 8 ) ;
+        out_.close() ;
+        return !out_.fail() ;
+    }
+
+    int SolutionArchiveWriter::nb_snapshots() const
+    {
+        return index_.size() ;
+    }
+
+    uint64_t SolutionArchiveWriter::compressed_bytes() const
+    {
+        return offset_ - archive_header_size ;
+    }
+
+    /****************************************************************/
+    /* Implementation of SolutionArchiveReader */
+    /****************************************************************/
+    SolutionArchiveReader::SolutionArchiveReader( const std::string& filename )
+        : in_( filename.c_str(), std::ios::binary ), valid_( false ),
+        nb_values_( 0 ), keyframe_interval_( 1 ), current_( -1 )
+    {
+        char magic[8] ;
+        if( !in_.read( magic, 8 ) || memcmp( magic, archive_magic, 8 ) != 0 ) return ;
+        if( !read_pod( in_, nb_values_ ) || !read_pod( in_, keyframe_interval_ ) ) return ;
+        if( keyframe_interval_ == 0 ) return ;
+
+        in_.seekg( 0, std::ios::end ) ;
+        const uint64_t file_size = in_.tellg() ;
+        if( file_size < archive_header_size + archive_footer_size ) return ;
+        in_.seekg( file_size - archive_footer_size ) ;
+        uint64_t nb_snapshots, index_offset ;
+        if( !read_pod( in_, nb_snapshots ) || !read_pod( in_, index_offset )
+            || !in_.read( magic, 8 ) || memcmp( magic, archive_magic, 8 ) != 0 ) return ;
+        if( index_offset + nb_snapshots * 24 + archive_footer_size != file_size ) return ;
+
+        in_.seekg( index_offset ) ;
+        index_.resize( nb_snapshots ) ;
+        for( uint64_t k = 0; k < nb_snapshots; ++k ) {
+            if( !read_pod( in_, index_[k].offset ) || !read_pod( in_, index_[k].size )
+                || !read_pod( in_, index_[k].time ) ) return ;
+            if( index_[k].offset + index_[k].size > index_offset ) return ;
+        }
+        valid_ = true ;
+    }
+
+    bool SolutionArchiveReader::is_open() const
+    {
+        return valid_ ;
+    }
+
+    int SolutionArchiveReader::nb_snapshots() const
+    {
+        return index_.size() ;
+    }
+
+    size_t SolutionArchiveReader::nb_values() const
+    {
+        return nb_values_ ;
+    }
+
+    double SolutionArchiveReader::time( int snapshot ) const
+    {
+        return index_[snapshot].time ;
+    }
+
+    bool SolutionArchiveReader::decode( int snapshot, const double* previous, std::vector< double >& x )
+    {
+        const Entry& e = index_[snapshot] ;
+        buffer_.resize( e.size ) ;
+        in_.clear() ;
+        in_.seekg( e.offset ) ;
+        if( !in_.read( buffer_.data(), e.size ) ) return false ;
+        x.resize( nb_values_ ) ;
+        return decompress_doubles( buffer_.data(), e.size, previous, nb_values_, x.data() ) ;
+    }
+
+    bool SolutionArchiveReader::read( int snapshot, std::vector< double >& x )
+    {
+        if( !valid_ || snapshot < 0 || snapshot >= index_.size() ) return false ;
+        /* decode from the keyframe, or from the snapshot kept if it is on
+         * the way */
+        const int keyframe = snapshot - snapshot % keyframe_interval_ ;
+        int k = keyframe ;
+        if( current_ >= keyframe && current_ <= snapshot ) {
+            k = current_ + 1 ;
+        } else {
+            current_ = -1 ;
+            if( !decode( keyframe, NULL, current_values_ ) ) return false ;
+            current_ = keyframe ;
+            k = keyframe + 1 ;
+        }
+        std::vector< double > next ;
+        for( ; k <= snapshot; ++k ) {
+            if( !decode( k, current_values_.data(), next ) ) {
+                current_ = -1 ;
+                return false ;
+            }
+            current_values_.swap( next ) ;
+            current_ = k ;
+        }
+        x = current_values_ ;
+        return true ;
+    }
+
+}
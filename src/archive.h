@@ -0,0 +1,105 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace FEM2A {
+
+    /**
+     * \brief SolutionArchiveWriter stores a series of solution vectors of
+     *        the same size (time steps, scenarios of a sweep) in a single
+     *        losslessly compressed file (see compress_doubles).
+     *
+     * Each snapshot is predicted from the previous one, except every
+     * keyframe_interval snapshots where it is coded alone, so that a
+     * reader reaches any snapshot by decoding at most keyframe_interval
+     * of them. Layout of the file (little-endian):
+     *   header  "FEM2ASA1", uint64 nb_values, uint64 keyframe_interval
+     *   records the compressed snapshots, one after the other
+     *   index   per snapshot: uint64 offset, uint64 size, double time
+     *   footer  uint64 nb_snapshots, uint64 offset of the index, "FEM2ASA1"
+     * The index is written by close() (or the destructor).
+     */
+    class SolutionArchiveWriter {
+        public:
+            SolutionArchiveWriter( const std::string& filename, size_t nb_values,
+                int keyframe_interval = 32 ) ;
+            ~SolutionArchiveWriter() ;
+
+            bool is_open() const ;
+
+            /**
+             * \brief Appends x (nb_values doubles) as the next snapshot.
+             * \return false if the file cannot be written
+             */
+            bool append( const std::vector< double >& x, double time = 0. ) ;
+
+            /**
+             * \brief Writes the index. No more snapshots can be appended.
+             */
+            bool close() ;
+
+            int nb_snapshots() const ;
+            /* bytes of the compressed records written so far */
+            uint64_t compressed_bytes() const ;
+
+        private:
+            struct Entry {
+                uint64_t offset ;
+                uint64_t size ;
+                double time ;
+            } ;
+
+            std::ofstream out_ ;
+            size_t nb_values_ ;
+            int keyframe_interval_ ;
+            std::vector< double > previous_ ;
+            std::vector< char > buffer_ ;
+            std::vector< Entry > index_ ;
+            uint64_t offset_ ;
+            bool closed_ ;
+    } ;
+
+    /**
+     * \brief SolutionArchiveReader reads the snapshots of a file written
+     *        by SolutionArchiveWriter in any order. The last snapshot read
+     *        is kept, so reading them in order decodes each one once.
+     */
+    class SolutionArchiveReader {
+        public:
+            explicit SolutionArchiveReader( const std::string& filename ) ;
+
+            /* false if the file is missing, truncated or not closed */
+            bool is_open() const ;
+
+            int nb_snapshots() const ;
+            size_t nb_values() const ;
+            double time( int snapshot ) const ;
+
+            /**
+             * \return false if the snapshot cannot be decoded
+             */
+            bool read( int snapshot, std::vector< double >& x ) ;
+
+        private:
+            struct Entry {
+                uint64_t offset ;
+                uint64_t size ;
+                double time ;
+            } ;
+
+            bool decode( int snapshot, const double* previous, std::vector< double >& x ) ;
+
+            std::ifstream in_ ;
+            bool valid_ ;
+            uint64_t nb_values_ ;
+            uint64_t keyframe_interval_ ;
+            std::vector< Entry > index_ ;
+            std::vector< char > buffer_ ;
+            int current_ ;                    /* snapshot in current_values_, -1 if none */
+            std::vector< double > current_values_ ;
+    } ;
+
+}
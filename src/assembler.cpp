@@ -0,0 +1,111 @@
+#include "assembler.h"
+
+#include <cmath>
+
+namespace FEM2A {
+
+    /* elementary contributions to the global system, P1 nodes only */
+    template< int N >
+    static void scatter( const Mat< N, N >& Ke, const int* nodes, SparseMatrix& K )
+    {
+        for( int i = 0; i < N; ++i ) {
+            for( int j = 0; j < N; ++j ) K.add( nodes[i], nodes[j], Ke( i, j ) ) ;
+        }
+    }
+
+    template< int N >
+    static void scatter( const Vec< N >& Fe, const int* nodes, std::vector< double >& F )
+    {
+        for( int i = 0; i < N; ++i ) F[nodes[i]] += Fe[i] ;
+    }
+
+    /****************************************************************/
+    /* Implementation of Assembler */
+    /****************************************************************/
+    template< class Element, class Rule, class Form >
+    Assembler< Element, Rule, Form >::Assembler( double (*coefficient)(vertex) )
+        : coefficient_( coefficient )
+    {
+    }
+
+    template< class Element, class Rule, class Form >
+    void Assembler< Element, Rule, Form >::element( const Mesh& M, int i, Local& Ke ) const
+    {
+        vertex v[Element::nb_vertices] ;
+        for( int k = 0; k < Element::nb_vertices; ++k ) {
+            v[k] = Element::dim == 2 ? M.get_triangle_vertex( i, k ) : M.get_edge_vertex( i, k ) ;
+        }
+
+        /* the mapping is affine: J and |J| are the same at all the points */
+        Mat< 2, 2 > inv_J ;
+        double det_J ;
+        if constexpr( Element::dim == 2 ) {
+            Mat< 2, 2 > J ;
+            J( 0, 0 ) = v[1].x - v[0].x ; J( 0, 1 ) = v[2].x - v[0].x ;
+            J( 1, 0 ) = v[1].y - v[0].y ; J( 1, 1 ) = v[2].y - v[0].y ;
+            det_J = det( J ) ;
+            inv_J = inverse( J ) ;
+        } else {
+            det_J = std::sqrt( ( v[1].x - v[0].x ) * ( v[1].x - v[0].x )
+                + ( v[1].y - v[0].y ) * ( v[1].y - v[0].y ) ) ;
+        }
+
+        Ke = Local() ;
+        for( int q = 0; q < Rule::nb_points; ++q ) {
+            const double xi = Rule::wxy[3 * q + 1], eta = Rule::wxy[3 * q + 2] ;
+            PointData< Element > p ;
+            p.phi = Element::shape( xi, eta ) ;
+            if constexpr( Form::needs_gradients ) {
+                p.grad = Element::grads( xi, eta ) * inv_J ;
+            }
+            if constexpr( Element::dim == 2 ) {
+                p.x.x = ( 1. - xi - eta ) * v[0].x + xi * v[1].x + eta * v[2].x ;
+                p.x.y = ( 1. - xi - eta ) * v[0].y + xi * v[1].y + eta * v[2].y ;
+            } else {
+                p.x.x = ( 1. - xi ) * v[0].x + xi * v[1].x ;
+                p.x.y = ( 1. - xi ) * v[0].y + xi * v[1].y ;
+            }
+            p.dx = Rule::wxy[3 * q] * det_J ;
+            Form::add( p, coefficient_( p.x ), Ke ) ;
+        }
+    }
+
+    template< class Element, class Rule, class Form >
+    void Assembler< Element, Rule, Form >::assemble( const Mesh& M, Global& G, int attribute ) const
+    {
+        static_assert( Element::nb_nodes == Element::nb_vertices,
+            "the mesh only numbers the vertices" ) ;
+        const int nb_elements = Element::dim == 2 ? M.nb_triangles() : M.nb_edges() ;
+        Local Ke ;
+        int nodes[nb_nodes] ;
+        for( int e = 0; e < nb_elements; ++e ) {
+            if( attribute >= 0 ) {
+                const int a = Element::dim == 2 ? M.get_triangle_attribute( e ) : M.get_edge_attribute( e ) ;
+                if( a != attribute ) continue ;
+            }
+            element( M, e, Ke ) ;
+            for( int k = 0; k < nb_nodes; ++k ) {
+                nodes[k] = Element::dim == 2 ? M.get_triangle_vertex_index( e, k )
+                    : M.get_edge_vertex_index( e, k ) ;
+            }
+            scatter( Ke, nodes, G ) ;
+        }
+    }
+
+    /****************************************************************/
+    /* Explicit instantiations */
+    /****************************************************************/
+    template class Assembler< P1Triangle, TriangleRule< 2 >, StiffnessForm > ;
+    template class Assembler< P1Triangle, TriangleRule< 2 >, MassForm > ;
+    template class Assembler< P1Triangle, TriangleRule< 2 >, SourceForm > ;
+    template class Assembler< P1Segment, SegmentRule< 2 >, SourceForm > ;
+    template class Assembler< P1Segment, SegmentRule< 2 >, MassForm > ;
+
+    template P2StiffnessAssembler::Assembler( double (*)(vertex) ) ;
+    template void P2StiffnessAssembler::element(
+        const Mesh&, int, P2StiffnessAssembler::Local& ) const ;
+    template P2MassAssembler::Assembler( double (*)(vertex) ) ;
+    template void P2MassAssembler::element(
+        const Mesh&, int, P2MassAssembler::Local& ) const ;
+
+}
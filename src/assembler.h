@@ -0,0 +1,309 @@
+#pragma once
+
+#include "mesh.h"
+#include "solver.h"
+#include "small_matrix.h"
+
+#include <type_traits>
+#include <vector>
+
+namespace FEM2A {
+
+    /****************************************************************/
+    /* Quadrature rules as types */
+    /****************************************************************/
+
+    /**
+     * \brief Quadrature rules known at compile time, with the same
+     *        points and weights as Quadrature::get_quadrature( Order ).
+     *        TriangleRule< Order > integrates exactly the polynomials of
+     *        degree Order (0, 2, 4 or 6) on the reference triangle,
+     *        SegmentRule< Order > (0 or 2) on the segment [0,1].
+     */
+    template< int Order > struct TriangleRule ;
+    template< int Order > struct SegmentRule ;
+
+    template<> struct TriangleRule< 0 > {
+        static constexpr int dim = 2 ;
+        static constexpr int nb_points = 1 ;
+        static constexpr double wxy[3] = {
+            0.5, 0.333333333333333, 0.333333333333333
+        } ;
+    } ;
+
+    template<> struct TriangleRule< 2 > {
+        static constexpr int dim = 2 ;
+        static constexpr int nb_points = 3 ;
+        static constexpr double wxy[9] = {
+            0.166666666666667, 0.166666666666667, 0.166666666666667,
+            0.166666666666667, 0.166666666666667, 0.666666666666667,
+            0.166666666666667, 0.666666666666667, 0.166666666666667
+        } ;
+    } ;
+
+    template<> struct TriangleRule< 4 > {
+        static constexpr int dim = 2 ;
+        static constexpr int nb_points = 6 ;
+        static constexpr double wxy[18] = {
+            0.0549758718276609, 0.0915762135097707, 0.0915762135097707,
+            0.0549758718276609, 0.0915762135097707, 0.816847572980459,
+            0.0549758718276609, 0.816847572980459, 0.0915762135097707,
+            0.111690794839006, 0.445948490915965, 0.445948490915965,
+            0.111690794839006, 0.445948490915965, 0.10810301816807,
+            0.111690794839006, 0.10810301816807, 0.445948490915965
+        } ;
+    } ;
+
+    template<> struct TriangleRule< 6 > {
+        static constexpr int dim = 2 ;
+        static constexpr int nb_points = 12 ;
+        static constexpr double wxy[36] = {
+            0.0254224531851034, 0.0630890144915022, 0.0630890144915022,
+            0.0254224531851034, 0.0630890144915022, 0.873821971016996,
+            0.0254224531851034, 0.873821971016996, 0.0630890144915022,
+            0.0583931378631897, 0.24928674517091, 0.24928674517091,
+            0.0583931378631897, 0.24928674517091, 0.501426509658179,
+            0.0583931378631897, 0.501426509658179, 0.24928674517091,
+            0.0414255378091868, 0.0531450498448169, 0.310352451033784,
+            0.0414255378091868, 0.310352451033784, 0.0531450498448169,
+            0.0414255378091868, 0.0531450498448169, 0.636502499121399,
+            0.0414255378091868, 0.636502499121399, 0.0531450498448169,
+            0.0414255378091868, 0.310352451033784, 0.636502499121399,
+            0.0414255378091868, 0.636502499121399, 0.310352451033784
+        } ;
+    } ;
+
+    /* segments: (weight, x, 0) to share the layout of the triangles */
+    template<> struct SegmentRule< 0 > {
+        static constexpr int dim = 1 ;
+        static constexpr int nb_points = 1 ;
+        static constexpr double wxy[3] = { 1., 0.5, 0. } ;
+    } ;
+
+    template<> struct SegmentRule< 2 > {
+        static constexpr int dim = 1 ;
+        static constexpr int nb_points = 2 ;
+        static constexpr double wxy[6] = {
+            0.5, 0.21132486540518708, 0.,
+            0.5, 0.7886751345948129, 0.
+        } ;
+    } ;
+
+    /****************************************************************/
+    /* Elements as types */
+    /****************************************************************/
+
+    /**
+     * \brief Reference elements known at compile time. Each one gives
+     *        its shape functions and their reference gradients at a
+     *        point (xi, eta) of the reference element, as fixed-size
+     *        matrices. The nodes are the vertices, then (P2) the middles
+     *        of the edges (0,1), (1,2) and (2,0).
+     */
+    struct P1Segment {
+        static constexpr int dim = 1 ;
+        static constexpr int nb_vertices = 2 ;
+        static constexpr int nb_nodes = 2 ;
+
+        static constexpr Vec< 2 > shape( double xi, double )
+        {
+            Vec< 2 > phi ;
+            phi[0] = 1. - xi ;
+            phi[1] = xi ;
+            return phi ;
+        }
+
+        static constexpr Mat< 2, 1 > grads( double, double )
+        {
+            Mat< 2, 1 > G ;
+            G( 0, 0 ) = -1. ;
+            G( 1, 0 ) = 1. ;
+            return G ;
+        }
+    } ;
+
+    struct P1Triangle {
+        static constexpr int dim = 2 ;
+        static constexpr int nb_vertices = 3 ;
+        static constexpr int nb_nodes = 3 ;
+
+        static constexpr Vec< 3 > shape( double xi, double eta )
+        {
+            Vec< 3 > phi ;
+            phi[0] = 1. - xi - eta ;
+            phi[1] = xi ;
+            phi[2] = eta ;
+            return phi ;
+        }
+
+        static constexpr Mat< 3, 2 > grads( double, double )
+        {
+            Mat< 3, 2 > G ;
+            G( 0, 0 ) = -1. ; G( 0, 1 ) = -1. ;
+            G( 1, 0 ) = 1. ;  G( 1, 1 ) = 0. ;
+            G( 2, 0 ) = 0. ;  G( 2, 1 ) = 1. ;
+            return G ;
+        }
+    } ;
+
+    struct P2Triangle {
+        static constexpr int dim = 2 ;
+        static constexpr int nb_vertices = 3 ;
+        static constexpr int nb_nodes = 6 ;
+
+        static constexpr Vec< 6 > shape( double xi, double eta )
+        {
+            const double l0 = 1. - xi - eta, l1 = xi, l2 = eta ;
+            Vec< 6 > phi ;
+            phi[0] = l0 * ( 2. * l0 - 1. ) ;
+            phi[1] = l1 * ( 2. * l1 - 1. ) ;
+            phi[2] = l2 * ( 2. * l2 - 1. ) ;
+            phi[3] = 4. * l0 * l1 ;
+            phi[4] = 4. * l1 * l2 ;
+            phi[5] = 4. * l2 * l0 ;
+            return phi ;
+        }
+
+        static constexpr Mat< 6, 2 > grads( double xi, double eta )
+        {
+            const double l0 = 1. - xi - eta, l1 = xi, l2 = eta ;
+            Mat< 6, 2 > G ;
+            G( 0, 0 ) = -( 4. * l0 - 1. ) ;     G( 0, 1 ) = -( 4. * l0 - 1. ) ;
+            G( 1, 0 ) = 4. * l1 - 1. ;          G( 1, 1 ) = 0. ;
+            G( 2, 0 ) = 0. ;                    G( 2, 1 ) = 4. * l2 - 1. ;
+            G( 3, 0 ) = 4. * ( l0 - l1 ) ;      G( 3, 1 ) = -4. * l1 ;
+            G( 4, 0 ) = 4. * l2 ;               G( 4, 1 ) = 4. * l1 ;
+            G( 5, 0 ) = -4. * l2 ;              G( 5, 1 ) = 4. * ( l0 - l2 ) ;
+            return G ;
+        }
+    } ;
+
+    /****************************************************************/
+    /* Forms as types */
+    /****************************************************************/
+
+    /**
+     * \brief Everything a form needs at one quadrature point of an
+     *        element: shape functions, world gradients (triangles only),
+     *        world position and w_q |J|.
+     */
+    template< class Element >
+    struct PointData {
+        Vec< Element::nb_nodes > phi ;
+        Mat< Element::nb_nodes, 2 > grad ;
+        vertex x ;
+        double dx ;
+    } ;
+
+    /**
+     * \brief The forms integrated by an Assembler, with a coefficient c:
+     *          StiffnessForm: Ke(i,j) += c grad phi_i . grad phi_j
+     *          MassForm:      Ke(i,j) += c phi_i phi_j
+     *          SourceForm:    Fe(i)   += c phi_i
+     */
+    struct StiffnessForm {
+        static constexpr bool bilinear = true ;
+        static constexpr bool needs_gradients = true ;
+
+        template< class Element >
+        static void add( const PointData< Element >& p, double c,
+            Mat< Element::nb_nodes, Element::nb_nodes >& Ke )
+        {
+            Ke += ( c * p.dx ) * ( p.grad * p.grad.transpose() ) ;
+        }
+    } ;
+
+    struct MassForm {
+        static constexpr bool bilinear = true ;
+        static constexpr bool needs_gradients = false ;
+
+        template< class Element >
+        static void add( const PointData< Element >& p, double c,
+            Mat< Element::nb_nodes, Element::nb_nodes >& Me )
+        {
+            Me += ( c * p.dx ) * ( p.phi * p.phi.transpose() ) ;
+        }
+    } ;
+
+    struct SourceForm {
+        static constexpr bool bilinear = false ;
+        static constexpr bool needs_gradients = false ;
+
+        template< class Element >
+        static void add( const PointData< Element >& p, double c,
+            Vec< Element::nb_nodes >& Fe )
+        {
+            Fe += ( c * p.dx ) * p.phi ;
+        }
+    } ;
+
+    /****************************************************************/
+    /* Assembler */
+    /****************************************************************/
+
+    /**
+     * \brief Assembler computes the elementary matrices (bilinear forms)
+     *        or vectors (linear forms) of Form on the elements of type
+     *        Element with the quadrature rule Rule, and adds them to the
+     *        global system.
+     *
+     * Unlike assemble_elementary_matrix, which tests at run time the
+     * dimension of the ShapeFunctions, the size of the Quadrature and
+     * the border flag of the ElementMapping, all these are template
+     * parameters: the kernels are unrolled and branch-free. The
+     * combinations used by FEM2A are explicitly instantiated in
+     * assembler.cpp.
+     */
+    template< class Element, class Rule, class Form >
+    class Assembler {
+        static_assert( Element::dim == Rule::dim, "quadrature rule of another element" ) ;
+        static_assert( !Form::needs_gradients || Element::dim == 2,
+            "gradients are only defined on triangles" ) ;
+
+        public:
+            static constexpr int nb_nodes = Element::nb_nodes ;
+
+            /* Mat< N, N > for a bilinear form, Vec< N > for a linear one */
+            typedef typename std::conditional< Form::bilinear,
+                Mat< nb_nodes, nb_nodes >, Vec< nb_nodes > >::type Local ;
+            /* SparseMatrix for a bilinear form, vector for a linear one */
+            typedef typename std::conditional< Form::bilinear,
+                SparseMatrix, std::vector< double > >::type Global ;
+
+            /**
+             * \param coefficient The coefficient c(x,y) of the form
+             */
+            explicit Assembler( double (*coefficient)(vertex) ) ;
+
+            /**
+             * \brief Computes the elementary matrix or vector of the
+             *        element i (a triangle, or an edge if Element::dim
+             *        is 1) of M.
+             */
+            void element( const Mesh& M, int i, Local& Ke ) const ;
+
+            /**
+             * \brief Adds the contributions of all the elements of M (or
+             *        only the ones whose attribute is attribute, if >= 0)
+             *        to G. Only for P1 elements, whose nodes are the
+             *        vertices of the mesh.
+             */
+            void assemble( const Mesh& M, Global& G, int attribute = -1 ) const ;
+
+        private:
+            double (*coefficient_)(vertex) ;
+    } ;
+
+    /*
+     * The instantiations available (see assembler.cpp). P2 triangles
+     * only have element(): the mesh has no numbering of the edge nodes.
+     */
+    typedef Assembler< P1Triangle, TriangleRule< 2 >, StiffnessForm > P1StiffnessAssembler ;
+    typedef Assembler< P1Triangle, TriangleRule< 2 >, MassForm > P1MassAssembler ;
+    typedef Assembler< P1Triangle, TriangleRule< 2 >, SourceForm > P1SourceAssembler ;
+    typedef Assembler< P1Segment, SegmentRule< 2 >, SourceForm > P1NeumannAssembler ;
+    typedef Assembler< P1Segment, SegmentRule< 2 >, MassForm > P1BoundaryMassAssembler ;
+    typedef Assembler< P2Triangle, TriangleRule< 4 >, StiffnessForm > P2StiffnessAssembler ;
+    typedef Assembler< P2Triangle, TriangleRule< 4 >, MassForm > P2MassAssembler ;
+
+}
@@ -0,0 +1,162 @@
+#include "async_writer.h"
+
+#include <chrono>
+
+namespace FEM2A {
+
+    static double seconds_between( std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end )
+    {
+        return std::chrono::duration< double >( end - start ).count() ;
+    }
+
+    /****************************************************************/
+    /* Implementation of AsyncWriter */
+    /****************************************************************/
+    AsyncWriter::AsyncWriter( const Mesh& M, Format format, size_t memory_budget )
+        : mesh_( M ), format_( format ), memory_budget_( memory_budget ),
+        gradient_( false ), queued_bytes_( 0 ), max_queued_bytes_( 0 ), busy_( false ),
+        stop_( false ), failed_( false ), nb_written_( 0 ), blocked_time_( 0. ), io_time_( 0. )
+    {
+        thread_ = std::thread( &AsyncWriter::io_loop, this ) ;
+    }
+
+    AsyncWriter::~AsyncWriter()
+    {
+        flush() ;
+        {
+            std::unique_lock< std::mutex > lock( mutex_ ) ;
+            stop_ = true ;
+        }
+        not_empty_.notify_one() ;
+        thread_.join() ;
+    }
+
+    void AsyncWriter::set_series( const std::string& pvd_filename )
+    {
+        flush() ;
+        series_.reset( new PvdWriter( pvd_filename ) ) ;
+    }
+
+    void AsyncWriter::set_gradient( bool gradient )
+    {
+        flush() ;
+        gradient_ = gradient ;
+    }
+
+    void AsyncWriter::write( std::vector< double >&& u, const std::string& basename, double time )
+    {
+        const size_t nb_bytes = u.size() * sizeof( double ) ;
+        std::shared_ptr< std::vector< double > > values(
+            new std::vector< double >( std::move( u ) ) ) ;
+        u.clear() ;
+        if( format_ == MEDIT ) {
+            submit( [values, basename]() {
+                save_solution( *values, basename + ".bb" ) ;
+                return true ;
+            }, nb_bytes ) ;
+            return ;
+        }
+        const bool compress = format_ == VTU_COMPRESSED ;
+        const bool gradient = gradient_ ;
+        submit( [this, values, basename, time, compress, gradient]() {
+            VtuWriter vtu( mesh_ ) ;
+            vtu.set_compression( compress ) ;
+            vtu.add_point_field( "u", *values ) ;
+            if( gradient ) vtu.add_gradient( "grad_u", *values ) ;
+            const std::string filename = basename + ".vtu" ;
+            bool ok = vtu.write( filename ) ;
+            /* only the I/O thread touches the series */
+            if( ok && series_ ) ok = series_->add( time, filename ) ;
+            return ok ;
+        }, nb_bytes ) ;
+    }
+
+    void AsyncWriter::write_mesh( const std::string& filename )
+    {
+        submit( [this, filename]() { return mesh_.save( filename ) ; } ) ;
+    }
+
+    void AsyncWriter::submit( std::function< bool() > task, size_t nb_bytes )
+    {
+        std::unique_lock< std::mutex > lock( mutex_ ) ;
+        if( queued_bytes_ > 0 && queued_bytes_ + nb_bytes > memory_budget_ ) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+            while( queued_bytes_ > 0 && queued_bytes_ + nb_bytes > memory_budget_ ) {
+                space_.wait( lock ) ;
+            }
+            blocked_time_ += seconds_between( start, std::chrono::steady_clock::now() ) ;
+        }
+        Task t ;
+        t.run = std::move( task ) ;
+        t.nb_bytes = nb_bytes ;
+        tasks_.push_back( std::move( t ) ) ;
+        queued_bytes_ += nb_bytes ;
+        if( queued_bytes_ > max_queued_bytes_ ) max_queued_bytes_ = queued_bytes_ ;
+        not_empty_.notify_one() ;
+    }
+
+    bool AsyncWriter::flush()
+    {
+        std::unique_lock< std::mutex > lock( mutex_ ) ;
+        while( !tasks_.empty() || busy_ ) idle_.wait( lock ) ;
+        const bool ok = !failed_ ;
+        failed_ = false ;
+        return ok ;
+    }
+
+    void AsyncWriter::io_loop()
+    {
+        while( true ) {
+            Task task ;
+            {
+                std::unique_lock< std::mutex > lock( mutex_ ) ;
+                while( tasks_.empty() && !stop_ ) not_empty_.wait( lock ) ;
+                if( tasks_.empty() ) return ;
+                task = std::move( tasks_.front() ) ;
+                tasks_.pop_front() ;
+                busy_ = true ;
+            }
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+            const bool ok = task.run() ;
+            /* the buffer is released before the budget is */
+            task.run = nullptr ;
+            const double elapsed = seconds_between( start, std::chrono::steady_clock::now() ) ;
+            {
+                std::unique_lock< std::mutex > lock( mutex_ ) ;
+                busy_ = false ;
+                queued_bytes_ -= task.nb_bytes ;
+                io_time_ += elapsed ;
+                if( ok ) ++nb_written_ ;
+                else failed_ = true ;
+                space_.notify_all() ;
+                if( tasks_.empty() ) idle_.notify_all() ;
+            }
+        }
+    }
+
+    int AsyncWriter::nb_written() const
+    {
+        std::unique_lock< std::mutex > lock( mutex_ ) ;
+        return nb_written_ ;
+    }
+
+    double AsyncWriter::blocked_time() const
+    {
+        std::unique_lock< std::mutex > lock( mutex_ ) ;
+        return blocked_time_ ;
+    }
+
+    double AsyncWriter::io_time() const
+    {
+        std::unique_lock< std::mutex > lock( mutex_ ) ;
+        return io_time_ ;
+    }
+
+    size_t AsyncWriter::max_queued_bytes() const
+    {
+        std::unique_lock< std::mutex > lock( mutex_ ) ;
+        return max_queued_bytes_ ;
+    }
+
+}
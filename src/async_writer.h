@@ -0,0 +1,125 @@
+#pragma once
+
+#include "mesh.h"
+#include "vtu.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief AsyncWriter writes simulation results from a background I/O
+     *        thread, so that the compute thread goes on while the files
+     *        are formatted and written.
+     *
+     * write() takes ownership of the solution buffer (moved, not copied)
+     * and queues it. The bytes of the queued and in-flight buffers are
+     * bounded by the memory budget: write() blocks while the budget would
+     * be exceeded (a single buffer larger than the budget is still
+     * accepted when the queue is empty). flush() is a barrier returning
+     * once every write submitted before it is on disk; the destructor
+     * flushes too.
+     *
+     * write() may be called from several threads. The mesh must outlive
+     * the writer and not change while writes are pending.
+     */
+    class AsyncWriter {
+        public:
+            enum Format {
+                MEDIT,          /* <basename>.bb, see save_solution */
+                VTU,            /* <basename>.vtu, see VtuWriter */
+                VTU_COMPRESSED  /* <basename>.vtu, LZ4 compressed */
+            } ;
+
+            /**
+             * \param M The mesh of the solutions
+             * \param format The format of write()
+             * \param memory_budget Bytes of solutions queued at most
+             */
+            AsyncWriter( const Mesh& M, Format format, size_t memory_budget = 256 << 20 ) ;
+            ~AsyncWriter() ;
+
+            /**
+             * \brief With the VTU formats, adds each file written to the
+             *        .pvd collection pvd_filename, with the time of write().
+             */
+            void set_series( const std::string& pvd_filename ) ;
+
+            /**
+             * \brief With the VTU formats, also writes the gradient of u
+             *        per triangle as the cell field grad_u.
+             */
+            void set_gradient( bool gradient ) ;
+
+            /**
+             * \brief Queues the writing of u (one value per vertex) to
+             *        <basename> with the extension of the format. u is
+             *        left empty.
+             */
+            void write( std::vector< double >&& u, const std::string& basename, double time = 0. ) ;
+
+            /**
+             * \brief Queues the writing of the mesh in the medit format.
+             */
+            void write_mesh( const std::string& filename ) ;
+
+            /**
+             * \brief Queues any output task, counted as nb_bytes in the
+             *        memory budget. The task returns false on failure.
+             */
+            void submit( std::function< bool() > task, size_t nb_bytes = 0 ) ;
+
+            /**
+             * \brief Waits until all the tasks submitted so far are done.
+             * \return false if a task failed since the last flush
+             */
+            bool flush() ;
+
+            int nb_written() const ;
+            /* seconds the callers of write() waited for the budget */
+            double blocked_time() const ;
+            /* seconds spent by the I/O thread in the tasks */
+            double io_time() const ;
+            size_t max_queued_bytes() const ;
+
+        private:
+            AsyncWriter( const AsyncWriter& ) ;
+            AsyncWriter& operator=( const AsyncWriter& ) ;
+
+            struct Task {
+                std::function< bool() > run ;
+                size_t nb_bytes ;
+            } ;
+
+            void io_loop() ;
+
+            const Mesh& mesh_ ;
+            Format format_ ;
+            size_t memory_budget_ ;
+            std::unique_ptr< PvdWriter > series_ ;
+            bool gradient_ ;
+
+            mutable std::mutex mutex_ ;
+            std::condition_variable not_empty_ ;
+            std::condition_variable space_ ;     /* bytes released */
+            std::condition_variable idle_ ;      /* queue empty and nothing in flight */
+            std::deque< Task > tasks_ ;
+            size_t queued_bytes_ ;               /* queued and in flight */
+            size_t max_queued_bytes_ ;
+            bool busy_ ;
+            bool stop_ ;
+            bool failed_ ;
+            int nb_written_ ;
+            double blocked_time_ ;
+            double io_time_ ;
+            std::thread thread_ ;
+    } ;
+
+}
@@ -0,0 +1,1644 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "solver.h"
+#include "matrix_free.h"
+#include "streaming.h"
+#include "partition.h"
+#include "schwarz.h"
+#include "assembler.h"
+#include "incremental.h"
+#include "material.h"
+#include "vtu.h"
+#include "async_writer.h"
+#include "archive.h"
+#include "compression.h"
+#include "transient.h"
+#include "server.h"
+#include "system_cache.h"
+#include "adjoint.h"
+#include "reduced_basis.h"
+#include "pipeline.h"
+#include "parallel.h"
+#include "allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace FEM2A {
+    namespace Bench {
+        /* number of calls to operator new since the start of the program,
+         * counted by bench_allocations.cpp (linked into fem2a only) */
+        extern std::atomic< long > nb_allocations;
+
+        double seconds_since( std::chrono::steady_clock::time_point start )
+        {
+            return std::chrono::duration< double >(
+                std::chrono::steady_clock::now() - start ).count();
+        }
+
+        /* peak resident memory of the process in MB (VmHWM), -1 if unknown */
+        double peak_memory_mb()
+        {
+            std::ifstream status( "/proc/self/status" );
+            std::string key;
+            while ( status >> key ) {
+                if ( key == "VmHWM:" ) {
+                    double kb;
+                    status >> kb;
+                    return kb / 1024.;
+                }
+            }
+            return -1.;
+        }
+
+        double unit_fct( vertex v )
+        {
+            return 1.;
+        }
+
+        /* mean time in seconds of one product y = A x */
+        double time_mult( const LinearOperator& A, const std::vector< double >& x, int nb_products )
+        {
+            std::vector< double > y;
+            A.mult( x, y );
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int i = 0; i < nb_products; ++i ) A.mult( x, y );
+            return seconds_since( start ) / nb_products;
+        }
+
+        /* mean time in seconds of one Jacobi PCG iteration */
+        double time_pcg( const LinearOperator& A, const std::vector< double >& b, int nb_iterations )
+        {
+            SolverConfig config;
+            config.method = SolverConfig::PCG;
+            config.preconditioner = SolverConfig::JACOBI;
+            config.threshold = 1e-30;
+            config.max_iterations = nb_iterations;
+            std::vector< double > x( b.size(), 0. );
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            LinearSolver solver( A, config );
+            solver.solve( b, x );
+            return seconds_since( start ) / std::max( solver.iterations(), 1 );
+        }
+
+        /**
+         * \brief Compares the assembled SparseMatrix and the
+         *        MatrixFreeStiffness on the unit square split in
+         *        2 nx^2 triangles: set-up time, memory, products and
+         *        PCG iterations per second.
+         */
+        void matrix_free_pb( int nx, bool verbose )
+        {
+            std::cout << "Matrix-free vs assembled stiffness on " << nx << "x" << nx
+                << " grid" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            std::cout << mesh.nb_vertices() << " vertices, " << mesh.nb_triangles()
+                << " triangles" << std::endl;
+            std::vector< bool > dirichlet( mesh.get_bdr_attr_max() + 1, true );
+            const double mb = 1024. * 1024.;
+            const int nb_products = 10;
+
+            std::vector< double > x( mesh.nb_vertices() ), b;
+            for ( int i = 0; i < x.size(); ++i ) x[i] = std::sin( 0.001 * i );
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            MatrixFreeStiffness A_free( mesh, unit_fct, dirichlet );
+            const double setup_free = seconds_since( start );
+            std::cout << "matrix-free: set-up " << setup_free << " s, "
+                << A_free.memory_bytes() / mb << " MB, " << A_free.nb_colors() << " colors" << std::endl;
+            const double mult_free = time_mult( A_free, x, nb_products );
+            A_free.mult( x, b );
+            const double pcg_free = time_pcg( A_free, b, nb_products );
+            std::cout << "matrix-free: " << mult_free << " s per product, "
+                << pcg_free << " s per PCG iteration" << std::endl;
+
+            start = std::chrono::steady_clock::now();
+            SparseMatrix K( mesh.nb_vertices() );
+            Quadrature quadrature = Quadrature::get_quadrature( 2 );
+            ShapeFunctions shape_functions( 2, 1 );
+            for ( int t = 0; t < mesh.nb_triangles(); ++t ) {
+                Mat< 3, 3 > Ke;
+                ElementMapping mapping( mesh, false, t );
+                assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                local_to_global_matrix( mesh, t, Ke, K );
+            }
+            std::vector< double > values( mesh.nb_vertices(), 0. ), F( mesh.nb_vertices(), 0. );
+            apply_dirichlet_boundary_conditions( mesh, dirichlet, values, K, F );
+            const double setup_csr = seconds_since( start );
+            std::cout << "assembled:   set-up " << setup_csr << " s, "
+                << K.memory_bytes() / mb << " MB" << std::endl;
+            const double mult_csr = time_mult( K, x, nb_products );
+            const double pcg_csr = time_pcg( K, b, nb_products );
+            std::cout << "assembled:   " << mult_csr << " s per product, "
+                << pcg_csr << " s per PCG iteration" << std::endl;
+
+            if ( verbose ) {
+                std::vector< double > y;
+                K.mult( x, y );
+                double err = 0.;
+                for ( int i = 0; i < y.size(); ++i ) err = std::max( err, std::fabs( y[i] - b[i] ) );
+                std::cout << "max difference of the products: " << err << std::endl;
+            }
+        }
+
+
+        /**
+         * \brief Compares the all-double Jacobi PCG and the
+         *        MixedPrecisionSolver on -div(grad u) = 1 with u = 0 on the
+         *        border of the mesh: time, iterations, bytes of matrix and
+         *        preconditioner read per iteration, accuracy.
+         */
+        void mixed_precision_pb( const std::string& mesh_filename, double threshold, bool verbose )
+        {
+            std::cout << "Mixed precision vs double PCG on " << mesh_filename << std::endl;
+            Mesh mesh;
+            mesh.load( mesh_filename );
+            mesh.set_attribute( unit_fct, 1, true );
+            std::vector< bool > dirichlet( 2, true );
+
+            SparseMatrix K( mesh.nb_vertices() );
+            std::vector< double > F( mesh.nb_vertices(), 0. );
+            Quadrature quadrature = Quadrature::get_quadrature( 2 );
+            ShapeFunctions shape_functions( 2, 1 );
+            for ( int t = 0; t < mesh.nb_triangles(); ++t ) {
+                Mat< 3, 3 > Ke;
+                std::vector< double > Fe( 3, 0. );
+                ElementMapping mapping( mesh, false, t );
+                assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                local_to_global_matrix( mesh, t, Ke, K );
+                assemble_elementary_vector( mapping, shape_functions, quadrature, unit_fct, Fe );
+                local_to_global_vector( mesh, false, t, Fe, F );
+            }
+            std::vector< double > values( mesh.nb_vertices(), 0. );
+            apply_dirichlet_boundary_conditions( mesh, dirichlet, values, K, F );
+
+            size_t nnz = 0;
+            for ( int i = 0; i < K.nb_rows(); ++i ) nnz += K.get_cols_at_line( i ).size();
+            const size_t n = K.nb_rows();
+            std::cout << n << " unknowns, " << nnz << " non-zeros" << std::endl;
+
+            SolverConfig config;
+            config.method = SolverConfig::PCG;
+            config.preconditioner = SolverConfig::JACOBI;
+            config.threshold = threshold;
+            config.verbose = verbose;
+
+            std::vector< double > x_double, x_mixed;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            LinearSolver double_solver( K, config );
+            double_solver.solve( F, x_double );
+            const double time_double = seconds_since( start );
+            /* values, columns and inverse diagonal read per product */
+            const double bytes_double = nnz * ( sizeof( double ) + sizeof( int ) ) + n * sizeof( double );
+            std::cout << "double: " << time_double << " s, " << double_solver.iterations()
+                << " iterations, " << bytes_double / 1e6
+                << " MB read per iteration, residual " << double_solver.residual() << std::endl;
+
+            start = std::chrono::steady_clock::now();
+            MixedPrecisionSolver mixed_solver( K, config );
+            mixed_solver.solve( F, x_mixed );
+            const double time_mixed = seconds_since( start );
+            const double bytes_mixed = nnz * ( sizeof( float ) + sizeof( int ) ) + n * sizeof( float );
+            std::cout << "mixed:  " << time_mixed << " s, " << mixed_solver.iterations()
+                << " float iterations in " << mixed_solver.refinements() << " refinements, "
+                << bytes_mixed / 1e6 << " MB read per iteration, residual "
+                << mixed_solver.residual() << std::endl;
+
+            double diff = 0., norm = 0.;
+            for ( int i = 0; i < n; ++i ) {
+                diff = std::max( diff, std::fabs( x_double[i] - x_mixed[i] ) );
+                norm = std::max( norm, std::fabs( x_double[i] ) );
+            }
+            std::cout << "speed-up " << time_double / time_mixed
+                << ", max relative difference of the solutions " << diff / norm << std::endl;
+        }
+
+        /* manufactured solution on the 20 x 20 geothermie domain */
+        double manufactured_fct( vertex v )
+        {
+            return std::sin( M_PI * v.x / 20. ) * std::sin( M_PI * v.y / 20. ) + v.x / 20.;
+        }
+
+        /* -div(grad u) for u = manufactured_fct */
+        double manufactured_source_fct( vertex v )
+        {
+            return 2. * M_PI * M_PI / 400. * std::sin( M_PI * v.x / 20. ) * std::sin( M_PI * v.y / 20. );
+        }
+
+        /**
+         * \brief Solves -div(grad u) = f with the manufactured solution u on
+         *        the border, with CG and Jacobi, at the fixed threshold 1e-12
+         *        then at discretization_factor * h^2: iterations, time and
+         *        relative nodal L2 error against u.
+         */
+        void tolerance_pb( const std::string& mesh_filename, double discretization_factor, bool verbose )
+        {
+            std::cout << "Fixed vs mesh-size threshold on " << mesh_filename << std::endl;
+            Mesh mesh;
+            mesh.load( mesh_filename );
+            const int n = mesh.nb_vertices();
+            SparseMatrix K( n );
+            std::vector< double > F( n, 0. );
+            Quadrature quadrature = Quadrature::get_quadrature( 2 );
+            ShapeFunctions shape_functions( 2, 1 );
+            for ( int t = 0; t < mesh.nb_triangles(); ++t ) {
+                Mat< 3, 3 > Ke;
+                std::vector< double > Fe( 3, 0. );
+                ElementMapping mapping( mesh, false, t );
+                assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                local_to_global_matrix( mesh, t, Ke, K );
+                assemble_elementary_vector( mapping, shape_functions, quadrature, manufactured_source_fct, Fe );
+                local_to_global_vector( mesh, false, t, Fe, F );
+            }
+            std::vector< double > exact( n );
+            for ( int i = 0; i < n; ++i ) exact[i] = manufactured_fct( mesh.get_vertex( i ) );
+            std::vector< bool > dirichlet( mesh.get_bdr_attr_max() + 1, true );
+            apply_dirichlet_boundary_conditions( mesh, dirichlet, exact, K, F );
+
+            for ( int pass = 0; pass < 2; ++pass ) {
+                SolverConfig config;
+                config.method = SolverConfig::CG;
+                config.preconditioner = SolverConfig::JACOBI;
+                config.verbose = verbose;
+                if ( pass == 1 ) {
+                    config.discretization_factor = discretization_factor;
+                    config.adapt_to_mesh( mesh );
+                }
+                std::vector< double > history, x;
+                config.progress = record_residual_history;
+                config.progress_data = &history;
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                solve( K, F, x, config );
+                const double time = seconds_since( start );
+
+                double error = 0., norm = 0.;
+                for ( int i = 0; i < n; ++i ) {
+                    error += ( x[i] - exact[i] ) * ( x[i] - exact[i] );
+                    norm += exact[i] * exact[i];
+                }
+                std::cout << ( pass == 0 ? "fixed:       " : "mesh-size:   " ) << "threshold "
+                    << config.threshold << ", " << history.size() << " iterations, " << time
+                    << " s, relative nodal error " << std::sqrt( error / norm ) << std::endl;
+            }
+        }
+
+
+        /**
+         * \brief Assembles -div(grad u) = 1 with u = 0 on the border of the
+         *        mesh either with assemble_streaming or, if in_core, with
+         *        Mesh::load and SparseMatrix, and prints the peak memory.
+         *        The peak is the one of the process: run it alone.
+         */
+        void streaming_pb( const std::string& mesh_filename, bool in_core, bool verbose )
+        {
+            std::cout << ( in_core ? "In-core" : "Streaming" ) << " assembly of "
+                << mesh_filename << std::endl;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::vector< double > F;
+            size_t matrix_bytes = 0;
+            if ( in_core ) {
+                Mesh mesh;
+                mesh.load( mesh_filename );
+                mesh.set_attribute( unit_fct, 1, true );
+                const double load_time = seconds_since( start );
+                std::vector< bool > dirichlet( 2, true );
+                SparseMatrix K( mesh.nb_vertices() );
+                F.assign( mesh.nb_vertices(), 0. );
+                Quadrature quadrature = Quadrature::get_quadrature( 2 );
+                ShapeFunctions shape_functions( 2, 1 );
+                for ( int t = 0; t < mesh.nb_triangles(); ++t ) {
+                    Mat< 3, 3 > Ke;
+                    std::vector< double > Fe( 3, 0. );
+                    ElementMapping mapping( mesh, false, t );
+                    assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                    local_to_global_matrix( mesh, t, Ke, K );
+                    assemble_elementary_vector( mapping, shape_functions, quadrature, unit_fct, Fe );
+                    local_to_global_vector( mesh, false, t, Fe, F );
+                }
+                std::vector< double > values( mesh.nb_vertices(), 0. );
+                apply_dirichlet_boundary_conditions( mesh, dirichlet, values, K, F );
+                matrix_bytes = K.memory_bytes();
+                std::cout << mesh.nb_triangles() << " triangles, load " << load_time
+                    << " s, total " << seconds_since( start ) << " s" << std::endl;
+            } else {
+                /* every edge of a .mesh file has an attribute >= 1 */
+                std::vector< bool > dirichlet( 1000, true );
+                std::vector< vertex > vertices;
+                CsrMatrix K;
+                StreamingReport report;
+                assemble_streaming( mesh_filename, unit_fct, unit_fct, dirichlet,
+                    []( vertex ) { return 0.; }, vertices, K, F, &report );
+                matrix_bytes = K.memory_bytes();
+                std::cout << report.nb_triangles << " triangles in " << report.nb_chunks
+                    << " chunks, scan " << report.scan_time << " s, parse "
+                    << report.parse_time << " s, assembly " << report.assembly_time
+                    << " s, total " << report.total_time << " s" << std::endl;
+                if ( verbose ) {
+                    std::cout << "at most " << report.max_queued_chunks
+                        << " chunks queued, parser blocked " << report.nb_full_waits
+                        << " times" << std::endl;
+                }
+            }
+            std::cout << "matrix " << matrix_bytes / ( 1024. * 1024. ) << " MB, peak memory "
+                << peak_memory_mb() << " MB" << std::endl;
+        }
+
+        /**
+         * \brief Solves -div(grad u) = 1 on a nx by nx grid, u = 0 on the
+         *        side y = 0 only (so that most subdomains float), with the
+         *        additive Schwarz PCG (overlap 1, with and without coarse
+         *        space) for 2 to 256 parts and with the Jacobi PCG for
+         *        reference. Prints the quality of both bisection methods.
+         */
+        void schwarz_pb( int nx, bool verbose )
+        {
+            std::cout << "Additive Schwarz on " << nx << "x" << nx << " grid with "
+                << ThreadPool::global().nb_threads() << " threads" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            std::vector< bool > dirichlet( mesh.get_bdr_attr_max() + 1, false );
+            dirichlet[1] = true;
+            SparseMatrix K( mesh.nb_vertices() );
+            std::vector< double > F( mesh.nb_vertices(), 0. );
+            Quadrature quadrature = Quadrature::get_quadrature( 2 );
+            ShapeFunctions shape_functions( 2, 1 );
+            for ( int t = 0; t < mesh.nb_triangles(); ++t ) {
+                Mat< 3, 3 > Ke;
+                std::vector< double > Fe( 3, 0. );
+                ElementMapping mapping( mesh, false, t );
+                assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                local_to_global_matrix( mesh, t, Ke, K );
+                assemble_elementary_vector( mapping, shape_functions, quadrature, unit_fct, Fe );
+                local_to_global_vector( mesh, false, t, Fe, F );
+            }
+            std::vector< double > values( mesh.nb_vertices(), 0. );
+            apply_dirichlet_boundary_conditions( mesh, dirichlet, values, K, F );
+            std::vector< int > fixed;
+            dirichlet_vertices( mesh, dirichlet, fixed );
+
+            SolverConfig config;
+            config.method = SolverConfig::PCG;
+            config.preconditioner = SolverConfig::JACOBI;
+            config.threshold = 1e-10;
+            config.verbose = verbose;
+            std::vector< double > x;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            LinearSolver jacobi( K, config );
+            jacobi.solve( F, x );
+            std::cout << "jacobi: " << jacobi.iterations() << " iterations, "
+                << seconds_since( start ) << " s" << std::endl;
+
+            std::cout << "parts | coordinate: cut  imbalance | inertial: cut  imbalance"
+                << " | iterations  coarse  set-up (s)  solve (s)" << std::endl;
+            for ( int k = 2; k <= 256; k *= 2 ) {
+                std::vector< int > triangle_part, vertex_part;
+                partition_mesh( mesh, k, INERTIAL_BISECTION, triangle_part );
+                const PartitionQuality inertial = partition_quality( mesh, k, triangle_part );
+                partition_mesh( mesh, k, COORDINATE_BISECTION, triangle_part );
+                const PartitionQuality coordinate = partition_quality( mesh, k, triangle_part );
+                vertex_partition( mesh, triangle_part, vertex_part );
+                for ( int coarse = 0; coarse < 2; ++coarse ) {
+                    start = std::chrono::steady_clock::now();
+                    AdditiveSchwarz schwarz( K, vertex_part, k, 1, coarse, fixed );
+                    const double setup = seconds_since( start );
+                    start = std::chrono::steady_clock::now();
+                    LinearSolver solver( K, config );
+                    solver.set_preconditioner( &schwarz );
+                    x.clear();
+                    solver.solve( F, x );
+                    std::cout << std::setw( 5 ) << k << " |"
+                        << std::setw( 16 ) << coordinate.edge_cut << std::setw( 11 ) << coordinate.imbalance
+                        << " |" << std::setw( 14 ) << inertial.edge_cut << std::setw( 11 ) << inertial.imbalance
+                        << " |" << std::setw( 11 ) << solver.iterations()
+                        << std::setw( 8 ) << ( coarse ? "yes" : "no" )
+                        << std::setw( 12 ) << setup
+                        << std::setw( 11 ) << seconds_since( start ) << std::endl;
+                }
+            }
+        }
+
+        /* the elementary matrix computed with DenseMatrix, as before Mat */
+        void dense_elementary_matrix(
+            const ElementMapping& elt_mapping,
+            const ShapeFunctions& reference_functions,
+            const Quadrature& quadrature,
+            double (*coefficient)(vertex),
+            DenseMatrix& Ke )
+        {
+            Ke.set_size( 3, 3 );
+            for ( int i = 0; i < 3; ++i ) {
+                for ( int j = 0; j < 3; ++j ) {
+                    Ke.set( i, j, 0. );
+                    for ( int k = 0; k < quadrature.nb_points(); ++k ) {
+                        vertex p_k = quadrature.point( k );
+                        DenseMatrix inv_J = elt_mapping.jacobian_matrix( p_k ).invert_2x2();
+                        vec2 grad_i = inv_J.transpose().mult_2x2_2( reference_functions.evaluate_grad( i, p_k ) );
+                        vec2 grad_j = inv_J.transpose().mult_2x2_2( reference_functions.evaluate_grad( j, p_k ) );
+                        Ke.add( i, j, quadrature.weight( k ) * coefficient( elt_mapping.transform( p_k ) )
+                            * dot( grad_i, grad_j ) * elt_mapping.jacobian( p_k ) );
+                    }
+                }
+            }
+        }
+
+        /**
+         * \brief Computes the elementary stiffness matrices of the
+         *        2 nx^2 triangles of the unit square with DenseMatrix and
+         *        with Mat< 3, 3 >: time and heap allocations per element,
+         *        largest difference between the two.
+         */
+        void small_matrix_pb( int nx, bool verbose )
+        {
+            std::cout << "Elementary matrices with DenseMatrix vs Mat on " << nx << "x" << nx
+                << " grid" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            const int nt = mesh.nb_triangles();
+            Quadrature quadrature = Quadrature::get_quadrature( 2 );
+            ShapeFunctions shape_functions( 2, 1 );
+            double sum_dense = 0., sum_mat = 0., err = 0.;
+
+            long allocations = nb_allocations;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int t = 0; t < nt; ++t ) {
+                ElementMapping mapping( mesh, false, t );
+                DenseMatrix Ke;
+                dense_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                sum_dense += Ke.get( 0, 1 );
+            }
+            const double time_dense = seconds_since( start );
+            const long allocations_dense = nb_allocations - allocations;
+
+            allocations = nb_allocations;
+            start = std::chrono::steady_clock::now();
+            for ( int t = 0; t < nt; ++t ) {
+                ElementMapping mapping( mesh, false, t );
+                Mat< 3, 3 > Ke;
+                assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                sum_mat += Ke( 0, 1 );
+            }
+            const double time_mat = seconds_since( start );
+            const long allocations_mat = nb_allocations - allocations;
+
+            if ( verbose ) {
+                for ( int t = 0; t < nt; ++t ) {
+                    ElementMapping mapping( mesh, false, t );
+                    DenseMatrix Kd;
+                    Mat< 3, 3 > Km;
+                    dense_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Kd );
+                    assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Km );
+                    for ( int i = 0; i < 3; ++i ) {
+                        for ( int j = 0; j < 3; ++j ) err = std::max( err, std::fabs( Kd.get( i, j ) - Km( i, j ) ) );
+                    }
+                }
+                std::cout << "max difference: " << err << std::endl;
+            }
+            std::cout << "DenseMatrix: " << 1e9 * time_dense / nt << " ns and "
+                << (double)allocations_dense / nt << " allocations per element" << std::endl;
+            std::cout << "Mat:         " << 1e9 * time_mat / nt << " ns and "
+                << (double)allocations_mat / nt << " allocations per element" << std::endl;
+            std::cout << "speed-up " << time_dense / time_mat
+                << " (checksums " << sum_dense << " " << sum_mat << ")" << std::endl;
+        }
+
+        /**
+         * \brief Compares the run-time dispatched element functions
+         *        (assemble_elementary_matrix / _vector with ElementMapping,
+         *        ShapeFunctions and Quadrature) with the compile-time
+         *        Assembler on the 2 nx^2 triangles of the unit square:
+         *        elementary kernels alone, then the whole assembly.
+         */
+        void assembler_pb( int nx, bool verbose )
+        {
+            std::cout << "Run-time vs compile-time assembly on " << nx << "x" << nx
+                << " grid" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            const int nt = mesh.nb_triangles();
+            const double ns = 1e9 / nt;
+            Quadrature quadrature = Quadrature::get_quadrature( 2 );
+            ShapeFunctions shape_functions( 2, 1 );
+            const P1StiffnessAssembler stiffness( unit_fct );
+            const P1SourceAssembler source( unit_fct );
+            double sum_runtime = 0., sum_template = 0.;
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int t = 0; t < nt; ++t ) {
+                ElementMapping mapping( mesh, false, t );
+                Mat< 3, 3 > Ke;
+                assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                sum_runtime += Ke( 0, 1 );
+            }
+            const double matrix_runtime = seconds_since( start );
+            start = std::chrono::steady_clock::now();
+            for ( int t = 0; t < nt; ++t ) {
+                Mat< 3, 3 > Ke;
+                stiffness.element( mesh, t, Ke );
+                sum_template += Ke( 0, 1 );
+            }
+            const double matrix_template = seconds_since( start );
+
+            start = std::chrono::steady_clock::now();
+            std::vector< double > Fe( 3, 0. );
+            for ( int t = 0; t < nt; ++t ) {
+                ElementMapping mapping( mesh, false, t );
+                assemble_elementary_vector( mapping, shape_functions, quadrature, unit_fct, Fe );
+                sum_runtime += Fe[0];
+            }
+            const double vector_runtime = seconds_since( start );
+            start = std::chrono::steady_clock::now();
+            for ( int t = 0; t < nt; ++t ) {
+                Vec< 3 > Fe;
+                source.element( mesh, t, Fe );
+                sum_template += Fe[0];
+            }
+            const double vector_template = seconds_since( start );
+
+            start = std::chrono::steady_clock::now();
+            SparseMatrix K_runtime( mesh.nb_vertices() );
+            std::vector< double > F_runtime( mesh.nb_vertices(), 0. );
+            for ( int t = 0; t < nt; ++t ) {
+                ElementMapping mapping( mesh, false, t );
+                Mat< 3, 3 > Ke;
+                assemble_elementary_matrix( mapping, shape_functions, quadrature, unit_fct, Ke );
+                local_to_global_matrix( mesh, t, Ke, K_runtime );
+                assemble_elementary_vector( mapping, shape_functions, quadrature, unit_fct, Fe );
+                local_to_global_vector( mesh, false, t, Fe, F_runtime );
+            }
+            const double assembly_runtime = seconds_since( start );
+            start = std::chrono::steady_clock::now();
+            SparseMatrix K_template( mesh.nb_vertices() );
+            std::vector< double > F_template( mesh.nb_vertices(), 0. );
+            stiffness.assemble( mesh, K_template );
+            source.assemble( mesh, F_template );
+            const double assembly_template = seconds_since( start );
+
+            std::cout << "                 run-time (ns)  template (ns)  speed-up" << std::endl;
+            std::cout << "stiffness Ke    " << std::setw( 14 ) << matrix_runtime * ns
+                << std::setw( 15 ) << matrix_template * ns
+                << std::setw( 10 ) << matrix_runtime / matrix_template << std::endl;
+            std::cout << "source Fe       " << std::setw( 14 ) << vector_runtime * ns
+                << std::setw( 15 ) << vector_template * ns
+                << std::setw( 10 ) << vector_runtime / vector_template << std::endl;
+            std::cout << "whole assembly  " << std::setw( 14 ) << assembly_runtime * ns
+                << std::setw( 15 ) << assembly_template * ns
+                << std::setw( 10 ) << assembly_runtime / assembly_template << std::endl;
+            std::cout << "checksums " << sum_runtime << " " << sum_template << std::endl;
+
+            if ( verbose ) {
+                std::vector< double > x( mesh.nb_vertices() ), y_runtime, y_template;
+                for ( int i = 0; i < x.size(); ++i ) x[i] = std::sin( 0.001 * i );
+                K_runtime.mult( x, y_runtime );
+                K_template.mult( x, y_template );
+                double err = 0.;
+                for ( int i = 0; i < x.size(); ++i ) {
+                    err = std::max( err, std::fabs( y_runtime[i] - y_template[i] ) );
+                    err = std::max( err, std::fabs( F_runtime[i] - F_template[i] ) );
+                }
+                std::cout << "max difference of the assembled systems: " << err << std::endl;
+            }
+        }
+
+        /* radius of the disc region of incremental_pb */
+        double region_radius = 0.;
+
+        double disc_region( vertex v )
+        {
+            const double dx = v.x - 0.5, dy = v.y - 0.5;
+            return region_radius * region_radius - dx * dx - dy * dy;
+        }
+
+        double ten_fct( vertex v )
+        {
+            return 10.;
+        }
+
+        /**
+         * \brief Changes the coefficient of a disc (attribute 2) covering
+         *        1% to 50% of the unit square split in 2 nx^2 triangles,
+         *        and compares IncrementalStiffness::update() (with the
+         *        Jacobi preconditioner update hook) with the assembly of
+         *        the whole matrix and preconditioner.
+         */
+        void incremental_pb( int nx, bool verbose )
+        {
+            std::cout << "Incremental vs full reassembly on " << nx << "x" << nx
+                << " grid" << std::endl;
+            std::vector< bool > dirichlet( 5, true );
+            SolverConfig config;
+            config.method = SolverConfig::PCG;
+            config.preconditioner = SolverConfig::JACOBI;
+            const double fractions[4] = { 0.01, 0.05, 0.1, 0.5 };
+            std::cout << "region | triangles    rows | incremental (s)  full (s)  speed-up" << std::endl;
+            for ( int f = 0; f < 4; ++f ) {
+                Mesh mesh;
+                mesh.generate_grid( nx, nx );
+                region_radius = std::sqrt( fractions[f] / M_PI );
+                mesh.set_attribute( disc_region, 2, false );
+                IncrementalStiffness inc( mesh, MaterialTable( unit_fct ), dirichlet );
+                LinearSolver solver( inc.matrix(), config );
+                inc.add_update_hook( [&]( const std::vector< int >& rows ) {
+                    solver.update_preconditioner( rows );
+                } );
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                inc.set_coefficient( 2, ten_fct );
+                const int recomputed = inc.update();
+                const double time_incremental = seconds_since( start );
+
+                start = std::chrono::steady_clock::now();
+                SparseMatrix K( mesh.nb_vertices() );
+                Quadrature quadrature = Quadrature::get_quadrature( 2 );
+                ShapeFunctions shape_functions( 2, 1 );
+                for ( int t = 0; t < mesh.nb_triangles(); ++t ) {
+                    ElementMapping mapping( mesh, false, t );
+                    Mat< 3, 3 > Ke;
+                    assemble_elementary_matrix( mapping, shape_functions, quadrature,
+                        mesh.get_triangle_attribute( t ) == 2 ? ten_fct : unit_fct, Ke );
+                    local_to_global_matrix( mesh, t, Ke, K );
+                }
+                std::vector< double > values( mesh.nb_vertices(), 0. ), F( mesh.nb_vertices(), 0. );
+                apply_dirichlet_boundary_conditions( mesh, dirichlet, values, K, F );
+                LinearSolver full( K, config );
+                const double time_full = seconds_since( start );
+
+                std::cout << std::setw( 5 ) << 100 * fractions[f] << "% |"
+                    << std::setw( 10 ) << recomputed << std::setw( 8 ) << inc.changed_rows().size()
+                    << " |" << std::setw( 16 ) << time_incremental << std::setw( 10 ) << time_full
+                    << std::setw( 10 ) << time_full / time_incremental << std::endl;
+
+                if ( verbose ) {
+                    std::vector< double > x( mesh.nb_vertices() ), y, y_full;
+                    for ( int i = 0; i < x.size(); ++i ) x[i] = std::sin( 0.001 * i );
+                    inc.matrix().mult( x, y );
+                    K.mult( x, y_full );
+                    double err = 0.;
+                    for ( int i = 0; i < x.size(); ++i ) err = std::max( err, std::fabs( y[i] - y_full[i] ) );
+                    std::cout << "max difference of the matrices: " << err << std::endl;
+                }
+            }
+        }
+
+        /**
+         * \brief Compares the elementary stiffness matrices of a
+         *        coefficient given as a function (quadrature) and as a
+         *        constant of a MaterialTable (closed form) on the 2 nx^2
+         *        triangles of the unit square with two attributes, then
+         *        the whole assembly with a constant and a mixed table.
+         */
+        void material_pb( int nx, bool verbose )
+        {
+            std::cout << "Function vs constant materials on " << nx << "x" << nx
+                << " grid" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            region_radius = 0.3;
+            mesh.set_attribute( disc_region, 2, false );
+            const int nt = mesh.nb_triangles();
+            const double ns = 1e9 / nt;
+            Quadrature quadrature = Quadrature::get_quadrature( 2 );
+            ShapeFunctions shape_functions( 2, 1 );
+            MaterialTable constant( 1. ), mixed( 1. ), functions( unit_fct );
+            constant.set_constant( 2, 10. );
+            mixed.set_function( 2, ten_fct );
+            functions.set_function( 2, ten_fct );
+            double sum_function = 0., sum_constant = 0., err = 0.;
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int t = 0; t < nt; ++t ) {
+                ElementMapping mapping( mesh, false, t );
+                Mat< 3, 3 > Ke;
+                assemble_elementary_matrix( mapping, shape_functions, quadrature,
+                    mesh.get_triangle_attribute( t ) == 2 ? ten_fct : unit_fct, Ke );
+                sum_function += Ke( 0, 1 );
+            }
+            const double element_function = seconds_since( start );
+            start = std::chrono::steady_clock::now();
+            for ( int t = 0; t < nt; ++t ) {
+                ElementMapping mapping( mesh, false, t );
+                Mat< 3, 3 > Ke;
+                assemble_elementary_matrix( mapping, shape_functions, quadrature,
+                    constant, mesh.get_triangle_attribute( t ), Ke );
+                sum_constant += Ke( 0, 1 );
+            }
+            const double element_constant = seconds_since( start );
+
+            double assembly[3];
+            const MaterialTable* tables[3] = { &functions, &mixed, &constant };
+            SparseMatrix K_function( mesh.nb_vertices() );
+            for ( int k = 0; k < 3; ++k ) {
+                SparseMatrix K( mesh.nb_vertices() );
+                start = std::chrono::steady_clock::now();
+                assemble_stiffness( mesh, *tables[k], k == 0 ? K_function : K );
+                assembly[k] = seconds_since( start );
+                if ( verbose && k > 0 ) {
+                    std::vector< double > x( mesh.nb_vertices() ), y, y_function;
+                    for ( int i = 0; i < x.size(); ++i ) x[i] = std::sin( 0.001 * i );
+                    K.mult( x, y );
+                    K_function.mult( x, y_function );
+                    for ( int i = 0; i < x.size(); ++i ) err = std::max( err, std::fabs( y[i] - y_function[i] ) );
+                }
+            }
+
+            std::cout << "elementary matrix: function " << element_function * ns << " ns, constant "
+                << element_constant * ns << " ns, speed-up " << element_function / element_constant << std::endl;
+            std::cout << "whole assembly: functions " << assembly[0] * ns << " ns, mixed "
+                << assembly[1] * ns << " ns, constants " << assembly[2] * ns << " ns per triangle" << std::endl;
+            std::cout << "checksums " << sum_function << " " << sum_constant << std::endl;
+            if ( verbose ) std::cout << "max difference of the matrices: " << err << std::endl;
+        }
+
+        long file_size( const std::string& filename )
+        {
+            std::ifstream in( filename.c_str(), std::ios::binary | std::ios::ate );
+            return in.is_open() ? (long)in.tellg() : -1;
+        }
+
+        /* medit ASCII (Mesh::save + save_solution) vs binary VTU, raw and
+         * compressed, for the mesh and one P1 field */
+        void vtu_pb( int nx, bool verbose )
+        {
+            std::cout << "Output formats on " << nx << "x" << nx << " grid" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            std::vector< double > u( mesh.nb_vertices() );
+            for ( int i = 0; i < mesh.nb_vertices(); ++i ) {
+                const vertex v = mesh.get_vertex( i );
+                u[i] = std::sin( 3. * v.x ) * std::cos( 2. * v.y );
+            }
+            const std::string name = "bench_output";
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            mesh.save( name + ".mesh" );
+            save_solution( u, name + ".bb" );
+            const double medit_time = seconds_since( start );
+            const long medit_size = file_size( name + ".mesh" ) + file_size( name + ".bb" );
+
+            VtuWriter writer( mesh );
+            writer.add_point_field( "u", u );
+            start = std::chrono::steady_clock::now();
+            writer.write( name + ".vtu" );
+            const double raw_time = seconds_since( start );
+            const long raw_size = file_size( name + ".vtu" );
+
+            writer.set_compression( true );
+            start = std::chrono::steady_clock::now();
+            writer.write( name + ".vtu" );
+            const double lz4_time = seconds_since( start );
+            const long lz4_size = file_size( name + ".vtu" );
+
+            std::cout << std::setw( 12 ) << "format" << std::setw( 12 ) << "time (s)"
+                << std::setw( 14 ) << "size (MB)" << std::endl;
+            std::cout << std::setw( 12 ) << "medit" << std::setw( 12 ) << medit_time
+                << std::setw( 14 ) << medit_size / 1e6 << std::endl;
+            std::cout << std::setw( 12 ) << "vtu raw" << std::setw( 12 ) << raw_time
+                << std::setw( 14 ) << raw_size / 1e6 << std::endl;
+            std::cout << std::setw( 12 ) << "vtu lz4" << std::setw( 12 ) << lz4_time
+                << std::setw( 14 ) << lz4_size / 1e6 << std::endl;
+
+            if ( verbose ) {
+                writer.add_gradient( "grad_u", u );
+                writer.add_triangle_attributes();
+                start = std::chrono::steady_clock::now();
+                writer.write( name + ".vtu" );
+                std::cout << "with gradient and attributes: " << seconds_since( start ) << " s, "
+                    << file_size( name + ".vtu" ) / 1e6 << " MB" << std::endl;
+            }
+            std::remove( ( name + ".mesh" ).c_str() );
+            std::remove( ( name + ".bb" ).c_str() );
+            std::remove( ( name + ".vtu" ).c_str() );
+        }
+
+        double zero_fct( vertex v )
+        {
+            return 0.;
+        }
+
+        /* time steps of the heat equation writing the solution at each
+         * step, synchronously then through an AsyncWriter */
+        void async_writer_pb( int nx, bool verbose )
+        {
+            std::cout << "Synchronous vs background output of " << nx << "x" << nx
+                << " heat steps" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            mesh.set_attribute( unit_fct, 1, true );
+            std::vector< bool > attribute_dirichlet( 2, false );
+            attribute_dirichlet[1] = true;
+            SolverConfig config;
+            config.preconditioner = SolverConfig::JACOBI;
+            config.adapt_to_mesh( mesh );
+            const int nb_steps = 20;
+            const AsyncWriter::Format formats[2] = { AsyncWriter::MEDIT, AsyncWriter::VTU_COMPRESSED };
+            const char* format_names[2] = { "medit", "vtu lz4" };
+
+            std::cout << std::setw( 10 ) << "format" << std::setw( 12 ) << "compute (s)"
+                << std::setw( 10 ) << "sync (s)" << std::setw( 11 ) << "async (s)"
+                << std::setw( 11 ) << "I/O (s)" << std::setw( 13 ) << "blocked (s)" << std::endl;
+            for ( int f = 0; f < 2; ++f ) {
+                double total[2], compute = 0., io = 0., blocked = 0.;
+                for ( int async = 0; async < 2; ++async ) {
+                    ImplicitHeatSolver heat( mesh, unit_fct, unit_fct, attribute_dirichlet,
+                        zero_fct, 1., 0.01, config );
+                    /* budget of 4 solutions: back-pressure if the I/O is slower */
+                    AsyncWriter writer( mesh, formats[f], 4 * mesh.nb_vertices() * sizeof( double ) );
+                    VtuWriter vtu( mesh );
+                    vtu.set_compression( true );
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    for ( int n = 0; n < nb_steps; ++n ) {
+                        std::chrono::steady_clock::time_point step = std::chrono::steady_clock::now();
+                        heat.step();
+                        if ( async ) compute += seconds_since( step );
+                        std::ostringstream name;
+                        name << "bench_async_" << n;
+                        if ( async ) {
+                            std::vector< double > u = heat.solution();
+                            writer.write( std::move( u ), name.str(), heat.time() );
+                        } else if ( formats[f] == AsyncWriter::MEDIT ) {
+                            save_solution( heat.solution(), name.str() + ".bb" );
+                        } else {
+                            vtu.clear_fields();
+                            vtu.add_point_field( "u", heat.solution() );
+                            vtu.write( name.str() + ".vtu" );
+                        }
+                    }
+                    writer.flush();
+                    total[async] = seconds_since( start );
+                    if ( async ) {
+                        io = writer.io_time();
+                        blocked = writer.blocked_time();
+                        if ( verbose ) {
+                            std::cout << "max queued " << writer.max_queued_bytes() / 1e6 << " MB, "
+                                << writer.nb_written() << " files" << std::endl;
+                        }
+                    }
+                }
+                for ( int n = 0; n < nb_steps; ++n ) {
+                    std::ostringstream name;
+                    name << "bench_async_" << n << ( formats[f] == AsyncWriter::MEDIT ? ".bb" : ".vtu" );
+                    std::remove( name.str().c_str() );
+                }
+                std::cout << std::setw( 10 ) << format_names[f] << std::setw( 12 ) << compute
+                    << std::setw( 10 ) << total[0] << std::setw( 11 ) << total[1]
+                    << std::setw( 11 ) << io << std::setw( 13 ) << blocked << std::endl;
+            }
+            std::cout << "(" << std::thread::hardware_concurrency() << " cores: the overlap "
+                << "needs a core free for the I/O thread)" << std::endl;
+        }
+
+        /* compression of the snapshots of a heat equation: .bb text, raw
+         * doubles, LZ4, compress_doubles and the SolutionArchive */
+        void archive_pb( int nx, bool verbose )
+        {
+            const int nb_steps = 40;
+            std::cout << "Compression of " << nb_steps << " heat snapshots on " << nx << "x" << nx
+                << " grid" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            mesh.set_attribute( unit_fct, 1, true );
+            std::vector< bool > attribute_dirichlet( 2, false );
+            attribute_dirichlet[1] = true;
+            SolverConfig config;
+            config.preconditioner = SolverConfig::JACOBI;
+            config.adapt_to_mesh( mesh );
+            ImplicitHeatSolver heat( mesh, unit_fct, unit_fct, attribute_dirichlet,
+                zero_fct, 1., 0.001, config );
+            std::vector< std::vector< double > > snapshots;
+            for ( int n = 0; n < nb_steps; ++n ) {
+                heat.step();
+                snapshots.push_back( heat.solution() );
+            }
+            const size_t n = mesh.nb_vertices();
+            const double raw_mb = nb_steps * n * sizeof( double ) / 1e6;
+
+            long bb_size = 0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int k = 0; k < nb_steps; ++k ) {
+                save_solution( snapshots[k], "bench_archive.bb" );
+                bb_size += file_size( "bench_archive.bb" );
+            }
+            const double bb_time = seconds_since( start );
+            std::remove( "bench_archive.bb" );
+
+            size_t lz4_size = 0;
+            std::vector< char > buffer;
+            start = std::chrono::steady_clock::now();
+            for ( int k = 0; k < nb_steps; ++k ) {
+                lz4_compress( (const char*)snapshots[k].data(), n * sizeof( double ), buffer );
+                lz4_size += buffer.size();
+            }
+            const double lz4_time = seconds_since( start );
+
+            /* spatial prediction only, then against the previous snapshot */
+            size_t sizes[2] = { 0, 0 };
+            double times[2], decode_times[2];
+            bool exact = true;
+            std::vector< double > x( n );
+            for ( int temporal = 0; temporal < 2; ++temporal ) {
+                std::vector< std::vector< char > > compressed( nb_steps );
+                start = std::chrono::steady_clock::now();
+                for ( int k = 0; k < nb_steps; ++k ) {
+                    const double* previous = temporal && k > 0 ? snapshots[k - 1].data() : NULL;
+                    compress_doubles( snapshots[k].data(), previous, n, compressed[k] );
+                    sizes[temporal] += compressed[k].size();
+                }
+                times[temporal] = seconds_since( start );
+                start = std::chrono::steady_clock::now();
+                for ( int k = 0; k < nb_steps; ++k ) {
+                    const double* previous = temporal && k > 0 ? snapshots[k - 1].data() : NULL;
+                    decompress_doubles( compressed[k].data(), compressed[k].size(), previous, n, x.data() );
+                    exact = exact && memcmp( x.data(), snapshots[k].data(), n * sizeof( double ) ) == 0;
+                }
+                decode_times[temporal] = seconds_since( start );
+            }
+
+            start = std::chrono::steady_clock::now();
+            {
+                SolutionArchiveWriter archive( "bench_archive.fsa", n, 8 );
+                for ( int k = 0; k < nb_steps; ++k ) archive.append( snapshots[k], 0.001 * ( k + 1 ) );
+            }
+            const double archive_time = seconds_since( start );
+            const long archive_size = file_size( "bench_archive.fsa" );
+            SolutionArchiveReader reader( "bench_archive.fsa" );
+            srand( 1 );
+            const int nb_reads = 20;
+            start = std::chrono::steady_clock::now();
+            for ( int r = 0; r < nb_reads; ++r ) {
+                const int k = rand() % nb_steps;
+                exact = exact && reader.read( k, x )
+                    && memcmp( x.data(), snapshots[k].data(), n * sizeof( double ) ) == 0;
+            }
+            const double random_read = seconds_since( start ) / nb_reads;
+            std::remove( "bench_archive.fsa" );
+
+            std::cout << std::setw( 20 ) << "format" << std::setw( 12 ) << "size (MB)"
+                << std::setw( 8 ) << "ratio" << std::setw( 14 ) << "write MB/s"
+                << std::setw( 13 ) << "read MB/s" << std::endl;
+            std::cout << std::setw( 20 ) << ".bb text (lossy)" << std::setw( 12 ) << bb_size / 1e6
+                << std::setw( 8 ) << raw_mb / ( bb_size / 1e6 ) << std::setw( 14 ) << raw_mb / bb_time
+                << std::setw( 13 ) << "-" << std::endl;
+            std::cout << std::setw( 20 ) << "raw doubles" << std::setw( 12 ) << raw_mb
+                << std::setw( 8 ) << 1. << std::setw( 14 ) << "-" << std::setw( 13 ) << "-" << std::endl;
+            std::cout << std::setw( 20 ) << "lz4" << std::setw( 12 ) << lz4_size / 1e6
+                << std::setw( 8 ) << raw_mb / ( lz4_size / 1e6 ) << std::setw( 14 ) << raw_mb / lz4_time
+                << std::setw( 13 ) << "-" << std::endl;
+            const char* names[2] = { "spatial xor", "temporal xor" };
+            for ( int temporal = 0; temporal < 2; ++temporal ) {
+                std::cout << std::setw( 20 ) << names[temporal] << std::setw( 12 ) << sizes[temporal] / 1e6
+                    << std::setw( 8 ) << raw_mb / ( sizes[temporal] / 1e6 )
+                    << std::setw( 14 ) << raw_mb / times[temporal]
+                    << std::setw( 13 ) << raw_mb / decode_times[temporal] << std::endl;
+            }
+            std::cout << std::setw( 20 ) << "archive (key 8)" << std::setw( 12 ) << archive_size / 1e6
+                << std::setw( 8 ) << raw_mb / ( archive_size / 1e6 ) << std::setw( 14 ) << raw_mb / archive_time
+                << std::setw( 13 ) << "-" << std::endl;
+            std::cout << "random access: " << random_read * 1e3 << " ms per snapshot, bit exact: "
+                << ( exact ? "yes" : "NO" ) << std::endl;
+            if ( verbose ) {
+                std::cout << "(.bb keeps 6 significant digits: it is not lossless)" << std::endl;
+            }
+        }
+
+        /* job lines of serve_pb: a few coefficient sets, varying values */
+        std::string serve_job( const std::string& mesh_filename, int k )
+        {
+            std::ostringstream line;
+            line << "mesh=" << mesh_filename << " k=1:" << 1 + k % 2 << " f=" << 1 + k
+                << " g=1:0 g=2:" << 0.1 * k << " g=3:0 g=4:" << -0.1 * k << " tol=1e-8";
+            return line.str();
+        }
+
+        void serve_pb( int nx, bool verbose )
+        {
+            const int nb_jobs = 8;
+            const std::string mesh_filename = "bench_serve.mesh";
+            const std::string socket_path = "bench_serve.sock";
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            mesh.save( mesh_filename );
+            std::cout << "Latency of " << nb_jobs << " jobs on " << nx << "x" << nx
+                << " grid: fresh processes vs daemon" << std::endl;
+
+            /* one process per job, as the scheduler does today */
+            char exe[4096];
+            const ssize_t length = readlink( "/proc/self/exe", exe, sizeof( exe ) - 1 );
+            double fresh = 0.;
+            if ( length > 0 ) {
+                exe[length] = '\0';
+                for ( int k = 0; k < nb_jobs; ++k ) {
+                    const std::string command = std::string( exe ) + " --job \""
+                        + serve_job( mesh_filename, k ) + "\" > /dev/null";
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    if ( std::system( command.c_str() ) != 0 ) std::cout << "job " << k << " failed" << std::endl;
+                    fresh += seconds_since( start );
+                }
+                fresh /= nb_jobs;
+            }
+
+            /* the daemon, one connection per job */
+            JobRunner runner;
+            SolverServer server( runner, 2 );
+            if ( !server.listen( socket_path ) ) {
+                std::cout << "cannot listen on " << socket_path << std::endl;
+                std::remove( mesh_filename.c_str() );
+                return;
+            }
+            std::vector< double > latencies;
+            std::vector< std::string > answers;
+            for ( int k = 0; k < nb_jobs; ++k ) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                submit_jobs( socket_path, std::vector< std::string >( 1, serve_job( mesh_filename, k ) ), answers );
+                latencies.push_back( seconds_since( start ) );
+                if ( verbose ) std::cout << "  " << answers[0] << std::endl;
+            }
+            const double cold = latencies[0];
+            std::vector< double > warm( latencies.begin() + 2, latencies.end() );
+            std::sort( warm.begin(), warm.end() );
+            double warm_mean = 0.;
+            for ( int i = 0; i < warm.size(); ++i ) warm_mean += warm[i] / warm.size();
+
+            /* throughput with 4 concurrent clients */
+            const int nb_clients = 4;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::vector< std::thread > clients;
+            for ( int c = 0; c < nb_clients; ++c ) {
+                clients.push_back( std::thread( [&, c]() {
+                    std::vector< std::string > lines, replies;
+                    for ( int k = 0; k < nb_jobs; ++k ) lines.push_back( serve_job( mesh_filename, k + c ) );
+                    submit_jobs( socket_path, lines, replies );
+                } ) );
+            }
+            for ( int c = 0; c < nb_clients; ++c ) clients[c].join();
+            const double concurrent = seconds_since( start );
+            std::vector< std::string > stats;
+            submit_jobs( socket_path, std::vector< std::string >( 1, "stats" ), stats );
+            server.stop();
+            server.wait();
+            std::remove( mesh_filename.c_str() );
+
+            std::cout << std::setw( 32 ) << "fresh process per job: " << fresh * 1e3 << " ms" << std::endl;
+            std::cout << std::setw( 32 ) << "daemon, first job (cold): " << cold * 1e3 << " ms" << std::endl;
+            std::cout << std::setw( 32 ) << "daemon, warm jobs: " << warm_mean * 1e3 << " ms (median "
+                << warm[warm.size() / 2] * 1e3 << ", max " << warm.back() * 1e3 << "), "
+                << fresh / warm_mean << "x faster" << std::endl;
+            std::cout << std::setw( 32 ) << "daemon, 4 clients: " << nb_clients * nb_jobs / concurrent
+                << " jobs/s" << std::endl;
+            if ( !stats.empty() ) std::cout << std::setw( 32 ) << "caches: " << stats[0] << std::endl;
+        }
+
+        double cache_source( vertex v )
+        {
+            return std::sin( 3. * v.x ) * std::cos( 2. * v.y );
+        }
+
+        /* assembly (or cache lookup) and solve times of one run */
+        void cached_run( const Mesh& mesh, SystemCache* cache, double& assembly, double& solve,
+            std::vector< double >& u )
+        {
+            PoissonProblem problem( mesh );
+            problem.set_source( cache_source );
+            for ( int a = 1; a <= 4; ++a ) problem.set_dirichlet( a, zero_fct );
+            if ( cache != NULL ) problem.set_system_cache( cache, "f=sin(3x)cos(2y) g=0" );
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            problem.assemble();
+            assembly = seconds_since( start );
+            start = std::chrono::steady_clock::now();
+            problem.solve();
+            solve = seconds_since( start );
+            u.assign( problem.solution(), problem.solution() + problem.size() );
+        }
+
+        void system_cache_pb( int nx, bool verbose )
+        {
+            std::cout << "On-disk system cache on " << nx << "x" << nx << " grid" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            const uint64_t hash = mesh_content_hash( mesh );
+            const double hash_time = seconds_since( start );
+
+            const char* names[4] = { "no cache", "miss (store)", "hit, checksum", "hit, no checksum" };
+            double assembly[4], solve[4];
+            std::vector< double > u[4];
+            cached_run( mesh, NULL, assembly[0], solve[0], u[0] );
+            SystemCache cache( "bench_system_cache" );
+            cached_run( mesh, &cache, assembly[1], solve[1], u[1] );
+            cached_run( mesh, &cache, assembly[2], solve[2], u[2] );
+            SystemCache unverified( "bench_system_cache", false );
+            cached_run( mesh, &unverified, assembly[3], solve[3], u[3] );
+
+            SystemKey key;
+            key.mesh_hash = hash;
+            key.coefficients = "f=sin(3x)cos(2y) g=0";
+            const std::string filename = cache.filename( key );
+            const long bytes = file_size( filename );
+            std::remove( filename.c_str() );
+            rmdir( "bench_system_cache" );
+
+            std::cout << std::setw( 20 ) << "run" << std::setw( 16 ) << "assembly (s)"
+                << std::setw( 12 ) << "solve (s)" << std::setw( 14 ) << "same u" << std::endl;
+            for ( int r = 0; r < 4; ++r ) {
+                std::cout << std::setw( 20 ) << names[r] << std::setw( 16 ) << assembly[r]
+                    << std::setw( 12 ) << solve[r] << std::setw( 14 )
+                    << ( u[r] == u[0] ? "bit exact" : "DIFFERENT" ) << std::endl;
+            }
+            std::cout << "file " << bytes / 1e6 << " MB, mesh hash " << hash_time << " s, assembly "
+                << assembly[0] / assembly[2] << "x faster on a hit" << std::endl;
+            if ( verbose ) {
+                std::cout << "(warm page cache: a cold hit also reads the file from the disk)" << std::endl;
+            }
+        }
+
+        double surface_fct( vertex v )
+        {
+            return v.y - 19.999;
+        }
+
+        double deep_source_fct( vertex v )
+        {
+            return v.y > 10. ? 0. : 1.;
+        }
+
+        /* problem of the geothermie mesh: one constant k per layer, u = 0 at the surface */
+        void layered_problem( PoissonProblem& problem, const std::vector< double >& k, double tolerance )
+        {
+            SolverConfig config = problem.solver_config();
+            config.threshold = tolerance;
+            problem.set_solver_config( config );
+            MaterialTable materials( 1. );
+            for ( int a = 0; a < (int)k.size(); ++a ) materials.set_constant( a, k[a] );
+            problem.set_diffusion( materials );
+            problem.set_source( deep_source_fct );
+            problem.set_dirichlet( 1, zero_fct );
+        }
+
+        void adjoint_pb( const std::string& mesh_filename, bool verbose )
+        {
+            std::cout << "Adjoint sensitivities on " << mesh_filename << std::endl;
+            Mesh mesh;
+            mesh.load( mesh_filename );
+            mesh.set_attribute( unit_fct, 0, true );
+            mesh.set_attribute( surface_fct, 1, true );
+            const double tolerance = 1e-12;
+
+            /* material attributes of the layers and their conductivities */
+            std::vector< bool > used;
+            for ( int t = 0; t < mesh.nb_triangles(); ++t ) {
+                const int a = mesh.get_triangle_attribute( t );
+                if ( a >= (int)used.size() ) used.resize( a + 1, false );
+                used[a] = true;
+            }
+            std::vector< int > layers;
+            std::vector< double > k( used.size(), 0. );
+            for ( int a = 0; a < (int)used.size(); ++a ) {
+                if ( !used[a] ) continue;
+                k[a] = 0.5 + 0.1 * layers.size();
+                layers.push_back( a );
+            }
+
+            /* outputs: temperatures in the deep and in the superficial layers
+             * (the surface flux balances the source, whatever k) */
+            vertex deep, superficial;
+            deep.x = superficial.x = 10.;
+            deep.y = 1.;
+            superficial.y = 15.;
+            LinearFunctional outputs[2] = { probe_functional( mesh, deep ),
+                probe_functional( mesh, superficial ) };
+            const char* names[2] = { "u(10, 1)", "u(10, 15)" };
+
+            for ( int o = 0; o < 2; ++o ) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                PoissonProblem problem( mesh );
+                layered_problem( problem, k, tolerance );
+                problem.solve();
+                const int forward_iterations = problem.iterations();
+                AdjointSensitivity sensitivity( problem );
+                sensitivity.compute( outputs[o] );
+                const double adjoint_time = seconds_since( start );
+
+                /* one more solve per layer, forward differences */
+                start = std::chrono::steady_clock::now();
+                const double J0 = outputs[o].evaluate( problem.solution() );
+                std::vector< double > fd( layers.size() );
+                for ( int l = 0; l < (int)layers.size(); ++l ) {
+                    std::vector< double > k_plus = k;
+                    const double h = 1e-6 * k[layers[l]];
+                    k_plus[layers[l]] += h;
+                    PoissonProblem perturbed( mesh );
+                    layered_problem( perturbed, k_plus, tolerance );
+                    perturbed.solve();
+                    fd[l] = ( outputs[o].evaluate( perturbed.solution() ) - J0 ) / h;
+                }
+                const double fd_time = seconds_since( start ) + adjoint_time;
+
+                double error = 0., norm = 0.;
+                for ( int l = 0; l < (int)layers.size(); ++l ) {
+                    error = std::max( error, std::abs( fd[l] - sensitivity.gradient()[layers[l]] ) );
+                    norm = std::max( norm, std::abs( fd[l] ) );
+                }
+                std::cout << std::setw( 14 ) << names[o] << ": J = " << J0 << ", " << layers.size()
+                    << " parameters" << std::endl;
+                std::cout << std::setw( 32 ) << "adjoint (2 solves): " << adjoint_time << " s ("
+                    << forward_iterations << " + " << sensitivity.iterations() << " iterations)" << std::endl;
+                std::cout << std::setw( 32 ) << "finite differences (" << layers.size() + 1 << " solves): "
+                    << fd_time << " s, " << fd_time / adjoint_time << "x slower" << std::endl;
+                std::cout << std::setw( 32 ) << "max difference: " << error / norm << " (relative)" << std::endl;
+                if ( verbose ) {
+                    for ( int l = 0; l < (int)layers.size(); ++l ) {
+                        std::cout << "    dJ/dk_" << layers[l] << " adjoint " << sensitivity.gradient()[layers[l]]
+                            << ", finite differences " << fd[l] << std::endl;
+                    }
+                }
+            }
+        }
+
+        double east_fct( vertex v )
+        {
+            return v.x - 0.5;
+        }
+
+        double north_fct( vertex v )
+        {
+            return v.y - 0.5;
+        }
+
+        double north_east_fct( vertex v )
+        {
+            return std::min( v.x, v.y ) - 0.5;
+        }
+
+        ReducedParameters random_parameters()
+        {
+            /* k log-uniform in [0.1, 10], amplitudes in [-1, 1] */
+            ReducedParameters p;
+            for ( int a = 0; a < 4; ++a ) {
+                p.diffusion.push_back( std::pow( 10., -1. + 2. * std::rand() / RAND_MAX ) );
+            }
+            for ( int j = 0; j < 2; ++j ) p.source.push_back( -1. + 2. * std::rand() / RAND_MAX );
+            return p;
+        }
+
+        void reduced_basis_pb( int nx, int nb_training, bool verbose )
+        {
+            std::cout << "POD reduced basis on " << nx << "x" << nx << " grid, 4 materials, 2 sources, "
+                << nb_training << " snapshots" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( nx, nx );
+            /* quadrants 1 (south west), 2 (south east), 3 (north west), 4 */
+            mesh.set_attribute( east_fct, 2, false );
+            mesh.set_attribute( north_fct, 3, false );
+            mesh.set_attribute( north_east_fct, 4, false );
+            std::vector< int > attributes;
+            for ( int a = 1; a <= 4; ++a ) attributes.push_back( a );
+            std::vector< ScalarField > sources;
+            sources.push_back( unit_fct );
+            sources.push_back( []( vertex v ) { return std::sin( 3. * v.x ) * std::cos( 2. * v.y ); } );
+            ReducedBasis model( mesh, MaterialTable( 1. ), attributes, sources );
+            model.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+            model.set_dirichlet( 3, zero_fct );
+
+            std::srand( 7 );
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int i = 0; i < nb_training; ++i ) model.add_snapshot( random_parameters() );
+            const double snapshots = seconds_since( start );
+            start = std::chrono::steady_clock::now();
+            const int size = model.build( 1e-7 );
+            const double build = seconds_since( start );
+            std::vector< ReducedParameters > samples;
+            for ( int s = 0; s < 5; ++s ) samples.push_back( random_parameters() );
+            start = std::chrono::steady_clock::now();
+            const double effectivity = model.calibrate( samples );
+            const double calibration = seconds_since( start );
+
+            /* online queries against full solves */
+            const int nb_queries = 20;
+            std::vector< ReducedParameters > queries;
+            for ( int q = 0; q < nb_queries; ++q ) queries.push_back( random_parameters() );
+            std::vector< std::vector< double > > coefficients( nb_queries );
+            std::vector< double > indicators( nb_queries );
+            const int repeats = 100;
+            start = std::chrono::steady_clock::now();
+            for ( int k = 0; k < repeats; ++k ) {
+                for ( int q = 0; q < nb_queries; ++q ) {
+                    indicators[q] = model.reduced_solve( queries[q], coefficients[q] );
+                }
+            }
+            const double online = seconds_since( start ) / ( repeats * nb_queries );
+            std::vector< double > u;
+            start = std::chrono::steady_clock::now();
+            for ( int q = 0; q < nb_queries; ++q ) model.reconstruct( coefficients[q], u );
+            const double reconstruct = seconds_since( start ) / nb_queries;
+
+            model.set_tolerance( 0. );
+            double full = 0., max_error = 0., max_indicator = 0., min_ratio = 1e300, max_ratio = 0.;
+            for ( int q = 0; q < nb_queries; ++q ) {
+                std::vector< double > reference;
+                start = std::chrono::steady_clock::now();
+                model.solve( queries[q], reference );
+                full += seconds_since( start );
+                model.reconstruct( coefficients[q], u );
+                double difference = 0., norm = 0.;
+                for ( int i = 0; i < u.size(); ++i ) {
+                    difference += ( u[i] - reference[i] ) * ( u[i] - reference[i] );
+                    norm += reference[i] * reference[i];
+                }
+                const double error = std::sqrt( difference / norm );
+                max_error = std::max( max_error, error );
+                max_indicator = std::max( max_indicator, indicators[q] );
+                min_ratio = std::min( min_ratio, error / indicators[q] );
+                max_ratio = std::max( max_ratio, error / indicators[q] );
+            }
+            full /= nb_queries;
+
+            std::cout << std::setw( 32 ) << "offline snapshots: " << snapshots << " s ("
+                << snapshots / nb_training << " s per full solve)" << std::endl;
+            std::cout << std::setw( 32 ) << "offline SVD + projections: " << build << " s, basis of "
+                << size << " vectors" << std::endl;
+            std::cout << std::setw( 32 ) << "calibration: " << calibration << " s, effectivity "
+                << effectivity << " on " << samples.size() << " samples" << std::endl;
+            std::cout << std::setw( 32 ) << "online reduced solve: " << online * 1e6 << " us (+ "
+                << reconstruct * 1e6 << " us to rebuild u), " << full / online << "x faster than "
+                << full << " s" << std::endl;
+            std::cout << std::setw( 32 ) << "error: " << max_error << " max relative, indicator max "
+                << max_indicator << " (error / indicator in [" << min_ratio << ", " << max_ratio << "])" << std::endl;
+            int nb_fallbacks = 0;
+            for ( int q = 0; q < nb_queries; ++q ) nb_fallbacks += effectivity * indicators[q] > 1e-6;
+            std::cout << std::setw( 32 ) << "tolerance 1e-6: " << nb_fallbacks << " of " << nb_queries
+                << " queries fall back to the full solve, error / estimate at most "
+                << max_ratio / effectivity << std::endl;
+            if ( verbose ) {
+                std::cout << "singular values:";
+                for ( int k = 0; k < model.singular_values().size(); ++k ) {
+                    std::cout << " " << model.singular_values()[k];
+                }
+                std::cout << std::endl;
+            }
+        }
+
+        /* the batch of the files of directory, each one repeated */
+        void pipeline_pb( const std::string& directory, int repeats, bool verbose )
+        {
+            std::vector< std::string > meshes = MeshPipeline::list_meshes( directory );
+            std::vector< std::string > batch;
+            for ( int r = 0; r < repeats; ++r ) batch.insert( batch.end(), meshes.begin(), meshes.end() );
+            std::cout << "Mesh pipeline on " << meshes.size() << " meshes of " << directory << " x "
+                << repeats << " (f = 1, u = 0 on the borders, tol 1e-8, vtu outputs)" << std::endl;
+            SolverConfig solver_config;
+            solver_config.preconditioner = SolverConfig::JACOBI;
+            solver_config.threshold = 1e-8;
+
+            const int nb_cores = std::max( 1, (int)std::thread::hardware_concurrency() );
+            const char* names[3] = { "sequential", "pipeline 1/1/1/1", "pipeline 1/1/n/1" };
+            double throughput[3];
+            for ( int run = 0; run < 3; ++run ) {
+                PipelineConfig config;
+                config.output_directory = "bench_pipeline";
+                config.vtu = true;
+                if ( run == 2 ) config.solve_threads = nb_cores;
+                MeshPipeline pipeline( config );
+                pipeline.set_solver_config( solver_config );
+                if ( run == 0 ) pipeline.run_sequential( batch );
+                else pipeline.run( batch );
+                throughput[run] = pipeline.throughput();
+                if ( run == 0 ) {
+                    double total = 0., busiest = 0.;
+                    for ( int k = 0; k < MeshPipeline::NB_STAGES; ++k ) {
+                        const double busy = pipeline.busy_seconds( MeshPipeline::Stage( k ) );
+                        total += busy;
+                        busiest = std::max( busiest, busy );
+                    }
+                    std::cout << "one core per stage: at most " << total / busiest
+                        << "x (the busiest stage bounds the pipeline)" << std::endl;
+                }
+                std::cout << names[run] << ":" << std::endl << pipeline.report() << std::endl;
+                if ( verbose && run == 0 ) {
+                    for ( int i = 0; i < meshes.size(); ++i ) {
+                        const PipelineResult& r = pipeline.results()[i];
+                        std::cout << "    " << r.filename << ": " << r.nb_vertices << " vertices, load "
+                            << r.seconds[0] << " s, assemble " << r.seconds[1] << " s, solve "
+                            << r.seconds[2] << " s, write " << r.seconds[3] << " s" << std::endl;
+                    }
+                }
+            }
+            for ( int i = 0; i < meshes.size(); ++i ) {
+                std::string name = meshes[i].substr( meshes[i].find_last_of( '/' ) + 1 );
+                name = "bench_pipeline/" + name.substr( 0, name.size() - 5 ) + ".vtu";
+                std::remove( name.c_str() );
+            }
+            rmdir( "bench_pipeline" );
+            std::cout << "pipeline " << throughput[1] / throughput[0] << "x, with " << nb_cores
+                << " solve threads " << throughput[2] / throughput[0] << "x the sequential throughput"
+                << std::endl;
+        }
+
+        /* work of the index i of the irregular loop, growing with i */
+        double triangular_work( int i )
+        {
+            double s = 0.;
+            for ( int k = 0; k < i; ++k ) s += std::sqrt( (double)k );
+            return s;
+        }
+
+        void scheduler_pb( int grid, bool verbose )
+        {
+            /* as many threads as the global pool (FEM2A_NUM_THREADS) */
+            ThreadPool pool( ThreadPool::global().nb_threads() );
+            std::cout << "Work-stealing pool of " << pool.nb_threads() << " threads" << std::endl;
+
+            /* cost of a task: empty tasks spawned then waited for */
+            const int nb_tasks = 200000;
+            std::atomic< int > nb_run( 0 );
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int i = 0; i < nb_tasks; ++i ) pool.spawn( [&]() { ++nb_run; } );
+            pool.wait_until( [&]() { return nb_run == nb_tasks; } );
+            const double spawn_time = seconds_since( start );
+            start = std::chrono::steady_clock::now();
+            pool.parallel_for( nb_tasks, 1, []( int, int ) {} );
+            const double range_time = seconds_since( start );
+            const int nb_threads = 200;
+            start = std::chrono::steady_clock::now();
+            for ( int i = 0; i < nb_threads; ++i ) std::thread( []() {} ).join();
+            const double thread_time = seconds_since( start );
+            std::cout << "empty task: spawn + run " << 1e9 * spawn_time / nb_tasks << " ns, parallel_for range "
+                << 1e9 * range_time / nb_tasks << " ns, new thread " << 1e9 * thread_time / nb_threads
+                << " ns" << std::endl;
+
+            /* irregular loop: fixed ranges vs grain and steals */
+            const int n = 20000;
+            std::vector< double > out( n );
+            const auto body = [&]( int begin, int end ) {
+                for ( int i = begin; i < end; ++i ) out[i] = triangular_work( i );
+            };
+            pool.reset_statistics();
+            start = std::chrono::steady_clock::now();
+            pool.parallel_for( n, body );
+            const double fixed_time = seconds_since( start );
+            const double fixed_imbalance = pool.statistics().imbalance();
+            if ( verbose ) std::cout << pool.report() << std::endl;
+            pool.reset_statistics();
+            start = std::chrono::steady_clock::now();
+            pool.parallel_for( n, 64, body );
+            const double stolen_time = seconds_since( start );
+            const double stolen_imbalance = pool.statistics().imbalance();
+            if ( verbose ) std::cout << pool.report() << std::endl;
+            std::cout << "triangular loop of " << n << ": " << pool.nb_threads() << " fixed ranges " << fixed_time
+                << " s (imbalance " << fixed_imbalance << "), grain 64 " << stolen_time << " s (imbalance "
+                << stolen_imbalance << ")" << std::endl;
+
+            /* the kernels of the library on the global pool */
+            Mesh mesh;
+            mesh.generate_grid( grid, grid );
+            ThreadPool& global = ThreadPool::global();
+            global.reset_statistics();
+            start = std::chrono::steady_clock::now();
+            SparseMatrix K( mesh.nb_vertices() );
+            assemble_stiffness( mesh, MaterialTable( 1. ), K );
+            const double assembly_time = seconds_since( start );
+            std::vector< double > x( mesh.nb_vertices(), 1. ), y;
+            const int nb_products = 50;
+            start = std::chrono::steady_clock::now();
+            for ( int k = 0; k < nb_products; ++k ) K.mult( x, y );
+            const double spmv_time = seconds_since( start ) / nb_products;
+            const ThreadPool::Statistics stats = global.statistics();
+            std::cout << grid << " x " << grid << " grid on the global pool (" << global.nb_threads()
+                << " threads): assembly " << assembly_time << " s, SpMV " << 1e3 * spmv_time << " ms, "
+                << stats.total_tasks() << " tasks, imbalance " << stats.imbalance() << std::endl;
+            if ( verbose ) std::cout << global.report() << std::endl;
+        }
+
+        void deterministic_pb( int grid, bool verbose )
+        {
+            ThreadPool& pool = ThreadPool::global();
+            std::cout << "Deterministic reductions on " << pool.nb_threads() << " threads, "
+                << grid << " x " << grid << " grid" << std::endl;
+            Mesh mesh;
+            mesh.generate_grid( grid, grid );
+            const int n = mesh.nb_vertices();
+            std::vector< double > x( n ), y( n );
+            for ( int i = 0; i < n; ++i ) {
+                x[i] = std::sin( 0.1 * i );
+                y[i] = std::cos( 0.3 * i );
+            }
+            const auto partial = [&]( int begin, int end ) {
+                double s = 0.;
+                for ( int i = begin; i < end; ++i ) s += x[i] * y[i];
+                return s;
+            };
+
+            /* the dot product alone: a plain loop, blocked pairwise, one range per thread */
+            const int nb_dots = 2000;
+            double check = 0.;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int k = 0; k < nb_dots; ++k ) check += partial( 0, n );
+            const double plain_time = seconds_since( start ) / nb_dots;
+            const bool saved = pool.deterministic();
+            double times[2];
+            for ( int mode = 0; mode < 2; ++mode ) {
+                pool.set_deterministic( mode == 0 );
+                start = std::chrono::steady_clock::now();
+                for ( int k = 0; k < nb_dots; ++k ) check += pool.sum( n, partial );
+                times[mode] = seconds_since( start ) / nb_dots;
+            }
+            std::cout << "dot of " << n << ": plain loop " << 1e6 * plain_time << " us, deterministic "
+                << 1e6 * times[0] << " us, per thread " << 1e6 * times[1] << " us" << std::endl;
+
+            /* a whole PCG solve in both modes */
+            SolverConfig config;
+            config.method = SolverConfig::PCG;
+            config.preconditioner = SolverConfig::JACOBI;
+            config.threshold = 1e-10;
+            double solve_times[2];
+            std::vector< double > u[2];
+            for ( int mode = 0; mode < 2; ++mode ) {
+                pool.set_deterministic( mode == 0 );
+                PoissonProblem problem( mesh );
+                problem.set_solver_config( config );
+                problem.set_source( []( vertex v ) { return std::sin( 7. * v.x ) + 1.; } );
+                for ( int a = 1; a <= 4; ++a ) problem.set_dirichlet( a, []( vertex ) { return 0.; } );
+                problem.assemble();
+                start = std::chrono::steady_clock::now();
+                problem.solve();
+                solve_times[mode] = seconds_since( start );
+                u[mode].assign( problem.solution(), problem.solution() + problem.size() );
+                if ( verbose ) {
+                    std::cout << ( mode == 0 ? "deterministic: " : "per thread: " ) << problem.iterations()
+                        << " iterations, residual " << problem.residual() << std::endl;
+                }
+            }
+            pool.set_deterministic( saved );
+            double difference = 0.;
+            for ( int i = 0; i < n; ++i ) difference = std::max( difference, std::fabs( u[0][i] - u[1][i] ) );
+            std::cout << "PCG solve: deterministic " << solve_times[0] << " s, per thread " << solve_times[1]
+                << " s (" << 100. * ( solve_times[0] / solve_times[1] - 1. ) << "% overhead), max difference "
+                << difference << std::endl;
+            std::cout << "checksum " << check << std::endl;
+        }
+
+        /* kB of the process backed by transparent huge pages (Linux) */
+        long anonymous_huge_pages_kb()
+        {
+            std::ifstream in( "/proc/self/smaps_rollup" );
+            std::string line;
+            while ( std::getline( in, line ) ) {
+                if ( line.compare( 0, 14, "AnonHugePages:" ) == 0 ) return atol( line.c_str() + 14 );
+            }
+            return -1;
+        }
+
+        void allocator_pb( int grid, bool verbose )
+        {
+            std::cout << "Allocators of the mesh and the matrix, " << grid << " x " << grid << " grid, "
+                << ThreadPool::global().nb_threads() << " threads" << std::endl;
+            HeapResource heap;
+            ArenaResource arena;
+            HugePageResource huge_pages;
+            NumaResource numa;
+            MemoryResource* resources[4] = { &heap, &arena, &huge_pages, &numa };
+            const int nb_products = 50;
+            double times[4][2];
+            for ( int r = 0; r < 4; ++r ) {
+                MemoryResource& resource = *resources[r];
+                const long heap_calls = nb_allocations.load();
+                const long huge_kb = anonymous_huge_pages_kb();
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                Mesh mesh( resource );
+                mesh.generate_grid( grid, grid );
+                SparseMatrix K( mesh.nb_vertices(), resource );
+                assemble_stiffness( mesh, MaterialTable( 1. ), K );
+                times[r][0] = seconds_since( start );
+                const long assembly_heap_calls = nb_allocations.load() - heap_calls;
+
+                std::vector< double > x( mesh.nb_vertices(), 1. ), y;
+                K.mult( x, y );
+                start = std::chrono::steady_clock::now();
+                for ( int k = 0; k < nb_products; ++k ) K.mult( x, y );
+                times[r][1] = seconds_since( start ) / nb_products;
+                std::cout << std::setw( 16 ) << resource.name() << ": mesh + assembly " << times[r][0]
+                    << " s, SpMV " << 1e3 * times[r][1] << " ms, " << assembly_heap_calls << " heap calls, "
+                    << resource.reserved_bytes() / ( 1 << 20 ) << " MB reserved for "
+                    << resource.allocated_bytes() / ( 1 << 20 ) << " MB, huge pages +"
+                    << anonymous_huge_pages_kb() - huge_kb << " kB" << std::endl;
+                if ( verbose ) std::cout << "    " << resource.report() << std::endl;
+            }
+            for ( int r = 1; r < 4; ++r ) {
+                std::cout << resources[r]->name() << " vs heap: assembly " << times[0][0] / times[r][0]
+                    << "x, SpMV " << times[0][1] / times[r][1] << "x" << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,390 @@
+#include "compression.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+
+namespace FEM2A {
+
+    /* LZ4 block format constraints */
+    static const int min_match = 4 ;
+    static const int last_literals = 5 ;  /* the block ends with 5 literals */
+    static const int match_limit = 12 ;   /* no match starts in the last 12 bytes */
+    static const int hash_bits = 16 ;
+
+    static uint32_t read32( const char* p )
+    {
+        uint32_t v ;
+        memcpy( &v, p, 4 ) ;
+        return v ;
+    }
+
+    static uint32_t hash32( uint32_t v )
+    {
+        return ( v * 2654435761u ) >> ( 32 - hash_bits ) ;
+    }
+
+    /* lengths >= 15 continue on bytes of 255 and a last byte < 255 */
+    static void write_length( size_t length, std::vector< char >& dst )
+    {
+        for( ; length >= 255; length -= 255 ) dst.push_back( (char)255 ) ;
+        dst.push_back( (char)length ) ;
+    }
+
+    static void write_sequence( const char* literals, size_t nb_literals,
+        size_t offset, size_t match_length, std::vector< char >& dst )
+    {
+        const size_t token_literals = nb_literals < 15 ? nb_literals : 15 ;
+        size_t token_match = 0 ;
+        if( match_length > 0 ) {
+            token_match = match_length - min_match < 15 ? match_length - min_match : 15 ;
+        }
+        dst.push_back( (char)( ( token_literals << 4 ) | token_match ) ) ;
+        if( token_literals == 15 ) write_length( nb_literals - 15, dst ) ;
+        dst.insert( dst.end(), literals, literals + nb_literals ) ;
+        if( match_length == 0 ) return ;
+        dst.push_back( (char)( offset & 0xff ) ) ;
+        dst.push_back( (char)( offset >> 8 ) ) ;
+        if( token_match == 15 ) write_length( match_length - min_match - 15, dst ) ;
+    }
+
+    void lz4_compress( const char* src, size_t n, std::vector< char >& dst )
+    {
+        dst.clear() ;
+        dst.reserve( n + n / 255 + 16 ) ;
+        size_t anchor = 0 ;
+        if( n > match_limit ) {
+            std::vector< int64_t > table( (size_t)1 << hash_bits, -1 ) ;
+            const size_t last_match_start = n - match_limit ;
+            const size_t last_match_end = n - last_literals ;
+            size_t ip = 0 ;
+            size_t misses = 0 ;
+            while( ip <= last_match_start ) {
+                const uint32_t sequence = read32( src + ip ) ;
+                const uint32_t h = hash32( sequence ) ;
+                const int64_t ref = table[h] ;
+                table[h] = ip ;
+                if( ref < 0 || ip - ref > 65535 || read32( src + ref ) != sequence ) {
+                    /* skip faster through data that does not compress */
+                    ip += 1 + ( misses++ >> 6 ) ;
+                    continue ;
+                }
+                misses = 0 ;
+                size_t length = min_match ;
+                while( ip + length < last_match_end && src[ref + length] == src[ip + length] ) ++length ;
+                write_sequence( src + anchor, ip - anchor, ip - ref, length, dst ) ;
+                ip += length ;
+                anchor = ip ;
+                if( ip <= last_match_start ) table[hash32( read32( src + ip - 2 ) )] = ip - 2 ;
+            }
+        }
+        write_sequence( src + anchor, n - anchor, 0, 0, dst ) ;
+    }
+
+    bool lz4_decompress( const char* src, size_t n, char* dst, size_t dst_size )
+    {
+        size_t ip = 0, op = 0 ;
+        while( ip < n ) {
+            const unsigned char token = src[ip++] ;
+            size_t length = token >> 4 ;
+            if( length == 15 ) {
+                unsigned char b ;
+                do {
+                    if( ip >= n ) return false ;
+                    b = src[ip++] ;
+                    length += b ;
+                } while( b == 255 ) ;
+            }
+            if( ip + length > n || op + length > dst_size ) return false ;
+            memcpy( dst + op, src + ip, length ) ;
+            ip += length ;
+            op += length ;
+            if( ip == n ) break ; /* last sequence: literals only */
+            if( ip + 2 > n ) return false ;
+            const size_t offset = (unsigned char)src[ip] | ( (size_t)(unsigned char)src[ip + 1] << 8 ) ;
+            ip += 2 ;
+            if( offset == 0 || offset > op ) return false ;
+            length = ( token & 15 ) ;
+            if( length == 15 ) {
+                unsigned char b ;
+                do {
+                    if( ip >= n ) return false ;
+                    b = src[ip++] ;
+                    length += b ;
+                } while( b == 255 ) ;
+            }
+            length += min_match ;
+            if( op + length > dst_size ) return false ;
+            /* byte by byte: the match may overlap the bytes being written */
+            for( size_t k = 0; k < length; ++k, ++op ) dst[op] = dst[op - offset] ;
+        }
+        return op == dst_size ;
+    }
+
+    /****************************************************************/
+    /* Range coder of compress_doubles */
+    /****************************************************************/
+    namespace {
+        /* probabilities of a 0 on 11 bits, adapted by 1/32 of the error */
+        const int probability_bits = 11 ;
+        const int adaptation_shift = 5 ;
+        const uint32_t range_top = 1u << 24 ;
+
+        class RangeEncoder {
+            public:
+                explicit RangeEncoder( std::vector< char >& out )
+                    : out_( out ), low_( 0 ), range_( 0xFFFFFFFFu ), cache_( 0 ), cache_size_( 1 )
+                {
+                }
+
+                void encode( uint16_t& probability, int bit )
+                {
+                    const uint32_t bound = ( range_ >> probability_bits ) * probability ;
+                    if( bit == 0 ) {
+                        range_ = bound ;
+                        probability += ( ( 1 << probability_bits ) - probability ) >> adaptation_shift ;
+                    } else {
+                        low_ += bound ;
+                        range_ -= bound ;
+                        probability -= probability >> adaptation_shift ;
+                    }
+                    while( range_ < range_top ) {
+                        range_ <<= 8 ;
+                        shift_low() ;
+                    }
+                }
+
+                void finish()
+                {
+                    for( int i = 0; i < 5; ++i ) shift_low() ;
+                }
+
+            private:
+                /* outputs the top byte of low, propagating the carry to
+                 * the bytes of 0xFF kept in cache */
+                void shift_low()
+                {
+                    if( (uint32_t)low_ < 0xFF000000u || ( low_ >> 32 ) != 0 ) {
+                        const unsigned char carry = low_ >> 32 ;
+                        unsigned char byte = cache_ ;
+                        do {
+                            out_.push_back( (char)( byte + carry ) ) ;
+                            byte = 0xFF ;
+                        } while( --cache_size_ != 0 ) ;
+                        cache_ = ( low_ >> 24 ) & 0xFF ;
+                    }
+                    ++cache_size_ ;
+                    low_ = ( low_ & 0x00FFFFFFu ) << 8 ;
+                }
+
+                std::vector< char >& out_ ;
+                uint64_t low_ ;
+                uint32_t range_ ;
+                unsigned char cache_ ;
+                uint64_t cache_size_ ;
+        } ;
+
+        class RangeDecoder {
+            public:
+                RangeDecoder( const char* src, size_t size )
+                    : src_( (const unsigned char*)src ), size_( size ), position_( 0 ),
+                    code_( 0 ), range_( 0xFFFFFFFFu )
+                {
+                    for( int i = 0; i < 5; ++i ) code_ = ( code_ << 8 ) | next() ;
+                }
+
+                int decode( uint16_t& probability )
+                {
+                    const uint32_t bound = ( range_ >> probability_bits ) * probability ;
+                    int bit ;
+                    if( code_ < bound ) {
+                        range_ = bound ;
+                        probability += ( ( 1 << probability_bits ) - probability ) >> adaptation_shift ;
+                        bit = 0 ;
+                    } else {
+                        code_ -= bound ;
+                        range_ -= bound ;
+                        probability -= probability >> adaptation_shift ;
+                        bit = 1 ;
+                    }
+                    while( range_ < range_top ) {
+                        range_ <<= 8 ;
+                        code_ = ( code_ << 8 ) | next() ;
+                    }
+                    return bit ;
+                }
+
+                /* the encoder flushes 5 bytes: reading more is an error */
+                bool overrun() const { return position_ > size_ ; }
+
+            private:
+                unsigned char next()
+                {
+                    return position_ < size_ ? src_[position_++] : ( ++position_, 0 ) ;
+                }
+
+                const unsigned char* src_ ;
+                size_t size_ ;
+                size_t position_ ;
+                uint32_t code_ ;
+                uint32_t range_ ;
+        } ;
+
+        /* 4 contexts: previous byte of the plane zero x byte above in
+         * the same value zero. Per context, the probability of a zero
+         * byte, then a binary tree of 255 probabilities for the 8 bits of
+         * a non zero byte. */
+        struct PlaneModel {
+            uint16_t zero[4] ;
+            uint16_t tree[4][256] ;
+
+            PlaneModel()
+            {
+                for( int c = 0; c < 4; ++c ) {
+                    zero[c] = 1 << ( probability_bits - 1 ) ;
+                    for( int i = 0; i < 256; ++i ) tree[c][i] = 1 << ( probability_bits - 1 ) ;
+                }
+            }
+        } ;
+
+        /* planes whose order-0 entropy is above this number of bits per
+         * byte are noise (the last bits of the mantissa): storing them
+         * raw costs less than coding them */
+        const double raw_plane_entropy = 7.8 ;
+
+        enum PlaneMode { CODED_PLANE = 0, RAW_PLANE = 1, ZERO_PLANE = 2 } ;
+
+        uint64_t bits_of( double x )
+        {
+            uint64_t b ;
+            memcpy( &b, &x, 8 ) ;
+            return b ;
+        }
+
+        double double_of( uint64_t b )
+        {
+            double x ;
+            memcpy( &x, &b, 8 ) ;
+            return x ;
+        }
+
+        unsigned byte_of( uint64_t residual, int plane )
+        {
+            return ( residual >> ( 8 * plane ) ) & 0xFF ;
+        }
+
+        int context( int plane, const uint64_t* residuals, size_t i )
+        {
+            const int previous_zero = i == 0 || byte_of( residuals[i - 1], plane ) == 0 ;
+            const int above_zero = plane == 7 || byte_of( residuals[i], plane + 1 ) == 0 ;
+            return 2 * previous_zero + above_zero ;
+        }
+
+        uint64_t prediction( const double* x, const double* previous, size_t i )
+        {
+            if( previous != NULL ) return bits_of( previous[i] ) ;
+            return i > 0 ? bits_of( x[i - 1] ) : 0 ;
+        }
+
+        template< class T >
+        void append_pod( std::vector< char >& dst, const T& value )
+        {
+            const char* p = reinterpret_cast< const char* >( &value ) ;
+            dst.insert( dst.end(), p, p + sizeof( T ) ) ;
+        }
+    }
+
+    void compress_doubles( const double* x, const double* previous, size_t n,
+        std::vector< char >& dst )
+    {
+        std::vector< uint64_t > residuals( n ) ;
+        for( size_t i = 0; i < n; ++i ) {
+            residuals[i] = bits_of( x[i] ) ^ prediction( x, previous, i ) ;
+        }
+        dst.clear() ;
+        std::vector< char > coded ;
+        /* each plane: mode byte, uint64 size, data. The planes go from the
+         * most significant byte, so that the decoder knows the byte above
+         * when it decodes a byte. */
+        for( int plane = 7; plane >= 0; --plane ) {
+            size_t histogram[256] = { 0 } ;
+            for( size_t i = 0; i < n; ++i ) ++histogram[byte_of( residuals[i], plane )] ;
+            double entropy = 0. ;
+            for( int b = 0; b < 256; ++b ) {
+                if( histogram[b] > 0 ) entropy -= histogram[b] * std::log2( (double)histogram[b] / n ) ;
+            }
+            entropy /= n > 0 ? n : 1 ;
+
+            char mode = CODED_PLANE ;
+            coded.clear() ;
+            if( histogram[0] == n ) {
+                mode = ZERO_PLANE ;
+            } else if( entropy <= raw_plane_entropy ) {
+                RangeEncoder encoder( coded ) ;
+                PlaneModel model ;
+                for( size_t i = 0; i < n; ++i ) {
+                    const int c = context( plane, residuals.data(), i ) ;
+                    const unsigned byte = byte_of( residuals[i], plane ) ;
+                    encoder.encode( model.zero[c], byte != 0 ) ;
+                    if( byte == 0 ) continue ;
+                    unsigned node = 1 ;
+                    for( int b = 7; b >= 0; --b ) {
+                        const int bit = ( byte >> b ) & 1 ;
+                        encoder.encode( model.tree[c][node], bit ) ;
+                        node = 2 * node + bit ;
+                    }
+                }
+                encoder.finish() ;
+            }
+            if( mode == CODED_PLANE && ( coded.empty() || coded.size() >= n ) ) {
+                mode = RAW_PLANE ;
+                coded.resize( n ) ;
+                for( size_t i = 0; i < n; ++i ) coded[i] = byte_of( residuals[i], plane ) ;
+            }
+            dst.push_back( mode ) ;
+            append_pod( dst, (uint64_t)coded.size() ) ;
+            dst.insert( dst.end(), coded.begin(), coded.end() ) ;
+        }
+    }
+
+    bool decompress_doubles( const char* src, size_t size, const double* previous,
+        size_t n, double* x )
+    {
+        std::vector< uint64_t > residuals( n, 0 ) ;
+        size_t position = 0 ;
+        for( int plane = 7; plane >= 0; --plane ) {
+            if( position + 9 > size ) return false ;
+            const char mode = src[position] ;
+            uint64_t plane_size ;
+            memcpy( &plane_size, src + position + 1, 8 ) ;
+            position += 9 ;
+            if( plane_size > size - position ) return false ;
+            const char* data = src + position ;
+            position += plane_size ;
+            if( mode == ZERO_PLANE ) continue ;
+            if( mode == RAW_PLANE ) {
+                if( plane_size != n ) return false ;
+                for( size_t i = 0; i < n; ++i ) {
+                    residuals[i] |= (uint64_t)(unsigned char)data[i] << ( 8 * plane ) ;
+                }
+                continue ;
+            }
+            if( mode != CODED_PLANE ) return false ;
+            RangeDecoder decoder( data, plane_size ) ;
+            PlaneModel model ;
+            for( size_t i = 0; i < n; ++i ) {
+                const int c = context( plane, residuals.data(), i ) ;
+                if( decoder.decode( model.zero[c] ) == 0 ) continue ;
+                unsigned node = 1 ;
+                while( node < 256 ) node = 2 * node + decoder.decode( model.tree[c][node] ) ;
+                residuals[i] |= (uint64_t)( node - 256 ) << ( 8 * plane ) ;
+            }
+            if( decoder.overrun() ) return false ;
+        }
+        for( size_t i = 0; i < n; ++i ) {
+            x[i] = double_of( residuals[i] ^ prediction( x, previous, i ) ) ;
+        }
+        return true ;
+    }
+
+}
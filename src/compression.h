@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief Compresses n bytes in the LZ4 block format (greedy matching
+     *        of 4-byte sequences, no frame header). The result is readable
+     *        by any LZ4 decoder, in particular by VTK (vtkLZ4DataCompressor).
+     * \param[in] src The data
+     * \param[in] n The number of bytes of src
+     * \param[out] dst The compressed block (replaces the content)
+     */
+    void lz4_compress( const char* src, size_t n, std::vector< char >& dst ) ;
+
+    /**
+     * \brief Decompresses an LZ4 block whose uncompressed size is known.
+     * \return false if the block is corrupted or does not decompress to
+     *         exactly dst_size bytes.
+     */
+    bool lz4_decompress( const char* src, size_t n, char* dst, size_t dst_size ) ;
+
+    /**
+     * \brief Lossless compression of n doubles, bit exact (NaN, -0 and
+     *        denormals included).
+     *
+     * Each value is XORed with its prediction: the same entry of
+     * previous (the last snapshot of a time series), or the previous
+     * entry of x if previous is NULL. The 8 bytes of the residuals are
+     * shuffled in byte planes, from the sign and exponent down to the
+     * last bits of the mantissa. Each plane is coded with an adaptive
+     * binary range coder (a zero flag, then the 8 bits of the byte) whose
+     * context is whether the previous byte of the plane and the byte
+     * above in the same value are zero: the leading bytes shared with the
+     * prediction cost almost nothing. Planes that are noise, as the last
+     * bits of the mantissa of a solution computed up to a tolerance,
+     * are stored raw.
+     * \param[out] dst The compressed data (replaces the content)
+     */
+    void compress_doubles( const double* x, const double* previous, size_t n,
+        std::vector< char >& dst ) ;
+
+    /**
+     * \brief Decompresses the output of compress_doubles, with the same
+     *        n and previous.
+     * \return false if the data is truncated
+     */
+    bool decompress_doubles( const char* src, size_t size, const double* previous,
+        size_t n, double* x ) ;
+
+}
@@ -134,13 +134,13 @@ namespace FEM2A {
     {
         if ( border==true ) {
         	for (int v = 0; v < 2; ++v ){
-        		vertices_.push_back(M.get_edge_vertex(i,v));
+        		vertices_[v] = M.get_edge_vertex(i,v);
         		//std::cout << "x : " << vertices_[v].x << " et y : " << vertices_[v].y << std::endl;
         	} 
         }
         else {
         	for ( int v = 0; v < 3; ++v ){
-        		vertices_.push_back(M.get_triangle_vertex(i,v)) ;
+        		vertices_[v] = M.get_triangle_vertex(i,v) ;
         		//std::cout << "x : " << vertices_[v].x << " et y : " << vertices_[v].y << std::endl;
         	} 
         }
@@ -183,17 +183,32 @@ namespace FEM2A {
 
     double ElementMapping::jacobian( vertex x_r ) const
     {
-        DenseMatrix J = jacobian_matrix(x_r);
         if ( border_ ) {
-        	double JTrans_J = J.get(0,0)*J.get(0,0) + J.get(1,0)*J.get(1,0);
-        	return std::sqrt(JTrans_J);
+        	double dx = -vertices_[0].x +vertices_[1].x;
+        	double dy = -vertices_[0].y +vertices_[1].y;
+        	return std::sqrt(dx*dx + dy*dy);
         }
         else {
-        	double JTrans_J  = J.det_2x2();
-        	return JTrans_J;
+        	return det(jacobian_matrix_2x2(x_r));
         }
     }
 
+    Mat< 2, 2 > ElementMapping::jacobian_matrix_2x2( vertex x_r ) const
+    {
+        assert( !border_ ) ;
+        Mat< 2, 2 > J ;
+        J( 0, 0 ) = -vertices_[0].x + vertices_[1].x ;
+        J( 0, 1 ) = -vertices_[0].x + vertices_[2].x ;
+        J( 1, 0 ) = -vertices_[0].y + vertices_[1].y ;
+        J( 1, 1 ) = -vertices_[0].y + vertices_[2].y ;
+        return J ;
+    }
+
+    bool ElementMapping::border() const
+    {
+        return border_ ;
+    }
+
     /****************************************************************/
     /* Implementation of ShapeFunctions */
     /****************************************************************/
@@ -224,7 +239,7 @@ namespace FEM2A {
 
     double ShapeFunctions::evaluate( int i, vertex x_r ) const
     {
-    	if  ( i == 0 ) {
+    	if  ( dim_ == 1 ) {
         	double xi = x_r.x ;
         	switch(i) {
         		case(0):
@@ -271,6 +286,17 @@ namespace FEM2A {
         return g ;
     }
 
+    Mat< 3, 2 > ShapeFunctions::evaluate_grads( vertex x_r ) const
+    {
+        Mat< 3, 2 > G ;
+        for ( int i = 0; i < nb_functions(); ++i ) {
+            vec2 g = evaluate_grad( i, x_r ) ;
+            G( i, 0 ) = g.x ;
+            G( i, 1 ) = g.y ;
+        }
+        return G ;
+    }
+
     /****************************************************************/
     /* Implementation of Finite Element functions */
     /****************************************************************/
@@ -281,6 +307,15 @@ namespace FEM2A {
         double (*coefficient)(vertex),
         DenseMatrix& Ke )
     {
+        if ( !elt_mapping.border() && reference_functions.nb_functions() == 3 ) {
+            Mat< 3, 3 > K ;
+            assemble_elementary_matrix( elt_mapping, reference_functions, quadrature, coefficient, K ) ;
+            Ke.set_size( 3, 3 ) ;
+            for ( int i = 0; i < 3; ++i ) {
+                for ( int j = 0; j < 3; ++j ) Ke.set( i, j, K( i, j ) ) ;
+            }
+            return ;
+        }
         Ke.set_size(reference_functions.nb_functions(), reference_functions.nb_functions());
         for ( int i = 0; i < reference_functions.nb_functions(); ++i ) {
         	for ( int j = 0; j < reference_functions.nb_functions(); ++j ) {
@@ -291,12 +326,65 @@ namespace FEM2A {
         			DenseMatrix inv_J = elt_mapping.jacobian_matrix(p_k).invert_2x2();
         			vec2 grad_i = inv_J.transpose().mult_2x2_2(reference_functions.evaluate_grad(i, p_k));
         			vec2 grad_j = inv_J.transpose().mult_2x2_2(reference_functions.evaluate_grad(j, p_k));
-        			Ke.add(i, j, w_k * coefficient(elt_mapping.transform(p_k)) * dot(grad_i, grad_j) * elt_mapping.jacobian(p_k));			
-        		}	
+        			Ke.add(i, j, w_k * coefficient(elt_mapping.transform(p_k)) * dot(grad_i, grad_j) * elt_mapping.jacobian(p_k));
+        		}
         	}
         }
     }
 
+    void assemble_elementary_matrix(
+        const ElementMapping& elt_mapping,
+        const ShapeFunctions& reference_functions,
+        const Quadrature& quadrature,
+        double (*coefficient)(vertex),
+        Mat< 3, 3 >& Ke )
+    {
+        Ke = Mat< 3, 3 >() ;
+        for ( int k = 0; k < quadrature.nb_points(); ++k ) {
+            vertex p_k = quadrature.point( k ) ;
+            Mat< 2, 2 > J = elt_mapping.jacobian_matrix_2x2( p_k ) ;
+            /* world gradients in rows: grad_i^T = grad_ref_i^T J^-1 */
+            Mat< 3, 2 > G = reference_functions.evaluate_grads( p_k ) * inverse( J ) ;
+            double w = quadrature.weight( k ) * coefficient( elt_mapping.transform( p_k ) ) * det( J ) ;
+            Ke += w * ( G * G.transpose() ) ;
+        }
+    }
+
+    void assemble_elementary_mass_matrix(
+        const ElementMapping& elt_mapping,
+        const ShapeFunctions& reference_functions,
+        const Quadrature& quadrature,
+        DenseMatrix& Me )
+    {
+        Me.set_size(reference_functions.nb_functions(), reference_functions.nb_functions());
+        for ( int i = 0; i < reference_functions.nb_functions(); ++i ) {
+        	for ( int j = 0; j < reference_functions.nb_functions(); ++j ) {
+        		Me.set(i, j, 0.);
+        		for (int k=0; k< quadrature.nb_points(); ++k ) {
+        			vertex p_k = quadrature.point(k);
+        			double w_k = quadrature.weight(k);
+        			Me.add(i, j, w_k * reference_functions.evaluate(i, p_k)
+        				* reference_functions.evaluate(j, p_k) * elt_mapping.jacobian(p_k));
+        		}
+        	}
+        }
+    }
+
+    void assemble_elementary_mass_matrix(
+        const ElementMapping& elt_mapping,
+        const ShapeFunctions& reference_functions,
+        const Quadrature& quadrature,
+        Mat< 3, 3 >& Me )
+    {
+        Me = Mat< 3, 3 >() ;
+        for ( int k = 0; k < quadrature.nb_points(); ++k ) {
+            vertex p_k = quadrature.point( k ) ;
+            Vec< 3 > phi ;
+            for ( int i = 0; i < 3; ++i ) phi[i] = reference_functions.evaluate( i, p_k ) ;
+            Me += ( quadrature.weight( k ) * elt_mapping.jacobian( p_k ) ) * ( phi * phi.transpose() ) ;
+        }
+    }
+
     void local_to_global_matrix(
         const Mesh& M,
         int t,
@@ -315,6 +403,19 @@ namespace FEM2A {
 
     }
 
+    void local_to_global_matrix(
+        const Mesh& M,
+        int t,
+        const Mat< 3, 3 >& Ke,
+        SparseMatrix& K )
+    {
+        int v[3] ;
+        for ( int i = 0; i < 3; ++i ) v[i] = M.get_triangle_vertex_index( t, i ) ;
+        for ( int i = 0; i < 3; ++i ) {
+            for ( int j = 0; j < 3; ++j ) K.add( v[i], v[j], Ke( i, j ) ) ;
+        }
+    }
+
     void assemble_elementary_vector(
         const ElementMapping& elt_mapping,
         const ShapeFunctions& reference_functions,
@@ -359,11 +460,13 @@ namespace FEM2A {
         std::vector< double >& F )
     {
         for (int y=0; y<Fe.size(); ++y) {
-        	int a = M.get_triangle_vertex_index( i, y );
-        	F[a] = Fe[y];
+        	int a = border ? M.get_edge_vertex_index( i, y ) : M.get_triangle_vertex_index( i, y );
+        	F[a] += Fe[y];
         }
     }
 
+    const double dirichlet_penalty = 10000. ;
+
     void apply_dirichlet_boundary_conditions(
         const Mesh& M,
         const std::vector< bool >& attribute_is_dirichlet, /* size: nb of attributes */
@@ -372,7 +475,7 @@ namespace FEM2A {
         std::vector< double >& F )
     {
         std::vector< bool > vertices(values.size(), false);
-        double p = 10000.;
+        double p = dirichlet_penalty;
         for (int ed = 0; ed < M.nb_edges(); ed++ ) {
         	int edge_attribute = M.get_edge_attribute(ed);
         	if( attribute_is_dirichlet[edge_attribute] ) {
@@ -389,6 +492,25 @@ namespace FEM2A {
         
     }
 
+    void dirichlet_vertices(
+        const Mesh& M,
+        const std::vector< bool >& attribute_is_dirichlet,
+        std::vector< int >& vertices )
+    {
+        std::vector< bool > seen( M.nb_vertices(), false ) ;
+        vertices.clear() ;
+        for( int ed = 0; ed < M.nb_edges(); ++ed ) {
+            if( !attribute_is_dirichlet[M.get_edge_attribute( ed )] ) continue ;
+            for( int k = 0; k < 2; ++k ) {
+                const int v = M.get_edge_vertex_index( ed, k ) ;
+                if( !seen[v] ) {
+                    seen[v] = true ;
+                    vertices.push_back( v ) ;
+                }
+            }
+        }
+    }
+
     void solve_poisson_problem(
             const Mesh& M,
             double (*diffusion_coef)(vertex),
@@ -2,14 +2,19 @@
 
 #include "mesh.h"
 #include "solver.h"
+#include "small_matrix.h"
 
 #include <assert.h>
+#include <functional>
 #include <string>
 #include <vector>
 
 
 namespace FEM2A {
 
+    /* a field f(x,y) that may carry state (lambdas with captures) */
+    typedef std::function< double( vertex ) > ScalarField ;
+
     /**
      * \brief Structure used to store a quadrature, which is a set of
      *        weights and points.
@@ -32,8 +37,8 @@ namespace FEM2A {
          */
         static Quadrature get_quadrature( int order, bool border = false ) ;
 
-        /* Data */
-        std::vector< double > wxy_ ;
+        /* Data: weight, x, y of each point */
+        ResourceVector< double > wxy_ ;
 
     } ;
 
@@ -91,9 +96,21 @@ namespace FEM2A {
              */
             double jacobian( vertex x_r ) const ;
 
+            /**
+             * \brief Jacobian matrix of a triangle mapping on the stack,
+             *        used by the element loops (no allocation).
+             * \param x_r Position in the reference space
+             */
+            Mat< 2, 2 > jacobian_matrix_2x2( vertex x_r ) const ;
+
+            /**
+             * \brief true if the element is an edge
+             */
+            bool border() const ;
+
         private:
             bool border_ ;
-            std::vector< vertex > vertices_ ;
+            vertex vertices_[3] ; /* the 2 first ones if border_ */
     } ;
 
     /**
@@ -138,6 +155,15 @@ namespace FEM2A {
              */
             vec2 evaluate_grad( int i, vertex x_r ) const ;
 
+            /**
+             * \brief Evaluates the gradients of all the shape functions at
+             *        a given reference point.
+             * \param x_r Position in the reference space
+             * \return the gradient of the i-th shape function in row i
+             *         (the third row is 0 on the reference segment)
+             */
+            Mat< 3, 2 > evaluate_grads( vertex x_r ) const ;
+
         private:
             int dim_ ;
             int order_ ;
@@ -166,6 +192,42 @@ namespace FEM2A {
         double (*coefficient)(vertex),
         DenseMatrix& Ke ) ;
 
+    /**
+     * \brief Same as above for P1 triangles, with the result on the
+     *        stack: nothing is allocated per element. The DenseMatrix
+     *        version uses it for triangles with 3 shape functions.
+     */
+    void assemble_elementary_matrix(
+        const ElementMapping& elt_mapping,
+        const ShapeFunctions& reference_functions,
+        const Quadrature& quadrature,
+        double (*coefficient)(vertex),
+        Mat< 3, 3 >& Ke ) ;
+
+    /**
+     * \brief Computes the elementary mass matrix Me associated
+     *        to a triangle defined by its ElementMapping:
+     *        Me(i,j) = integral of phi_i * phi_j over the triangle.
+     *
+     * \param[in] elt_mapping The mapping of the considered triangle
+     * \param[in] reference_functions The shape functions on the
+                                      reference triangle
+     * \param[in] quadrature The quadrature on the reference triangle
+     *                       (order >= 2 for exact integration)
+     * \param[out] Me The result
+     */
+    void assemble_elementary_mass_matrix(
+        const ElementMapping& elt_mapping,
+        const ShapeFunctions& reference_functions,
+        const Quadrature& quadrature,
+        DenseMatrix& Me ) ;
+
+    void assemble_elementary_mass_matrix(
+        const ElementMapping& elt_mapping,
+        const ShapeFunctions& reference_functions,
+        const Quadrature& quadrature,
+        Mat< 3, 3 >& Me ) ;
+
     /**
      * \brief  Adds the contribution Ke of triangle t to
      *         the global matrix K.
@@ -181,6 +243,12 @@ namespace FEM2A {
         const DenseMatrix& Ke,
         SparseMatrix& K ) ;
 
+    void local_to_global_matrix(
+        const Mesh& M,
+        int t,
+        const Mat< 3, 3 >& Ke,
+        SparseMatrix& K ) ;
+
     /**
      * \brief Computes the elementary vector Fe associated to a
      *        triangle defined by its ElementMapping due to the
@@ -239,6 +307,12 @@ namespace FEM2A {
         std::vector< double >& Fe,
         std::vector< double >& F ) ;
 
+    /**
+     * \brief Penalty coefficient added on the diagonal by
+     *        apply_dirichlet_boundary_conditions.
+     */
+    extern const double dirichlet_penalty ;
+
     /**
      * \brief  Modifies the linear system with the penalty method to
      *         apply Dirichlet boundary conditions.
@@ -258,6 +332,19 @@ namespace FEM2A {
         SparseMatrix& K,
         std::vector< double >& F ) ;
 
+    /**
+     * \brief Lists the vertices penalized by
+     *        apply_dirichlet_boundary_conditions, each once.
+     *
+     * \param[in] M The mesh
+     * \param[in] attribute_is_dirichlet As in apply_dirichlet_boundary_conditions
+     * \param[out] vertices The vertices of the Dirichlet edges
+     */
+    void dirichlet_vertices(
+        const Mesh& M,
+        const std::vector< bool >& attribute_is_dirichlet,
+        std::vector< int >& vertices ) ;
+
     /**
      * \brief Genereal function to solve a Poisson problem with the
      *        finite element method
@@ -0,0 +1,228 @@
+#include "fem2a_c.h"
+#include "problem.h"
+
+#include <exception>
+#include <new>
+#include <string>
+
+using namespace FEM2A ;
+
+struct fem2a_mesh {
+    Mesh mesh ;
+} ;
+
+struct fem2a_problem {
+    explicit fem2a_problem( const Mesh& M ) : problem( M ) {}
+    PoissonProblem problem ;
+} ;
+
+/* no exception crosses the C interface: they become error codes */
+static thread_local std::string last_error ;
+
+static int fail( int code, const char* message )
+{
+    last_error = message ;
+    return code ;
+}
+
+static ScalarField c_field( fem2a_field f, void* user_data )
+{
+    return [f, user_data]( vertex v ) { return f( v.x, v.y, user_data ) ; } ;
+}
+
+extern "C" {
+
+int fem2a_api_version( void )
+{
+    return FEM2A_API_VERSION ;
+}
+
+const char* fem2a_last_error( void )
+{
+    return last_error.c_str() ;
+}
+
+fem2a_mesh* fem2a_mesh_wrap( int nb_vertices, const double* coordinates,
+    int nb_triangles, const int* triangles,
+    int nb_edges, const int* edges,
+    const int* triangle_attributes, const int* edge_attributes )
+{
+    if( nb_vertices <= 0 || nb_triangles <= 0 || nb_edges < 0 || coordinates == NULL
+        || triangles == NULL || ( nb_edges > 0 && edges == NULL ) ) {
+        fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_mesh_wrap: invalid sizes or NULL arrays" ) ;
+        return NULL ;
+    }
+    for( long i = 0; i < 3L * nb_triangles; ++i ) {
+        if( triangles[i] < 0 || triangles[i] >= nb_vertices ) {
+            fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_mesh_wrap: vertex index out of range" ) ;
+            return NULL ;
+        }
+    }
+    for( long i = 0; i < 2L * nb_edges; ++i ) {
+        if( edges[i] < 0 || edges[i] >= nb_vertices ) {
+            fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_mesh_wrap: vertex index out of range" ) ;
+            return NULL ;
+        }
+    }
+    try {
+        fem2a_mesh* mesh = new fem2a_mesh ;
+        mesh->mesh.wrap( nb_vertices, coordinates, nb_triangles, triangles,
+            nb_edges, edges, triangle_attributes, edge_attributes ) ;
+        return mesh ;
+    } catch( const std::exception& e ) {
+        fail( FEM2A_ERROR_INTERNAL, e.what() ) ;
+        return NULL ;
+    }
+}
+
+fem2a_mesh* fem2a_mesh_load( const char* filename )
+{
+    if( filename == NULL ) {
+        fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_mesh_load: NULL filename" ) ;
+        return NULL ;
+    }
+    try {
+        fem2a_mesh* mesh = new fem2a_mesh ;
+        if( !mesh->mesh.load( filename ) ) {
+            delete mesh ;
+            fail( FEM2A_ERROR_IO, "fem2a_mesh_load: cannot read the file" ) ;
+            return NULL ;
+        }
+        return mesh ;
+    } catch( const std::exception& e ) {
+        fail( FEM2A_ERROR_INTERNAL, e.what() ) ;
+        return NULL ;
+    }
+}
+
+fem2a_mesh* fem2a_mesh_grid( int nx, int ny )
+{
+    if( nx <= 0 || ny <= 0 ) {
+        fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_mesh_grid: nx and ny must be positive" ) ;
+        return NULL ;
+    }
+    try {
+        fem2a_mesh* mesh = new fem2a_mesh ;
+        mesh->mesh.generate_grid( nx, ny ) ;
+        return mesh ;
+    } catch( const std::exception& e ) {
+        fail( FEM2A_ERROR_INTERNAL, e.what() ) ;
+        return NULL ;
+    }
+}
+
+void fem2a_mesh_free( fem2a_mesh* mesh )
+{
+    delete mesh ;
+}
+
+int fem2a_mesh_nb_vertices( const fem2a_mesh* mesh )
+{
+    if( mesh == NULL ) return fail( FEM2A_ERROR_INVALID_ARGUMENT, "NULL mesh" ) ;
+    return mesh->mesh.nb_vertices() ;
+}
+
+int fem2a_mesh_nb_triangles( const fem2a_mesh* mesh )
+{
+    if( mesh == NULL ) return fail( FEM2A_ERROR_INVALID_ARGUMENT, "NULL mesh" ) ;
+    return mesh->mesh.nb_triangles() ;
+}
+
+fem2a_problem* fem2a_problem_create( const fem2a_mesh* mesh )
+{
+    if( mesh == NULL ) {
+        fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_problem_create: NULL mesh" ) ;
+        return NULL ;
+    }
+    try {
+        return new fem2a_problem( mesh->mesh ) ;
+    } catch( const std::exception& e ) {
+        fail( FEM2A_ERROR_INTERNAL, e.what() ) ;
+        return NULL ;
+    }
+}
+
+void fem2a_problem_free( fem2a_problem* problem )
+{
+    delete problem ;
+}
+
+int fem2a_problem_set_diffusion( fem2a_problem* problem, int attribute, double value )
+{
+    if( problem == NULL || attribute < 0 ) {
+        return fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_problem_set_diffusion: invalid argument" ) ;
+    }
+    try {
+        problem->problem.set_diffusion( attribute, value ) ;
+    } catch( const std::exception& e ) {
+        return fail( FEM2A_ERROR_INTERNAL, e.what() ) ;
+    }
+    return FEM2A_OK ;
+}
+
+int fem2a_problem_set_source( fem2a_problem* problem, fem2a_field f, void* user_data )
+{
+    if( problem == NULL ) {
+        return fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_problem_set_source: NULL problem" ) ;
+    }
+    problem->problem.set_source( f != NULL ? c_field( f, user_data ) : ScalarField() ) ;
+    return FEM2A_OK ;
+}
+
+int fem2a_problem_set_dirichlet( fem2a_problem* problem, int edge_attribute,
+    fem2a_field g, void* user_data )
+{
+    if( problem == NULL || edge_attribute < 0 || g == NULL ) {
+        return fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_problem_set_dirichlet: invalid argument" ) ;
+    }
+    try {
+        problem->problem.set_dirichlet( edge_attribute, c_field( g, user_data ) ) ;
+    } catch( const std::exception& e ) {
+        return fail( FEM2A_ERROR_INTERNAL, e.what() ) ;
+    }
+    return FEM2A_OK ;
+}
+
+int fem2a_problem_set_tolerance( fem2a_problem* problem, double tolerance )
+{
+    if( problem == NULL || !( tolerance > 0. ) ) {
+        return fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_problem_set_tolerance: invalid argument" ) ;
+    }
+    SolverConfig config = problem->problem.solver_config() ;
+    config.threshold = tolerance ;
+    problem->problem.set_solver_config( config ) ;
+    return FEM2A_OK ;
+}
+
+int fem2a_problem_solve( fem2a_problem* problem )
+{
+    if( problem == NULL ) {
+        return fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_problem_solve: NULL problem" ) ;
+    }
+    try {
+        if( !problem->problem.solve() ) {
+            return fail( FEM2A_ERROR_NOT_CONVERGED, "fem2a_problem_solve: the solver did not converge" ) ;
+        }
+    } catch( const std::exception& e ) {
+        return fail( FEM2A_ERROR_INTERNAL, e.what() ) ;
+    }
+    return FEM2A_OK ;
+}
+
+const double* fem2a_problem_solution( const fem2a_problem* problem, int* size )
+{
+    if( problem == NULL ) {
+        fail( FEM2A_ERROR_INVALID_ARGUMENT, "fem2a_problem_solution: NULL problem" ) ;
+        return NULL ;
+    }
+    if( size != NULL ) *size = problem->problem.size() ;
+    return problem->problem.solution() ;
+}
+
+int fem2a_problem_iterations( const fem2a_problem* problem )
+{
+    if( problem == NULL ) return fail( FEM2A_ERROR_INVALID_ARGUMENT, "NULL problem" ) ;
+    return problem->problem.iterations() ;
+}
+
+}
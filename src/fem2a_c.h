@@ -0,0 +1,74 @@
+#ifndef __FEM2A_C_API__
+#define __FEM2A_C_API__
+
+/*
+ * C interface of libfem2a (see PoissonProblem in problem.h): opaque
+ * handles, plain arrays and integer status codes, so that the library can
+ * be called from C or through any FFI without the C++ runtime types.
+ * The functions returning an int return FEM2A_OK or a negative error
+ * code; fem2a_last_error() describes the last error of the thread.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FEM2A_API_VERSION 1
+
+#define FEM2A_OK 0
+#define FEM2A_ERROR_INVALID_ARGUMENT -1
+#define FEM2A_ERROR_NOT_CONVERGED -2
+#define FEM2A_ERROR_IO -3
+#define FEM2A_ERROR_INTERNAL -4
+
+typedef struct fem2a_mesh fem2a_mesh ;
+typedef struct fem2a_problem fem2a_problem ;
+
+/* a field f(x,y), user_data is passed back unchanged */
+typedef double (*fem2a_field)( double x, double y, void* user_data ) ;
+
+int fem2a_api_version( void ) ;
+const char* fem2a_last_error( void ) ;
+
+/*
+ * Mesh viewing the arrays of the caller, which are not copied and must
+ * outlive the mesh: coordinates (x0 y0 x1 y1 ...), triangles (3 vertex
+ * indices from 0 each), border edges (2 each, may be NULL if nb_edges is
+ * 0). The attribute arrays may be NULL (attribute 1 everywhere).
+ * Returns NULL on error.
+ */
+fem2a_mesh* fem2a_mesh_wrap( int nb_vertices, const double* coordinates,
+    int nb_triangles, const int* triangles,
+    int nb_edges, const int* edges,
+    const int* triangle_attributes, const int* edge_attributes ) ;
+fem2a_mesh* fem2a_mesh_load( const char* filename ) ;
+/* unit square, nx x ny cells; border attributes 1 (y = 0), 2 (x = 1), 3 (y = 1), 4 (x = 0) */
+fem2a_mesh* fem2a_mesh_grid( int nx, int ny ) ;
+void fem2a_mesh_free( fem2a_mesh* mesh ) ;
+int fem2a_mesh_nb_vertices( const fem2a_mesh* mesh ) ;
+int fem2a_mesh_nb_triangles( const fem2a_mesh* mesh ) ;
+
+/* the mesh must outlive the problem */
+fem2a_problem* fem2a_problem_create( const fem2a_mesh* mesh ) ;
+void fem2a_problem_free( fem2a_problem* problem ) ;
+
+int fem2a_problem_set_diffusion( fem2a_problem* problem, int attribute, double value ) ;
+int fem2a_problem_set_source( fem2a_problem* problem, fem2a_field f, void* user_data ) ;
+int fem2a_problem_set_dirichlet( fem2a_problem* problem, int edge_attribute,
+    fem2a_field g, void* user_data ) ;
+int fem2a_problem_set_tolerance( fem2a_problem* problem, double tolerance ) ;
+
+int fem2a_problem_solve( fem2a_problem* problem ) ;
+
+/*
+ * View of the solution (one value per vertex, *size of them if size is
+ * not NULL), valid until fem2a_problem_free; updated by each solve.
+ */
+const double* fem2a_problem_solution( const fem2a_problem* problem, int* size ) ;
+int fem2a_problem_iterations( const fem2a_problem* problem ) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
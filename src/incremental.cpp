@@ -0,0 +1,150 @@
+#include "incremental.h"
+
+#include <algorithm>
+
+namespace FEM2A {
+
+    /****************************************************************/
+    /* Implementation of IncrementalStiffness */
+    /****************************************************************/
+    IncrementalStiffness::IncrementalStiffness(
+        const Mesh& M,
+        const MaterialTable& materials,
+        const std::vector< bool >& attribute_is_dirichlet )
+        : mesh_( M ), K_( M.nb_vertices() ), quadrature_( Quadrature::get_quadrature( 2 ) ),
+        shape_functions_( 2, 1 ), materials_( materials ), marked_( M.nb_triangles(), 0 ),
+        row_changed_( M.nb_vertices(), 0 )
+    {
+        const int nt = M.nb_triangles() ;
+        int attr_max = 0 ;
+        for( int t = 0; t < nt; ++t ) attr_max = std::max( attr_max, M.get_triangle_attribute( t ) ) ;
+        triangles_by_attribute_.resize( attr_max + 1 ) ;
+
+        attributes_.resize( nt ) ;
+        ke_.resize( 9 * (size_t)nt ) ;
+        for( int t = 0; t < nt; ++t ) {
+            attributes_[t] = M.get_triangle_attribute( t ) ;
+            triangles_by_attribute_[attributes_[t]].push_back( t ) ;
+            double* ke = &ke_[9 * (size_t)t] ;
+            compute_element( t, ke ) ;
+            for( int i = 0; i < 3; ++i ) {
+                for( int j = 0; j < 3; ++j ) {
+                    K_.add( M.get_triangle_vertex_index( t, i ),
+                        M.get_triangle_vertex_index( t, j ), ke[3 * i + j] ) ;
+                }
+            }
+        }
+        std::vector< double > values( M.nb_vertices(), 0. ), F( M.nb_vertices(), 0. ) ;
+        apply_dirichlet_boundary_conditions( M, attribute_is_dirichlet, values, K_, F ) ;
+    }
+
+    void IncrementalStiffness::compute_element( int t, double* ke ) const
+    {
+        ElementMapping mapping( mesh_, false, t ) ;
+        Mat< 3, 3 > Ke ;
+        assemble_elementary_matrix( mapping, shape_functions_, quadrature_,
+            materials_, attributes_[t], Ke ) ;
+        for( int k = 0; k < 9; ++k ) ke[k] = Ke[k] ;
+    }
+
+    void IncrementalStiffness::mark( int t )
+    {
+        if( !marked_[t] ) {
+            marked_[t] = 1 ;
+            pending_.push_back( t ) ;
+        }
+    }
+
+    void IncrementalStiffness::mark_attribute( int attribute )
+    {
+        if( attribute >= triangles_by_attribute_.size() ) return ;
+        const std::vector< int >& triangles = triangles_by_attribute_[attribute] ;
+        for( int k = 0; k < triangles.size(); ++k ) mark( triangles[k] ) ;
+    }
+
+    void IncrementalStiffness::set_coefficient( int attribute, double (*coefficient)(vertex) )
+    {
+        materials_.set_function( attribute, coefficient ) ;
+        mark_attribute( attribute ) ;
+    }
+
+    void IncrementalStiffness::set_coefficient( int attribute, double value )
+    {
+        materials_.set_constant( attribute, value ) ;
+        mark_attribute( attribute ) ;
+    }
+
+    int IncrementalStiffness::refresh_attributes()
+    {
+        int nb_changed = 0 ;
+        for( int t = 0; t < mesh_.nb_triangles(); ++t ) {
+            const int attribute = mesh_.get_triangle_attribute( t ) ;
+            if( attribute == attributes_[t] ) continue ;
+            if( attribute >= triangles_by_attribute_.size() ) {
+                triangles_by_attribute_.resize( attribute + 1 ) ;
+            }
+            attributes_[t] = attribute ;
+            mark( t ) ;
+            ++nb_changed ;
+        }
+        if( nb_changed > 0 ) {
+            for( int a = 0; a < triangles_by_attribute_.size(); ++a ) triangles_by_attribute_[a].clear() ;
+            for( int t = 0; t < mesh_.nb_triangles(); ++t ) {
+                triangles_by_attribute_[attributes_[t]].push_back( t ) ;
+            }
+        }
+        return nb_changed ;
+    }
+
+    int IncrementalStiffness::update()
+    {
+        for( int k = 0; k < changed_rows_.size(); ++k ) row_changed_[changed_rows_[k]] = 0 ;
+        changed_rows_.clear() ;
+
+        double ke[9] ;
+        for( int k = 0; k < pending_.size(); ++k ) {
+            const int t = pending_[k] ;
+            marked_[t] = 0 ;
+            compute_element( t, ke ) ;
+            double* old_ke = &ke_[9 * (size_t)t] ;
+            int v[3] ;
+            for( int i = 0; i < 3; ++i ) {
+                v[i] = mesh_.get_triangle_vertex_index( t, i ) ;
+                if( !row_changed_[v[i]] ) {
+                    row_changed_[v[i]] = 1 ;
+                    changed_rows_.push_back( v[i] ) ;
+                }
+            }
+            for( int i = 0; i < 3; ++i ) {
+                for( int j = 0; j < 3; ++j ) {
+                    K_.add( v[i], v[j], ke[3 * i + j] - old_ke[3 * i + j] ) ;
+                    old_ke[3 * i + j] = ke[3 * i + j] ;
+                }
+            }
+        }
+        const int nb_updated = pending_.size() ;
+        pending_.clear() ;
+        std::sort( changed_rows_.begin(), changed_rows_.end() ) ;
+
+        if( !changed_rows_.empty() ) {
+            for( int h = 0; h < hooks_.size(); ++h ) hooks_[h]( changed_rows_ ) ;
+        }
+        return nb_updated ;
+    }
+
+    void IncrementalStiffness::add_update_hook( const UpdateHook& hook )
+    {
+        hooks_.push_back( hook ) ;
+    }
+
+    const SparseMatrix& IncrementalStiffness::matrix() const
+    {
+        return K_ ;
+    }
+
+    const std::vector< int >& IncrementalStiffness::changed_rows() const
+    {
+        return changed_rows_ ;
+    }
+
+}
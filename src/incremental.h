@@ -0,0 +1,101 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "solver.h"
+#include "material.h"
+
+#include <functional>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief IncrementalStiffness keeps the stiffness matrix of
+     *        -div(k grad u) (with the Dirichlet penalty) up to date when
+     *        the diffusion coefficient of some triangle attributes, or the
+     *        attributes of some triangles, change.
+     *
+     * The coefficient of each triangle attribute comes from a
+     * MaterialTable (constant or function). The elementary matrices of all the triangles are kept; update()
+     * recomputes only the ones of the triangles whose coefficient or
+     * attribute changed and adds Ke_new - Ke_old in place to the
+     * coefficients of the SparseMatrix, whose sparsity pattern does not
+     * change. The cost is proportional to the changed region.
+     *
+     * The hooks registered with add_update_hook() are then called with
+     * the rows that changed, to update preconditioners or factorizations
+     * (see LinearSolver::update_preconditioner and
+     * LinearPreconditioner::update).
+     */
+    class IncrementalStiffness {
+        public:
+            typedef std::function< void( const std::vector< int >& changed_rows ) > UpdateHook ;
+
+            /**
+             * \param M The mesh, must outlive the object
+             * \param materials The coefficient of each attribute until
+             *        set_coefficient() is called
+             * \param attribute_is_dirichlet Edge attributes where a
+             *        Dirichlet condition is imposed by penalty
+             */
+            IncrementalStiffness(
+                const Mesh& M,
+                const MaterialTable& materials,
+                const std::vector< bool >& attribute_is_dirichlet ) ;
+
+            /**
+             * \brief Sets the coefficient of the triangles of attribute
+             *        attribute. Takes effect at the next update(), even if
+             *        the function is the same (it may read a parameter
+             *        that changed).
+             */
+            void set_coefficient( int attribute, double (*coefficient)(vertex) ) ;
+            void set_coefficient( int attribute, double value ) ;
+
+            /**
+             * \brief Compares the attributes of the triangles with the
+             *        ones of the last update (for instance after
+             *        Mesh::set_attribute) and marks the triangles whose
+             *        attribute changed. Costs one pass over the triangles.
+             *        New attributes get the default material of the table.
+             * \return the number of triangles whose attribute changed
+             */
+            int refresh_attributes() ;
+
+            /**
+             * \brief Recomputes the elementary matrices of the marked
+             *        triangles, updates the matrix in place and calls the
+             *        hooks with the rows that changed.
+             * \return the number of elementary matrices recomputed
+             */
+            int update() ;
+
+            void add_update_hook( const UpdateHook& hook ) ;
+
+            const SparseMatrix& matrix() const ;
+
+            /* rows modified by the last update(), sorted */
+            const std::vector< int >& changed_rows() const ;
+
+        private:
+            void compute_element( int t, double* ke ) const ;
+            void mark( int t ) ;
+            void mark_attribute( int attribute ) ;
+
+            const Mesh& mesh_ ;
+            SparseMatrix K_ ;
+            Quadrature quadrature_ ;
+            ShapeFunctions shape_functions_ ;
+            MaterialTable materials_ ;
+            std::vector< int > attributes_ ;     /* of the triangles at the last update */
+            std::vector< double > ke_ ;          /* 9 values of Ke per triangle */
+            std::vector< std::vector< int > > triangles_by_attribute_ ;
+            std::vector< char > marked_ ;
+            std::vector< int > pending_ ;        /* marked triangles */
+            std::vector< char > row_changed_ ;
+            std::vector< int > changed_rows_ ;
+            std::vector< UpdateHook > hooks_ ;
+    } ;
+
+}
@@ -0,0 +1,127 @@
+#include "material.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace FEM2A {
+
+    /****************************************************************/
+    /* Implementation of MaterialTable */
+    /****************************************************************/
+    MaterialTable::MaterialTable( double value )
+    {
+        default_.value = value ;
+        default_.function = NULL ;
+    }
+
+    MaterialTable::MaterialTable( double (*coefficient)(vertex) )
+    {
+        assert( coefficient != NULL ) ;
+        default_.value = 0. ;
+        default_.function = coefficient ;
+    }
+
+    void MaterialTable::set_constant( int attribute, double value )
+    {
+        assert( attribute >= 0 ) ;
+        if( attribute >= materials_.size() ) {
+            materials_.resize( attribute + 1, default_ ) ;
+            is_set_.resize( attribute + 1, 0 ) ;
+        }
+        materials_[attribute].value = value ;
+        materials_[attribute].function = NULL ;
+        is_set_[attribute] = 1 ;
+    }
+
+    void MaterialTable::set_function( int attribute, double (*coefficient)(vertex) )
+    {
+        assert( attribute >= 0 && coefficient != NULL ) ;
+        if( attribute >= materials_.size() ) {
+            materials_.resize( attribute + 1, default_ ) ;
+            is_set_.resize( attribute + 1, 0 ) ;
+        }
+        materials_[attribute].value = 0. ;
+        materials_[attribute].function = coefficient ;
+        is_set_[attribute] = 1 ;
+    }
+
+    const MaterialTable::Material& MaterialTable::get( int attribute ) const
+    {
+        if( attribute >= 0 && attribute < materials_.size() && is_set_[attribute] ) {
+            return materials_[attribute] ;
+        }
+        return default_ ;
+    }
+
+    bool MaterialTable::is_constant( int attribute ) const
+    {
+        return get( attribute ).function == NULL ;
+    }
+
+    double MaterialTable::constant( int attribute ) const
+    {
+        assert( is_constant( attribute ) ) ;
+        return get( attribute ).value ;
+    }
+
+    double (*MaterialTable::function( int attribute ) const)(vertex)
+    {
+        return get( attribute ).function ;
+    }
+
+    double MaterialTable::evaluate( int attribute, vertex x ) const
+    {
+        const Material& m = get( attribute ) ;
+        return m.function == NULL ? m.value : m.function( x ) ;
+    }
+
+    /****************************************************************/
+    /* Finite element functions with a MaterialTable */
+    /****************************************************************/
+    void assemble_elementary_matrix(
+        const ElementMapping& elt_mapping,
+        const ShapeFunctions& reference_functions,
+        const Quadrature& quadrature,
+        const MaterialTable& materials,
+        int attribute,
+        Mat< 3, 3 >& Ke )
+    {
+        if( !materials.is_constant( attribute ) ) {
+            assemble_elementary_matrix( elt_mapping, reference_functions, quadrature,
+                materials.function( attribute ), Ke ) ;
+            return ;
+        }
+        /* P1: constant gradients, the integral is k |T| grad phi_i . grad phi_j
+         * with |T| = det(J) / 2 */
+        const vertex origin = { 0., 0. } ;
+        const Mat< 2, 2 > J = elt_mapping.jacobian_matrix_2x2( origin ) ;
+        const Mat< 3, 2 > G = reference_functions.evaluate_grads( origin ) * inverse( J ) ;
+        Ke = ( 0.5 * materials.constant( attribute ) * det( J ) ) * ( G * G.transpose() ) ;
+    }
+
+    void assemble_stiffness( const Mesh& M, const MaterialTable& materials, SparseMatrix& K )
+    {
+        const Quadrature quadrature = Quadrature::get_quadrature( 2 ) ;
+        const ShapeFunctions shape_functions( 2, 1 ) ;
+        /* the elementary matrices of a block are computed on the pool,
+         * then added in the order of the triangles: K does not depend on
+         * the number of threads */
+        const int block_size = 8192 ;
+        std::vector< Mat< 3, 3 > > Ke( std::min( block_size, M.nb_triangles() ) ) ;
+        for( int first = 0; first < M.nb_triangles(); first += block_size ) {
+            const int size = std::min( block_size, M.nb_triangles() - first ) ;
+            ThreadPool::current().parallel_for( size, 512, [&]( int begin, int end ) {
+                for( int b = begin; b < end; ++b ) {
+                    ElementMapping mapping( M, false, first + b ) ;
+                    assemble_elementary_matrix( mapping, shape_functions, quadrature,
+                        materials, M.get_triangle_attribute( first + b ), Ke[b] ) ;
+                }
+            } ) ;
+            for( int b = 0; b < size; ++b ) {
+                local_to_global_matrix( M, first + b, Ke[b], K ) ;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "solver.h"
+
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief MaterialTable gives the diffusion coefficient of each
+     *        triangle attribute (see Mesh::get_triangle_attribute),
+     *        either as a constant or as a function k(x,y). The attributes
+     *        that are not set get the default material.
+     *
+     * The elements of a constant material are computed in closed form
+     * (k |T| grad phi_i . grad phi_j for P1 triangles) without quadrature
+     * nor call through a function pointer; the other ones go through
+     * assemble_elementary_matrix.
+     */
+    class MaterialTable {
+        public:
+            /**
+             * \brief Table whose default material is the constant value.
+             */
+            explicit MaterialTable( double value = 1. ) ;
+
+            /**
+             * \brief Table whose default material is the function.
+             */
+            explicit MaterialTable( double (*coefficient)(vertex) ) ;
+
+            void set_constant( int attribute, double value ) ;
+            void set_function( int attribute, double (*coefficient)(vertex) ) ;
+
+            bool is_constant( int attribute ) const ;
+            /* only if is_constant( attribute ) */
+            double constant( int attribute ) const ;
+            /* NULL if is_constant( attribute ) */
+            double (*function( int attribute ) const)(vertex) ;
+
+            /**
+             * \return the coefficient of attribute at the point x
+             */
+            double evaluate( int attribute, vertex x ) const ;
+
+        private:
+            struct Material {
+                double value ;
+                double (*function)(vertex) ; /* NULL for a constant */
+            } ;
+
+            const Material& get( int attribute ) const ;
+
+            Material default_ ;
+            std::vector< Material > materials_ ;
+            std::vector< char > is_set_ ;
+    } ;
+
+    /**
+     * \brief Computes the elementary stiffness matrix of a P1 triangle
+     *        of the given attribute: in closed form if its material is
+     *        constant, with quadrature and reference_functions otherwise.
+     */
+    void assemble_elementary_matrix(
+        const ElementMapping& elt_mapping,
+        const ShapeFunctions& reference_functions,
+        const Quadrature& quadrature,
+        const MaterialTable& materials,
+        int attribute,
+        Mat< 3, 3 >& Ke ) ;
+
+    /**
+     * \brief Adds the stiffness matrices of all the triangles of M to K,
+     *        with the material of their attribute.
+     */
+    void assemble_stiffness( const Mesh& M, const MaterialTable& materials, SparseMatrix& K ) ;
+
+}
@@ -0,0 +1,179 @@
+#include "matrix_free.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <assert.h>
+
+namespace FEM2A {
+
+    /* number of consecutive triangles colored together */
+    static const int block_size = 512 ;
+
+    /* color given to the blocks that do not fit in the 63 first ones,
+     * they are applied sequentially */
+    static const int last_color = 63 ;
+
+    /****************************************************************/
+    /* Implementation of MatrixFreeStiffness */
+    /****************************************************************/
+    MatrixFreeStiffness::MatrixFreeStiffness(
+        const Mesh& M,
+        double (*diffusion_coef)(vertex),
+        const std::vector< bool >& attribute_is_dirichlet,
+        ThreadPool& pool )
+        : mesh_( M ), pool_( pool )
+    {
+        const int nt = M.nb_triangles() ;
+        const int nb_blocks = ( nt + block_size - 1 ) / block_size ;
+        const Quadrature quadrature = Quadrature::get_quadrature( 2 ) ;
+
+        factor_.resize( nt ) ;
+        for( int t = 0; t < nt; ++t ) {
+            const vertex p0 = M.get_triangle_vertex( t, 0 ) ;
+            const vertex p1 = M.get_triangle_vertex( t, 1 ) ;
+            const vertex p2 = M.get_triangle_vertex( t, 2 ) ;
+            const double twice_area = std::fabs(
+                ( p1.x - p0.x ) * ( p2.y - p0.y ) - ( p2.x - p0.x ) * ( p1.y - p0.y ) ) ;
+            double k = 0. ;
+            for( int q = 0; q < quadrature.nb_points(); ++q ) {
+                const vertex xi = quadrature.point( q ) ;
+                vertex x ;
+                x.x = ( 1 - xi.x - xi.y ) * p0.x + xi.x * p1.x + xi.y * p2.x ;
+                x.y = ( 1 - xi.x - xi.y ) * p0.y + xi.x * p1.y + xi.y * p2.y ;
+                k += quadrature.weight( q ) * diffusion_coef( x ) ;
+            }
+            factor_[t] = k / twice_area ;
+        }
+
+        /* greedy coloring: a block takes the first color that none of
+         * its vertices has already seen */
+        std::vector< uint64_t > used( M.nb_vertices(), 0 ) ;
+        std::vector< unsigned char > color( nb_blocks ) ;
+        std::vector< int > count( last_color + 1, 0 ) ;
+        for( int b = 0; b < nb_blocks; ++b ) {
+            const int end = std::min( nt, ( b + 1 ) * block_size ) ;
+            uint64_t taken = 0 ;
+            for( int t = b * block_size; t < end; ++t ) {
+                for( int i = 0; i < 3; ++i ) taken |= used[M.get_triangle_vertex_index( t, i )] ;
+            }
+            int c = 0 ;
+            while( c < last_color && ( taken >> c & 1 ) ) ++c ;
+            color[b] = c ;
+            ++count[c] ;
+            for( int t = b * block_size; t < end; ++t ) {
+                for( int i = 0; i < 3; ++i ) used[M.get_triangle_vertex_index( t, i )] |= (uint64_t)1 << c ;
+            }
+        }
+        std::vector< uint64_t >().swap( used ) ;
+
+        int nb_colors = 0 ;
+        for( int c = 0; c <= last_color; ++c ) {
+            if( count[c] > 0 ) nb_colors = c + 1 ;
+        }
+        color_offsets_.assign( nb_colors + 1, 0 ) ;
+        for( int c = 0; c < nb_colors; ++c ) {
+            color_offsets_[c + 1] = color_offsets_[c] + count[c] ;
+        }
+        blocks_.resize( nb_blocks ) ;
+        std::vector< int > next( color_offsets_.begin(), color_offsets_.end() - 1 ) ;
+        for( int b = 0; b < nb_blocks; ++b ) {
+            blocks_[next[color[b]]++] = b ;
+        }
+
+        std::vector< bool > seen( M.nb_vertices(), false ) ;
+        for( int e = 0; e < M.nb_edges(); ++e ) {
+            if( !attribute_is_dirichlet[M.get_edge_attribute( e )] ) continue ;
+            for( int i = 0; i < 2; ++i ) {
+                const int v = M.get_edge_vertex_index( e, i ) ;
+                if( !seen[v] ) {
+                    seen[v] = true ;
+                    dirichlet_vertices_.push_back( v ) ;
+                }
+            }
+        }
+    }
+
+    int MatrixFreeStiffness::nb_rows() const
+    {
+        return mesh_.nb_vertices() ;
+    }
+
+    int MatrixFreeStiffness::nb_colors() const
+    {
+        return color_offsets_.size() - 1 ;
+    }
+
+    void MatrixFreeStiffness::mult( const std::vector< double >& x, std::vector< double >& y ) const
+    {
+        assert( x.size() == nb_rows() ) ;
+        const int nt = mesh_.nb_triangles() ;
+        y.assign( nb_rows(), 0. ) ;
+        for( int c = 0; c < nb_colors(); ++c ) {
+            const int first = color_offsets_[c] ;
+            const int size = color_offsets_[c + 1] - first ;
+            pool_.parallel_for( c == last_color ? 1 : size, [&]( int begin, int end ) {
+                if( c == last_color ) end = size ;
+                for( int b = first + begin; b < first + end; ++b ) {
+                    const int t_end = std::min( nt, ( blocks_[b] + 1 ) * block_size ) ;
+                    for( int t = blocks_[b] * block_size; t < t_end; ++t ) {
+                        const int v0 = mesh_.get_triangle_vertex_index( t, 0 ) ;
+                        const int v1 = mesh_.get_triangle_vertex_index( t, 1 ) ;
+                        const int v2 = mesh_.get_triangle_vertex_index( t, 2 ) ;
+                        const vertex p0 = mesh_.get_vertex( v0 ) ;
+                        const vertex p1 = mesh_.get_vertex( v1 ) ;
+                        const vertex p2 = mesh_.get_vertex( v2 ) ;
+                        /* edges opposite to each vertex */
+                        const double e0x = p2.x - p1.x, e0y = p2.y - p1.y ;
+                        const double e1x = p0.x - p2.x, e1y = p0.y - p2.y ;
+                        const double e2x = p1.x - p0.x, e2y = p1.y - p0.y ;
+                        /* (Ke u)_i = c e_i . g with g = sum_j u_j e_j */
+                        const double gx = factor_[t] * ( e0x * x[v0] + e1x * x[v1] + e2x * x[v2] ) ;
+                        const double gy = factor_[t] * ( e0y * x[v0] + e1y * x[v1] + e2y * x[v2] ) ;
+                        y[v0] += e0x * gx + e0y * gy ;
+                        y[v1] += e1x * gx + e1y * gy ;
+                        y[v2] += e2x * gx + e2y * gy ;
+                    }
+                }
+            } ) ;
+        }
+        for( int d = 0; d < dirichlet_vertices_.size(); ++d ) {
+            const int v = dirichlet_vertices_[d] ;
+            y[v] += dirichlet_penalty * x[v] ;
+        }
+    }
+
+    void MatrixFreeStiffness::diagonal( std::vector< double >& d ) const
+    {
+        d.assign( nb_rows(), 0. ) ;
+        for( int t = 0; t < factor_.size(); ++t ) {
+            for( int a = 0; a < 3; ++a ) {
+                const vertex p = mesh_.get_triangle_vertex( t, ( a + 1 ) % 3 ) ;
+                const vertex q = mesh_.get_triangle_vertex( t, ( a + 2 ) % 3 ) ;
+                const double ex = q.x - p.x ;
+                const double ey = q.y - p.y ;
+                d[mesh_.get_triangle_vertex_index( t, a )] += factor_[t] * ( ex * ex + ey * ey ) ;
+            }
+        }
+        for( int k = 0; k < dirichlet_vertices_.size(); ++k ) {
+            d[dirichlet_vertices_[k]] += dirichlet_penalty ;
+        }
+    }
+
+    void MatrixFreeStiffness::add_dirichlet_terms( double (*dirichlet_fct)(vertex), std::vector< double >& F ) const
+    {
+        for( int d = 0; d < dirichlet_vertices_.size(); ++d ) {
+            const int v = dirichlet_vertices_[d] ;
+            F[v] += dirichlet_penalty * dirichlet_fct( mesh_.get_vertex( v ) ) ;
+        }
+    }
+
+    size_t MatrixFreeStiffness::memory_bytes() const
+    {
+        return blocks_.capacity() * sizeof( int )
+            + color_offsets_.capacity() * sizeof( int )
+            + factor_.capacity() * sizeof( double )
+            + dirichlet_vertices_.capacity() * sizeof( int ) ;
+    }
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "solver.h"
+#include "parallel.h"
+
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief MatrixFreeStiffness is the P1 stiffness operator of
+     *        -div(k grad u), with the Dirichlet penalty, applied element
+     *        by element without assembling any matrix.
+     *
+     * For a triangle with edges e_0, e_1, e_2 (e_i opposite to vertex i)
+     * the elementary matrix is Ke_ij = c (e_i . e_j), c being the
+     * quadrature of k divided by twice the area. Only c is cached per
+     * triangle: the edges are recomputed from the Mesh coordinates at each
+     * product, so the operator costs 8 bytes per triangle instead of the
+     * ~7 row entries per vertex of the assembled SparseMatrix.
+     *
+     * The triangles are cut in blocks of consecutive triangles and the
+     * blocks are colored so that two blocks of the same color never share
+     * a vertex: the blocks of a color are scattered on a ThreadPool without
+     * atomics, while each block still reads the mesh contiguously.
+     */
+    class MatrixFreeStiffness : public LinearOperator {
+        public:
+            /**
+             * \param M The mesh, must outlive the operator
+             * \param diffusion_coef The diffusion coefficient k(x,y)
+             * \param attribute_is_dirichlet Edge attributes where the
+             *        penalty is added on the diagonal
+             * \param pool The threads running the products
+             */
+            MatrixFreeStiffness(
+                const Mesh& M,
+                double (*diffusion_coef)(vertex),
+                const std::vector< bool >& attribute_is_dirichlet,
+                ThreadPool& pool = ThreadPool::global() ) ;
+
+            int nb_rows() const ;
+            void mult( const std::vector< double >& x, std::vector< double >& y ) const ;
+            void diagonal( std::vector< double >& d ) const ;
+
+            /**
+             * \brief Adds the penalty terms of the Dirichlet vertices to F,
+             *        as apply_dirichlet_boundary_conditions does.
+             */
+            void add_dirichlet_terms( double (*dirichlet_fct)(vertex), std::vector< double >& F ) const ;
+
+            int nb_colors() const ;
+
+            /**
+             * \return the number of bytes allocated by the operator
+             *         (the Mesh excluded).
+             */
+            size_t memory_bytes() const ;
+
+        private:
+            const Mesh& mesh_ ;
+            ThreadPool& pool_ ;
+            std::vector< int > blocks_ ;        /* blocks sorted by color */
+            std::vector< int > color_offsets_ ; /* color c: blocks_[offsets[c], offsets[c+1]) */
+            std::vector< double > factor_ ;     /* c of each triangle */
+            std::vector< int > dirichlet_vertices_ ;
+    } ;
+
+}
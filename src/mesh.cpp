@@ -6,69 +6,124 @@
 namespace FEM2A {
 
     Mesh::Mesh()
-        : bdr_attr_max_( 0 ), attr_max_( 0 )
+        : Mesh( MemoryResource::default_resource() )
     {
+    }
+
+    Mesh::Mesh( MemoryResource& resource )
+        : vertices_( Allocator< vertex >( resource ) ), edges_( Allocator< int >( resource ) ),
+        triangles_( Allocator< int >( resource ) ), vertex_attributes_( Allocator< int >( resource ) ),
+        edge_attributes_( Allocator< int >( resource ) ), triangle_attributes_( Allocator< int >( resource ) ),
+        vertex_data_( NULL ), edge_data_( NULL ), triangle_data_( NULL ),
+        nb_vertices_( 0 ), nb_edges_( 0 ), nb_triangles_( 0 ), wrapped_( false ),
+        bdr_attr_max_( 0 ), attr_max_( 0 )
+    {
+    }
 
+    Mesh::Mesh( const Mesh& other )
+        : Mesh( other.resource() )
+    {
+        *this = other;
+    }
+
+    MemoryResource& Mesh::resource() const
+    {
+        return vertices_.get_allocator().resource();
+    }
+
+    Mesh& Mesh::operator=( const Mesh& other )
+    {
+        if( this == &other ) return *this;
+        vertices_ = other.vertices_;
+        edges_ = other.edges_;
+        triangles_ = other.triangles_;
+        vertex_attributes_ = other.vertex_attributes_;
+        edge_attributes_ = other.edge_attributes_;
+        triangle_attributes_ = other.triangle_attributes_;
+        bdr_attr_max_ = other.bdr_attr_max_;
+        attr_max_ = other.attr_max_;
+        /* a copy of a wrapped mesh reads the same arrays of the caller */
+        vertex_data_ = other.vertex_data_;
+        edge_data_ = other.edge_data_;
+        triangle_data_ = other.triangle_data_;
+        nb_vertices_ = other.nb_vertices_;
+        nb_edges_ = other.nb_edges_;
+        nb_triangles_ = other.nb_triangles_;
+        wrapped_ = other.wrapped_;
+        if( !wrapped_ ) bind_owned_arrays();
+        return *this;
     }
+
+    void Mesh::bind_owned_arrays()
+    {
+        vertex_data_ = vertices_.data();
+        edge_data_ = edges_.data();
+        triangle_data_ = triangles_.data();
+        nb_vertices_ = vertices_.size();
+        nb_edges_ = edges_.size() / 2;
+        nb_triangles_ = triangles_.size() / 3;
+        wrapped_ = false;
+    }
+
     int Mesh::nb_vertices() const
     {
-        return vertices_.size();
+        return nb_vertices_;
     }
     int Mesh::nb_edges() const
     {
-        return edges_.size() / 2;
+        return nb_edges_;
     }
     int Mesh::nb_triangles() const
     {
-        return triangles_.size() / 3;
+        return nb_triangles_;
     }
 
     vertex Mesh::get_vertex( int vertex_index ) const
     {
-        assert( vertex_index < vertices_.size() );
-        return vertices_[vertex_index];
+        assert( vertex_index < nb_vertices_ );
+        return vertex_data_[vertex_index];
     }
     vertex Mesh::get_edge_vertex( int edge_index, int vertex_local_index ) const
     {
-        assert( edge_index < edges_.size() / 2 );
+        assert( edge_index < nb_edges_ );
         assert( vertex_local_index < 2 );
-        return vertices_[edges_[2 * edge_index + vertex_local_index]];
+        return vertex_data_[edge_data_[2 * edge_index + vertex_local_index]];
     }
     vertex Mesh::get_triangle_vertex( int triangle_index, int vertex_local_index ) const
     {
-        assert( triangle_index < triangles_.size() / 3 );
+        assert( triangle_index < nb_triangles_ );
         assert( vertex_local_index < 3 );
-        return vertices_[triangles_[3 * triangle_index + vertex_local_index]];
+        return vertex_data_[triangle_data_[3 * triangle_index + vertex_local_index]];
     }
 
     int Mesh::get_edge_vertex_index( int edge_index, int vertex_local_index ) const
     {
-        assert( edge_index < edges_.size() / 2 );
+        assert( edge_index < nb_edges_ );
         assert( vertex_local_index < 2 );
-        return edges_[2 * edge_index + vertex_local_index];
+        return edge_data_[2 * edge_index + vertex_local_index];
     }
     int Mesh::get_triangle_vertex_index( int triangle_index, int vertex_local_index ) const
     {
-        assert( triangles_.size() != 0 );
-        assert( triangle_index < triangles_.size() / 3 );
+        assert( nb_triangles_ != 0 );
+        assert( triangle_index < nb_triangles_ );
         assert( vertex_local_index < 3 );
-        return triangles_[3 * triangle_index + vertex_local_index];
+        return triangle_data_[3 * triangle_index + vertex_local_index];
     }
 
     int Mesh::get_vertex_attribute( int vertex_index ) const
     {
-        assert( vertex_index < vertices_.size() );
+        assert( vertex_index < nb_vertices_ );
         return vertex_attributes_[vertex_index];
     }
     int Mesh::get_edge_attribute( int edge_index ) const
     {
-        assert( edge_index < edges_.size() / 2 );
+        assert( edge_index < nb_edges_ );
         return edge_attributes_[edge_index];
 
     }
     int Mesh::get_triangle_attribute( int triangle_index ) const
     {
-        assert( triangle_index < triangles_.size() / 3 );
+        assert( triangle_index < nb_triangles_ );
         return triangle_attributes_[triangle_index];
     }
 
@@ -103,6 +158,99 @@ namespace FEM2A {
         return attr_max_;
     }
 
+    void Mesh::generate_grid( int nx, int ny )
+    {
+        assert( nx > 0 && ny > 0 );
+        const int row = nx + 1;
+        vertices_.resize( (size_t)row * ( ny + 1 ) );
+        vertex_attributes_.assign( vertices_.size(), 0 );
+        for( int j = 0; j <= ny; ++j ) {
+            for( int i = 0; i <= nx; ++i ) {
+                vertices_[(size_t)row * j + i].x = (double)i / nx;
+                vertices_[(size_t)row * j + i].y = (double)j / ny;
+            }
+        }
+
+        triangles_.resize( (size_t)6 * nx * ny );
+        triangle_attributes_.assign( (size_t)2 * nx * ny, 1 );
+        for( int j = 0; j < ny; ++j ) {
+            for( int i = 0; i < nx; ++i ) {
+                const int v = row * j + i;
+                int* tr = &triangles_[(size_t)6 * ( (size_t)nx * j + i )];
+                tr[0] = v; tr[1] = v + 1; tr[2] = v + row + 1;
+                tr[3] = v; tr[4] = v + row + 1; tr[5] = v + row;
+            }
+        }
+
+        edges_.clear();
+        edge_attributes_.clear();
+        for( int i = 0; i < nx; ++i ) {
+            edges_.push_back( i ); edges_.push_back( i + 1 );
+            edge_attributes_.push_back( 1 );
+        }
+        for( int j = 0; j < ny; ++j ) {
+            edges_.push_back( row * j + nx ); edges_.push_back( row * ( j + 1 ) + nx );
+            edge_attributes_.push_back( 2 );
+        }
+        for( int i = nx; i > 0; --i ) {
+            edges_.push_back( row * ny + i ); edges_.push_back( row * ny + i - 1 );
+            edge_attributes_.push_back( 3 );
+        }
+        for( int j = ny; j > 0; --j ) {
+            edges_.push_back( row * j ); edges_.push_back( row * ( j - 1 ) );
+            edge_attributes_.push_back( 4 );
+        }
+        attr_max_ = 1;
+        bdr_attr_max_ = 4;
+        bind_owned_arrays();
+    }
+
+    void Mesh::wrap( int nb_vertices, const double* coordinates,
+        int nb_triangles, const int* triangles,
+        int nb_edges, const int* edges,
+        const int* triangle_attributes, const int* edge_attributes )
+    {
+        static_assert( sizeof( vertex ) == 2 * sizeof( double ),
+            "vertex must have the layout of 2 doubles" );
+        assert( nb_vertices >= 0 && nb_triangles >= 0 && nb_edges >= 0 );
+        assert( nb_edges == 0 || edges != NULL );
+        vertices_.clear();
+        edges_.clear();
+        triangles_.clear();
+        vertex_data_ = reinterpret_cast< const vertex* >( coordinates );
+        edge_data_ = edges;
+        triangle_data_ = triangles;
+        nb_vertices_ = nb_vertices;
+        nb_edges_ = nb_edges;
+        nb_triangles_ = nb_triangles;
+        wrapped_ = true;
+
+        vertex_attributes_.assign( nb_vertices, 0 );
+        if( triangle_attributes != NULL ) {
+            triangle_attributes_.assign( triangle_attributes, triangle_attributes + nb_triangles );
+        } else {
+            triangle_attributes_.assign( nb_triangles, 1 );
+        }
+        if( edge_attributes != NULL ) {
+            edge_attributes_.assign( edge_attributes, edge_attributes + nb_edges );
+        } else {
+            edge_attributes_.assign( nb_edges, 1 );
+        }
+        attr_max_ = 0;
+        for( int t = 0; t < nb_triangles; ++t ) {
+            if( triangle_attributes_[t] > attr_max_ ) attr_max_ = triangle_attributes_[t];
+        }
+        bdr_attr_max_ = 0;
+        for( int e = 0; e < nb_edges; ++e ) {
+            if( edge_attributes_[e] > bdr_attr_max_ ) bdr_attr_max_ = edge_attributes_[e];
+        }
+    }
+
+    bool Mesh::is_wrapped() const
+    {
+        return wrapped_;
+    }
+
     enum input_flag {
         HEADER, DIMENSION, VERTICES, TRIANGLES, EDGES, NO_FLAG
     };
@@ -205,6 +353,7 @@ namespace FEM2A {
             return false;
         }
 
+        bind_owned_arrays();
         return true;
     }
 
@@ -1,6 +1,8 @@
 #ifndef __MESH_FEM2A__
 #define __MESH_FEM2A__
 
+#include "allocator.h"
+
 #include <vector>
 #include <string>
 
@@ -15,6 +17,13 @@ namespace FEM2A {
     class Mesh {
         public:
             Mesh() ;
+            /* the arrays of the mesh in the memory of resource */
+            explicit Mesh( MemoryResource& resource ) ;
+            /* a copy uses the resource of other */
+            Mesh( const Mesh& other ) ;
+            Mesh& operator=( const Mesh& other ) ;
+
+            MemoryResource& resource() const ;
 
             int nb_vertices() const ;
             int nb_edges() const ;
@@ -46,16 +55,58 @@ namespace FEM2A {
              */
             void set_attribute( double (*region)(vertex), int attribute_index, bool border ) ;
 
+            /**
+             * \brief  Replaces the mesh by a structured triangulation of
+             *         the unit square: nx by ny cells, each split in two
+             *         triangles (attribute 1). The border edges get the
+             *         attributes 1 (y = 0), 2 (x = 1), 3 (y = 1), 4 (x = 0).
+             */
+            void generate_grid( int nx, int ny ) ;
+
             bool load( const std::string& file_name ) ;
             bool save( const std::string& file_name ) const ;
 
+            /**
+             * \brief  Replaces the mesh by a view of arrays owned by the caller: the
+             *         coordinates and the connectivity are not copied. They must stay
+             *         valid and unchanged until the mesh is destroyed or replaced
+             *         (load, generate_grid, wrap). The attributes are copied, since
+             *         set_attribute modifies them; NULL gives the attribute 1 to all
+             *         the triangles or edges. Vertex indices start at 0.
+             *
+             * \param coordinates x0 y0 x1 y1 ... (2 * nb_vertices values)
+             * \param triangles Vertex indices, 3 per triangle
+             * \param edges Vertex indices of the border edges, 2 per edge
+             */
+            void wrap( int nb_vertices, const double* coordinates,
+                int nb_triangles, const int* triangles,
+                int nb_edges = 0, const int* edges = 0,
+                const int* triangle_attributes = 0, const int* edge_attributes = 0 ) ;
+
+            /* true if the mesh reads arrays of the caller (see wrap) */
+            bool is_wrapped() const ;
+
         private:
-            std::vector< vertex > vertices_ ;
-            std::vector< int > edges_ ;
-            std::vector< int > triangles_ ;
-            std::vector< int > vertex_attributes_ ;
-            std::vector< int > edge_attributes_ ;
-            std::vector< int > triangle_attributes_ ;
+            /* points the accessors to the vectors below */
+            void bind_owned_arrays() ;
+
+
+            ResourceVector< vertex > vertices_ ;
+            ResourceVector< int > edges_ ;
+            ResourceVector< int > triangles_ ;
+            ResourceVector< int > vertex_attributes_ ;
+            ResourceVector< int > edge_attributes_ ;
+            ResourceVector< int > triangle_attributes_ ;
+
+            /* the accessors read these arrays: the vectors above, or the
+             * arrays of the caller for a wrapped mesh */
+            const vertex* vertex_data_ ;
+            const int* edge_data_ ;
+            const int* triangle_data_ ;
+            int nb_vertices_ ;
+            int nb_edges_ ;
+            int nb_triangles_ ;
+            bool wrapped_ ;
 
             int bdr_attr_max_ ;
             int attr_max_ ;
@@ -0,0 +1,487 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace FEM2A {
+
+    /* the pool and the rank of the task running in this thread */
+    static thread_local ThreadPool* current_pool = NULL ;
+    static thread_local int current_worker = 0 ;
+
+    static double seconds_between( std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end )
+    {
+        return std::chrono::duration< double >( end - start ).count() ;
+    }
+
+    /* NUMA node of each cpu from /sys, empty if unknown */
+    static std::vector< int > numa_node_of_cpus()
+    {
+        std::vector< int > nodes ;
+#ifdef __linux__
+        const std::string root = "/sys/devices/system/node" ;
+        DIR* dir = opendir( root.c_str() ) ;
+        if( dir == NULL ) return nodes ;
+        while( dirent* entry = readdir( dir ) ) {
+            const std::string name = entry->d_name ;
+            if( name.compare( 0, 4, "node" ) != 0 || name.size() == 4 ) continue ;
+            const int node = atoi( name.c_str() + 4 ) ;
+            std::ifstream in( ( root + "/" + name + "/cpulist" ).c_str() ) ;
+            std::string list ;
+            std::getline( in, list ) ;
+            /* "0-3,8-11" */
+            std::istringstream ranges( list ) ;
+            std::string range ;
+            while( std::getline( ranges, range, ',' ) ) {
+                if( range.empty() ) continue ;
+                const size_t dash = range.find( '-' ) ;
+                const int first = atoi( range.c_str() ) ;
+                const int last = dash == std::string::npos ? first : atoi( range.c_str() + dash + 1 ) ;
+                if( last >= nodes.size() ) nodes.resize( last + 1, -1 ) ;
+                for( int cpu = first; cpu <= last; ++cpu ) nodes[cpu] = node ;
+            }
+        }
+        closedir( dir ) ;
+#endif
+        return nodes ;
+    }
+
+    /* the cpus the process may run on */
+    static std::vector< int > allowed_cpus()
+    {
+        std::vector< int > cpus ;
+#ifdef __linux__
+        cpu_set_t set ;
+        CPU_ZERO( &set ) ;
+        if( sched_getaffinity( 0, sizeof( set ), &set ) == 0 ) {
+            for( int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+                if( CPU_ISSET( cpu, &set ) ) cpus.push_back( cpu ) ;
+            }
+        }
+#endif
+        return cpus ;
+    }
+
+    static void pin_current_thread( int cpu )
+    {
+#ifdef __linux__
+        cpu_set_t set ;
+        CPU_ZERO( &set ) ;
+        CPU_SET( cpu, &set ) ;
+        pthread_setaffinity_np( pthread_self(), sizeof( set ), &set ) ;
+#endif
+    }
+
+    /* the deque and the counters of one thread */
+    struct ThreadPool::Slot {
+        Slot() : cpu( -1 ), nb_tasks( 0 ), nb_steals( 0 ), nb_failed_steals( 0 ), busy_ns( 0 ) {}
+
+        std::mutex mutex ;
+        std::deque< std::function< void() > > tasks ;
+        int cpu ;                                /* -1 if not pinned */
+        std::atomic< long > nb_tasks ;
+        std::atomic< long > nb_steals ;
+        std::atomic< long > nb_failed_steals ;
+        std::atomic< long long > busy_ns ;
+    } ;
+
+    /****************************************************************/
+    /* Implementation of ThreadPool::Statistics */
+    /****************************************************************/
+    long ThreadPool::Statistics::total_tasks() const
+    {
+        long total = 0 ;
+        for( int i = 0; i < tasks.size(); ++i ) total += tasks[i] ;
+        return total ;
+    }
+
+    double ThreadPool::Statistics::imbalance() const
+    {
+        double max = 0., sum = 0. ;
+        for( int i = 0; i < busy.size(); ++i ) {
+            max = std::max( max, busy[i] ) ;
+            sum += busy[i] ;
+        }
+        return sum > 0. ? max * busy.size() / sum : 1. ;
+    }
+
+    /****************************************************************/
+    /* Implementation of ThreadPool */
+    /****************************************************************/
+    ThreadPool::ThreadPool( int nb_threads, bool pin_threads )
+        : nb_queued_( 0 ), nb_sleeping_( 0 ), nb_waiting_( 0 ), nb_completed_( 0 ), stop_( false ),
+        deterministic_( true ), reset_time_( std::chrono::steady_clock::now() )
+    {
+        if( nb_threads <= 0 ) {
+            nb_threads = std::thread::hardware_concurrency() ;
+        }
+        if( nb_threads <= 0 ) {
+            nb_threads = 1 ;
+        }
+        for( int rank = 0; rank < nb_threads; ++rank ) slots_.emplace_back( new Slot ) ;
+
+        /* the worker i on the i-th allowed cpu; the callers are not pinned */
+        numa_nodes_.assign( nb_threads, -1 ) ;
+        if( pin_threads ) {
+            const std::vector< int > cpus = allowed_cpus() ;
+            const std::vector< int > nodes = numa_node_of_cpus() ;
+            for( int rank = 1; rank < nb_threads && !cpus.empty(); ++rank ) {
+                const int cpu = cpus[( rank - 1 ) % cpus.size()] ;
+                slots_[rank]->cpu = cpu ;
+                numa_nodes_[rank] = cpu < nodes.size() ? nodes[cpu] : -1 ;
+            }
+        }
+
+        /* victims: the same NUMA node first, each list starting after
+         * its owner so that the thieves do not all hit the same deque */
+        victims_.resize( nb_threads ) ;
+        for( int rank = 0; rank < nb_threads; ++rank ) {
+            for( int pass = 0; pass < 2; ++pass ) {
+                for( int k = 1; k < nb_threads; ++k ) {
+                    const int victim = ( rank + k ) % nb_threads ;
+                    const bool near = numa_nodes_[rank] >= 0 && numa_nodes_[victim] == numa_nodes_[rank] ;
+                    if( near == ( pass == 0 ) ) victims_[rank].push_back( victim ) ;
+                }
+            }
+        }
+        for( int rank = 1; rank < nb_threads; ++rank ) {
+            workers_.push_back( std::thread( &ThreadPool::worker_loop, this, rank ) ) ;
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::unique_lock< std::mutex > lock( sleep_mutex_ ) ;
+            stop_ = true ;
+        }
+        wake_.notify_all() ;
+        for( int i = 0; i < workers_.size(); ++i ) {
+            workers_[i].join() ;
+        }
+    }
+
+    int ThreadPool::nb_threads() const
+    {
+        return slots_.size() ;
+    }
+
+    int ThreadPool::current_rank() const
+    {
+        return current_pool == this ? current_worker : 0 ;
+    }
+
+    void ThreadPool::worker_loop( int rank )
+    {
+        current_pool = this ;
+        current_worker = rank ;
+        if( slots_[rank]->cpu >= 0 ) pin_current_thread( slots_[rank]->cpu ) ;
+        while( true ) {
+            if( try_run_one( rank ) ) continue ;
+            std::unique_lock< std::mutex > lock( sleep_mutex_ ) ;
+            if( stop_ ) return ;
+            ++nb_sleeping_ ;
+            while( !stop_ && nb_queued_ == 0 ) wake_.wait( lock ) ;
+            --nb_sleeping_ ;
+        }
+    }
+
+    bool ThreadPool::try_run_one( int rank )
+    {
+        std::function< void() > task ;
+        {
+            Slot& own = *slots_[rank] ;
+            std::unique_lock< std::mutex > lock( own.mutex ) ;
+            if( !own.tasks.empty() ) {
+                task = std::move( own.tasks.back() ) ;
+                own.tasks.pop_back() ;
+            }
+        }
+        if( !task ) {
+            const std::vector< int >& victims = victims_[rank] ;
+            for( int k = 0; k < victims.size() && !task; ++k ) {
+                Slot& victim = *slots_[victims[k]] ;
+                std::unique_lock< std::mutex > lock( victim.mutex ) ;
+                if( !victim.tasks.empty() ) {
+                    task = std::move( victim.tasks.front() ) ;
+                    victim.tasks.pop_front() ;
+                }
+            }
+            if( !task ) {
+                ++slots_[rank]->nb_failed_steals ;
+                return false ;
+            }
+            ++slots_[rank]->nb_steals ;
+        }
+        --nb_queued_ ;
+        run_task( rank, task ) ;
+        return true ;
+    }
+
+    void ThreadPool::run_task( int rank, std::function< void() >& task )
+    {
+        /* a caller helping in wait_until runs the task as a thread of this pool */
+        ThreadPool* const caller_pool = current_pool ;
+        const int caller_rank = current_worker ;
+        current_pool = this ;
+        current_worker = rank ;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+        task() ;
+        task = nullptr ;
+        current_pool = caller_pool ;
+        current_worker = caller_rank ;
+        Slot& slot = *slots_[rank] ;
+        slot.busy_ns += std::chrono::duration_cast< std::chrono::nanoseconds >(
+            std::chrono::steady_clock::now() - start ).count() ;
+        ++slot.nb_tasks ;
+        ++nb_completed_ ;
+        notify_waiters() ;
+    }
+
+    void ThreadPool::notify_waiters()
+    {
+        if( nb_waiting_ == 0 ) return ;
+        /* taking the mutex orders this with the check of a waiter */
+        { std::unique_lock< std::mutex > lock( sleep_mutex_ ) ; }
+        done_.notify_all() ;
+    }
+
+    void ThreadPool::spawn( std::function< void() > task )
+    {
+        if( workers_.empty() ) {
+            run_task( 0, task ) ;
+            return ;
+        }
+        const int rank = current_rank() ;
+        ++nb_queued_ ;
+        {
+            Slot& own = *slots_[rank] ;
+            std::unique_lock< std::mutex > lock( own.mutex ) ;
+            own.tasks.push_back( std::move( task ) ) ;
+        }
+        if( nb_sleeping_ > 0 ) {
+            { std::unique_lock< std::mutex > lock( sleep_mutex_ ) ; }
+            wake_.notify_one() ;
+        }
+        notify_waiters() ;
+    }
+
+    void ThreadPool::wait_until( const std::function< bool() >& done )
+    {
+        const int rank = current_rank() ;
+        while( !done() ) {
+            if( try_run_one( rank ) ) continue ;
+            const unsigned long seen = nb_completed_ ;
+            if( done() ) break ;
+            std::unique_lock< std::mutex > lock( sleep_mutex_ ) ;
+            ++nb_waiting_ ;
+            while( nb_completed_ == seen && nb_queued_ == 0 ) done_.wait( lock ) ;
+            --nb_waiting_ ;
+        }
+    }
+
+    void ThreadPool::parallel_for( int n, const std::function< void( int, int ) >& fct )
+    {
+        if( workers_.empty() || n < 2 ) {
+            if( n > 0 ) fct( 0, n ) ;
+            return ;
+        }
+        parallel_for( n, ( n + nb_threads() - 1 ) / nb_threads(), fct ) ;
+    }
+
+    void ThreadPool::parallel_for( int n, int grain, const std::function< void( int, int ) >& fct )
+    {
+        if( n <= 0 ) return ;
+        grain = std::max( grain, 1 ) ;
+        if( workers_.empty() || n <= grain ) {
+            fct( 0, n ) ;
+            return ;
+        }
+        std::atomic< int > nb_done( 0 ) ;
+        /* [begin, end) keeps its left half and spawns the right one, the
+         * halves cut at multiples of grain */
+        std::function< void( int, int ) > split ;
+        split = [&]( int begin, int end ) {
+            while( end - begin > grain ) {
+                const int nb_blocks = ( end - begin + grain - 1 ) / grain ;
+                const int middle = begin + ( nb_blocks / 2 ) * grain ;
+                const int right_end = end ;
+                spawn( [&split, middle, right_end]() { split( middle, right_end ) ; } ) ;
+                end = middle ;
+            }
+            fct( begin, end ) ;
+            nb_done += end - begin ;
+        } ;
+        /* a task too, so that the statistics count the part of the caller */
+        spawn( [&split, n]() { split( 0, n ) ; } ) ;
+        wait_until( [&]() { return nb_done == n ; } ) ;
+    }
+
+    /* the sums of [begin, end) added as a balanced binary tree */
+    static double pairwise_sum( const std::vector< double >& sums, int begin, int end )
+    {
+        if( end - begin == 1 ) return sums[begin] ;
+        const int middle = begin + ( end - begin ) / 2 ;
+        return pairwise_sum( sums, begin, middle ) + pairwise_sum( sums, middle, end ) ;
+    }
+
+    double ThreadPool::sum( int n, const std::function< double( int, int ) >& partial )
+    {
+        if( n <= 0 ) return 0. ;
+        if( !deterministic_ ) {
+            if( workers_.empty() ) return partial( 0, n ) ;
+            const int grain = ( n + nb_threads() - 1 ) / nb_threads() ;
+            std::vector< double > sums( ( n + grain - 1 ) / grain, 0. ) ;
+            parallel_for( n, grain, [&]( int begin, int end ) {
+                sums[begin / grain] = partial( begin, end ) ;
+            } ) ;
+            double s = 0. ;
+            for( int k = 0; k < sums.size(); ++k ) s += sums[k] ;
+            return s ;
+        }
+        const int nb_blocks = ( n + SUM_BLOCK - 1 ) / SUM_BLOCK ;
+        if( nb_blocks == 1 ) return partial( 0, n ) ;
+        std::vector< double > sums( nb_blocks ) ;
+        /* 8 blocks per task */
+        parallel_for( nb_blocks, 8, [&]( int begin, int end ) {
+            for( int b = begin; b < end; ++b ) {
+                sums[b] = partial( b * SUM_BLOCK, std::min( n, ( b + 1 ) * SUM_BLOCK ) ) ;
+            }
+        } ) ;
+        return pairwise_sum( sums, 0, nb_blocks ) ;
+    }
+
+    void ThreadPool::set_deterministic( bool deterministic )
+    {
+        deterministic_ = deterministic ;
+    }
+
+    bool ThreadPool::deterministic() const
+    {
+        return deterministic_ ;
+    }
+
+    ThreadPool::Statistics ThreadPool::statistics() const
+    {
+        Statistics statistics ;
+        for( int rank = 0; rank < slots_.size(); ++rank ) {
+            const Slot& slot = *slots_[rank] ;
+            statistics.tasks.push_back( slot.nb_tasks ) ;
+            statistics.steals.push_back( slot.nb_steals ) ;
+            statistics.failed_steals.push_back( slot.nb_failed_steals ) ;
+            statistics.busy.push_back( slot.busy_ns * 1e-9 ) ;
+        }
+        statistics.wall = seconds_between( reset_time_, std::chrono::steady_clock::now() ) ;
+        return statistics ;
+    }
+
+    void ThreadPool::reset_statistics()
+    {
+        for( int rank = 0; rank < slots_.size(); ++rank ) {
+            Slot& slot = *slots_[rank] ;
+            slot.nb_tasks = 0 ;
+            slot.nb_steals = 0 ;
+            slot.nb_failed_steals = 0 ;
+            slot.busy_ns = 0 ;
+        }
+        reset_time_ = std::chrono::steady_clock::now() ;
+    }
+
+    std::string ThreadPool::report() const
+    {
+        const Statistics s = statistics() ;
+        std::ostringstream out ;
+        for( int rank = 0; rank < s.tasks.size(); ++rank ) {
+            out << std::setw( 10 ) << ( rank == 0 ? "callers" : "worker " + std::to_string( rank ) )
+                << ": " << s.tasks[rank] << " tasks, " << s.steals[rank] << " stolen, "
+                << s.failed_steals[rank] << " failed steals, busy " << std::fixed << std::setprecision( 3 )
+                << s.busy[rank] << " s" ;
+            if( numa_nodes_[rank] >= 0 ) out << ", node " << numa_nodes_[rank] ;
+            out << std::defaultfloat << std::endl ;
+        }
+        out << "imbalance " << std::setprecision( 3 ) << s.imbalance() << ", "
+            << ( s.wall > 0. ? s.total_tasks() / s.wall : 0. ) << " tasks/s" ;
+        return out.str() ;
+    }
+
+    int ThreadPool::numa_node( int thread ) const
+    {
+        return numa_nodes_[thread] ;
+    }
+
+    ThreadPool& ThreadPool::global()
+    {
+        static ThreadPool pool( getenv( "FEM2A_NUM_THREADS" ) != NULL
+            ? atoi( getenv( "FEM2A_NUM_THREADS" ) ) : 0,
+            getenv( "FEM2A_PIN_THREADS" ) != NULL && atoi( getenv( "FEM2A_PIN_THREADS" ) ) == 1 ) ;
+        static std::once_flag configured ;
+        std::call_once( configured, []() {
+            pool.set_deterministic( getenv( "FEM2A_DETERMINISTIC" ) == NULL
+                || atoi( getenv( "FEM2A_DETERMINISTIC" ) ) != 0 ) ;
+        } ) ;
+        return pool ;
+    }
+
+    ThreadPool& ThreadPool::current()
+    {
+        return current_pool != NULL ? *current_pool : global() ;
+    }
+
+    /****************************************************************/
+    /* Implementation of TaskGraph */
+    /****************************************************************/
+    int TaskGraph::add( std::function< void() > task, const std::vector< int >& dependencies )
+    {
+        const int index = nodes_.size() ;
+        Node node ;
+        node.task = std::move( task ) ;
+        node.nb_dependencies = dependencies.size() ;
+        nodes_.push_back( std::move( node ) ) ;
+        for( int d = 0; d < dependencies.size(); ++d ) {
+            assert( dependencies[d] >= 0 && dependencies[d] < index ) ;
+            nodes_[dependencies[d]].successors.push_back( index ) ;
+        }
+        return index ;
+    }
+
+    int TaskGraph::nb_tasks() const
+    {
+        return nodes_.size() ;
+    }
+
+    void TaskGraph::release( ThreadPool& pool, int task )
+    {
+        pool.spawn( [this, &pool, task]() {
+            nodes_[task].task() ;
+            const std::vector< int >& successors = nodes_[task].successors ;
+            for( int k = 0; k < successors.size(); ++k ) {
+                if( --pending_[successors[k]] == 0 ) release( pool, successors[k] ) ;
+            }
+            ++nb_done_ ;
+        } ) ;
+    }
+
+    void TaskGraph::run( ThreadPool& pool )
+    {
+        const int n = nodes_.size() ;
+        pending_.reset( new std::atomic< int >[n] ) ;
+        for( int i = 0; i < n; ++i ) pending_[i] = nodes_[i].nb_dependencies ;
+        nb_done_ = 0 ;
+        for( int i = 0; i < n; ++i ) {
+            if( nodes_[i].nb_dependencies == 0 ) release( pool, i ) ;
+        }
+        pool.wait_until( [this, n]() { return nb_done_ == n ; } ) ;
+    }
+
+}
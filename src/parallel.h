@@ -0,0 +1,267 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief ThreadPool is the work-stealing scheduler shared by the
+     *        parallel loops (assembly, SpMV, transient kernels, Schwarz,
+     *        sweeps), so that the program never runs more compute
+     *        threads than the pool has.
+     *
+     * Each thread owns a deque of tasks: it pushes and pops at the back
+     * (the most recent task, still in cache) and, when empty, steals at
+     * the front of the deque of another thread, those on its own NUMA
+     * node first. The threads calling into the pool from outside share
+     * an extra deque and take part in the work while they wait: a pool
+     * of n threads owns n - 1 workers. A thread waiting for tasks (in
+     * parallel_for, wait_until or TaskGraph::run) runs other tasks
+     * meanwhile, so nested parallel loops are parallel too.
+     *
+     * Tasks must not block on anything but the pool (wait_until): the
+     * threads blocking on sockets or queues (server, pipeline stages,
+     * streaming parser) keep their own threads. So does the output of
+     * AsyncWriter: a write run as a task would delay the thread that
+     * picked it up in wait_until (or spawn, without workers) by the whole
+     * write.
+     */
+    class ThreadPool {
+        public:
+            /**
+             * \brief Counters of the scheduler since the last reset, per
+             *        thread (index 0: the external callers).
+             */
+            struct Statistics {
+                std::vector< long > tasks ;          /* executed */
+                std::vector< long > steals ;         /* tasks taken from another deque */
+                std::vector< long > failed_steals ;  /* full rounds of the victims without a task */
+                std::vector< double > busy ;         /* seconds in tasks */
+                double wall ;                        /* seconds since the reset */
+
+                long total_tasks() const ;
+                /* max busy / mean busy over the workers: 1 is perfect */
+                double imbalance() const ;
+            } ;
+
+            /**
+             * \param nb_threads Number of threads, 0 for one per core
+             * \param pin_threads Binds the worker i to the i-th core the
+             *        process may run on (Linux), and orders the victims of
+             *        the steals by NUMA node
+             */
+            explicit ThreadPool( int nb_threads = 0, bool pin_threads = false ) ;
+            ~ThreadPool() ;
+
+            int nb_threads() const ;
+
+            /**
+             * \brief Splits [0, n) in nb_threads() contiguous ranges,
+             *        calls fct(begin, end) on each of them concurrently and
+             *        returns when all of them are done.
+             */
+            void parallel_for( int n, const std::function< void( int, int ) >& fct ) ;
+
+            /**
+             * \brief Calls fct on the ranges [k grain, (k + 1) grain) of
+             *        [0, n), balanced by stealing: the range is split in
+             *        halves until grain, the thieves taking the biggest
+             *        halves. The ranges do not depend on the threads.
+             */
+            void parallel_for( int n, int grain, const std::function< void( int, int ) >& fct ) ;
+
+            /**
+             * \brief Sum of partial( begin, end ) over ranges covering
+             *        [0, n). A deterministic pool (the default) cuts [0, n)
+             *        in blocks of SUM_BLOCK and adds the block sums
+             *        pairwise in a fixed tree: the bits of the result do not
+             *        depend on the number of threads nor on the steals.
+             *        Otherwise, one range per thread and their sums in order.
+             */
+            double sum( int n, const std::function< double( int, int ) >& partial ) ;
+
+            void set_deterministic( bool deterministic ) ;
+            bool deterministic() const ;
+
+            static const int SUM_BLOCK = 1024 ;
+
+            /**
+             * \brief Queues task to run on some thread of the pool. A
+             *        pool without worker runs it at once in the caller.
+             */
+            void spawn( std::function< void() > task ) ;
+
+            /**
+             * \brief Runs tasks of the pool until done() is true. done
+             *        must become true through tasks of the pool; it is
+             *        checked after each task.
+             */
+            void wait_until( const std::function< bool() >& done ) ;
+
+            Statistics statistics() const ;
+            void reset_statistics() ;
+            /* one line per thread, the imbalance and the tasks per second */
+            std::string report() const ;
+
+            /* NUMA node of the thread, -1 if unknown (not pinned) */
+            int numa_node( int thread ) const ;
+
+            /**
+             * \brief Pool shared by the whole program, with one thread per
+             *        core (or FEM2A_NUM_THREADS if this variable is set),
+             *        pinned if FEM2A_PIN_THREADS is set to 1, deterministic
+             *        unless FEM2A_DETERMINISTIC is set to 0.
+             */
+            static ThreadPool& global() ;
+
+            /* the pool running the calling task, global() outside of tasks */
+            static ThreadPool& current() ;
+
+        private:
+            ThreadPool( const ThreadPool& ) ;
+            ThreadPool& operator=( const ThreadPool& ) ;
+
+            struct Slot ;
+
+            void worker_loop( int rank ) ;
+            /* the deque of the calling thread: its rank, 0 from outside */
+            int current_rank() const ;
+            bool try_run_one( int rank ) ;
+            void run_task( int rank, std::function< void() >& task ) ;
+            void notify_waiters() ;
+
+            std::vector< std::unique_ptr< Slot > > slots_ ;
+            std::vector< std::vector< int > > victims_ ;  /* steal order per rank */
+            std::vector< int > numa_nodes_ ;
+            std::vector< std::thread > workers_ ;
+            std::atomic< int > nb_queued_ ;
+            std::atomic< int > nb_sleeping_ ;      /* idle workers */
+            std::atomic< int > nb_waiting_ ;       /* threads in wait_until */
+            std::atomic< unsigned long > nb_completed_ ;
+            std::mutex sleep_mutex_ ;
+            std::condition_variable wake_ ;        /* a task is queued */
+            std::condition_variable done_ ;        /* a task is done */
+            bool stop_ ;
+            bool deterministic_ ;
+            std::chrono::steady_clock::time_point reset_time_ ;
+    } ;
+
+    /**
+     * \brief TaskGraph runs tasks on a ThreadPool once the tasks they
+     *        depend on are done. A task becomes ready when its last
+     *        dependency finishes and is pushed on the deque of the thread
+     *        that finished it.
+     */
+    class TaskGraph {
+        public:
+            /**
+             * \param dependencies Indices returned by previous add()
+             * \return the index of the task
+             */
+            int add( std::function< void() > task,
+                const std::vector< int >& dependencies = std::vector< int >() ) ;
+
+            int nb_tasks() const ;
+
+            /* runs all the tasks, returns when they are done */
+            void run( ThreadPool& pool = ThreadPool::global() ) ;
+
+        private:
+            struct Node {
+                std::function< void() > task ;
+                std::vector< int > successors ;
+                int nb_dependencies ;
+            } ;
+
+            void release( ThreadPool& pool, int task ) ;
+
+            std::vector< Node > nodes_ ;
+            std::unique_ptr< std::atomic< int >[] > pending_ ;
+            std::atomic< int > nb_done_ ;
+    } ;
+
+    /**
+     * \brief BoundedQueue passes items from producer threads to consumer
+     *        threads. push() blocks while the queue holds capacity items,
+     *        which bounds the memory used when the producers are faster.
+     */
+    template< class T >
+    class BoundedQueue {
+        public:
+            explicit BoundedQueue( int capacity )
+                : capacity_( capacity > 0 ? capacity : 1 ), closed_( false ),
+                max_size_( 0 ), nb_full_waits_( 0 )
+            {
+            }
+
+            /**
+             * \brief Moves item at the end of the queue, waiting for a free
+             *        slot. Returns false (item not pushed) if closed.
+             */
+            bool push( T& item )
+            {
+                std::unique_lock< std::mutex > lock( mutex_ ) ;
+                if( items_.size() >= capacity_ && !closed_ ) ++nb_full_waits_ ;
+                while( items_.size() >= capacity_ && !closed_ ) not_full_.wait( lock ) ;
+                if( closed_ ) return false ;
+                items_.push_back( std::move( item ) ) ;
+                if( items_.size() > max_size_ ) max_size_ = items_.size() ;
+                not_empty_.notify_one() ;
+                return true ;
+            }
+
+            /**
+             * \brief Moves the first item to item, waiting for one.
+             *        Returns false once the queue is closed and empty.
+             */
+            bool pop( T& item )
+            {
+                std::unique_lock< std::mutex > lock( mutex_ ) ;
+                while( items_.empty() && !closed_ ) not_empty_.wait( lock ) ;
+                if( items_.empty() ) return false ;
+                item = std::move( items_.front() ) ;
+                items_.pop_front() ;
+                not_full_.notify_one() ;
+                return true ;
+            }
+
+            /**
+             * \brief No more items will be pushed: wakes up all the
+             *        waiting threads.
+             */
+            void close()
+            {
+                std::unique_lock< std::mutex > lock( mutex_ ) ;
+                closed_ = true ;
+                not_empty_.notify_all() ;
+                not_full_.notify_all() ;
+            }
+
+            /* Largest number of items queued and number of blocked push() */
+            int max_size() const { return max_size_ ; }
+            int nb_full_waits() const { return nb_full_waits_ ; }
+
+        private:
+            BoundedQueue( const BoundedQueue& ) ;
+            BoundedQueue& operator=( const BoundedQueue& ) ;
+
+            std::mutex mutex_ ;
+            std::condition_variable not_empty_ ;
+            std::condition_variable not_full_ ;
+            std::deque< T > items_ ;
+            int capacity_ ;
+            bool closed_ ;
+            int max_size_ ;
+            int nb_full_waits_ ;
+    } ;
+
+}
@@ -0,0 +1,153 @@
+#include "partition.h"
+
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+namespace FEM2A {
+
+    /* splits the triangles ids[begin, end) in nb_parts parts numbered
+     * from first_part */
+    static void bisect(
+        const std::vector< vertex >& centers,
+        PartitionMethod method,
+        std::vector< int >& ids,
+        int begin,
+        int end,
+        int first_part,
+        int nb_parts,
+        std::vector< int >& triangle_part )
+    {
+        if( nb_parts == 1 || end - begin < 2 ) {
+            for( int i = begin; i < end; ++i ) triangle_part[ids[i]] = first_part ;
+            return ;
+        }
+
+        /* direction of the cut */
+        double dx = 1., dy = 0. ;
+        if( method == COORDINATE_BISECTION ) {
+            double x_min = centers[ids[begin]].x, x_max = x_min ;
+            double y_min = centers[ids[begin]].y, y_max = y_min ;
+            for( int i = begin; i < end; ++i ) {
+                const vertex& c = centers[ids[i]] ;
+                x_min = std::min( x_min, c.x ) ; x_max = std::max( x_max, c.x ) ;
+                y_min = std::min( y_min, c.y ) ; y_max = std::max( y_max, c.y ) ;
+            }
+            if( y_max - y_min > x_max - x_min ) {
+                dx = 0. ;
+                dy = 1. ;
+            }
+        } else {
+            /* eigenvector of the largest eigenvalue of the covariance */
+            double mx = 0., my = 0. ;
+            for( int i = begin; i < end; ++i ) {
+                mx += centers[ids[i]].x ;
+                my += centers[ids[i]].y ;
+            }
+            mx /= end - begin ;
+            my /= end - begin ;
+            double sxx = 0., sxy = 0., syy = 0. ;
+            for( int i = begin; i < end; ++i ) {
+                const double x = centers[ids[i]].x - mx ;
+                const double y = centers[ids[i]].y - my ;
+                sxx += x * x ; sxy += x * y ; syy += y * y ;
+            }
+            const double angle = 0.5 * std::atan2( 2. * sxy, sxx - syy ) ;
+            dx = std::cos( angle ) ;
+            dy = std::sin( angle ) ;
+        }
+
+        const int left_parts = nb_parts / 2 ;
+        const int middle = begin + (long)( end - begin ) * left_parts / nb_parts ;
+        std::nth_element( ids.begin() + begin, ids.begin() + middle, ids.begin() + end,
+            [&]( int a, int b ) {
+                return dx * centers[a].x + dy * centers[a].y
+                    < dx * centers[b].x + dy * centers[b].y ;
+            } ) ;
+        bisect( centers, method, ids, begin, middle, first_part, left_parts, triangle_part ) ;
+        bisect( centers, method, ids, middle, end, first_part + left_parts,
+            nb_parts - left_parts, triangle_part ) ;
+    }
+
+    void partition_mesh(
+        const Mesh& M,
+        int nb_parts,
+        PartitionMethod method,
+        std::vector< int >& triangle_part )
+    {
+        assert( nb_parts > 0 ) ;
+        const int nt = M.nb_triangles() ;
+        std::vector< vertex > centers( nt ) ;
+        std::vector< int > ids( nt ) ;
+        for( int t = 0; t < nt; ++t ) {
+            centers[t].x = centers[t].y = 0. ;
+            for( int i = 0; i < 3; ++i ) {
+                centers[t].x += M.get_triangle_vertex( t, i ).x / 3. ;
+                centers[t].y += M.get_triangle_vertex( t, i ).y / 3. ;
+            }
+            ids[t] = t ;
+        }
+        triangle_part.assign( nt, 0 ) ;
+        bisect( centers, method, ids, 0, nt, 0, nb_parts, triangle_part ) ;
+    }
+
+    PartitionQuality partition_quality(
+        const Mesh& M,
+        int nb_parts,
+        const std::vector< int >& triangle_part )
+    {
+        PartitionQuality quality ;
+        std::vector< int > sizes( nb_parts, 0 ) ;
+        for( int t = 0; t < M.nb_triangles(); ++t ) ++sizes[triangle_part[t]] ;
+        quality.min_size = *std::min_element( sizes.begin(), sizes.end() ) ;
+        quality.max_size = *std::max_element( sizes.begin(), sizes.end() ) ;
+        quality.imbalance = quality.max_size * (double)nb_parts / std::max( M.nb_triangles(), 1 ) ;
+
+        /* sorting the (vertex, vertex, part) triples brings the two
+         * triangles of an interior edge next to each other */
+        struct HalfEdge {
+            int a, b, part ;
+            bool operator<( const HalfEdge& other ) const {
+                return a < other.a || ( a == other.a && b < other.b ) ;
+            }
+        } ;
+        std::vector< HalfEdge > edges ;
+        edges.reserve( 3 * M.nb_triangles() ) ;
+        for( int t = 0; t < M.nb_triangles(); ++t ) {
+            for( int i = 0; i < 3; ++i ) {
+                const int a = M.get_triangle_vertex_index( t, i ) ;
+                const int b = M.get_triangle_vertex_index( t, ( i + 1 ) % 3 ) ;
+                HalfEdge edge = { std::min( a, b ), std::max( a, b ), triangle_part[t] } ;
+                edges.push_back( edge ) ;
+            }
+        }
+        std::sort( edges.begin(), edges.end() ) ;
+        quality.edge_cut = 0 ;
+        for( int e = 1; e < edges.size(); ++e ) {
+            if( edges[e].a == edges[e - 1].a && edges[e].b == edges[e - 1].b
+                && edges[e].part != edges[e - 1].part ) {
+                ++quality.edge_cut ;
+            }
+        }
+        return quality ;
+    }
+
+    void vertex_partition(
+        const Mesh& M,
+        const std::vector< int >& triangle_part,
+        std::vector< int >& vertex_part )
+    {
+        vertex_part.assign( M.nb_vertices(), -1 ) ;
+        for( int t = 0; t < M.nb_triangles(); ++t ) {
+            for( int i = 0; i < 3; ++i ) {
+                int& part = vertex_part[M.get_triangle_vertex_index( t, i )] ;
+                if( part < 0 ) part = triangle_part[t] ;
+            }
+        }
+        /* vertices outside of the triangles */
+        for( int v = 0; v < vertex_part.size(); ++v ) {
+            if( vertex_part[v] < 0 ) vertex_part[v] = 0 ;
+        }
+    }
+
+}
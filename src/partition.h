@@ -0,0 +1,49 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <vector>
+
+namespace FEM2A {
+
+    enum PartitionMethod {
+        COORDINATE_BISECTION, /* cut across the longest side of the bounding box */
+        INERTIAL_BISECTION    /* cut across the principal axis of inertia */
+    } ;
+
+    /**
+     * \brief Splits the triangles of M in nb_parts subdomains by
+     *        recursive bisection of their centers: each cut sends
+     *        floor(k/2)/k of the triangles to one side, so the parts have
+     *        the same number of triangles up to one.
+     *
+     * \param triangle_part Filled with the part of each triangle
+     */
+    void partition_mesh(
+        const Mesh& M,
+        int nb_parts,
+        PartitionMethod method,
+        std::vector< int >& triangle_part ) ;
+
+    struct PartitionQuality {
+        int edge_cut ;     /* edges shared by triangles of two parts */
+        int min_size ;     /* triangles of the smallest part */
+        int max_size ;     /* triangles of the largest part */
+        double imbalance ; /* max_size / mean size */
+    } ;
+
+    PartitionQuality partition_quality(
+        const Mesh& M,
+        int nb_parts,
+        const std::vector< int >& triangle_part ) ;
+
+    /**
+     * \brief Gives each vertex to the part of the first triangle that
+     *        contains it: the parts of the vertices do not overlap.
+     */
+    void vertex_partition(
+        const Mesh& M,
+        const std::vector< int >& triangle_part,
+        std::vector< int >& vertex_part ) ;
+
+}
@@ -0,0 +1,331 @@
+#include "pipeline.h"
+#include "parallel.h"
+#include "vtu.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace FEM2A {
+
+    static double seconds_between( std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end )
+    {
+        return std::chrono::duration< double >( end - start ).count() ;
+    }
+
+    /* the file name without its directory and extension */
+    static std::string mesh_name( const std::string& filename )
+    {
+        const size_t slash = filename.find_last_of( '/' ) ;
+        std::string name = slash == std::string::npos ? filename : filename.substr( slash + 1 ) ;
+        const size_t dot = name.find_last_of( '.' ) ;
+        if( dot != std::string::npos && dot > 0 ) name.erase( dot ) ;
+        return name ;
+    }
+
+    static void default_problem( PoissonProblem& problem )
+    {
+        const Mesh& M = problem.mesh() ;
+        problem.set_source( []( vertex ) { return 1. ; } ) ;
+        std::vector< bool > seen ;
+        for( int e = 0; e < M.nb_edges(); ++e ) {
+            const int attribute = M.get_edge_attribute( e ) ;
+            if( attribute < 0 ) continue ;
+            if( attribute >= seen.size() ) seen.resize( attribute + 1, false ) ;
+            if( seen[attribute] ) continue ;
+            seen[attribute] = true ;
+            problem.set_dirichlet( attribute, []( vertex ) { return 0. ; } ) ;
+        }
+    }
+
+    /* a mesh on its way through the stages; the problem refers to the mesh */
+    struct MeshPipeline::Item {
+        int index ;
+        PipelineResult result ;
+        std::unique_ptr< Mesh > mesh ;
+        std::unique_ptr< PoissonProblem > problem ;
+    } ;
+
+    /****************************************************************/
+    /* Implementation of PipelineConfig */
+    /****************************************************************/
+    PipelineConfig::PipelineConfig()
+        : load_threads( 1 ), assemble_threads( 1 ), solve_threads( 1 ), write_threads( 1 ),
+        queue_capacity( 2 ), vtu( false )
+    {
+    }
+
+    /****************************************************************/
+    /* Implementation of MeshPipeline */
+    /****************************************************************/
+    MeshPipeline::MeshPipeline( const PipelineConfig& config )
+        : config_( config ), setup_( default_problem ), has_solver_config_( false ), wall_( 0. )
+    {
+        for( int s = 0; s < NB_STAGES; ++s ) {
+            busy_[s] = starved_[s] = blocked_[s] = 0. ;
+            threads_[s] = nb_threads( Stage( s ) ) ;
+        }
+    }
+
+    void MeshPipeline::set_problem( const ProblemSetup& setup )
+    {
+        setup_ = setup ;
+    }
+
+    void MeshPipeline::set_solver_config( const SolverConfig& config )
+    {
+        solver_config_ = config ;
+        has_solver_config_ = true ;
+    }
+
+    int MeshPipeline::nb_threads( Stage stage ) const
+    {
+        const int n[NB_STAGES] = { config_.load_threads, config_.assemble_threads,
+            config_.solve_threads, config_.write_threads } ;
+        return std::max( n[stage], 1 ) ;
+    }
+
+    const char* MeshPipeline::stage_name( Stage stage )
+    {
+        const char* names[NB_STAGES] = { "load", "assemble", "solve", "write" } ;
+        return names[stage] ;
+    }
+
+    void MeshPipeline::reset( const std::vector< std::string >& filenames )
+    {
+        results_.assign( filenames.size(), PipelineResult() ) ;
+        for( int s = 0; s < NB_STAGES; ++s ) busy_[s] = starved_[s] = blocked_[s] = 0. ;
+        if( !config_.output_directory.empty() ) mkdir( config_.output_directory.c_str(), 0755 ) ;
+    }
+
+    void MeshPipeline::process( Stage stage, Item& item ) const
+    {
+        PipelineResult& result = item.result ;
+        if( !result.ok ) return ;
+        switch( stage ) {
+            case LOAD :
+                item.mesh.reset( new Mesh ) ;
+                if( !item.mesh->load( result.filename ) || item.mesh->nb_triangles() == 0 ) {
+                    result.ok = false ;
+                    result.error = "cannot load " + result.filename ;
+                    item.mesh.reset() ;
+                    return ;
+                }
+                result.nb_vertices = item.mesh->nb_vertices() ;
+                break ;
+            case ASSEMBLE :
+                item.problem.reset( new PoissonProblem( *item.mesh ) ) ;
+                if( has_solver_config_ ) item.problem->set_solver_config( solver_config_ ) ;
+                setup_( *item.problem ) ;
+                item.problem->assemble() ;
+                break ;
+            case SOLVE :
+                if( !item.problem->solve() ) {
+                    result.ok = false ;
+                    result.error = "not converged" ;
+                }
+                result.iterations = item.problem->iterations() ;
+                result.residual = item.problem->residual() ;
+                break ;
+            case WRITE :
+                if( !config_.output_directory.empty() ) {
+                    const std::string basename = config_.output_directory + "/" + mesh_name( result.filename ) ;
+                    const std::vector< double > u( item.problem->solution(),
+                        item.problem->solution() + item.problem->size() ) ;
+                    if( config_.vtu ) {
+                        VtuWriter writer( *item.mesh ) ;
+                        writer.add_point_field( "u", u ) ;
+                        if( !writer.write( basename + ".vtu" ) ) {
+                            result.ok = false ;
+                            result.error = "cannot write " + basename + ".vtu" ;
+                        }
+                    } else {
+                        save_solution( u, basename + ".bb" ) ;
+                    }
+                }
+                break ;
+            default :
+                break ;
+        }
+    }
+
+    void MeshPipeline::finish( Item& item )
+    {
+        /* the matrix and the mesh are released here, not at the end */
+        item.problem.reset() ;
+        item.mesh.reset() ;
+        results_[item.index] = item.result ;
+    }
+
+    bool MeshPipeline::run( const std::vector< std::string >& filenames )
+    {
+        typedef std::unique_ptr< Item > ItemPtr ;
+        reset( filenames ) ;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+
+        /* queues[s] feeds the stage s + 1 */
+        std::vector< std::unique_ptr< BoundedQueue< ItemPtr > > > queues ;
+        for( int s = 0; s + 1 < NB_STAGES; ++s ) {
+            queues.emplace_back( new BoundedQueue< ItemPtr >( config_.queue_capacity ) ) ;
+        }
+        std::atomic< int > next_file( 0 ) ;
+        std::atomic< int > running[NB_STAGES] ;
+        for( int s = 0; s < NB_STAGES; ++s ) running[s] = threads_[s] ;
+
+        std::vector< std::thread > threads ;
+        for( int s = 0; s < NB_STAGES; ++s ) {
+            const Stage stage = Stage( s ) ;
+            for( int t = 0; t < threads_[s]; ++t ) {
+                threads.emplace_back( [this, stage, &queues, &next_file, &running, &filenames]() {
+                    BoundedQueue< ItemPtr >* in = stage == LOAD ? NULL : queues[stage - 1].get() ;
+                    BoundedQueue< ItemPtr >* out = stage == WRITE ? NULL : queues[stage].get() ;
+                    double busy = 0., starved = 0., blocked = 0. ;
+                    while( true ) {
+                        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now() ;
+                        ItemPtr item ;
+                        if( in == NULL ) {
+                            const int index = next_file++ ;
+                            if( index >= filenames.size() ) break ;
+                            item.reset( new Item ) ;
+                            item->index = index ;
+                            PipelineResult& result = item->result ;
+                            result.filename = filenames[index] ;
+                            result.ok = true ;
+                            result.nb_vertices = result.iterations = 0 ;
+                            result.residual = 0. ;
+                            for( int k = 0; k < NB_STAGES; ++k ) result.seconds[k] = 0. ;
+                        } else if( !in->pop( item ) ) {
+                            break ;
+                        }
+                        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now() ;
+                        process( stage, *item ) ;
+                        std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now() ;
+                        item->result.seconds[stage] = seconds_between( t1, t2 ) ;
+                        if( out != NULL ) {
+                            out->push( item ) ;
+                        } else {
+                            std::lock_guard< std::mutex > lock( mutex_ ) ;
+                            finish( *item ) ;
+                        }
+                        starved += seconds_between( t0, t1 ) ;
+                        busy += seconds_between( t1, t2 ) ;
+                        blocked += seconds_between( t2, std::chrono::steady_clock::now() ) ;
+                    }
+                    /* the last thread of a stage closes its output */
+                    if( --running[stage] == 0 && out != NULL ) out->close() ;
+                    std::lock_guard< std::mutex > lock( mutex_ ) ;
+                    busy_[stage] += busy ;
+                    starved_[stage] += starved ;
+                    blocked_[stage] += blocked ;
+                } ) ;
+            }
+        }
+        for( int t = 0; t < threads.size(); ++t ) threads[t].join() ;
+        wall_ = seconds_between( start, std::chrono::steady_clock::now() ) ;
+
+        for( int i = 0; i < results_.size(); ++i ) {
+            if( !results_[i].ok ) return false ;
+        }
+        return true ;
+    }
+
+    bool MeshPipeline::run_sequential( const std::vector< std::string >& filenames )
+    {
+        reset( filenames ) ;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+        bool ok = true ;
+        for( int i = 0; i < filenames.size(); ++i ) {
+            Item item ;
+            item.index = i ;
+            item.result.filename = filenames[i] ;
+            item.result.ok = true ;
+            item.result.nb_vertices = item.result.iterations = 0 ;
+            item.result.residual = 0. ;
+            for( int s = 0; s < NB_STAGES; ++s ) {
+                const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now() ;
+                process( Stage( s ), item ) ;
+                item.result.seconds[s] = seconds_between( t0, std::chrono::steady_clock::now() ) ;
+                busy_[s] += item.result.seconds[s] ;
+            }
+            finish( item ) ;
+            ok = ok && item.result.ok ;
+        }
+        wall_ = seconds_between( start, std::chrono::steady_clock::now() ) ;
+        return ok ;
+    }
+
+    const std::vector< PipelineResult >& MeshPipeline::results() const
+    {
+        return results_ ;
+    }
+
+    double MeshPipeline::wall_seconds() const
+    {
+        return wall_ ;
+    }
+
+    double MeshPipeline::throughput() const
+    {
+        return wall_ > 0. ? results_.size() / wall_ : 0. ;
+    }
+
+    double MeshPipeline::busy_seconds( Stage stage ) const
+    {
+        return busy_[stage] ;
+    }
+
+    double MeshPipeline::starved_seconds( Stage stage ) const
+    {
+        return starved_[stage] ;
+    }
+
+    double MeshPipeline::blocked_seconds( Stage stage ) const
+    {
+        return blocked_[stage] ;
+    }
+
+    double MeshPipeline::utilization( Stage stage ) const
+    {
+        return wall_ > 0. ? busy_[stage] / ( wall_ * threads_[stage] ) : 0. ;
+    }
+
+    std::string MeshPipeline::report() const
+    {
+        std::ostringstream out ;
+        out << std::fixed << std::setprecision( 3 ) ;
+        for( int s = 0; s < NB_STAGES; ++s ) {
+            const Stage stage = Stage( s ) ;
+            out << std::setw( 10 ) << stage_name( stage ) << ": " << threads_[s] << " thread(s), busy "
+                << busy_[s] << " s (" << std::setprecision( 1 ) << 100. * utilization( stage )
+                << "%), starved " << std::setprecision( 3 ) << starved_[s] << " s, blocked "
+                << blocked_[s] << " s" << std::endl ;
+        }
+        out << std::setw( 10 ) << "total" << ": " << results_.size() << " meshes in " << wall_
+            << " s, " << std::setprecision( 2 ) << throughput() << " meshes/s" ;
+        return out.str() ;
+    }
+
+    std::vector< std::string > MeshPipeline::list_meshes( const std::string& directory )
+    {
+        std::vector< std::string > filenames ;
+        DIR* dir = opendir( directory.c_str() ) ;
+        if( dir == NULL ) return filenames ;
+        while( dirent* entry = readdir( dir ) ) {
+            const std::string name = entry->d_name ;
+            if( name.size() > 5 && name.compare( name.size() - 5, 5, ".mesh" ) == 0 ) {
+                filenames.push_back( directory + "/" + name ) ;
+            }
+        }
+        closedir( dir ) ;
+        std::sort( filenames.begin(), filenames.end() ) ;
+        return filenames ;
+    }
+
+}
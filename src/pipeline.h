@@ -0,0 +1,136 @@
+#pragma once
+
+#include "mesh.h"
+#include "solver.h"
+#include "problem.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief Thread budgets and queues of a MeshPipeline.
+     */
+    struct PipelineConfig {
+        PipelineConfig() ;
+
+        /* threads of each stage */
+        int load_threads ;
+        int assemble_threads ;
+        int solve_threads ;
+        int write_threads ;
+
+        /* meshes waiting between two stages, at most */
+        int queue_capacity ;
+
+        /* <output_directory>/<mesh name>.bb (or .vtu), nothing if empty */
+        std::string output_directory ;
+        bool vtu ;
+    } ;
+
+    /**
+     * \brief Outcome of one mesh of a batch.
+     */
+    struct PipelineResult {
+        std::string filename ;
+        bool ok ;
+        std::string error ;
+        int nb_vertices ;
+        int iterations ;
+        double residual ;
+        double seconds[4] ;     /* in each stage */
+    } ;
+
+    /**
+     * \brief MeshPipeline solves a Poisson problem on each mesh of a batch
+     *        with the stages overlapped: the next mesh is loaded while the
+     *        current one is assembled and the previous ones are solved or
+     *        written.
+     *
+     *   load --queue--> assemble --queue--> solve --queue--> write
+     *
+     * Each stage has its own threads, taking a mesh from its input queue
+     * and pushing it to the next one. The queues are bounded: a slow
+     * stage blocks the earlier ones, so that at most
+     * sum( threads ) + 3 queue_capacity meshes (with their matrices) are
+     * in memory. For each stage the pipeline measures the time spent
+     * working, waiting for a mesh (input starved) and waiting for a free
+     * slot downstream (output blocked).
+     */
+    class MeshPipeline {
+        public:
+            enum Stage { LOAD, ASSEMBLE, SOLVE, WRITE, NB_STAGES } ;
+
+            /* defines the problem on problem.mesh() */
+            typedef std::function< void( PoissonProblem& ) > ProblemSetup ;
+
+            explicit MeshPipeline( const PipelineConfig& config = PipelineConfig() ) ;
+
+            /**
+             * \brief Problem of every mesh. Default: f = 1 and u = 0 on
+             *        every border edge attribute of the mesh.
+             */
+            void set_problem( const ProblemSetup& setup ) ;
+            void set_solver_config( const SolverConfig& config ) ;
+
+            /**
+             * \brief Runs the batch through the pipeline.
+             * \return true if every mesh is loaded, solved and written
+             */
+            bool run( const std::vector< std::string >& filenames ) ;
+
+            /* the same stages one after the other in the calling thread */
+            bool run_sequential( const std::vector< std::string >& filenames ) ;
+
+            /* of the last run, in the order of the filenames */
+            const std::vector< PipelineResult >& results() const ;
+
+            double wall_seconds() const ;
+            /* meshes per second */
+            double throughput() const ;
+
+            /* summed over the threads of the stage */
+            double busy_seconds( Stage stage ) const ;
+            double starved_seconds( Stage stage ) const ;
+            double blocked_seconds( Stage stage ) const ;
+            /* busy / ( wall * threads of the stage ) */
+            double utilization( Stage stage ) const ;
+
+            /* one line per stage and the throughput */
+            std::string report() const ;
+
+            static const char* stage_name( Stage stage ) ;
+
+            /* the .mesh files of a directory, sorted */
+            static std::vector< std::string > list_meshes( const std::string& directory ) ;
+
+        private:
+            struct Item ;
+
+            MeshPipeline( const MeshPipeline& ) ;
+            MeshPipeline& operator=( const MeshPipeline& ) ;
+
+            int nb_threads( Stage stage ) const ;
+            void reset( const std::vector< std::string >& filenames ) ;
+            void process( Stage stage, Item& item ) const ;
+            void finish( Item& item ) ;
+
+            PipelineConfig config_ ;
+            ProblemSetup setup_ ;
+            SolverConfig solver_config_ ;
+            bool has_solver_config_ ;
+
+            std::vector< PipelineResult > results_ ;
+            double wall_ ;
+            double busy_[NB_STAGES] ;
+            double starved_[NB_STAGES] ;
+            double blocked_[NB_STAGES] ;
+            int threads_[NB_STAGES] ;
+            std::mutex mutex_ ;
+    } ;
+
+}
@@ -0,0 +1,236 @@
+#include "problem.h"
+
+#include <assert.h>
+
+namespace FEM2A {
+
+    /****************************************************************/
+    /* Implementation of PoissonProblem */
+    /****************************************************************/
+    PoissonProblem::PoissonProblem( const Mesh& M )
+        : mesh_( M ), materials_( 1. ), matrix_changed_( true ), rhs_changed_( true ),
+        cache_( NULL ), F_( M.nb_vertices(), 0. ), solution_( M.nb_vertices(), 0. )
+    {
+        config_.preconditioner = SolverConfig::JACOBI ;
+        config_.adapt_to_mesh( M ) ;
+    }
+
+    void PoissonProblem::set_diffusion( const MaterialTable& materials )
+    {
+        materials_ = materials ;
+        matrix_changed_ = true ;
+    }
+
+    void PoissonProblem::set_diffusion( int attribute, double value )
+    {
+        materials_.set_constant( attribute, value ) ;
+        matrix_changed_ = true ;
+    }
+
+    void PoissonProblem::set_source( const ScalarField& f )
+    {
+        source_ = f ;
+        rhs_changed_ = true ;
+    }
+
+    void PoissonProblem::set_dirichlet( int edge_attribute, const ScalarField& g )
+    {
+        assert( edge_attribute >= 0 ) ;
+        if( edge_attribute >= dirichlet_.size() ) dirichlet_.resize( edge_attribute + 1 ) ;
+        /* a new Dirichlet attribute adds penalties to the matrix */
+        if( !dirichlet_[edge_attribute] ) matrix_changed_ = true ;
+        dirichlet_[edge_attribute] = g ;
+        rhs_changed_ = true ;
+    }
+
+    void PoissonProblem::set_solver_config( const SolverConfig& config )
+    {
+        config_ = config ;
+        solver_.reset() ;
+    }
+
+    void PoissonProblem::set_system_cache( SystemCache* cache, const std::string& coefficients )
+    {
+        if( cache != NULL && cache_key_.mesh_hash == 0 ) cache_key_.mesh_hash = mesh_content_hash( mesh_ ) ;
+        cache_ = cache ;
+        cache_key_.coefficients = coefficients ;
+    }
+
+    bool PoissonProblem::system_from_cache() const
+    {
+        return (bool)mapped_ ;
+    }
+
+    void PoissonProblem::use_pattern( const SparseMatrix& pattern )
+    {
+        assert( pattern.nb_rows() == mesh_.nb_vertices() ) ;
+        K_.reset( new SparseMatrix( pattern ) ) ;
+        solver_.reset() ;
+        matrix_changed_ = true ;
+    }
+
+    const SolverConfig& PoissonProblem::solver_config() const
+    {
+        return config_ ;
+    }
+
+    void PoissonProblem::collect_dirichlet_vertices( std::vector< int >& vertices,
+        std::vector< const ScalarField* >& fields ) const
+    {
+        /* as apply_dirichlet_boundary_conditions: each vertex once, with
+         * the field of the first edge reaching it */
+        std::vector< bool > seen( mesh_.nb_vertices(), false ) ;
+        vertices.clear() ;
+        fields.clear() ;
+        for( int e = 0; e < mesh_.nb_edges(); ++e ) {
+            const int attribute = mesh_.get_edge_attribute( e ) ;
+            if( attribute < 0 || attribute >= dirichlet_.size() || !dirichlet_[attribute] ) continue ;
+            for( int k = 0; k < 2; ++k ) {
+                const int v = mesh_.get_edge_vertex_index( e, k ) ;
+                if( seen[v] ) continue ;
+                seen[v] = true ;
+                vertices.push_back( v ) ;
+                fields.push_back( &dirichlet_[attribute] ) ;
+            }
+        }
+    }
+
+    void PoissonProblem::assemble()
+    {
+        if( !matrix_changed_ && !rhs_changed_ ) return ;
+        if( matrix_changed_ && cache_ != NULL ) {
+            mapped_ = cache_->load( cache_key_ ) ;
+            if( mapped_ ) {
+                /* nothing to assemble */
+                F_.assign( mapped_->rhs(), mapped_->rhs() + mapped_->nb_rows() ) ;
+                K_.reset() ;
+                solver_.reset() ;
+                matrix_changed_ = false ;
+                rhs_changed_ = false ;
+                return ;
+            }
+        }
+        if( !mapped_ && !K_ ) matrix_changed_ = true ;
+        std::vector< int > dirichlet_vertices ;
+        std::vector< const ScalarField* > dirichlet_fields ;
+        collect_dirichlet_vertices( dirichlet_vertices, dirichlet_fields ) ;
+
+        const bool stored_matrix = matrix_changed_ ;
+        if( matrix_changed_ ) {
+            mapped_.reset() ;
+            /* the stored coefficients are kept (and zeroed): new diffusion
+             * coefficients do not reallocate the rows */
+            if( K_ ) K_->fill( 0. ) ;
+            else K_.reset( new SparseMatrix( mesh_.nb_vertices() ) ) ;
+            assemble_stiffness( mesh_, materials_, *K_ ) ;
+            for( int d = 0; d < dirichlet_vertices.size(); ++d ) {
+                K_->add( dirichlet_vertices[d], dirichlet_vertices[d], dirichlet_penalty ) ;
+            }
+            solver_.reset() ;
+            matrix_changed_ = false ;
+        }
+
+        if( rhs_changed_ ) {
+            F_.assign( mesh_.nb_vertices(), 0. ) ;
+            if( source_ ) {
+                const Quadrature quadrature = Quadrature::get_quadrature( 2 ) ;
+                const ShapeFunctions shape_functions( 2, 1 ) ;
+                for( int t = 0; t < mesh_.nb_triangles(); ++t ) {
+                    const ElementMapping mapping( mesh_, false, t ) ;
+                    for( int q = 0; q < quadrature.nb_points(); ++q ) {
+                        const vertex xq = quadrature.point( q ) ;
+                        const double w = quadrature.weight( q ) * mapping.jacobian( xq )
+                            * source_( mapping.transform( xq ) ) ;
+                        for( int i = 0; i < 3; ++i ) {
+                            F_[mesh_.get_triangle_vertex_index( t, i )] += w * shape_functions.evaluate( i, xq ) ;
+                        }
+                    }
+                }
+            }
+            for( int d = 0; d < dirichlet_vertices.size(); ++d ) {
+                const int v = dirichlet_vertices[d] ;
+                F_[v] += dirichlet_penalty * ( *dirichlet_fields[d] )( mesh_.get_vertex( v ) ) ;
+            }
+            rhs_changed_ = false ;
+        }
+        if( cache_ != NULL && !mapped_ && stored_matrix ) cache_->store( cache_key_, *K_, F_ ) ;
+    }
+
+    void PoissonProblem::create_solver()
+    {
+        if( solver_ ) return ;
+        if( mapped_ && config_.preconditioner == SolverConfig::JACOBI ) {
+            /* the inverse diagonal is read from the file */
+            SolverConfig config = config_ ;
+            config.preconditioner = SolverConfig::NONE ;
+            solver_.reset( new LinearSolver( *mapped_, config ) ) ;
+            solver_->set_preconditioner( &mapped_->preconditioner() ) ;
+        } else {
+            solver_.reset( new LinearSolver( system(), config_ ) ) ;
+        }
+    }
+
+    bool PoissonProblem::solve()
+    {
+        assemble() ;
+        create_solver() ;
+        return solver_->solve( F_, solution_ ) ;
+    }
+
+    bool PoissonProblem::solve_adjoint( const std::vector< double >& c, std::vector< double >& lambda )
+    {
+        assert( c.size() == mesh_.nb_vertices() ) ;
+        assemble() ;
+        create_solver() ;
+        return solver_->solve( c, lambda ) ;
+    }
+
+    const Mesh& PoissonProblem::mesh() const
+    {
+        return mesh_ ;
+    }
+
+    const MaterialTable& PoissonProblem::diffusion() const
+    {
+        return materials_ ;
+    }
+
+    const double* PoissonProblem::solution() const
+    {
+        return solution_.data() ;
+    }
+
+    int PoissonProblem::size() const
+    {
+        return solution_.size() ;
+    }
+
+    int PoissonProblem::iterations() const
+    {
+        return solver_ ? solver_->iterations() : 0 ;
+    }
+
+    double PoissonProblem::residual() const
+    {
+        return solver_ ? solver_->residual() : 0. ;
+    }
+
+    const LinearOperator& PoissonProblem::system() const
+    {
+        if( mapped_ ) return *mapped_ ;
+        assert( K_ ) ;
+        return *K_ ;
+    }
+
+    const SparseMatrix& PoissonProblem::matrix() const
+    {
+        assert( K_ ) ;
+        return *K_ ;
+    }
+
+    const std::vector< double >& PoissonProblem::rhs() const
+    {
+        return F_ ;
+    }
+
+}
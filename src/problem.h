@@ -0,0 +1,137 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "solver.h"
+#include "material.h"
+#include "system_cache.h"
+
+#include <memory>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief PoissonProblem is the entry point of the library for
+     *        embedding the solver: -div(k grad u) = f on a mesh, with
+     *        u = g imposed by penalty on the border edges of the Dirichlet
+     *        attributes, solved with P1 elements and the PCG solver.
+     *
+     * The problem keeps the assembled matrix and the solver between
+     * solves: changing only the source or the Dirichlet values
+     * reassembles the right hand side and reuses the preconditioner.
+     * The solution is read through solution(), a view of an internal
+     * buffer, without any file.
+     */
+    class PoissonProblem {
+        public:
+            /**
+             * \param M The mesh (possibly wrapping arrays of the caller,
+             *        see Mesh::wrap), must outlive the problem
+             */
+            explicit PoissonProblem( const Mesh& M ) ;
+
+            /* k per triangle attribute (default: 1 everywhere) */
+            void set_diffusion( const MaterialTable& materials ) ;
+            void set_diffusion( int attribute, double value ) ;
+
+            /* f on all the triangles (default: 0) */
+            void set_source( const ScalarField& f ) ;
+
+            /* u = g on the border edges of attribute edge_attribute */
+            void set_dirichlet( int edge_attribute, const ScalarField& g ) ;
+
+            /* default: PCG with Jacobi, threshold of adapt_to_mesh */
+            void set_solver_config( const SolverConfig& config ) ;
+            const SolverConfig& solver_config() const ;
+
+            /**
+             * \brief Looks the assembled system up in cache before
+             *        assembling the matrix, and stores it there after.
+             *        coefficients names k, f and g (see SystemKey): the
+             *        caller changes it when one of them changes. NULL
+             *        disables the cache, which must outlive the problem.
+             */
+            void set_system_cache( SystemCache* cache, const std::string& coefficients ) ;
+
+            /* true if the current system was mapped from the cache */
+            bool system_from_cache() const ;
+
+            /**
+             * \brief Starts from a copy of the rows of pattern (the matrix
+             *        of another problem on the same mesh): the assembly
+             *        only adds to existing coefficients.
+             */
+            void use_pattern( const SparseMatrix& pattern ) ;
+
+            /**
+             * \brief Assembles what changed since the last call: the
+             *        matrix (diffusion, Dirichlet edges) and/or the right
+             *        hand side. Called by solve().
+             */
+            void assemble() ;
+
+            /**
+             * \brief Solves, starting from the previous solution.
+             * \return true if the solver has converged
+             */
+            bool solve() ;
+
+            /**
+             * \brief View of the solution, one value per vertex. The
+             *        pointer stays valid as long as the problem; its
+             *        content is updated by solve().
+             */
+            const double* solution() const ;
+            int size() const ;
+
+            /**
+             * \brief Solves the adjoint system K^T lambda = c with the
+             *        matrix and preconditioner of the forward problem (K is
+             *        symmetric), assembled if needed.
+             * \return true if the solver has converged
+             */
+            bool solve_adjoint( const std::vector< double >& c, std::vector< double >& lambda ) ;
+
+            const Mesh& mesh() const ;
+            const MaterialTable& diffusion() const ;
+
+            /* statistics of the last solve() or solve_adjoint() */
+            int iterations() const ;
+            double residual() const ;
+
+            /* the assembled matrix, or the mapped one */
+            const LinearOperator& system() const ;
+            /* not available when the system comes from the cache */
+            const SparseMatrix& matrix() const ;
+            const std::vector< double >& rhs() const ;
+
+        private:
+            PoissonProblem( const PoissonProblem& ) ;
+            PoissonProblem& operator=( const PoissonProblem& ) ;
+
+            /* the solver of the current matrix, created once */
+            void create_solver() ;
+
+            /* vertices of the Dirichlet edges and the value imposed there */
+            void collect_dirichlet_vertices( std::vector< int >& vertices,
+                std::vector< const ScalarField* >& fields ) const ;
+
+            const Mesh& mesh_ ;
+            MaterialTable materials_ ;
+            ScalarField source_ ;
+            std::vector< ScalarField > dirichlet_ ;  /* per edge attribute, empty if none */
+            SolverConfig config_ ;
+
+            bool matrix_changed_ ;
+            bool rhs_changed_ ;
+            SystemCache* cache_ ;
+            SystemKey cache_key_ ;
+            std::unique_ptr< MappedSystem > mapped_ ;
+            std::unique_ptr< SparseMatrix > K_ ;
+            std::unique_ptr< LinearSolver > solver_ ;
+            std::vector< double > F_ ;
+            std::vector< double > solution_ ;
+    } ;
+
+}
@@ -0,0 +1,441 @@
+#include "reduced_basis.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <limits>
+
+namespace FEM2A {
+
+    static double dot( const std::vector< double >& x, const std::vector< double >& y )
+    {
+        double sum = 0. ;
+        for( int i = 0; i < x.size(); ++i ) sum += x[i] * y[i] ;
+        return sum ;
+    }
+
+    /* y += a x */
+    static void axpy( double a, const std::vector< double >& x, std::vector< double >& y )
+    {
+        for( int i = 0; i < x.size(); ++i ) y[i] += a * x[i] ;
+    }
+
+    /**
+     * Thin QR of the columns S = Q R by Gram-Schmidt, orthogonalized twice
+     * (CGS2) to stay orthogonal to the working precision. A column in the
+     * span of the previous ones gives a zero column of Q and R(j,j) = 0.
+     * R is m x m row major.
+     */
+    static void thin_qr( const std::vector< std::vector< double > >& S,
+        std::vector< std::vector< double > >& Q, std::vector< double >& R )
+    {
+        const int m = S.size() ;
+        Q = S ;
+        R.assign( m * m, 0. ) ;
+        for( int j = 0; j < m; ++j ) {
+            std::vector< double >& w = Q[j] ;
+            const double norm = std::sqrt( dot( w, w ) ) ;
+            for( int pass = 0; pass < 2; ++pass ) {
+                for( int i = 0; i < j; ++i ) {
+                    const double h = dot( Q[i], w ) ;
+                    axpy( -h, Q[i], w ) ;
+                    R[i * m + j] += h ;
+                }
+            }
+            const double r = std::sqrt( dot( w, w ) ) ;
+            if( r > 1e-13 * norm ) {
+                R[j * m + j] = r ;
+                for( int k = 0; k < w.size(); ++k ) w[k] /= r ;
+            } else {
+                std::fill( w.begin(), w.end(), 0. ) ;
+            }
+        }
+    }
+
+    /**
+     * One-sided Jacobi SVD of the m x m row major A: columns of A are
+     * rotated until orthogonal, then A = U Sigma (V^T dropped). Returns
+     * sigma and U (column i in U[i * m .. i * m + m[) sorted by
+     * decreasing singular value.
+     */
+    static void jacobi_svd( std::vector< double > A, int m,
+        std::vector< double >& sigma, std::vector< double >& U )
+    {
+        /* work on columns: C[j * m + i] = A(i, j) */
+        std::vector< double > C( m * m ) ;
+        for( int i = 0; i < m; ++i ) {
+            for( int j = 0; j < m; ++j ) C[j * m + i] = A[i * m + j] ;
+        }
+        const double eps = std::numeric_limits< double >::epsilon() ;
+        for( int sweep = 0; sweep < 60; ++sweep ) {
+            bool rotated = false ;
+            for( int p = 0; p < m; ++p ) {
+                for( int q = p + 1; q < m; ++q ) {
+                    double* cp = &C[p * m] ;
+                    double* cq = &C[q * m] ;
+                    double alpha = 0., beta = 0., gamma = 0. ;
+                    for( int i = 0; i < m; ++i ) {
+                        alpha += cp[i] * cp[i] ;
+                        beta += cq[i] * cq[i] ;
+                        gamma += cp[i] * cq[i] ;
+                    }
+                    if( std::abs( gamma ) <= eps * std::sqrt( alpha * beta ) ) continue ;
+                    rotated = true ;
+                    const double zeta = ( beta - alpha ) / ( 2. * gamma ) ;
+                    const double t = ( zeta >= 0. ? 1. : -1. ) / ( std::abs( zeta ) + std::sqrt( 1. + zeta * zeta ) ) ;
+                    const double c = 1. / std::sqrt( 1. + t * t ) ;
+                    const double s = c * t ;
+                    for( int i = 0; i < m; ++i ) {
+                        const double x = cp[i], y = cq[i] ;
+                        cp[i] = c * x - s * y ;
+                        cq[i] = s * x + c * y ;
+                    }
+                }
+            }
+            if( !rotated ) break ;
+        }
+        std::vector< std::pair< double, int > > order( m ) ;
+        for( int j = 0; j < m; ++j ) {
+            double norm = 0. ;
+            for( int i = 0; i < m; ++i ) norm += C[j * m + i] * C[j * m + i] ;
+            order[j] = std::make_pair( -std::sqrt( norm ), j ) ;
+        }
+        std::sort( order.begin(), order.end() ) ;
+        sigma.assign( m, 0. ) ;
+        U.assign( m * m, 0. ) ;
+        for( int k = 0; k < m; ++k ) {
+            sigma[k] = -order[k].first ;
+            if( sigma[k] == 0. ) continue ;
+            const int j = order[k].second ;
+            for( int i = 0; i < m; ++i ) U[k * m + i] = C[j * m + i] / sigma[k] ;
+        }
+    }
+
+    /* solves the r x r symmetric positive definite A x = b in place of
+     * b, false if a pivot is not positive */
+    static bool cholesky_solve( std::vector< double >& A, int r, std::vector< double >& b )
+    {
+        for( int j = 0; j < r; ++j ) {
+            double d = A[j * r + j] ;
+            for( int k = 0; k < j; ++k ) d -= A[j * r + k] * A[j * r + k] ;
+            if( !( d > 0. ) ) return false ;
+            d = std::sqrt( d ) ;
+            A[j * r + j] = d ;
+            for( int i = j + 1; i < r; ++i ) {
+                double s = A[i * r + j] ;
+                for( int k = 0; k < j; ++k ) s -= A[i * r + k] * A[j * r + k] ;
+                A[i * r + j] = s / d ;
+            }
+        }
+        for( int i = 0; i < r; ++i ) {
+            double s = b[i] ;
+            for( int k = 0; k < i; ++k ) s -= A[i * r + k] * b[k] ;
+            b[i] = s / A[i * r + i] ;
+        }
+        for( int i = r - 1; i >= 0; --i ) {
+            double s = b[i] ;
+            for( int k = i + 1; k < r; ++k ) s -= A[k * r + i] * b[k] ;
+            b[i] = s / A[i * r + i] ;
+        }
+        return true ;
+    }
+
+    /****************************************************************/
+    /* Implementation of ReducedBasis */
+    /****************************************************************/
+    ReducedBasis::ReducedBasis(
+        const Mesh& M,
+        const MaterialTable& base,
+        const std::vector< int >& attributes,
+        const std::vector< ScalarField >& sources )
+        : mesh_( M ), base_( base ), attributes_( attributes ), sources_( sources ),
+        tolerance_( 1e-6 ), full_( M ), effectivity_( 1. ), estimated_error_( 0. ), used_full_solve_( false ),
+        nb_full_solves_( 0 )
+    {
+        full_.set_diffusion( base ) ;
+    }
+
+    void ReducedBasis::set_dirichlet( int edge_attribute, const ScalarField& g )
+    {
+        assert( edge_attribute >= 0 ) ;
+        if( edge_attribute >= dirichlet_.size() ) dirichlet_.resize( edge_attribute + 1 ) ;
+        dirichlet_[edge_attribute] = g ;
+        full_.set_dirichlet( edge_attribute, g ) ;
+    }
+
+    void ReducedBasis::set_solver_config( const SolverConfig& config )
+    {
+        full_.set_solver_config( config ) ;
+    }
+
+    void ReducedBasis::set_tolerance( double tolerance )
+    {
+        tolerance_ = tolerance ;
+    }
+
+    void ReducedBasis::set_full_parameters( const ReducedParameters& parameters )
+    {
+        assert( parameters.diffusion.size() == attributes_.size() ) ;
+        assert( parameters.source.size() == sources_.size() ) ;
+        for( int a = 0; a < attributes_.size(); ++a ) {
+            full_.set_diffusion( attributes_[a], parameters.diffusion[a] ) ;
+        }
+        const std::vector< ScalarField > sources = sources_ ;
+        const std::vector< double > amplitudes = parameters.source ;
+        full_.set_source( [sources, amplitudes]( vertex v ) {
+            double f = 0. ;
+            for( int j = 0; j < sources.size(); ++j ) {
+                if( amplitudes[j] != 0. ) f += amplitudes[j] * sources[j]( v ) ;
+            }
+            return f ;
+        } ) ;
+    }
+
+    bool ReducedBasis::add_snapshot( const ReducedParameters& parameters )
+    {
+        set_full_parameters( parameters ) ;
+        const bool converged = full_.solve() ;
+        add_snapshot( std::vector< double >( full_.solution(), full_.solution() + full_.size() ) ) ;
+        return converged ;
+    }
+
+    void ReducedBasis::add_snapshot( const std::vector< double >& u )
+    {
+        assert( u.size() == mesh_.nb_vertices() ) ;
+        snapshots_.push_back( u ) ;
+    }
+
+    int ReducedBasis::nb_snapshots() const
+    {
+        return snapshots_.size() ;
+    }
+
+    int ReducedBasis::build( double pod_tolerance, int max_size )
+    {
+        const int m = snapshots_.size() ;
+        std::vector< std::vector< double > > Q ;
+        std::vector< double > R, U ;
+        thin_qr( snapshots_, Q, R ) ;
+        jacobi_svd( R, m, singular_values_, U ) ;
+
+        /* truncation: discarded energy below pod_tolerance^2 */
+        double energy = 0. ;
+        for( int k = 0; k < m; ++k ) energy += singular_values_[k] * singular_values_[k] ;
+        int r = m ;
+        double discarded = 0. ;
+        while( r > 0 ) {
+            const double s2 = singular_values_[r - 1] * singular_values_[r - 1] ;
+            if( discarded + s2 > pod_tolerance * pod_tolerance * energy
+                && singular_values_[r - 1] > 1e-12 * singular_values_[0] ) break ;
+            discarded += s2 ;
+            --r ;
+        }
+        if( max_size > 0 ) r = std::min( r, max_size ) ;
+
+        /* V = Q U, first r columns */
+        const int n = mesh_.nb_vertices() ;
+        basis_.assign( r, std::vector< double >( n, 0. ) ) ;
+        for( int k = 0; k < r; ++k ) {
+            for( int i = 0; i < m; ++i ) {
+                if( U[k * m + i] != 0. ) axpy( U[k * m + i], Q[i], basis_[k] ) ;
+            }
+        }
+        build_operators() ;
+        return r ;
+    }
+
+    void ReducedBasis::build_operators()
+    {
+        const int r = basis_.size() ;
+        const int n = mesh_.nb_vertices() ;
+
+        /* the residual terms: b_0, F_j, A_0 V, K_a V */
+        std::vector< std::vector< double > > terms ;
+
+        /* fixed part: other materials and Dirichlet penalties */
+        PoissonProblem fixed( mesh_ ) ;
+        MaterialTable materials = base_ ;
+        for( int a = 0; a < attributes_.size(); ++a ) materials.set_constant( attributes_[a], 0. ) ;
+        fixed.set_diffusion( materials ) ;
+        for( int e = 0; e < dirichlet_.size(); ++e ) {
+            if( dirichlet_[e] ) fixed.set_dirichlet( e, dirichlet_[e] ) ;
+        }
+        fixed.assemble() ;
+        terms.push_back( fixed.rhs() ) ;
+        for( int j = 0; j < sources_.size(); ++j ) {
+            PoissonProblem source( mesh_ ) ;
+            source.set_diffusion( MaterialTable( 0. ) ) ;
+            source.set_source( sources_[j] ) ;
+            source.assemble() ;
+            terms.push_back( source.rhs() ) ;
+        }
+        const int first_operator = terms.size() ;
+        /* D: diagonal of A_0 + sum_a K_a */
+        std::vector< double > weight ;
+        fixed.system().diagonal( weight ) ;
+        for( int k = 0; k < r; ++k ) {
+            terms.push_back( std::vector< double >( n ) ) ;
+            fixed.system().mult( basis_[k], terms.back() ) ;
+        }
+        for( int a = 0; a < attributes_.size(); ++a ) {
+            /* k = 1 on the attribute, 0 elsewhere */
+            PoissonProblem parameter( mesh_ ) ;
+            MaterialTable unit( 0. ) ;
+            unit.set_constant( attributes_[a], 1. ) ;
+            parameter.set_diffusion( unit ) ;
+            parameter.assemble() ;
+            std::vector< double > d ;
+            parameter.system().diagonal( d ) ;
+            for( int i = 0; i < n; ++i ) weight[i] += d[i] ;
+            for( int k = 0; k < r; ++k ) {
+                terms.push_back( std::vector< double >( n ) ) ;
+                parameter.system().mult( basis_[k], terms.back() ) ;
+            }
+        }
+
+        /* projections */
+        b0_.assign( r, 0. ) ;
+        F_.assign( sources_.size(), std::vector< double >( r, 0. ) ) ;
+        A0_.assign( r * r, 0. ) ;
+        K_.assign( attributes_.size(), std::vector< double >( r * r, 0. ) ) ;
+        for( int i = 0; i < r; ++i ) {
+            b0_[i] = dot( basis_[i], terms[0] ) ;
+            for( int j = 0; j < sources_.size(); ++j ) F_[j][i] = dot( basis_[i], terms[1 + j] ) ;
+            for( int k = 0; k < r; ++k ) {
+                A0_[i * r + k] = dot( basis_[i], terms[first_operator + k] ) ;
+                for( int a = 0; a < attributes_.size(); ++a ) {
+                    K_[a][i * r + k] = dot( basis_[i], terms[first_operator + ( a + 1 ) * r + k] ) ;
+                }
+            }
+        }
+
+        const int nb_terms = terms.size() ;
+        gram_.assign( nb_terms * nb_terms, 0. ) ;
+        for( int p = 0; p < nb_terms; ++p ) {
+            for( int q = p; q < nb_terms; ++q ) {
+                double sum = 0. ;
+                for( int i = 0; i < n; ++i ) sum += terms[p][i] * terms[q][i] / ( weight[i] * weight[i] ) ;
+                gram_[p * nb_terms + q] = gram_[q * nb_terms + p] = sum ;
+            }
+        }
+    }
+
+    int ReducedBasis::basis_size() const
+    {
+        return basis_.size() ;
+    }
+
+    const std::vector< double >& ReducedBasis::singular_values() const
+    {
+        return singular_values_ ;
+    }
+
+    double ReducedBasis::reduced_solve( const ReducedParameters& parameters,
+        std::vector< double >& coefficients ) const
+    {
+        assert( parameters.diffusion.size() == attributes_.size() ) ;
+        assert( parameters.source.size() == sources_.size() ) ;
+        const int r = basis_.size() ;
+        const int nb_sources = sources_.size() ;
+        std::vector< double > A = A0_ ;
+        coefficients = b0_ ;
+        for( int a = 0; a < attributes_.size(); ++a ) {
+            const double k = parameters.diffusion[a] ;
+            for( int i = 0; i < r * r; ++i ) A[i] += k * K_[a][i] ;
+        }
+        for( int j = 0; j < nb_sources; ++j ) {
+            for( int i = 0; i < r; ++i ) coefficients[i] += parameters.source[j] * F_[j][i] ;
+        }
+        if( !cholesky_solve( A, r, coefficients ) ) return std::numeric_limits< double >::infinity() ;
+
+        /* ||D^-1 ( F - K V c )||^2 = theta^T G theta, theta the factors
+         * of the terms; ||V c|| = ||c|| (orthonormal basis) */
+        std::vector< double > theta( 1, 1. ) ;
+        theta.insert( theta.end(), parameters.source.begin(), parameters.source.end() ) ;
+        for( int a = -1; a < (int)attributes_.size(); ++a ) {
+            const double k = a < 0 ? 1. : parameters.diffusion[a] ;
+            for( int i = 0; i < r; ++i ) theta.push_back( -k * coefficients[i] ) ;
+        }
+        const int nb_terms = theta.size() ;
+        double residual = 0. ;
+        for( int p = 0; p < nb_terms; ++p ) {
+            double row = 0. ;
+            for( int q = 0; q < nb_terms; ++q ) row += gram_[p * nb_terms + q] * theta[q] ;
+            residual += theta[p] * row ;
+        }
+        /* the cancellation leaves about 1e-8 of the scaled ||F|| */
+        residual = std::sqrt( std::max( residual, 0. ) ) ;
+        const double norm = std::sqrt( dot( coefficients, coefficients ) ) ;
+        return norm > 0. ? residual / norm : residual ;
+    }
+
+    void ReducedBasis::reconstruct( const std::vector< double >& coefficients,
+        std::vector< double >& u ) const
+    {
+        assert( coefficients.size() == basis_.size() ) ;
+        u.assign( mesh_.nb_vertices(), 0. ) ;
+        for( int k = 0; k < basis_.size(); ++k ) axpy( coefficients[k], basis_[k], u ) ;
+    }
+
+    double ReducedBasis::calibrate( const std::vector< ReducedParameters >& samples, double safety )
+    {
+        double ratio = 0. ;
+        for( int s = 0; s < samples.size(); ++s ) {
+            std::vector< double > coefficients, u ;
+            const double indicator = reduced_solve( samples[s], coefficients ) ;
+            reconstruct( coefficients, u ) ;
+            set_full_parameters( samples[s] ) ;
+            full_.solve() ;
+            double difference = 0., norm = 0. ;
+            for( int i = 0; i < u.size(); ++i ) {
+                const double x = full_.solution()[i] ;
+                difference += ( u[i] - x ) * ( u[i] - x ) ;
+                norm += x * x ;
+            }
+            const double error = norm > 0. ? std::sqrt( difference / norm ) : std::sqrt( difference ) ;
+            if( indicator > 0. ) ratio = std::max( ratio, error / indicator ) ;
+        }
+        effectivity_ = std::max( 1., safety * ratio ) ;
+        return effectivity_ ;
+    }
+
+    double ReducedBasis::effectivity() const
+    {
+        return effectivity_ ;
+    }
+
+    bool ReducedBasis::solve( const ReducedParameters& parameters, std::vector< double >& u )
+    {
+        used_full_solve_ = basis_.empty() ;
+        if( !used_full_solve_ ) {
+            std::vector< double > coefficients ;
+            estimated_error_ = effectivity_ * reduced_solve( parameters, coefficients ) ;
+            used_full_solve_ = !( estimated_error_ <= tolerance_ ) ;
+            if( !used_full_solve_ ) {
+                reconstruct( coefficients, u ) ;
+                return true ;
+            }
+        }
+        ++nb_full_solves_ ;
+        set_full_parameters( parameters ) ;
+        const bool converged = full_.solve() ;
+        u.assign( full_.solution(), full_.solution() + full_.size() ) ;
+        return converged ;
+    }
+
+    double ReducedBasis::estimated_error() const
+    {
+        return estimated_error_ ;
+    }
+
+    bool ReducedBasis::used_full_solve() const
+    {
+        return used_full_solve_ ;
+    }
+
+    int ReducedBasis::nb_full_solves() const
+    {
+        return nb_full_solves_ ;
+    }
+
+}
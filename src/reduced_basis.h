@@ -0,0 +1,176 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "solver.h"
+#include "material.h"
+#include "problem.h"
+
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief A point of the parameter space of a ReducedBasis.
+     */
+    struct ReducedParameters {
+        /* k of each parameter attribute, in the order of the constructor */
+        std::vector< double > diffusion ;
+        /* amplitude of each source field: f = sum_j source[j] f_j */
+        std::vector< double > source ;
+    } ;
+
+    /**
+     * \brief ReducedBasis is a POD reduced order model of
+     *        -div(k grad u) = f for many queries of (k, f).
+     *
+     * The problem is affine in the parameters: the diffusion is constant
+     * on each parameter attribute (the other attributes keep the base
+     * table) and f is a combination of fixed fields, so
+     *   K(mu) = A_0 + sum_a k_a K_a      F(mu) = b_0 + sum_j s_j F_j
+     * where A_0, b_0 hold the fixed materials and the Dirichlet penalties.
+     *
+     * Offline: snapshots are solved with the full PoissonProblem, the
+     * basis V is the leading left singular vectors of the snapshots (thin
+     * SVD: Gram-Schmidt QR, then Jacobi SVD of R), and every affine term
+     * is projected once: V^T A_0 V, V^T K_a V, V^T b_0, V^T F_j. The Gram
+     * matrix of the residual terms is kept too, so that the residual norm
+     * of a reduced solution is computed without any vector of the mesh.
+     *
+     * Online: the reduced system (size of the basis) is combined,
+     * factorized by Cholesky and solved. The error indicator is the
+     * Jacobi scaled residual ||D^-1 ( F - K V c )|| / ||V c||, D the
+     * diagonal of K with k = 1 on the parameter attributes. It follows
+     * the relative error of u but underestimates it: by a factor 3 to 41
+     * on the queries of the reduced-basis bench. calibrate() measures
+     * this effectivity on full solves outside the snapshots, and solve()
+     * falls back to the full problem when the effectivity times the
+     * indicator exceeds the tolerance.
+     */
+    class ReducedBasis {
+        public:
+            /**
+             * \param M The mesh, must outlive the model
+             * \param base Diffusion of the attributes which are not
+             *        parameters
+             * \param attributes Triangle attributes whose k is a parameter
+             * \param sources Fields combined by the source parameters
+             */
+            ReducedBasis(
+                const Mesh& M,
+                const MaterialTable& base,
+                const std::vector< int >& attributes,
+                const std::vector< ScalarField >& sources ) ;
+
+            /* u = g on the border edges of attribute edge_attribute */
+            void set_dirichlet( int edge_attribute, const ScalarField& g ) ;
+
+            /* solver of the snapshots and of the fallback */
+            void set_solver_config( const SolverConfig& config ) ;
+
+            /* largest estimated relative error accepted by solve()
+             * (default 1e-6) */
+            void set_tolerance( double tolerance ) ;
+
+            /**
+             * \brief Solves the full problem at parameters and adds the
+             *        solution to the snapshots.
+             * \return true if the solver has converged
+             */
+            bool add_snapshot( const ReducedParameters& parameters ) ;
+
+            /* a solution computed elsewhere, one value per vertex */
+            void add_snapshot( const std::vector< double >& u ) ;
+
+            int nb_snapshots() const ;
+
+            /**
+             * \brief Computes the basis and the reduced operators. The
+             *        basis keeps the singular values until the discarded
+             *        ones hold less than pod_tolerance^2 of the energy
+             *        (sum of sigma^2), at most max_size vectors if > 0.
+             *        Needs 1 + nb_sources + ( 1 + nb_attributes ) r
+             *        vectors of the mesh while it runs.
+             * \return the size of the basis
+             */
+            int build( double pod_tolerance = 1e-8, int max_size = 0 ) ;
+
+            int basis_size() const ;
+            /* of the snapshots, in decreasing order */
+            const std::vector< double >& singular_values() const ;
+
+            /**
+             * \brief Online solve, without any vector of the mesh:
+             *        coefficients of the solution in the basis.
+             * \return the error indicator, infinite if the reduced matrix
+             *         is not positive definite
+             */
+            double reduced_solve( const ReducedParameters& parameters,
+                std::vector< double >& coefficients ) const ;
+
+            /* u = V coefficients */
+            void reconstruct( const std::vector< double >& coefficients,
+                std::vector< double >& u ) const ;
+
+            /**
+             * \brief Solves the full problem at each of the samples, which
+             *        should not be snapshots (their error is only the
+             *        truncation of the basis), and sets the effectivity to
+             *        safety times the largest ratio of the relative error
+             *        to the indicator, at least 1: a few samples do not see
+             *        the worst ratio. Call it after build().
+             * \return the effectivity
+             */
+            double calibrate( const std::vector< ReducedParameters >& samples, double safety = 2. ) ;
+
+            /* 1 until calibrate() */
+            double effectivity() const ;
+
+            /**
+             * \brief Reduced solve, or full solve if the indicator is
+             *        above the tolerance (or the basis is empty).
+             * \return true if the solution is reduced or the full solve
+             *         has converged
+             */
+            bool solve( const ReducedParameters& parameters, std::vector< double >& u ) ;
+
+            /* of the last solve(): effectivity times the indicator */
+            double estimated_error() const ;
+            bool used_full_solve() const ;
+            int nb_full_solves() const ;
+
+        private:
+            ReducedBasis( const ReducedBasis& ) ;
+            ReducedBasis& operator=( const ReducedBasis& ) ;
+
+            void set_full_parameters( const ReducedParameters& parameters ) ;
+            void build_operators() ;
+
+            const Mesh& mesh_ ;
+            MaterialTable base_ ;
+            std::vector< int > attributes_ ;
+            std::vector< ScalarField > sources_ ;
+            std::vector< ScalarField > dirichlet_ ; /* per edge attribute, empty if none */
+            double tolerance_ ;
+            PoissonProblem full_ ;
+
+            std::vector< std::vector< double > > snapshots_ ;
+            std::vector< double > singular_values_ ;
+            std::vector< std::vector< double > > basis_ ;
+
+            /* reduced terms, r x r row major and r */
+            std::vector< double > A0_ ;
+            std::vector< std::vector< double > > K_ ;
+            std::vector< double > b0_ ;
+            std::vector< std::vector< double > > F_ ;
+            /* Gram matrix of the residual terms b_0, F_j, A_0 V, K_a V,
+             * in the D^-2 inner product */
+            std::vector< double > gram_ ;
+
+            double effectivity_ ;
+            double estimated_error_ ;
+            bool used_full_solve_ ;
+            int nb_full_solves_ ;
+    } ;
+
+}
@@ -0,0 +1,310 @@
+#include "schwarz.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <assert.h>
+
+namespace FEM2A {
+
+    /* Cholesky of the profile: row i of L covers the columns [first[i], i] */
+    static bool profile_cholesky(
+        const std::vector< int >& first,
+        const std::vector< int >& offsets,
+        std::vector< double >& L )
+    {
+        bool positive = true ;
+        for( int i = 0; i < first.size(); ++i ) {
+            double* Li = &L[offsets[i] - first[i]] ;
+            for( int j = first[i]; j <= i; ++j ) {
+                const double* Lj = &L[offsets[j] - first[j]] ;
+                double s = Li[j] ;
+                for( int k = std::max( first[i], first[j] ); k < j; ++k ) {
+                    s -= Li[k] * Lj[k] ;
+                }
+                if( j < i ) {
+                    Li[j] = s / Lj[j] ;
+                } else if( s > 0. ) {
+                    Li[i] = std::sqrt( s ) ;
+                } else {
+                    positive = false ;
+                    Li[i] = 1. ;
+                }
+            }
+        }
+        return positive ;
+    }
+
+    /* solves L L^T x = x in place */
+    static void profile_solve(
+        const std::vector< int >& first,
+        const std::vector< int >& offsets,
+        const std::vector< double >& L,
+        std::vector< double >& x )
+    {
+        const int n = first.size() ;
+        for( int i = 0; i < n; ++i ) {
+            const double* Li = &L[offsets[i] - first[i]] ;
+            double s = x[i] ;
+            for( int k = first[i]; k < i; ++k ) s -= Li[k] * x[k] ;
+            x[i] = s / Li[i] ;
+        }
+        for( int i = n - 1; i >= 0; --i ) {
+            const double* Li = &L[offsets[i] - first[i]] ;
+            x[i] /= Li[i] ;
+            for( int k = first[i]; k < i; ++k ) x[k] -= Li[k] * x[i] ;
+        }
+    }
+
+    /****************************************************************/
+    /* Implementation of AdditiveSchwarz */
+    /****************************************************************/
+    AdditiveSchwarz::AdditiveSchwarz(
+        const SparseMatrix& A,
+        const std::vector< int >& vertex_part,
+        int nb_parts,
+        int overlap,
+        bool coarse_space,
+        const std::vector< int >& dirichlet_rows,
+        ThreadPool& pool )
+        : A_( A ), pool_( pool ), subdomains_( nb_parts ), vertex_part_( vertex_part ),
+        coarse_space_( coarse_space ), nb_updated_subdomains_( 0 )
+    {
+        const int n = A.nb_rows() ;
+        assert( vertex_part.size() == n ) ;
+
+        /* unknowns of each part, extended layer by layer */
+        for( int i = 0; i < n; ++i ) {
+            subdomains_[vertex_part[i]].dofs.push_back( i ) ;
+        }
+        std::vector< int > mark( n, -1 ) ;
+        for( int s = 0; s < nb_parts; ++s ) {
+            std::vector< int >& dofs = subdomains_[s].dofs ;
+            for( int k = 0; k < dofs.size(); ++k ) mark[dofs[k]] = s ;
+            int layer_begin = 0 ;
+            for( int layer = 0; layer < overlap; ++layer ) {
+                const int layer_end = dofs.size() ;
+                for( int k = layer_begin; k < layer_end; ++k ) {
+                    const SparseMatrix::Columns& J = A.get_cols_at_line( dofs[k] ) ;
+                    for( int l = 0; l < J.size(); ++l ) {
+                        if( mark[J[l]] != s ) {
+                            mark[J[l]] = s ;
+                            dofs.push_back( J[l] ) ;
+                        }
+                    }
+                }
+                layer_begin = layer_end ;
+            }
+        }
+
+        /* subdomains of each unknown, as a CSR structure */
+        subdomain_offsets_.assign( n + 1, 0 ) ;
+        for( int s = 0; s < nb_parts; ++s ) {
+            const std::vector< int >& dofs = subdomains_[s].dofs ;
+            for( int k = 0; k < dofs.size(); ++k ) subdomain_offsets_[dofs[k] + 1]++ ;
+        }
+        for( int i = 0; i < n; ++i ) subdomain_offsets_[i + 1] += subdomain_offsets_[i] ;
+        dof_subdomains_.resize( subdomain_offsets_[n] ) ;
+        std::vector< int > fill( subdomain_offsets_.begin(), subdomain_offsets_.end() - 1 ) ;
+        for( int s = 0; s < nb_parts; ++s ) {
+            const std::vector< int >& dofs = subdomains_[s].dofs ;
+            for( int k = 0; k < dofs.size(); ++k ) dof_subdomains_[fill[dofs[k]]++] = s ;
+        }
+
+        pool_.parallel_for( nb_parts, [&]( int begin, int end ) {
+            for( int s = begin; s < end; ++s ) factor_subdomain( A, subdomains_[s] ) ;
+        } ) ;
+
+        if( coarse_space_ ) {
+            for( int k = 0; k < dirichlet_rows.size(); ++k ) {
+                vertex_part_[dirichlet_rows[k]] = -1 ;
+            }
+            factor_coarse( A ) ;
+        }
+    }
+
+    void AdditiveSchwarz::factor_coarse( const SparseMatrix& A )
+    {
+        /* A_0 = Z^T A Z with Z the indicators of the parts */
+        const int k = subdomains_.size() ;
+        std::vector< double > A0( k * k, 0. ) ;
+        for( int i = 0; i < A.nb_rows(); ++i ) {
+            if( vertex_part_[i] < 0 ) continue ;
+            const SparseMatrix::Columns& J = A.get_cols_at_line( i ) ;
+            const SparseMatrix::Values& V = A.get_vals_at_line( i ) ;
+            for( int l = 0; l < J.size(); ++l ) {
+                if( vertex_part_[J[l]] < 0 ) continue ;
+                A0[k * vertex_part_[i] + vertex_part_[J[l]]] += V[l] ;
+            }
+        }
+        for( int p = 0; p < k; ++p ) {
+            if( A0[k * p + p] == 0. ) A0[k * p + p] = 1. ;
+        }
+        std::vector< int > first( k, 0 ), offsets( k ) ;
+        for( int p = 0; p < k; ++p ) offsets[p] = p * k ;
+        coarse_L_.swap( A0 ) ;
+        if( !profile_cholesky( first, offsets, coarse_L_ ) ) {
+            std::cout << "Warning: the coarse matrix is not positive definite" << std::endl ;
+        }
+    }
+
+    void AdditiveSchwarz::update( const std::vector< int >& changed_rows )
+    {
+        std::vector< char > changed( subdomains_.size(), 0 ) ;
+        for( int k = 0; k < changed_rows.size(); ++k ) {
+            const int i = changed_rows[k] ;
+            for( int l = subdomain_offsets_[i]; l < subdomain_offsets_[i + 1]; ++l ) {
+                changed[dof_subdomains_[l]] = 1 ;
+            }
+        }
+        std::vector< int > refactored ;
+        for( int s = 0; s < subdomains_.size(); ++s ) {
+            if( changed[s] ) refactored.push_back( s ) ;
+        }
+        pool_.parallel_for( refactored.size(), [&]( int begin, int end ) {
+            for( int r = begin; r < end; ++r ) factor_subdomain( A_, subdomains_[refactored[r]] ) ;
+        } ) ;
+        if( coarse_space_ && !refactored.empty() ) factor_coarse( A_ ) ;
+        nb_updated_subdomains_ = refactored.size() ;
+    }
+
+    int AdditiveSchwarz::nb_updated_subdomains() const
+    {
+        return nb_updated_subdomains_ ;
+    }
+
+    void AdditiveSchwarz::factor_subdomain( const SparseMatrix& A, Subdomain& sub ) const
+    {
+        const int m = sub.dofs.size() ;
+        std::vector< int > local( A.nb_rows(), -1 ) ;
+        for( int k = 0; k < m; ++k ) local[sub.dofs[k]] = k ;
+
+        /* graph of A_s */
+        std::vector< std::vector< int > > adjacency( m ) ;
+        for( int k = 0; k < m; ++k ) {
+            const SparseMatrix::Columns& J = A.get_cols_at_line( sub.dofs[k] ) ;
+            for( int l = 0; l < J.size(); ++l ) {
+                if( local[J[l]] >= 0 && local[J[l]] != k ) adjacency[k].push_back( local[J[l]] ) ;
+            }
+        }
+
+        /* reverse Cuthill-McKee: breadth first search from low degree
+         * vertices, neighbors by increasing degree */
+        std::vector< int > order ;
+        order.reserve( m ) ;
+        std::vector< char > visited( m, 0 ) ;
+        std::vector< int > by_degree( m ) ;
+        for( int k = 0; k < m; ++k ) by_degree[k] = k ;
+        std::stable_sort( by_degree.begin(), by_degree.end(), [&]( int a, int b ) {
+            return adjacency[a].size() < adjacency[b].size() ;
+        } ) ;
+        for( int start = 0; start < m; ++start ) {
+            if( visited[by_degree[start]] ) continue ;
+            int head = order.size() ;
+            order.push_back( by_degree[start] ) ;
+            visited[by_degree[start]] = 1 ;
+            for( ; head < order.size(); ++head ) {
+                std::vector< int > next ;
+                const std::vector< int >& neighbors = adjacency[order[head]] ;
+                for( int l = 0; l < neighbors.size(); ++l ) {
+                    if( !visited[neighbors[l]] ) {
+                        visited[neighbors[l]] = 1 ;
+                        next.push_back( neighbors[l] ) ;
+                    }
+                }
+                std::sort( next.begin(), next.end(), [&]( int a, int b ) {
+                    return adjacency[a].size() < adjacency[b].size() ;
+                } ) ;
+                order.insert( order.end(), next.begin(), next.end() ) ;
+            }
+        }
+        std::reverse( order.begin(), order.end() ) ;
+        std::vector< int > dofs( m ) ;
+        std::vector< int > position( m ) ;
+        for( int k = 0; k < m; ++k ) {
+            dofs[k] = sub.dofs[order[k]] ;
+            position[order[k]] = k ;
+        }
+        for( int k = 0; k < m; ++k ) local[dofs[k]] = k ;
+
+        /* profile of the lower triangle, filled with A_s */
+        sub.first.resize( m ) ;
+        sub.offsets.resize( m + 1 ) ;
+        sub.offsets[0] = 0 ;
+        for( int k = 0; k < m; ++k ) {
+            int first = k ;
+            const int old = order[k] ;
+            for( int l = 0; l < adjacency[old].size(); ++l ) {
+                first = std::min( first, position[adjacency[old][l]] ) ;
+            }
+            sub.first[k] = first ;
+            sub.offsets[k + 1] = sub.offsets[k] + k - first + 1 ;
+        }
+        sub.L.assign( sub.offsets[m], 0. ) ;
+        for( int k = 0; k < m; ++k ) {
+            const SparseMatrix::Columns& J = A.get_cols_at_line( dofs[k] ) ;
+            const SparseMatrix::Values& V = A.get_vals_at_line( dofs[k] ) ;
+            for( int l = 0; l < J.size(); ++l ) {
+                const int j = local[J[l]] ;
+                if( j >= 0 && j <= k ) sub.L[sub.offsets[k] - sub.first[k] + j] += V[l] ;
+            }
+        }
+        sub.dofs.swap( dofs ) ;
+        if( !profile_cholesky( sub.first, sub.offsets, sub.L ) ) {
+            std::cout << "Warning: a subdomain matrix is not positive definite" << std::endl ;
+        }
+    }
+
+    void AdditiveSchwarz::apply( const std::vector< double >& r, std::vector< double >& z ) const
+    {
+        /* the local solutions are scratch of this call: concurrent solves
+         * may share the preconditioner */
+        std::vector< std::vector< double > > x( subdomains_.size() ) ;
+        pool_.parallel_for( subdomains_.size(), [&]( int begin, int end ) {
+            for( int s = begin; s < end; ++s ) {
+                const Subdomain& sub = subdomains_[s] ;
+                x[s].resize( sub.dofs.size() ) ;
+                for( int k = 0; k < sub.dofs.size(); ++k ) x[s][k] = r[sub.dofs[k]] ;
+                profile_solve( sub.first, sub.offsets, sub.L, x[s] ) ;
+            }
+        } ) ;
+
+        z.assign( r.size(), 0. ) ;
+        for( int s = 0; s < subdomains_.size(); ++s ) {
+            const Subdomain& sub = subdomains_[s] ;
+            for( int k = 0; k < sub.dofs.size(); ++k ) z[sub.dofs[k]] += x[s][k] ;
+        }
+
+        if( coarse_space_ ) {
+            const int k = subdomains_.size() ;
+            std::vector< double > c( k, 0. ) ;
+            for( int i = 0; i < r.size(); ++i ) {
+                if( vertex_part_[i] >= 0 ) c[vertex_part_[i]] += r[i] ;
+            }
+            std::vector< int > first( k, 0 ), offsets( k ) ;
+            for( int p = 0; p < k; ++p ) offsets[p] = p * k ;
+            profile_solve( first, offsets, coarse_L_, c ) ;
+            for( int i = 0; i < r.size(); ++i ) {
+                if( vertex_part_[i] >= 0 ) z[i] += c[vertex_part_[i]] ;
+            }
+        }
+    }
+
+    int AdditiveSchwarz::nb_subdomains() const
+    {
+        return subdomains_.size() ;
+    }
+
+    int AdditiveSchwarz::subdomain_size( int s ) const
+    {
+        return subdomains_[s].dofs.size() ;
+    }
+
+    size_t AdditiveSchwarz::factor_size() const
+    {
+        size_t size = coarse_L_.size() ;
+        for( int s = 0; s < subdomains_.size(); ++s ) size += subdomains_[s].L.size() ;
+        return size ;
+    }
+
+}
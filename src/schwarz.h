@@ -0,0 +1,94 @@
+#pragma once
+
+#include "solver.h"
+#include "parallel.h"
+
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief AdditiveSchwarz is the overlapping domain decomposition
+     *        preconditioner
+     *
+     *        P^{-1} = sum_s R_s^T A_s^{-1} R_s  [ + Z A_0^{-1} Z^T ]
+     *
+     * Subdomain s holds the unknowns of part s (see vertex_partition)
+     * extended by overlap layers of neighbors in the graph of A. Each A_s
+     * is factored once (Cholesky of its profile after a reverse
+     * Cuthill-McKee ordering); apply() solves the subdomains concurrently
+     * on a ThreadPool and sums their corrections in a fixed order.
+     *
+     * The optional coarse space has one vector per part, the indicator of
+     * its unknowns (Nicolaides) except the Dirichlet rows, and couples the
+     * subdomains globally, which helps the parts that do not touch a
+     * Dirichlet border. A has to be symmetric positive definite.
+     */
+    class AdditiveSchwarz : public LinearPreconditioner {
+        public:
+            /**
+             * \param A The matrix to precondition, must outlive the
+             *        preconditioner
+             * \param vertex_part The part of each unknown, in [0, nb_parts)
+             * \param overlap Number of layers added around each part
+             * \param coarse_space Adds the coarse correction if true
+             * \param dirichlet_rows The unknowns fixed by a Dirichlet
+             *        penalty (see dirichlet_vertices), left out of
+             *        the coarse space where the penalty would dominate A_0
+             * \param pool The threads solving the subdomains
+             */
+            AdditiveSchwarz(
+                const SparseMatrix& A,
+                const std::vector< int >& vertex_part,
+                int nb_parts,
+                int overlap,
+                bool coarse_space,
+                const std::vector< int >& dirichlet_rows,
+                ThreadPool& pool = ThreadPool::global() ) ;
+
+            void apply( const std::vector< double >& r, std::vector< double >& z ) const ;
+
+            /**
+             * \brief Factors again the subdomains containing one of the
+             *        changed_rows (and the coarse matrix, assembled from
+             *        the whole A) after A has been modified in place. The
+             *        partition and the Dirichlet rows must not change.
+             */
+            void update( const std::vector< int >& changed_rows ) ;
+
+            /* number of subdomains factored again by the last update() */
+            int nb_updated_subdomains() const ;
+
+            int nb_subdomains() const ;
+            int subdomain_size( int s ) const ;
+
+            /**
+             * \return the number of coefficients stored by the factors
+             */
+            size_t factor_size() const ;
+
+        private:
+            struct Subdomain {
+                std::vector< int > dofs ;     /* global unknown of each local one */
+                std::vector< int > first ;    /* first column of each row of L */
+                std::vector< int > offsets ;  /* row i of L: L[offsets[i] - first[i] + j] */
+                std::vector< double > L ;
+            } ;
+
+            void factor_subdomain( const SparseMatrix& A, Subdomain& sub ) const ;
+            void factor_coarse( const SparseMatrix& A ) ;
+
+            const SparseMatrix& A_ ;
+            ThreadPool& pool_ ;
+            std::vector< Subdomain > subdomains_ ;
+            /* subdomains containing unknown i:
+             * dof_subdomains_[subdomain_offsets_[i] .. subdomain_offsets_[i + 1]) */
+            std::vector< int > subdomain_offsets_ ;
+            std::vector< int > dof_subdomains_ ;
+            std::vector< int > vertex_part_ ; /* -1: not in the coarse space */
+            bool coarse_space_ ;
+            int nb_updated_subdomains_ ;
+            std::vector< double > coarse_L_ ; /* dense Cholesky of A_0 */
+    } ;
+
+}
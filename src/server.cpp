@@ -0,0 +1,432 @@
+#include "server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace FEM2A {
+
+    static bool read_file( const std::string& filename, std::string& content )
+    {
+        std::ifstream in( filename.c_str(), std::ios::binary ) ;
+        if( !in ) return false ;
+        std::ostringstream buffer ;
+        buffer << in.rdbuf() ;
+        content = buffer.str() ;
+        return true ;
+    }
+
+    /****************************************************************/
+    /* Implementation of JobDescription and JobResult */
+    /****************************************************************/
+    JobDescription::JobDescription()
+        : source( 0. ), tolerance( 0. )
+    {
+    }
+
+    static bool parse_double( const std::string& text, double& value )
+    {
+        char* end = NULL ;
+        value = strtod( text.c_str(), &end ) ;
+        return !text.empty() && *end == '\0' ;
+    }
+
+    /* "<attribute>:<value>" */
+    static bool parse_attribute_value( const std::string& text, std::pair< int, double >& result )
+    {
+        const size_t colon = text.find( ':' ) ;
+        if( colon == std::string::npos || colon == 0 ) return false ;
+        char* end = NULL ;
+        const long attribute = strtol( text.c_str(), &end, 10 ) ;
+        if( end != text.c_str() + colon || attribute < 0 ) return false ;
+        result.first = attribute ;
+        return parse_double( text.substr( colon + 1 ), result.second ) ;
+    }
+
+    bool JobDescription::parse( const std::string& line, std::string& error )
+    {
+        *this = JobDescription() ;
+        std::istringstream tokens( line ) ;
+        std::string token ;
+        while( tokens >> token ) {
+            const size_t equal = token.find( '=' ) ;
+            const std::string key = token.substr( 0, equal ) ;
+            const std::string value = equal == std::string::npos ? "" : token.substr( equal + 1 ) ;
+            std::pair< int, double > attribute_value ;
+            bool valid = true ;
+            if( key == "mesh" ) {
+                mesh = value ;
+            } else if( key == "k" ) {
+                valid = parse_attribute_value( value, attribute_value ) ;
+                diffusion.push_back( attribute_value ) ;
+            } else if( key == "f" ) {
+                valid = parse_double( value, source ) ;
+            } else if( key == "g" ) {
+                valid = parse_attribute_value( value, attribute_value ) ;
+                dirichlet.push_back( attribute_value ) ;
+            } else if( key == "tol" ) {
+                valid = parse_double( value, tolerance ) && tolerance >= 0. ;
+            } else if( key == "out" ) {
+                output = value ;
+            } else {
+                error = "unknown key " + key ;
+                return false ;
+            }
+            if( !valid ) {
+                error = "invalid value in " + token ;
+                return false ;
+            }
+        }
+        if( mesh.empty() ) {
+            error = "no mesh" ;
+            return false ;
+        }
+        std::sort( diffusion.begin(), diffusion.end() ) ;
+        std::sort( dirichlet.begin(), dirichlet.end() ) ;
+        return true ;
+    }
+
+    JobResult::JobResult()
+        : ok( false ), iterations( 0 ), residual( 0. ), seconds( 0. ),
+        mesh_cached( false ), system_cached( false )
+    {
+    }
+
+    std::string JobResult::to_string() const
+    {
+        std::ostringstream out ;
+        if( !ok ) {
+            out << "error " << error ;
+            return out.str() ;
+        }
+        out << "ok iterations=" << iterations << " residual=" << residual
+            << " seconds=" << seconds
+            << " mesh=" << ( mesh_cached ? "hit" : "miss" )
+            << " system=" << ( system_cached ? "hit" : "miss" ) ;
+        return out.str() ;
+    }
+
+    /****************************************************************/
+    /* Implementation of JobRunner */
+    /****************************************************************/
+    JobRunner::JobRunner( int max_meshes, int max_systems )
+        : meshes_( max_meshes ), systems_( max_systems ), system_cache_( NULL ), nb_jobs_( 0 )
+    {
+    }
+
+    void JobRunner::set_system_cache( SystemCache* cache )
+    {
+        system_cache_ = cache ;
+    }
+
+    JobResult JobRunner::run( const JobDescription& job, std::vector< double >* solution )
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+        ++nb_jobs_ ;
+        JobResult result ;
+
+        /* the content, not the path, identifies the mesh */
+        std::string content ;
+        if( !read_file( job.mesh, content ) ) {
+            result.error = "cannot read " + job.mesh ;
+            return result ;
+        }
+        const uint64_t hash = content_hash( content.data(), content.size() ) ;
+        std::shared_ptr< MeshEntry > mesh = meshes_.find( hash ) ;
+        result.mesh_cached = (bool)mesh ;
+        if( !mesh ) {
+            std::shared_ptr< MeshEntry > loaded( new MeshEntry ) ;
+            if( !loaded->mesh.load( job.mesh ) || loaded->mesh.nb_vertices() == 0 ) {
+                result.error = "invalid mesh " + job.mesh ;
+                return result ;
+            }
+            mesh = meshes_.insert( hash, loaded ) ;
+        }
+
+        /* everything that changes the matrix or its preconditioner */
+        std::ostringstream key ;
+        key.precision( 17 ) ;
+        key << std::hex << hash << std::dec << " tol=" << job.tolerance << " k=" ;
+        for( int i = 0; i < job.diffusion.size(); ++i ) {
+            key << job.diffusion[i].first << ":" << job.diffusion[i].second << "," ;
+        }
+        key << " g=" ;
+        for( int i = 0; i < job.dirichlet.size(); ++i ) key << job.dirichlet[i].first << "," ;
+
+        std::shared_ptr< SystemEntry > system = systems_.find( key.str() ) ;
+        result.system_cached = (bool)system ;
+        if( !system ) {
+            std::shared_ptr< SystemEntry > created( new SystemEntry ) ;
+            created->mesh = mesh ;
+            created->problem.reset( new PoissonProblem( mesh->mesh ) ) ;
+            for( int i = 0; i < job.diffusion.size(); ++i ) {
+                created->problem->set_diffusion( job.diffusion[i].first, job.diffusion[i].second ) ;
+            }
+            if( job.tolerance > 0. ) {
+                SolverConfig config = created->problem->solver_config() ;
+                config.threshold = job.tolerance ;
+                created->problem->set_solver_config( config ) ;
+            }
+            if( system_cache_ != NULL ) {
+                /* the file also holds the right hand side of this job */
+                std::ostringstream coefficients ;
+                coefficients.precision( 17 ) ;
+                coefficients << "k=" ;
+                for( int i = 0; i < job.diffusion.size(); ++i ) {
+                    coefficients << job.diffusion[i].first << ":" << job.diffusion[i].second << "," ;
+                }
+                coefficients << " f=" << job.source << " g=" ;
+                for( int i = 0; i < job.dirichlet.size(); ++i ) {
+                    coefficients << job.dirichlet[i].first << ":" << job.dirichlet[i].second << "," ;
+                }
+                created->problem->set_system_cache( system_cache_, coefficients.str() ) ;
+            }
+            {
+                std::lock_guard< std::mutex > lock( mesh->mutex ) ;
+                if( mesh->pattern ) created->problem->use_pattern( *mesh->pattern ) ;
+            }
+            system = systems_.insert( key.str(), created ) ;
+        }
+
+        std::vector< double > u ;
+        {
+            std::lock_guard< std::mutex > lock( system->mutex ) ;
+            PoissonProblem& problem = *system->problem ;
+            const double f = job.source ;
+            if( f != 0. ) problem.set_source( [f]( vertex ) { return f ; } ) ;
+            else problem.set_source( ScalarField() ) ;
+            for( int i = 0; i < job.dirichlet.size(); ++i ) {
+                const double g = job.dirichlet[i].second ;
+                problem.set_dirichlet( job.dirichlet[i].first, [g]( vertex ) { return g ; } ) ;
+            }
+            const bool converged = problem.solve() ;
+            result.iterations = problem.iterations() ;
+            result.residual = problem.residual() ;
+            if( !converged ) {
+                result.error = "the solver did not converge" ;
+                return result ;
+            }
+            if( solution != NULL || !job.output.empty() ) {
+                u.assign( problem.solution(), problem.solution() + problem.size() ) ;
+            }
+            std::lock_guard< std::mutex > pattern_lock( mesh->mutex ) ;
+            if( !mesh->pattern && !problem.system_from_cache() ) mesh->pattern.reset( new SparseMatrix( problem.matrix() ) ) ;
+        }
+
+        if( !job.output.empty() ) save_solution( u, job.output ) ;
+        if( solution != NULL ) solution->swap( u ) ;
+        result.ok = true ;
+        result.seconds = std::chrono::duration< double >(
+            std::chrono::steady_clock::now() - start ).count() ;
+        return result ;
+    }
+
+    std::string JobRunner::statistics() const
+    {
+        std::ostringstream out ;
+        out << "meshes=" << meshes_.size() << "/" << meshes_.nb_hits() << "/" << meshes_.nb_misses()
+            << " systems=" << systems_.size() << "/" << systems_.nb_hits() << "/" << systems_.nb_misses()
+            << " jobs=" << nb_jobs_ ;
+        if( system_cache_ != NULL ) {
+            out << " disk=" << system_cache_->nb_hits() << "/" << system_cache_->nb_misses()
+                << "/" << system_cache_->nb_rejected() ;
+        }
+        return out.str() ;
+    }
+
+    /****************************************************************/
+    /* Implementation of SolverServer */
+    /****************************************************************/
+    static bool socket_address( const std::string& path, sockaddr_un& address )
+    {
+        memset( &address, 0, sizeof( address ) ) ;
+        address.sun_family = AF_UNIX ;
+        if( path.size() >= sizeof( address.sun_path ) ) return false ;
+        strcpy( address.sun_path, path.c_str() ) ;
+        return true ;
+    }
+
+    static bool send_all( int fd, const std::string& data )
+    {
+        size_t sent = 0 ;
+        while( sent < data.size() ) {
+            const ssize_t n = send( fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL ) ;
+            if( n < 0 && errno == EINTR ) continue ;
+            if( n <= 0 ) return false ;
+            sent += n ;
+        }
+        return true ;
+    }
+
+    SolverServer::SolverServer( JobRunner& runner, int nb_workers )
+        : runner_( runner ),
+        nb_workers_( nb_workers > 0 ? nb_workers : std::max( 1u, std::thread::hardware_concurrency() ) ),
+        listen_fd_( -1 ), stopping_( false ), connections_( 64 )
+    {
+    }
+
+    SolverServer::~SolverServer()
+    {
+        stop() ;
+        wait() ;
+    }
+
+    int SolverServer::nb_workers() const
+    {
+        return nb_workers_ ;
+    }
+
+    bool SolverServer::listen( const std::string& socket_path )
+    {
+        sockaddr_un address ;
+        if( listen_fd_ >= 0 || !socket_address( socket_path, address ) ) return false ;
+        listen_fd_ = socket( AF_UNIX, SOCK_STREAM, 0 ) ;
+        if( listen_fd_ < 0 ) return false ;
+        unlink( socket_path.c_str() ) ;
+        if( bind( listen_fd_, (sockaddr*)&address, sizeof( address ) ) != 0
+            || ::listen( listen_fd_, 64 ) != 0 ) {
+            close( listen_fd_ ) ;
+            listen_fd_ = -1 ;
+            return false ;
+        }
+        socket_path_ = socket_path ;
+        for( int w = 0; w < nb_workers_; ++w ) {
+            workers_.push_back( std::thread( &SolverServer::worker_loop, this ) ) ;
+        }
+        acceptor_ = std::thread( &SolverServer::accept_loop, this ) ;
+        return true ;
+    }
+
+    void SolverServer::stop()
+    {
+        if( stopping_.exchange( true ) ) return ;
+        /* wakes up accept() and the reads of the open connections */
+        if( listen_fd_ >= 0 ) shutdown( listen_fd_, SHUT_RDWR ) ;
+        connections_.close() ;
+        std::lock_guard< std::mutex > lock( clients_mutex_ ) ;
+        for( std::set< int >::iterator it = clients_.begin(); it != clients_.end(); ++it ) {
+            shutdown( *it, SHUT_RDWR ) ;
+        }
+    }
+
+    void SolverServer::wait()
+    {
+        if( acceptor_.joinable() ) acceptor_.join() ;
+        for( int w = 0; w < workers_.size(); ++w ) {
+            if( workers_[w].joinable() ) workers_[w].join() ;
+        }
+        workers_.clear() ;
+        if( listen_fd_ >= 0 ) {
+            close( listen_fd_ ) ;
+            listen_fd_ = -1 ;
+            unlink( socket_path_.c_str() ) ;
+        }
+    }
+
+    void SolverServer::accept_loop()
+    {
+        while( !stopping_ ) {
+            int client = accept( listen_fd_, NULL, NULL ) ;
+            if( client < 0 ) {
+                if( errno == EINTR || errno == ECONNABORTED ) continue ;
+                break ;
+            }
+            if( !connections_.push( client ) ) close( client ) ;
+        }
+        connections_.close() ;
+    }
+
+    void SolverServer::worker_loop()
+    {
+        int client ;
+        while( connections_.pop( client ) ) {
+            {
+                std::lock_guard< std::mutex > lock( clients_mutex_ ) ;
+                if( stopping_ ) {
+                    close( client ) ;
+                    continue ;
+                }
+                clients_.insert( client ) ;
+            }
+            serve( client ) ;
+            std::lock_guard< std::mutex > lock( clients_mutex_ ) ;
+            clients_.erase( client ) ;
+            close( client ) ;
+        }
+    }
+
+    void SolverServer::serve( int client )
+    {
+        std::string pending ;
+        char buffer[4096] ;
+        while( true ) {
+            const ssize_t n = recv( client, buffer, sizeof( buffer ), 0 ) ;
+            if( n < 0 && errno == EINTR ) continue ;
+            if( n <= 0 ) return ;
+            pending.append( buffer, n ) ;
+            size_t end ;
+            while( ( end = pending.find( '\n' ) ) != std::string::npos ) {
+                const std::string line = pending.substr( 0, end ) ;
+                pending.erase( 0, end + 1 ) ;
+                if( line == "shutdown" ) {
+                    /* answered before stop() closes the connections */
+                    send_all( client, "ok\n" ) ;
+                    stop() ;
+                    return ;
+                }
+                if( !send_all( client, answer( line ) + "\n" ) ) return ;
+            }
+        }
+    }
+
+    std::string SolverServer::answer( const std::string& line )
+    {
+        if( line == "stats" ) return runner_.statistics() ;
+        JobDescription job ;
+        std::string error ;
+        if( !job.parse( line, error ) ) return "error " + error ;
+        return runner_.run( job ).to_string() ;
+    }
+
+    bool submit_jobs( const std::string& socket_path,
+        const std::vector< std::string >& lines, std::vector< std::string >& answers )
+    {
+        answers.clear() ;
+        sockaddr_un address ;
+        if( !socket_address( socket_path, address ) ) return false ;
+        const int fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ;
+        if( fd < 0 ) return false ;
+        if( connect( fd, (sockaddr*)&address, sizeof( address ) ) != 0 ) {
+            close( fd ) ;
+            return false ;
+        }
+        std::string request ;
+        for( int i = 0; i < lines.size(); ++i ) request += lines[i] + "\n" ;
+        bool ok = send_all( fd, request ) ;
+        std::string pending ;
+        char buffer[4096] ;
+        while( ok && answers.size() < lines.size() ) {
+            const ssize_t n = recv( fd, buffer, sizeof( buffer ), 0 ) ;
+            if( n < 0 && errno == EINTR ) continue ;
+            if( n <= 0 ) break ;
+            pending.append( buffer, n ) ;
+            size_t end ;
+            while( ( end = pending.find( '\n' ) ) != std::string::npos ) {
+                answers.push_back( pending.substr( 0, end ) ) ;
+                pending.erase( 0, end + 1 ) ;
+            }
+        }
+        close( fd ) ;
+        return ok && answers.size() == lines.size() ;
+    }
+
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "mesh.h"
+#include "problem.h"
+#include "parallel.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief LruCache keeps at most capacity values, dropping the least
+     *        recently used one. The values are shared: an evicted value
+     *        stays alive as long as a job uses it. Thread safe.
+     */
+    template< class Key, class Value >
+    class LruCache {
+        public:
+            explicit LruCache( int capacity )
+                : capacity_( capacity > 0 ? capacity : 1 ), nb_hits_( 0 ), nb_misses_( 0 )
+            {
+            }
+
+            /* the value of key (now the most recent one), NULL if absent */
+            std::shared_ptr< Value > find( const Key& key )
+            {
+                std::lock_guard< std::mutex > lock( mutex_ ) ;
+                typename std::map< Key, typename List::iterator >::iterator it = positions_.find( key ) ;
+                if( it == positions_.end() ) {
+                    ++nb_misses_ ;
+                    return std::shared_ptr< Value >() ;
+                }
+                ++nb_hits_ ;
+                entries_.splice( entries_.begin(), entries_, it->second ) ;
+                return it->second->second ;
+            }
+
+            /**
+             * \brief Adds value for key, unless another thread already did:
+             *        returns the value kept in the cache.
+             */
+            std::shared_ptr< Value > insert( const Key& key, const std::shared_ptr< Value >& value )
+            {
+                std::lock_guard< std::mutex > lock( mutex_ ) ;
+                typename std::map< Key, typename List::iterator >::iterator it = positions_.find( key ) ;
+                if( it != positions_.end() ) return it->second->second ;
+                entries_.push_front( std::make_pair( key, value ) ) ;
+                positions_[key] = entries_.begin() ;
+                if( entries_.size() > capacity_ ) {
+                    positions_.erase( entries_.back().first ) ;
+                    entries_.pop_back() ;
+                }
+                return value ;
+            }
+
+            int size() const
+            {
+                std::lock_guard< std::mutex > lock( mutex_ ) ;
+                return entries_.size() ;
+            }
+            long nb_hits() const { return nb_hits_ ; }
+            long nb_misses() const { return nb_misses_ ; }
+
+        private:
+            typedef std::list< std::pair< Key, std::shared_ptr< Value > > > List ;
+
+            LruCache( const LruCache& ) ;
+            LruCache& operator=( const LruCache& ) ;
+
+            mutable std::mutex mutex_ ;
+            List entries_ ;  /* most recent first */
+            std::map< Key, typename List::iterator > positions_ ;
+            size_t capacity_ ;
+            std::atomic< long > nb_hits_ ;
+            std::atomic< long > nb_misses_ ;
+    } ;
+
+    /**
+     * \brief A job of the solver daemon, one line of text:
+     *
+     *   mesh=<file> [k=<attribute>:<value>]... [f=<value>]
+     *   [g=<edge attribute>:<value>]... [tol=<value>] [out=<file.bb>]
+     *
+     * for -div(k grad u) = f, u = g on the edges of the given attributes
+     * (constant values, k = 1 on the attributes not given).
+     */
+    struct JobDescription {
+        JobDescription() ;
+
+        /* false, with a message in error, if the line is not a valid job */
+        bool parse( const std::string& line, std::string& error ) ;
+
+        std::string mesh ;
+        std::vector< std::pair< int, double > > diffusion ;
+        double source ;
+        std::vector< std::pair< int, double > > dirichlet ;
+        double tolerance ;  /* 0: default threshold of PoissonProblem */
+        std::string output ;
+    } ;
+
+    struct JobResult {
+        JobResult() ;
+
+        /* "ok iterations=... seconds=... mesh=hit|miss system=hit|miss" or "error <message>" */
+        std::string to_string() const ;
+
+        bool ok ;
+        std::string error ;
+        int iterations ;
+        double residual ;
+        double seconds ;
+        bool mesh_cached ;
+        bool system_cached ;
+    } ;
+
+    /**
+     * \brief JobRunner solves jobs with two levels of cache:
+     *        - the meshes, keyed by the hash of the file content (the file
+     *          is read at each job, but parsed only once), with the
+     *          sparsity pattern of their matrix;
+     *        - the assembled systems (matrix with its Dirichlet penalties
+     *          and Jacobi preconditioner), keyed by mesh, diffusion
+     *          coefficients, Dirichlet attributes and tolerance.
+     *        A job on a cached system only assembles its right hand side
+     *        and starts from the previous solution of that system.
+     *
+     * run() may be called from several threads; the jobs on a same system
+     * are serialized.
+     */
+    class JobRunner {
+        public:
+            JobRunner( int max_meshes = 8, int max_systems = 16 ) ;
+
+            /* solution, if not NULL, receives the solution of the job */
+            JobResult run( const JobDescription& job, std::vector< double >* solution = NULL ) ;
+
+            /**
+             * \brief Systems missing from the memory cache are looked up
+             *        in cache (on disk, shared by the runs) before being
+             *        assembled. cache must outlive the runner.
+             */
+            void set_system_cache( SystemCache* cache ) ;
+
+            /* "meshes=n/hits/misses systems=n/hits/misses jobs=n [disk=hits/misses/rejected]" */
+            std::string statistics() const ;
+
+        private:
+            struct MeshEntry {
+                Mesh mesh ;
+                std::mutex mutex ;
+                std::unique_ptr< SparseMatrix > pattern ;
+            } ;
+
+            struct SystemEntry {
+                std::shared_ptr< MeshEntry > mesh ;
+                std::unique_ptr< PoissonProblem > problem ;
+                std::mutex mutex ;
+            } ;
+
+            LruCache< uint64_t, MeshEntry > meshes_ ;
+            LruCache< std::string, SystemEntry > systems_ ;
+            SystemCache* system_cache_ ;
+            std::atomic< long > nb_jobs_ ;
+    } ;
+
+    /**
+     * \brief SolverServer is the daemon of `fem2a --serve`: it listens on
+     *        a Unix domain socket and solves the jobs received, one line
+     *        each, answered by one line (JobResult::to_string). The
+     *        connections are served by a pool of workers sharing the
+     *        caches of a JobRunner. Two more commands: "stats" answers
+     *        JobRunner::statistics(), "shutdown" stops the server.
+     */
+    class SolverServer {
+        public:
+            /**
+             * \param nb_workers Number of connections served concurrently,
+             *        0 for one per core
+             */
+            SolverServer( JobRunner& runner, int nb_workers = 0 ) ;
+            ~SolverServer() ;
+
+            /* binds the socket (replacing a stale one) and starts serving */
+            bool listen( const std::string& socket_path ) ;
+
+            /* returns once stopped (stop() or a "shutdown" command) */
+            void wait() ;
+
+            void stop() ;
+
+            int nb_workers() const ;
+
+        private:
+            SolverServer( const SolverServer& ) ;
+            SolverServer& operator=( const SolverServer& ) ;
+
+            void accept_loop() ;
+            void worker_loop() ;
+            void serve( int client ) ;
+            std::string answer( const std::string& line ) ;
+
+            JobRunner& runner_ ;
+            int nb_workers_ ;
+            std::string socket_path_ ;
+            int listen_fd_ ;
+            std::atomic< bool > stopping_ ;
+            BoundedQueue< int > connections_ ;
+            std::thread acceptor_ ;
+            std::vector< std::thread > workers_ ;
+            std::mutex clients_mutex_ ;
+            std::set< int > clients_ ;
+    } ;
+
+    /**
+     * \brief Client side: sends the lines on one connection to the server
+     *        listening at socket_path and collects the answers.
+     * \return false if the server cannot be reached
+     */
+    bool submit_jobs( const std::string& socket_path,
+        const std::vector< std::string >& lines, std::vector< std::string >& answers ) ;
+
+}
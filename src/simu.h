@@ -2,9 +2,15 @@
 
 #include "mesh.h"
 #include "fem.h"
+#include "transient.h"
+#include "sweep.h"
+#include "vtu.h"
+#include "async_writer.h"
 #include <math.h>
 #include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 namespace FEM2A {
     namespace Simu {
@@ -34,11 +40,35 @@ namespace FEM2A {
         	return 2*(pi*pi)*sin(pi*v.x)*sin(pi*v.y);
         }
 
+        double geothermie_diffusion_fct( vertex v )
+        {
+            /* insulating superficial layer above a conductive deep layer */
+            return v.y > 10. ? 0.01 : 1.;
+        }
+
+        double geothermie_source_fct( vertex v )
+        {
+            return v.y > 10. ? 0. : 1.;
+        }
+
+        double geothermie_surface_fct( vertex v )
+        {
+            return v.y - 19.999;
+        }
+
+        /* "data/square_fine.mesh" -> "square_fine", used to name outputs */
+        std::string mesh_basename( const std::string& mesh_filename )
+        {
+            std::string name = mesh_filename.substr( mesh_filename.find_last_of( "/\\" ) + 1 );
+            return name.substr( 0, name.find_last_of( '.' ) );
+        }
+
         //#################################
         //  Simulations
         //#################################
 
-        void pure_dirichlet_pb( const std::string& mesh_filename, bool verbose )
+        void pure_dirichlet_pb( const std::string& mesh_filename, bool verbose,
+            const SolverConfig& solver_config = SolverConfig() )
         {
             std::cout << "Solving a pure Dirichlet problem" << std::endl;
             
@@ -68,8 +98,10 @@ namespace FEM2A {
             
             apply_dirichlet_boundary_conditions(mesh, attribute_dirichlet, imposed_v, K_globale, F_globale);
             std::vector<double> u(mesh.nb_vertices());
-            solve(K_globale, F_globale, u);
-            std::string export_name = "square_pure_dirichlet";
+            SolverConfig config = solver_config;
+            config.adapt_to_mesh(mesh);
+            solve(K_globale, F_globale, u, config);
+            std::string export_name = mesh_basename(mesh_filename) + "_pure_dirichlet";
             mesh.save(export_name+".mesh");
             save_solution(u, export_name +".bb");
             
@@ -80,7 +112,8 @@ namespace FEM2A {
         }
         
         
-        void source_dirichlet_pb( const std::string& mesh_filename, bool verbose )
+        void source_dirichlet_pb( const std::string& mesh_filename, bool verbose,
+            const SolverConfig& solver_config = SolverConfig() )
         {
             std::cout << "Solving a pure Dirichlet problem" << std::endl;
             
@@ -99,7 +132,7 @@ namespace FEM2A {
             	assemble_elementary_matrix(mapping, shapefunctions, quadrature, unit_fct, Ke);
             	assemble_elementary_vector(mapping, shapefunctions, quadrature, unit_fct, Fe);
             	local_to_global_matrix(mesh, a, Ke, K_globale);
-            	local_to_global_vector(mesh, true, a, Fe, F_globale);
+            	local_to_global_vector(mesh, false, a, Fe, F_globale);
             }
             
             std::vector< bool > attribute_dirichlet(2, false);
@@ -113,8 +146,10 @@ namespace FEM2A {
             
             apply_dirichlet_boundary_conditions(mesh, attribute_dirichlet, imposed_v, K_globale, F_globale);
             std::vector<double> u(mesh.nb_vertices());
-            solve(K_globale, F_globale, u);
-            std::string export_name = "square_fine_source_dirichlet";
+            SolverConfig config = solver_config;
+            config.adapt_to_mesh(mesh);
+            solve(K_globale, F_globale, u, config);
+            std::string export_name = mesh_basename(mesh_filename) + "_source_dirichlet";
             mesh.save(export_name+".mesh");
             save_solution(u, export_name +".bb");
             
@@ -124,7 +159,8 @@ namespace FEM2A {
             
         }
         
-        void sinus_dirichlet_pb( const std::string& mesh_filename, bool verbose )
+        void sinus_dirichlet_pb( const std::string& mesh_filename, bool verbose,
+            const SolverConfig& solver_config = SolverConfig() )
         {
             std::cout << "Solving a pure Dirichlet problem" << std::endl;
             
@@ -143,7 +179,7 @@ namespace FEM2A {
             	assemble_elementary_matrix(mapping, shapefunctions, quadrature, unit_fct, Ke);
             	assemble_elementary_vector(mapping, shapefunctions, quadrature, sinus_fct, Fe);
             	local_to_global_matrix(mesh, a, Ke, K_globale);
-            	local_to_global_vector(mesh, true, a, Fe, F_globale);
+            	local_to_global_vector(mesh, false, a, Fe, F_globale);
             }
             
             std::vector< bool > attribute_dirichlet(2, false);
@@ -157,8 +193,10 @@ namespace FEM2A {
             
             apply_dirichlet_boundary_conditions(mesh, attribute_dirichlet, imposed_v, K_globale, F_globale);
             std::vector<double> u(mesh.nb_vertices());
-            solve(K_globale, F_globale, u);
-            std::string export_name = "square_fine_sinus_bump_dirichlet";
+            SolverConfig config = solver_config;
+            config.adapt_to_mesh(mesh);
+            solve(K_globale, F_globale, u, config);
+            std::string export_name = mesh_basename(mesh_filename) + "_sinus_bump_dirichlet";
             mesh.save(export_name+".mesh");
             save_solution(u, export_name +".bb");
             
@@ -169,6 +207,166 @@ namespace FEM2A {
         }
         
 
+        void geothermie_transient_pb( const std::string& mesh_filename, bool verbose,
+            const SolverConfig& solver_config = SolverConfig(), bool vtu_output = false )
+        {
+            std::cout << "Solving a transient geothermal problem" << std::endl;
+
+            Mesh mesh;
+            mesh.load(mesh_filename);
+
+            /* u = 0 at the surface, no flux through the other borders */
+            mesh.set_attribute(unit_fct, 0, true);
+            mesh.set_attribute(geothermie_surface_fct, 1, true);
+            std::vector< bool > attribute_dirichlet(2, false);
+            attribute_dirichlet[1] = true;
+
+            const double theta = 1.;
+            const double dt = 1.;
+            const int nb_steps = 100;
+            SolverConfig config = solver_config;
+            config.verbose = false;
+            if ( config.preconditioner == SolverConfig::NONE ) {
+                config.preconditioner = SolverConfig::JACOBI;
+            }
+            config.adapt_to_mesh(mesh);
+
+            ImplicitHeatSolver heat(mesh, geothermie_diffusion_fct, geothermie_source_fct,
+                attribute_dirichlet, zero_fct, theta, dt, config);
+
+            /* time series: one .vtu every output_period steps, written
+             * by a background thread while the next steps are computed */
+            std::string export_name = mesh_basename(mesh_filename) + "_transient";
+            const int output_period = 10;
+            AsyncWriter writer(mesh, AsyncWriter::VTU_COMPRESSED);
+            writer.set_gradient(true);
+            writer.set_series(export_name + ".pvd");
+
+            double total_solve = 0.;
+            double total_rhs = 0.;
+            int total_iterations = 0;
+            for ( int n = 0; n < nb_steps; ++n ) {
+                if ( !heat.step() ) {
+                    std::cout << "Failure at step " << n + 1 << std::endl;
+                    break;
+                }
+                const StepReport& report = heat.last_report();
+                total_solve += report.solve_time;
+                total_rhs += report.rhs_time;
+                total_iterations += report.iterations;
+                if ( vtu_output && ( n + 1 ) % output_period == 0 ) {
+                    std::ostringstream vtu_name;
+                    vtu_name << export_name << "_" << std::setw(4) << std::setfill('0') << n + 1;
+                    std::vector< double > u = heat.solution();
+                    writer.write(std::move(u), vtu_name.str(), report.time);
+                }
+                if ( verbose ) {
+                    std::cout << "step " << report.step << " t = " << report.time
+                        << " : " << report.iterations << " iterations, "
+                        << report.rhs_time + report.solve_time << " s" << std::endl;
+                }
+            }
+            std::cout << "assembly " << heat.assembly_time() << " s, "
+                << nb_steps << " steps: rhs " << total_rhs << " s, solve "
+                << total_solve << " s, " << total_iterations << " iterations" << std::endl;
+            if ( vtu_output ) {
+                const bool written = writer.flush();
+                std::cout << "vtu output: " << writer.nb_written() << " files in "
+                    << writer.io_time() << " s in the background, compute blocked "
+                    << writer.blocked_time() << " s" << ( written ? "" : " (write failure)" ) << std::endl;
+            }
+
+            mesh.save(export_name+".mesh");
+            save_solution(heat.solution(), export_name +".bb");
+        }
+
+        void geothermie_explicit_pb( const std::string& mesh_filename, bool verbose )
+        {
+            std::cout << "Solving a transient geothermal problem with an explicit scheme" << std::endl;
+
+            Mesh mesh;
+            mesh.load(mesh_filename);
+
+            mesh.set_attribute(unit_fct, 0, true);
+            mesh.set_attribute(geothermie_surface_fct, 1, true);
+            std::vector< bool > attribute_dirichlet(2, false);
+            attribute_dirichlet[1] = true;
+
+            ExplicitHeatSolver heat(mesh, geothermie_diffusion_fct, geothermie_source_fct,
+                attribute_dirichlet, zero_fct, ExplicitHeatSolver::RK2);
+            const double final_time = 1.;
+            const int nb_steps = (int)std::ceil( final_time / heat.time_step() );
+            heat.set_time_step( final_time / nb_steps );
+            double total = 0.;
+            for ( int n = 0; n < nb_steps; ++n ) {
+                heat.step();
+                total += heat.last_report().solve_time;
+            }
+            std::cout << "stable dt " << heat.stable_time_step() << ", " << nb_steps
+                << " steps of " << heat.time_step() << " in " << total << " s ("
+                << total / nb_steps << " s per step)" << std::endl;
+            if ( verbose ) {
+                std::cout << "final time " << heat.time() << std::endl;
+            }
+
+            std::string export_name = mesh_basename(mesh_filename) + "_explicit";
+            mesh.save(export_name+".mesh");
+            save_solution(heat.solution(), export_name +".bb");
+        }
+
+
+        void sinus_sweep_pb( const std::string& mesh_filename, bool verbose,
+            const SolverConfig& solver_config = SolverConfig() )
+        {
+            std::cout << "Solving a sweep of sinus bump problems" << std::endl;
+
+            Mesh mesh;
+            mesh.load(mesh_filename);
+            mesh.set_attribute(unit_fct, 1, true);
+            std::vector< bool > attribute_dirichlet(2, false);
+            attribute_dirichlet[1] = true;
+
+            SolverConfig config = solver_config;
+            config.verbose = verbose;
+            config.adapt_to_mesh(mesh);
+            SweepEngine sweep(mesh, attribute_dirichlet, config);
+
+            /* diffusion k, source amplitude a, boundary value g */
+            const double diffusions[] = { 0.5, 1., 2., 4. };
+            const double amplitudes[] = { 1., 2., 5. };
+            const double boundaries[] = { 0., 1. };
+            for ( int d = 0; d < 4; ++d ) {
+                for ( int a = 0; a < 3; ++a ) {
+                    for ( int b = 0; b < 2; ++b ) {
+                        const double k = diffusions[d];
+                        const double amplitude = amplitudes[a];
+                        const double g = boundaries[b];
+                        Scenario scenario;
+                        std::ostringstream name;
+                        name << "k" << k << "_a" << amplitude << "_g" << g;
+                        scenario.name = name.str();
+                        scenario.lhs_key = d;
+                        scenario.diffusion = [k]( vertex ) { return k; };
+                        scenario.source = [amplitude]( vertex v ) {
+                            return amplitude * sinus_fct( v );
+                        };
+                        scenario.dirichlet = [g]( vertex ) { return g; };
+                        sweep.add_scenario(scenario);
+                    }
+                }
+            }
+            /* the solutions are written while the next groups are solved */
+            const std::string prefix = mesh_basename(mesh_filename) + "_sweep";
+            AsyncWriter writer(mesh, AsyncWriter::MEDIT);
+            writer.write_mesh(prefix + ".mesh");
+            sweep.set_writer(&writer, prefix);
+            if ( !sweep.run() ) {
+                std::cout << "Failure: some scenarios did not converge" << std::endl;
+            }
+            if ( !writer.flush() ) {
+                std::cout << "Failure: some solutions were not written" << std::endl;
+            }
+        }
     }
 
 }
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "mesh.h"
+
+#if defined( FEM2A_SIMD ) && defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+namespace FEM2A {
+
+    /**
+     * \brief Mat is a R x C matrix of doubles stored row-major on the
+     *        stack. It never allocates, so it can be used in the element
+     *        loops where a DenseMatrix would cost one heap allocation per
+     *        matrix (and per transpose / inverse / product).
+     *
+     * All the operations are constexpr: the sizes are template
+     * parameters, so the loops are fully unrolled by the compiler.
+     * Vec< N > is the column vector Mat< N, 1 >.
+     */
+    template< int R, int C >
+    struct Mat {
+        double data_[R * C] ;
+
+        /* zero matrix */
+        constexpr Mat() : data_() {}
+
+        static constexpr int height() { return R ; }
+        static constexpr int width() { return C ; }
+
+        constexpr double& operator()( int i, int j ) { return data_[C * i + j] ; }
+        constexpr double operator()( int i, int j ) const { return data_[C * i + j] ; }
+
+        /* linear access, mostly useful for vectors */
+        constexpr double& operator[]( int i ) { return data_[i] ; }
+        constexpr double operator[]( int i ) const { return data_[i] ; }
+
+        constexpr Mat< C, R > transpose() const
+        {
+            Mat< C, R > T ;
+            for( int i = 0; i < R; ++i ) {
+                for( int j = 0; j < C; ++j ) T( j, i ) = ( *this )( i, j ) ;
+            }
+            return T ;
+        }
+
+        constexpr Mat& operator+=( const Mat& B )
+        {
+            for( int i = 0; i < R * C; ++i ) data_[i] += B.data_[i] ;
+            return *this ;
+        }
+
+        constexpr Mat& operator*=( double s )
+        {
+            for( int i = 0; i < R * C; ++i ) data_[i] *= s ;
+            return *this ;
+        }
+    } ;
+
+    template< int N >
+    using Vec = Mat< N, 1 > ;
+
+    template< int R, int K, int C >
+    constexpr Mat< R, C > operator*( const Mat< R, K >& A, const Mat< K, C >& B )
+    {
+        Mat< R, C > P ;
+        for( int i = 0; i < R; ++i ) {
+            for( int j = 0; j < C; ++j ) {
+                double s = 0. ;
+                for( int k = 0; k < K; ++k ) s += A( i, k ) * B( k, j ) ;
+                P( i, j ) = s ;
+            }
+        }
+        return P ;
+    }
+
+    template< int R, int C >
+    constexpr Mat< R, C > operator*( double s, Mat< R, C > A )
+    {
+        return A *= s ;
+    }
+
+    template< int N >
+    constexpr double dot( const Vec< N >& a, const Vec< N >& b )
+    {
+        double s = 0. ;
+        for( int i = 0; i < N; ++i ) s += a[i] * b[i] ;
+        return s ;
+    }
+
+    constexpr double det( const Mat< 2, 2 >& A )
+    {
+        return A( 0, 0 ) * A( 1, 1 ) - A( 0, 1 ) * A( 1, 0 ) ;
+    }
+
+    constexpr double det( const Mat< 3, 3 >& A )
+    {
+        return A( 0, 0 ) * ( A( 1, 1 ) * A( 2, 2 ) - A( 1, 2 ) * A( 2, 1 ) )
+            - A( 0, 1 ) * ( A( 1, 0 ) * A( 2, 2 ) - A( 1, 2 ) * A( 2, 0 ) )
+            + A( 0, 2 ) * ( A( 1, 0 ) * A( 2, 1 ) - A( 1, 1 ) * A( 2, 0 ) ) ;
+    }
+
+    /**
+     * \brief Inverse of a 2x2 or 3x3 matrix by the adjugate formula.
+     *        The matrix must be invertible (det(A) != 0).
+     */
+    constexpr Mat< 2, 2 > inverse( const Mat< 2, 2 >& A )
+    {
+        const double inv_det = 1. / det( A ) ;
+        Mat< 2, 2 > I ;
+        I( 0, 0 ) = A( 1, 1 ) * inv_det ;
+        I( 0, 1 ) = -A( 0, 1 ) * inv_det ;
+        I( 1, 0 ) = -A( 1, 0 ) * inv_det ;
+        I( 1, 1 ) = A( 0, 0 ) * inv_det ;
+        return I ;
+    }
+
+    constexpr Mat< 3, 3 > inverse( const Mat< 3, 3 >& A )
+    {
+        const double inv_det = 1. / det( A ) ;
+        Mat< 3, 3 > I ;
+        for( int i = 0; i < 3; ++i ) {
+            for( int j = 0; j < 3; ++j ) {
+                /* cofactor of A(j,i), the cyclic indices give the sign */
+                const int r0 = ( j + 1 ) % 3, r1 = ( j + 2 ) % 3 ;
+                const int c0 = ( i + 1 ) % 3, c1 = ( i + 2 ) % 3 ;
+                I( i, j ) = ( A( r0, c0 ) * A( r1, c1 ) - A( r0, c1 ) * A( r1, c0 ) ) * inv_det ;
+            }
+        }
+        return I ;
+    }
+
+    constexpr Vec< 2 > to_vec( vec2 v )
+    {
+        Vec< 2 > r ;
+        r[0] = v.x ;
+        r[1] = v.y ;
+        return r ;
+    }
+
+    constexpr vec2 to_vec2( const Vec< 2 >& v )
+    {
+        return vec2{ v[0], v[1] } ;
+    }
+
+#if defined( FEM2A_SIMD ) && defined( __SSE2__ )
+    /*
+     * SSE2 versions of the 2x2 and 3x3 matrix-vector products, enabled by
+     * compiling with -DFEM2A_SIMD. The non-template overloads are chosen
+     * over the generic operator* above; they are not constexpr. With -O2
+     * the unrolled generic loops are usually as fast, measure before
+     * enabling.
+     */
+    inline Vec< 2 > operator*( const Mat< 2, 2 >& A, const Vec< 2 >& x )
+    {
+        const __m128d r0 = _mm_mul_pd( _mm_loadu_pd( &A.data_[0] ), _mm_loadu_pd( x.data_ ) ) ;
+        const __m128d r1 = _mm_mul_pd( _mm_loadu_pd( &A.data_[2] ), _mm_loadu_pd( x.data_ ) ) ;
+        /* (r0.lo + r0.hi, r1.lo + r1.hi) */
+        const __m128d sum = _mm_add_pd( _mm_unpacklo_pd( r0, r1 ), _mm_unpackhi_pd( r0, r1 ) ) ;
+        Vec< 2 > y ;
+        _mm_storeu_pd( y.data_, sum ) ;
+        return y ;
+    }
+
+    inline Vec< 3 > operator*( const Mat< 3, 3 >& A, const Vec< 3 >& x )
+    {
+        const __m128d x01 = _mm_loadu_pd( x.data_ ) ;
+        Vec< 3 > y ;
+        for( int i = 0; i < 3; ++i ) {
+            const __m128d p = _mm_mul_pd( _mm_loadu_pd( &A.data_[3 * i] ), x01 ) ;
+            y[i] = _mm_cvtsd_f64( _mm_add_sd( p, _mm_unpackhi_pd( p, p ) ) )
+                + A.data_[3 * i + 2] * x.data_[2] ;
+        }
+        return y ;
+    }
+#endif
+
+}
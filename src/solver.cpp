@@ -1,10 +1,15 @@
 #include "solver.h"
+#include "parallel.h"
 #include <assert.h>
 #include <iostream>
 #include <iomanip>
 #include <cmath>
 #include <algorithm>
 #include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <mutex>
 
 
 #include "../third_party/OpenNL_psm.h"
@@ -24,25 +29,552 @@
 
 namespace FEM2A {
 
-    bool solve(
+    /* rows per task of the products: smaller matrices stay in the caller */
+    static const int SPMV_GRAIN = 2048 ;
+
+    /****************************************************************/
+    /* Implementation of SolverConfig */
+    /****************************************************************/
+    SolverConfig::SolverConfig()
+        : method( DEFAULT ), preconditioner( NONE ), threshold( 1e-12 ),
+        discretization_factor( 0. ), max_iterations( 1000000 ), verbose( false ),
+        progress( NULL ), progress_data( NULL ), auto_tune( false ),
+        tuning_cache( "fem2a_solver.cache" ), mixed_precision( false )
+    {
+
+    }
+
+    static const int nb_methods = 5 ;
+    static const char* method_names[] = {
+        "default", "cg", "bicgstab", "gmres", "pcg" } ;
+    static const char* preconditioner_names[] = { "none", "jacobi", "ssor" } ;
+
+    std::string SolverConfig::name() const
+    {
+        return std::string( method_names[method] ) + "/"
+            + preconditioner_names[preconditioner] ;
+    }
+
+    SolverConfig SolverConfig::from_arguments(
+        const std::vector< std::string >& arguments )
+    {
+        SolverConfig config ;
+        for( int i = 0; i < arguments.size(); ++i ) {
+            const std::string& arg = arguments[i] ;
+            const bool has_value = i + 1 < arguments.size() ;
+            if( arg == "-v" || arg == "--verbose" ) {
+                config.verbose = true ;
+            } else if( arg == "--auto-tune" ) {
+                config.auto_tune = true ;
+            } else if( arg == "--mixed" ) {
+                config.mixed_precision = true ;
+            } else if( arg == "--solver" && has_value ) {
+                const std::string& value = arguments[++i] ;
+                for( int m = 0; m < nb_methods; ++m ) {
+                    if( value == method_names[m] ) config.method = Method( m ) ;
+                }
+            } else if( arg == "--precond" && has_value ) {
+                const std::string& value = arguments[++i] ;
+                for( int p = 0; p < 3; ++p ) {
+                    if( value == preconditioner_names[p] ) {
+                        config.preconditioner = Preconditioner( p ) ;
+                    }
+                }
+            } else if( arg == "--tol" && has_value ) {
+                config.threshold = atof( arguments[++i].c_str() ) ;
+            } else if( arg == "--tol-mesh" && has_value ) {
+                config.discretization_factor = atof( arguments[++i].c_str() ) ;
+            } else if( arg == "--max-iter" && has_value ) {
+                config.max_iterations = atoi( arguments[++i].c_str() ) ;
+            }
+        }
+        return config ;
+    }
+
+    void SolverConfig::adapt_to_mesh( const Mesh& M )
+    {
+        if( discretization_factor <= 0. ) return ;
+        const double h = mesh_size( M ) ;
+        threshold = discretization_factor * h * h ;
+        if( verbose ) {
+            std::cout << "mesh size h = " << h << ", solver threshold = "
+                << threshold << std::endl ;
+        }
+    }
+
+    double mesh_size( const Mesh& M )
+    {
+        double h2 = 0. ;
+        for( int t = 0; t < M.nb_triangles(); ++t ) {
+            for( int v = 0; v < 3; ++v ) {
+                vertex a = M.get_triangle_vertex( t, v ) ;
+                vertex b = M.get_triangle_vertex( t, ( v + 1 ) % 3 ) ;
+                double l2 = ( b.x - a.x ) * ( b.x - a.x ) + ( b.y - a.y ) * ( b.y - a.y ) ;
+                if( l2 > h2 ) h2 = l2 ;
+            }
+        }
+        return std::sqrt( h2 ) ;
+    }
+
+    bool record_residual_history( const SolverProgress& progress, void* history )
+    {
+        static_cast< std::vector< double >* >( history )->push_back( progress.residual ) ;
+        return true ;
+    }
+
+    /* OpenNL keeps its current context in a global, and its progress
+     * functions have no user data: the configuration of the running solve
+     * is kept here. The OpenNL solves are serialized by opennl_mutex, so
+     * concurrent callers (server, sweeps) wait for each other. */
+    static std::mutex opennl_mutex ;
+    static const SolverConfig* opennl_progress_config = NULL ;
+    static std::chrono::steady_clock::time_point opennl_progress_start ;
+
+    static void opennl_progress(
+        NLuint cur_iter, NLuint max_iter, double cur_err, double max_err )
+    {
+        SolverProgress progress ;
+        progress.iteration = cur_iter ;
+        progress.max_iterations = max_iter ;
+        /* OpenNL gives squared norms, max_err being (threshold * ||b||)^2 */
+        progress.residual = max_err > 0.
+            ? opennl_progress_config->threshold * std::sqrt( cur_err / max_err )
+            : std::sqrt( cur_err ) ;
+        progress.elapsed = std::chrono::duration< double >(
+            std::chrono::steady_clock::now() - opennl_progress_start ).count() ;
+        opennl_progress_config->progress( progress, opennl_progress_config->progress_data ) ;
+    }
+
+    /* reproducible for any number of threads, see ThreadPool::sum */
+    static double dot( const std::vector< double >& x, const std::vector< double >& y )
+    {
+        return ThreadPool::current().sum( x.size(), [&]( int begin, int end ) {
+            double s = 0. ;
+            for( int i = begin; i < end; ++i ) {
+                s += x[i] * y[i] ;
+            }
+            return s ;
+        } ) ;
+    }
+
+    /****************************************************************/
+    /* Implementation of LinearSolver */
+    /****************************************************************/
+    LinearSolver::LinearSolver( const LinearOperator& A, const SolverConfig& config )
+        : A_( A ), config_( config ), inv_diag_( A.nb_rows(), 1. ),
+        preconditioner_( NULL ), iterations_( 0 ), residual_( 0. )
+    {
+        update_preconditioner() ;
+    }
+
+    void LinearSolver::set_preconditioner( LinearPreconditioner* P )
+    {
+        preconditioner_ = P ;
+    }
+
+    void LinearSolver::precondition( const std::vector< double >& r, std::vector< double >& z ) const
+    {
+        if( preconditioner_ != NULL ) {
+            preconditioner_->apply( r, z ) ;
+            return ;
+        }
+        for( int i = 0; i < r.size(); ++i ) {
+            z[i] = inv_diag_[i] * r[i] ;
+        }
+    }
+
+    void LinearSolver::update_preconditioner()
+    {
+        inv_diag_.assign( A_.nb_rows(), 1. ) ;
+        if( config_.preconditioner != SolverConfig::NONE ) {
+            std::vector< double > d ;
+            A_.diagonal( d ) ;
+            for( int i = 0; i < A_.nb_rows(); ++i ) {
+                if( d[i] != 0. ) inv_diag_[i] = 1. / d[i] ;
+            }
+        }
+    }
+
+    void LinearSolver::update_preconditioner( const std::vector< int >& changed_rows )
+    {
+        if( preconditioner_ != NULL ) preconditioner_->update( changed_rows ) ;
+        if( config_.preconditioner == SolverConfig::NONE ) return ;
+        for( int k = 0; k < changed_rows.size(); ++k ) {
+            const int i = changed_rows[k] ;
+            const double d = A_.diagonal_entry( i ) ;
+            inv_diag_[i] = d != 0. ? 1. / d : 1. ;
+        }
+    }
+
+    bool LinearSolver::solve( const std::vector< double >& b, std::vector< double >& x )
+    {
+        const int n = b.size() ;
+        assert( n == A_.nb_rows() ) ;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+        if( x.size() != n ) x.assign( n, 0. ) ;
+        iterations_ = 0 ;
+        residual_ = 0. ;
+
+        r_.resize( n ) ; z_.resize( n ) ; p_.resize( n ) ; q_.resize( n ) ;
+        A_.mult( x, q_ ) ;
+        for( int i = 0; i < n; ++i ) {
+            r_[i] = b[i] - q_[i] ;
+        }
+        precondition( r_, z_ ) ;
+        p_ = z_ ;
+        double rz = dot( r_, z_ ) ;
+        const double b_norm = std::sqrt( dot( b, b ) ) ;
+        if( b_norm == 0. ) {
+            x.assign( n, 0. ) ;
+            return true ;
+        }
+
+        SolverProgress progress ;
+        progress.max_iterations = config_.max_iterations ;
+        for( int it = 0; ; ++it ) {
+            residual_ = std::sqrt( dot( r_, r_ ) ) / b_norm ;
+            iterations_ = it ;
+            progress.iteration = it ;
+            progress.residual = residual_ ;
+            progress.elapsed = std::chrono::duration< double >(
+                std::chrono::steady_clock::now() - start ).count() ;
+            if( config_.verbose && !( it % 100 ) ) {
+                std::cout << it << " : " << residual_ << std::endl ;
+            }
+            if( residual_ <= config_.threshold ) {
+                if( config_.verbose ) {
+                    std::cout << ".. system solved in " << it
+                        << " iterations, ||Ax-b||/||b|| = " << residual_ << std::endl ;
+                }
+                return true ;
+            }
+            if( it >= config_.max_iterations ) {
+                std::cout << "Failure: PCG reached " << it
+                    << " iterations without converging" << std::endl ;
+                return false ;
+            }
+            if( config_.progress != NULL
+                && !config_.progress( progress, config_.progress_data ) ) {
+                if( config_.verbose ) {
+                    std::cout << "PCG stopped by the progress callback at iteration "
+                        << it << std::endl ;
+                }
+                return false ;
+            }
+
+            A_.mult( p_, q_ ) ;
+            const double alpha = rz / dot( p_, q_ ) ;
+            for( int i = 0; i < n; ++i ) {
+                x[i] += alpha * p_[i] ;
+                r_[i] -= alpha * q_[i] ;
+            }
+            precondition( r_, z_ ) ;
+            const double rz_new = dot( r_, z_ ) ;
+            const double beta = rz_new / rz ;
+            rz = rz_new ;
+            for( int i = 0; i < n; ++i ) {
+                p_[i] = z_[i] + beta * p_[i] ;
+            }
+        }
+    }
+
+    bool LinearSolver::solve_multiple( int k, const std::vector< double >& B, std::vector< double >& X )
+    {
+        const int n = A_.nb_rows() ;
+        assert( B.size() == (size_t)n * k ) ;
+        if( X.size() != B.size() ) X.assign( B.size(), 0. ) ;
+        iterations_ = 0 ;
+        residual_ = 0. ;
+
+        std::vector< double > R( B.size() ), Z( B.size() ), P( B.size() ), Q( B.size() ) ;
+        std::vector< double > rz( k, 0. ), b_norm( k, 0. ), pq( k ), rr( k ) ;
+        std::vector< char > active( k, 1 ) ;
+        A_.mult_multiple( k, X, Q ) ;
+        for( int i = 0; i < n; ++i ) {
+            for( int c = 0; c < k; ++c ) {
+                const int ic = k * i + c ;
+                R[ic] = B[ic] - Q[ic] ;
+                Z[ic] = inv_diag_[i] * R[ic] ;
+                P[ic] = Z[ic] ;
+                rz[c] += R[ic] * Z[ic] ;
+                b_norm[c] += B[ic] * B[ic] ;
+            }
+        }
+        for( int c = 0; c < k; ++c ) {
+            b_norm[c] = std::sqrt( b_norm[c] ) ;
+            if( b_norm[c] == 0. ) {
+                active[c] = 0 ;
+                for( int i = 0; i < n; ++i ) X[k * i + c] = 0. ;
+            }
+        }
+
+        for( int it = 0; ; ++it ) {
+            std::fill( rr.begin(), rr.end(), 0. ) ;
+            for( int i = 0; i < n; ++i ) {
+                for( int c = 0; c < k; ++c ) rr[c] += R[k * i + c] * R[k * i + c] ;
+            }
+            int nb_active = 0 ;
+            residual_ = 0. ;
+            for( int c = 0; c < k; ++c ) {
+                if( !active[c] ) continue ;
+                const double residual = std::sqrt( rr[c] ) / b_norm[c] ;
+                if( residual <= config_.threshold ) {
+                    active[c] = 0 ;
+                } else {
+                    ++nb_active ;
+                }
+                residual_ = std::max( residual_, residual ) ;
+            }
+            iterations_ = it ;
+            if( nb_active == 0 ) {
+                if( config_.verbose ) {
+                    std::cout << ".. " << k << " systems solved in " << it
+                        << " iterations" << std::endl ;
+                }
+                return true ;
+            }
+            if( it >= config_.max_iterations ) {
+                std::cout << "Failure: PCG reached " << it << " iterations with "
+                    << nb_active << " systems not converged" << std::endl ;
+                return false ;
+            }
+
+            A_.mult_multiple( k, P, Q ) ;
+            std::fill( pq.begin(), pq.end(), 0. ) ;
+            for( int i = 0; i < n; ++i ) {
+                for( int c = 0; c < k; ++c ) pq[c] += P[k * i + c] * Q[k * i + c] ;
+            }
+            std::vector< double > rz_new( k, 0. ) ;
+            for( int i = 0; i < n; ++i ) {
+                for( int c = 0; c < k; ++c ) {
+                    if( !active[c] ) continue ;
+                    const int ic = k * i + c ;
+                    const double alpha = rz[c] / pq[c] ;
+                    X[ic] += alpha * P[ic] ;
+                    R[ic] -= alpha * Q[ic] ;
+                    Z[ic] = inv_diag_[i] * R[ic] ;
+                    rz_new[c] += R[ic] * Z[ic] ;
+                }
+            }
+            for( int i = 0; i < n; ++i ) {
+                for( int c = 0; c < k; ++c ) {
+                    if( !active[c] ) continue ;
+                    const int ic = k * i + c ;
+                    P[ic] = Z[ic] + rz_new[c] / rz[c] * P[ic] ;
+                }
+            }
+            rz.swap( rz_new ) ;
+        }
+    }
+
+    int LinearSolver::iterations() const
+    {
+        return iterations_ ;
+    }
+
+    double LinearSolver::residual() const
+    {
+        return residual_ ;
+    }
+
+    /****************************************************************/
+    /* Implementation of MixedPrecisionSolver */
+    /****************************************************************/
+    const double MixedPrecisionSolver::inner_threshold = 1e-4 ;
+
+    /* number of refinements allowed without halving the residual */
+    static const int max_stagnations = 3 ;
+
+    static double dot( const std::vector< float >& x, const std::vector< float >& y )
+    {
+        return ThreadPool::current().sum( x.size(), [&]( int begin, int end ) {
+            double s = 0. ;
+            for( int i = begin; i < end; ++i ) {
+                s += (double)x[i] * y[i] ;
+            }
+            return s ;
+        } ) ;
+    }
+
+    MixedPrecisionSolver::MixedPrecisionSolver( const SparseMatrix& A, const SolverConfig& config )
+        : A_( A ), config_( config ), inv_diag_( A.nb_rows(), 1.f ), iterations_( 0 ),
+        refinements_( 0 ), residual_( 0. )
+    {
+        const int n = A.nb_rows() ;
+        build_csr( A, row_offsets_, cols_, vals_ ) ;
+        if( config_.preconditioner != SolverConfig::NONE ) {
+            std::vector< double > d ;
+            A.diagonal( d ) ;
+            for( int i = 0; i < n; ++i ) {
+                if( d[i] != 0. ) inv_diag_[i] = 1. / d[i] ;
+            }
+        }
+    }
+
+    void MixedPrecisionSolver::mult_float( const std::vector< float >& p, std::vector< float >& q ) const
+    {
+        ThreadPool::current().parallel_for( int( row_offsets_.size() ) - 1, SPMV_GRAIN, [&]( int begin, int end ) {
+            for( int i = begin; i < end; ++i ) {
+                float s = 0.f ;
+                for( int k = row_offsets_[i]; k < row_offsets_[i + 1]; ++k ) {
+                    s += vals_[k] * p[cols_[k]] ;
+                }
+                q[i] = s ;
+            }
+        } ) ;
+    }
+
+    bool MixedPrecisionSolver::solve( const std::vector< double >& b, std::vector< double >& x )
+    {
+        const int n = b.size() ;
+        assert( n == A_.nb_rows() ) ;
+        if( x.size() != n ) x.assign( n, 0. ) ;
+        iterations_ = 0 ;
+        refinements_ = 0 ;
+        residual_ = 0. ;
+        const double b_norm = std::sqrt( dot( b, b ) ) ;
+        if( b_norm == 0. ) {
+            x.assign( n, 0. ) ;
+            return true ;
+        }
+
+        r_.resize( n ) ; z_.resize( n ) ; p_.resize( n ) ; q_.resize( n ) ; d_.resize( n ) ;
+        std::vector< double > Ax ;
+        double best = -1. ;
+        int stagnations = 0 ;
+        for( ; ; ++refinements_ ) {
+            /* residual of the current solution, in double */
+            A_.mult( x, Ax ) ;
+            const double r_norm = std::sqrt( ThreadPool::current().sum( n, [&]( int begin, int end ) {
+                double s = 0. ;
+                for( int i = begin; i < end; ++i ) {
+                    s += ( b[i] - Ax[i] ) * ( b[i] - Ax[i] ) ;
+                }
+                return s ;
+            } ) ) ;
+            residual_ = r_norm / b_norm ;
+            if( config_.verbose ) {
+                std::cout << "refinement " << refinements_ << " : " << residual_
+                    << " (" << iterations_ << " float iterations)" << std::endl ;
+            }
+            if( residual_ <= config_.threshold ) {
+                if( config_.verbose ) {
+                    std::cout << ".. system solved in " << refinements_ << " refinements and "
+                        << iterations_ << " float iterations, ||Ax-b||/||b|| = "
+                        << residual_ << std::endl ;
+                }
+                return true ;
+            }
+            if( best < 0. || residual_ < 0.5 * best ) {
+                best = residual_ ;
+                stagnations = 0 ;
+            } else if( ++stagnations >= max_stagnations ) {
+                std::cout << "Failure: mixed precision refinement stagnates at "
+                    << residual_ << std::endl ;
+                return false ;
+            }
+            if( iterations_ >= config_.max_iterations ) {
+                std::cout << "Failure: mixed precision PCG reached " << iterations_
+                    << " iterations without converging" << std::endl ;
+                return false ;
+            }
+
+            /* A d = r / ||r|| in float: the scaling keeps r in the float range */
+            for( int i = 0; i < n; ++i ) {
+                r_[i] = ( b[i] - Ax[i] ) / r_norm ;
+                d_[i] = 0.f ;
+                z_[i] = inv_diag_[i] * r_[i] ;
+            }
+            p_ = z_ ;
+            double rz = dot( r_, z_ ) ;
+            /* do not reduce the residual further than needed by the last refinement */
+            const double target = std::max( inner_threshold, 0.5 * config_.threshold / residual_ ) ;
+            while( iterations_ < config_.max_iterations
+                && dot( r_, r_ ) > target * target ) {
+                mult_float( p_, q_ ) ;
+                const float alpha = rz / dot( p_, q_ ) ;
+                for( int i = 0; i < n; ++i ) {
+                    d_[i] += alpha * p_[i] ;
+                    r_[i] -= alpha * q_[i] ;
+                    z_[i] = inv_diag_[i] * r_[i] ;
+                }
+                const double rz_new = dot( r_, z_ ) ;
+                const float beta = rz_new / rz ;
+                rz = rz_new ;
+                for( int i = 0; i < n; ++i ) {
+                    p_[i] = z_[i] + beta * p_[i] ;
+                }
+                ++iterations_ ;
+            }
+            for( int i = 0; i < n; ++i ) {
+                x[i] += r_norm * d_[i] ;
+            }
+        }
+    }
+
+    int MixedPrecisionSolver::iterations() const
+    {
+        return iterations_ ;
+    }
+
+    int MixedPrecisionSolver::refinements() const
+    {
+        return refinements_ ;
+    }
+
+    double MixedPrecisionSolver::residual() const
+    {
+        return residual_ ;
+    }
+
+    size_t MixedPrecisionSolver::memory_bytes() const
+    {
+        return row_offsets_.capacity() * sizeof( int ) + cols_.capacity() * sizeof( int )
+            + vals_.capacity() * sizeof( float ) + inv_diag_.capacity() * sizeof( float ) ;
+    }
+
+    /**
+     * Runs OpenNL once with the given configuration.
+     * Returns true if the solver stopped before max_iterations.
+     */
+    static bool solve_opennl(
         const SparseMatrix& A,
         const std::vector< double >& b,
-        std::vector< double >& x )
+        std::vector< double >& x,
+        const SolverConfig& config )
     {
-        assert(A.nb_rows() == b.size()) ;
+        const NLenum methods[] = { NL_SOLVER_DEFAULT, NL_CG, NL_BICGSTAB, NL_GMRES } ;
+        const NLenum preconditioners[] = {
+            NL_PRECOND_NONE, NL_PRECOND_JACOBI, NL_PRECOND_SSOR } ;
         int n = b.size() ;
         x.resize( n ) ;
 
+        std::lock_guard< std::mutex > lock( opennl_mutex ) ;
         NLContext nl_context = nlNewContext() ;
-        nlSolverParameteri( NL_NB_VARIABLES, NLint( n    ) ) ;
-        nlSolverParameteri( NL_MAX_ITERATIONS, NLint( 1e6 ) ) ;
-        nlSolverParameterd( NL_THRESHOLD, NLdouble( 1e-12 ) ) ;
-        nlEnable( NL_VERBOSE ) ;
+        nlSolverParameteri( NL_NB_VARIABLES, NLint( n ) ) ;
+        nlSolverParameteri( NL_SOLVER, NLint( methods[config.method] ) ) ;
+        if( config.method != SolverConfig::DEFAULT
+            || config.preconditioner != SolverConfig::NONE ) {
+            nlSolverParameteri( NL_PRECONDITIONER,
+                NLint( preconditioners[config.preconditioner] ) ) ;
+        }
+        nlSolverParameteri( NL_MAX_ITERATIONS, NLint( config.max_iterations ) ) ;
+        nlSolverParameterd( NL_THRESHOLD, NLdouble( config.threshold ) ) ;
+        if( config.preconditioner == SolverConfig::SSOR ) {
+            /* OpenNL's SSOR needs symmetric storage; stiffness matrices are */
+            nlSolverParameteri( NL_SYMMETRIC, NL_TRUE ) ;
+        }
+        if( config.verbose ) nlEnable( NL_VERBOSE ) ;
+        if( config.progress != NULL ) {
+            opennl_progress_config = &config ;
+            opennl_progress_start = std::chrono::steady_clock::now() ;
+            nlSetFunction( NL_FUNC_PROGRESS, NLfunc( opennl_progress ) ) ;
+        }
         nlBegin( NL_SYSTEM ) ;
         nlBegin( NL_MATRIX ) ;
         for( int i = 0; i < n; i++ ) {
-            const std::vector< int >& J = A.get_cols_at_line( i ) ;
-            const std::vector< double >& V = A.get_vals_at_line( i ) ;
+            const SparseMatrix::Columns& J = A.get_cols_at_line( i ) ;
+            const SparseMatrix::Values& V = A.get_vals_at_line( i ) ;
             assert( J.size() == V.size() ) ;
             nlBegin( NL_ROW ) ;
             for( unsigned int k = 0; k < J.size(); k++ ) {
@@ -53,24 +585,180 @@ namespace FEM2A {
         }
         nlEnd( NL_MATRIX ) ;
         nlEnd( NL_SYSTEM ) ;
-        std::cout << "solving system with " << n << " unknowns .. " << std::endl ;
+        if( config.verbose ) {
+            std::cout << "solving system with " << n << " unknowns ("
+                << config.name() << ") .. " << std::endl ;
+        }
 
         if( !nlSolve() ) {
             std::cout << "Failure: OpenNL didn't manage to solve the system"
                 << std::endl ;
+            nlDeleteContext( nl_context ) ;
             return false ;
         }
 
         for( int i = 0; i < n; i++ ) {
             x[i] = nlGetVariable( i ) ;
         }
-
+        NLint used_iterations = 0 ;
+        nlGetIntegerv( NL_USED_ITERATIONS, &used_iterations ) ;
         nlDeleteContext( nl_context ) ;
 
-        std::cout << ".. system solved" << std::endl ;
+        if( used_iterations >= config.max_iterations ) {
+            std::cout << "Failure: OpenNL reached " << used_iterations
+                << " iterations without converging" << std::endl ;
+            return false ;
+        }
+        if( config.verbose ) {
+            std::cout << ".. system solved in " << used_iterations
+                << " iterations" << std::endl ;
+        }
         return true ;
     }
 
+    /**
+     * Runs the method of the configuration once: the in-tree PCG
+     * (LinearSolver or MixedPrecisionSolver) or OpenNL.
+     */
+    static bool solve_once(
+        const SparseMatrix& A,
+        const std::vector< double >& b,
+        std::vector< double >& x,
+        const SolverConfig& config )
+    {
+        if( config.method != SolverConfig::PCG ) return solve_opennl( A, b, x, config ) ;
+        x.assign( b.size(), 0. ) ;
+        if( config.mixed_precision ) {
+            return MixedPrecisionSolver( A, config ).solve( b, x ) ;
+        }
+        return LinearSolver( A, config ).solve( b, x ) ;
+    }
+
+    /**
+     * Key identifying a system for the auto-tuning cache: size, number
+     * of non-zeros and a FNV-1a hash of the sparsity pattern.
+     */
+    static std::string pattern_key( const SparseMatrix& A )
+    {
+        unsigned long long hash = 14695981039346656037ULL ;
+        long nnz = 0 ;
+        for( int i = 0; i < A.nb_rows(); ++i ) {
+            const SparseMatrix::Columns& J = A.get_cols_at_line( i ) ;
+            nnz += J.size() ;
+            for( int k = 0; k < J.size(); ++k ) {
+                hash = ( hash ^ (unsigned long long)( J[k] + 1 ) ) * 1099511628211ULL ;
+            }
+            hash *= 1099511628211ULL ; /* end of row */
+        }
+        std::ostringstream key ;
+        key << A.nb_rows() << ":" << nnz << ":" << std::hex << hash ;
+        return key.str() ;
+    }
+
+    static bool read_tuning_cache(
+        const std::string& filename,
+        const std::string& key,
+        SolverConfig& config )
+    {
+        std::ifstream ifs( filename.c_str() ) ;
+        std::string k ;
+        int method, preconditioner ;
+        while( ifs >> k >> method >> preconditioner ) {
+            if( k == key && method >= 0 && method < nb_methods
+                && preconditioner >= 0 && preconditioner < 3 ) {
+                config.method = SolverConfig::Method( method ) ;
+                config.preconditioner = SolverConfig::Preconditioner( preconditioner ) ;
+                return true ;
+            }
+        }
+        return false ;
+    }
+
+    static void write_tuning_cache(
+        const std::string& filename,
+        const std::string& key,
+        const SolverConfig& config )
+    {
+        std::ofstream ofs( filename.c_str(), std::ios::out | std::ios::app ) ;
+        ofs << key << " " << int( config.method ) << " "
+            << int( config.preconditioner ) << std::endl ;
+    }
+
+    /**
+     * Solves the system with every candidate configuration, keeps the
+     * solution of the fastest converged one and stores its choice.
+     */
+    static bool auto_tune_solve(
+        const SparseMatrix& A,
+        const std::vector< double >& b,
+        std::vector< double >& x,
+        const SolverConfig& config,
+        const std::string& key )
+    {
+        const SolverConfig::Method methods[] = {
+            SolverConfig::CG, SolverConfig::CG, SolverConfig::CG,
+            SolverConfig::BICGSTAB, SolverConfig::BICGSTAB, SolverConfig::GMRES,
+            SolverConfig::PCG } ;
+        const SolverConfig::Preconditioner preconditioners[] = {
+            SolverConfig::NONE, SolverConfig::JACOBI, SolverConfig::SSOR,
+            SolverConfig::NONE, SolverConfig::JACOBI, SolverConfig::NONE,
+            SolverConfig::JACOBI } ;
+
+        SolverConfig best = config ;
+        double best_time = -1. ;
+        std::vector< double > trial ;
+        for( int c = 0; c < 7; ++c ) {
+            SolverConfig candidate = config ;
+            candidate.method = methods[c] ;
+            candidate.preconditioner = preconditioners[c] ;
+            std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now() ;
+            const bool converged = solve_once( A, b, trial, candidate ) ;
+            const double elapsed = std::chrono::duration< double >(
+                std::chrono::steady_clock::now() - start ).count() ;
+            if( config.verbose ) {
+                std::cout << "auto-tune: " << candidate.name() << " "
+                    << elapsed << " s" << ( converged ? "" : " (no convergence)" )
+                    << std::endl ;
+            }
+            if( converged && ( best_time < 0. || elapsed < best_time ) ) {
+                best_time = elapsed ;
+                best = candidate ;
+                x.swap( trial ) ;
+            }
+        }
+        if( best_time < 0. ) {
+            return solve_once( A, b, x, config ) ;
+        }
+        write_tuning_cache( config.tuning_cache, key, best ) ;
+        if( config.verbose ) {
+            std::cout << "auto-tune: selected " << best.name() << std::endl ;
+        }
+        return true ;
+    }
+
+    bool solve(
+        const SparseMatrix& A,
+        const std::vector< double >& b,
+        std::vector< double >& x,
+        const SolverConfig& config )
+    {
+        assert(A.nb_rows() == b.size()) ;
+        if( !config.auto_tune ) {
+            return solve_once( A, b, x, config ) ;
+        }
+
+        const std::string key = pattern_key( A ) ;
+        SolverConfig tuned = config ;
+        if( read_tuning_cache( config.tuning_cache, key, tuned ) ) {
+            if( config.verbose ) {
+                std::cout << "auto-tune: cached choice " << tuned.name() << std::endl ;
+            }
+            return solve_once( A, b, x, tuned ) ;
+        }
+        return auto_tune_solve( A, b, x, config, key ) ;
+    }
+
     bool test_opennl()
     {
         std::cout << "------------------------ \n" ;
@@ -81,6 +769,7 @@ namespace FEM2A {
 
         double sol[3] = { 2., -3., 2. } ;
 
+        std::lock_guard< std::mutex > lock( opennl_mutex ) ;
         NLContext nl_context = nlNewContext() ;
         nlSolverParameteri( NL_NB_VARIABLES, NLint( 3 ) ) ;
         nlSolverParameteri( NL_MAX_ITERATIONS, NLint( 1e6 ) ) ;
@@ -205,16 +894,44 @@ namespace FEM2A {
         return x.x * y.x + x.y * y.y ;
     }
 
+    /****************************************************************/
+    /* Implementation of LinearOperator */
+    /****************************************************************/
+    void LinearOperator::mult_multiple( int k, const std::vector< double >& X, std::vector< double >& Y ) const
+    {
+        const int n = nb_rows() ;
+        std::vector< double > x( n ), y( n ) ;
+        Y.resize( (size_t)k * n ) ;
+        for( int c = 0; c < k; ++c ) {
+            for( int i = 0; i < n; ++i ) x[i] = X[(size_t)k * i + c] ;
+            mult( x, y ) ;
+            for( int i = 0; i < n; ++i ) Y[(size_t)k * i + c] = y[i] ;
+        }
+    }
+
+    double LinearOperator::diagonal_entry( int i ) const
+    {
+        std::vector< double > d ;
+        diagonal( d ) ;
+        return d[i] ;
+    }
+
     /****************************************************************/
     /* Implementation of SparseMatrix */
     /****************************************************************/
 
-    SparseMatrix::SparseMatrix( int nb_dofs )
-        : cols_at_line_( nb_dofs ), val_at_line_( nb_dofs )
+    SparseMatrix::SparseMatrix( int nb_dofs, MemoryResource& resource )
+        : cols_at_line_( nb_dofs, Columns( Allocator< int >( resource ) ), Allocator< Columns >( resource ) ),
+        val_at_line_( nb_dofs, Values( Allocator< double >( resource ) ), Allocator< Values >( resource ) )
     {
 
     }
 
+    MemoryResource& SparseMatrix::resource() const
+    {
+        return cols_at_line_.get_allocator().resource() ;
+    }
+
     void SparseMatrix::add( int i, int j, double val )
     {
         bool found = false ;
@@ -244,15 +961,86 @@ namespace FEM2A {
             ASSERT(false,"Can't multiply a coefficient that does not exist") ;
         }
     }
-    const std::vector< int > & SparseMatrix::get_cols_at_line( int i ) const
+    const SparseMatrix::Columns& SparseMatrix::get_cols_at_line( int i ) const
     {
         return cols_at_line_[i] ;
     }
-    const std::vector< double > & SparseMatrix::get_vals_at_line( int i ) const
+    const SparseMatrix::Values& SparseMatrix::get_vals_at_line( int i ) const
     {
         return val_at_line_[i] ;
     }
 
+    void SparseMatrix::mult( const std::vector< double >& x, std::vector< double >& y ) const
+    {
+        y.resize( cols_at_line_.size() ) ;
+        ThreadPool::current().parallel_for( cols_at_line_.size(), SPMV_GRAIN, [&]( int begin, int end ) {
+            for( int i = begin; i < end; ++i ) {
+                const Columns& J = cols_at_line_[i] ;
+                const Values& V = val_at_line_[i] ;
+                double s = 0. ;
+                for( int k = 0; k < J.size(); ++k ) {
+                    s += V[k] * x[J[k]] ;
+                }
+                y[i] = s ;
+            }
+        } ) ;
+    }
+
+    void SparseMatrix::mult_multiple( int k, const std::vector< double >& X, std::vector< double >& Y ) const
+    {
+        Y.assign( (size_t)k * cols_at_line_.size(), 0. ) ;
+        ThreadPool::current().parallel_for( cols_at_line_.size(), SPMV_GRAIN, [&]( int begin, int end ) {
+            for( int i = begin; i < end; ++i ) {
+                const Columns& J = cols_at_line_[i] ;
+                const Values& V = val_at_line_[i] ;
+                double* y = &Y[(size_t)k * i] ;
+                for( int l = 0; l < J.size(); ++l ) {
+                    const double* x = &X[(size_t)k * J[l]] ;
+                    for( int c = 0; c < k; ++c ) {
+                        y[c] += V[l] * x[c] ;
+                    }
+                }
+            }
+        } ) ;
+    }
+
+    void SparseMatrix::diagonal( std::vector< double >& d ) const
+    {
+        d.assign( cols_at_line_.size(), 0. ) ;
+        for( int i = 0; i < cols_at_line_.size(); ++i ) {
+            for( int k = 0; k < cols_at_line_[i].size(); ++k ) {
+                if( cols_at_line_[i][k] == i ) d[i] += val_at_line_[i][k] ;
+            }
+        }
+    }
+
+    double SparseMatrix::diagonal_entry( int i ) const
+    {
+        double d = 0. ;
+        for( int k = 0; k < cols_at_line_[i].size(); ++k ) {
+            if( cols_at_line_[i][k] == i ) d += val_at_line_[i][k] ;
+        }
+        return d ;
+    }
+
+    size_t SparseMatrix::memory_bytes() const
+    {
+        size_t bytes = cols_at_line_.capacity() * sizeof( Columns )
+            + val_at_line_.capacity() * sizeof( Values ) ;
+        for( int i = 0; i < cols_at_line_.size(); ++i ) {
+            bytes += cols_at_line_[i].capacity() * sizeof( int )
+                + val_at_line_[i].capacity() * sizeof( double ) ;
+        }
+        return bytes ;
+    }
+
+    void SparseMatrix::fill( double val )
+    {
+        for( int i = 0; i < val_at_line_.size(); ++i ) {
+            std::fill( val_at_line_[i].begin(), val_at_line_[i].end(), val ) ;
+        }
+    }
+
     int SparseMatrix::nb_rows() const
     {
         return cols_at_line_.size() ;
@@ -262,8 +1050,8 @@ namespace FEM2A {
     {
         std::cout << std::setprecision(3);
         for(int i = 0; i < cols_at_line_.size(); ++i) {
-            const std::vector<int>& J = cols_at_line_[i];
-            const std::vector<double>& V = val_at_line_[i];
+            const Columns& J = cols_at_line_[i];
+            const Values& V = val_at_line_[i];
             std::cout << std::right << std::setw(3) << i << "|";
             for(int k = 0; k < J.size() ; ++k) {
                 std::cout << std::right << std::setw(6) << "(" << J[k] << "," << V[k] << ") ";
@@ -272,4 +1060,206 @@ namespace FEM2A {
         }
     }
 
+    template< class T >
+    void build_csr(
+        const SparseMatrix& A,
+        std::vector< int >& row_offsets,
+        std::vector< int >& cols,
+        std::vector< T >& vals )
+    {
+        const int n = A.nb_rows() ;
+        row_offsets.assign( n + 1, 0 ) ;
+        for( int i = 0; i < n; ++i ) {
+            row_offsets[i + 1] = row_offsets[i] + A.get_cols_at_line( i ).size() ;
+        }
+        cols.resize( row_offsets[n] ) ;
+        vals.resize( row_offsets[n] ) ;
+        for( int i = 0; i < n; ++i ) {
+            const SparseMatrix::Columns& J = A.get_cols_at_line( i ) ;
+            const SparseMatrix::Values& V = A.get_vals_at_line( i ) ;
+            std::copy( J.begin(), J.end(), cols.begin() + row_offsets[i] ) ;
+            std::copy( V.begin(), V.end(), vals.begin() + row_offsets[i] ) ;
+        }
+    }
+
+    template void build_csr( const SparseMatrix&, std::vector< int >&, std::vector< int >&, std::vector< double >& ) ;
+    template void build_csr( const SparseMatrix&, std::vector< int >&, std::vector< int >&, std::vector< float >& ) ;
+
+    /****************************************************************/
+    /* Implementation of CsrMatrix */
+    /****************************************************************/
+    CsrMatrix::CsrMatrix()
+        : row_offsets_( 1, 0 )
+    {
+
+    }
+
+    CsrMatrix::CsrMatrix( const SparseMatrix& A )
+    {
+        /* full rows: compress() only sorts their columns */
+        build_csr( A, row_offsets_, cols_, vals_ ) ;
+        row_sizes_.resize( A.nb_rows() ) ;
+        for( int i = 0; i < A.nb_rows(); ++i ) {
+            row_sizes_[i] = row_offsets_[i + 1] - row_offsets_[i] ;
+        }
+        compress() ;
+    }
+
+    void CsrMatrix::reserve( const std::vector< int >& capacities )
+    {
+        const int n = capacities.size() ;
+        row_offsets_.assign( n + 1, 0 ) ;
+        for( int i = 0; i < n; ++i ) {
+            row_offsets_[i + 1] = row_offsets_[i] + capacities[i] ;
+        }
+        row_sizes_.assign( n, 0 ) ;
+        cols_.assign( row_offsets_[n], 0 ) ;
+        vals_.assign( row_offsets_[n], 0. ) ;
+        overflow_.clear() ;
+    }
+
+    void CsrMatrix::add( int i, int j, double val )
+    {
+        const int begin = row_offsets_[i] ;
+        const int end = begin + row_sizes_[i] ;
+        for( int k = begin; k < end; ++k ) {
+            if( cols_[k] == j ) {
+                vals_[k] += val ;
+                return ;
+            }
+        }
+        if( end < row_offsets_[i + 1] ) {
+            cols_[end] = j ;
+            vals_[end] = val ;
+            ++row_sizes_[i] ;
+        } else {
+            Entry entry = { i, j, val } ;
+            overflow_.push_back( entry ) ;
+        }
+    }
+
+    void CsrMatrix::compress()
+    {
+        const int n = nb_rows() ;
+        if( !overflow_.empty() ) {
+            /* rebuild with the exact capacities, then fill again */
+            std::vector< int > capacities( row_sizes_ ) ;
+            for( int e = 0; e < overflow_.size(); ++e ) ++capacities[overflow_[e].i] ;
+            std::vector< int > offsets( row_offsets_ ) ;
+            std::vector< int > sizes( row_sizes_ ) ;
+            std::vector< int > cols ;
+            std::vector< double > vals ;
+            cols.swap( cols_ ) ;
+            vals.swap( vals_ ) ;
+            std::vector< Entry > overflow ;
+            overflow.swap( overflow_ ) ;
+            reserve( capacities ) ;
+            for( int i = 0; i < n; ++i ) {
+                for( int k = offsets[i]; k < offsets[i] + sizes[i]; ++k ) add( i, cols[k], vals[k] ) ;
+            }
+            for( int e = 0; e < overflow.size(); ++e ) {
+                add( overflow[e].i, overflow[e].j, overflow[e].val ) ;
+            }
+        }
+
+        /* shift the rows to the left, sorting their columns */
+        int next = 0 ;
+        for( int i = 0; i < n; ++i ) {
+            const int begin = row_offsets_[i] ;
+            const int size = row_sizes_[i] ;
+            row_offsets_[i] = next ;
+            for( int k = 0; k < size; ++k ) {
+                const int j = cols_[begin + k] ;
+                const double val = vals_[begin + k] ;
+                int l = next + k ;
+                while( l > next && cols_[l - 1] > j ) {
+                    cols_[l] = cols_[l - 1] ;
+                    vals_[l] = vals_[l - 1] ;
+                    --l ;
+                }
+                cols_[l] = j ;
+                vals_[l] = val ;
+            }
+            next += size ;
+        }
+        row_offsets_[n] = next ;
+        /* no shrink_to_fit: the copy would double the peak memory */
+        cols_.resize( next ) ;
+        vals_.resize( next ) ;
+    }
+
+    int CsrMatrix::nb_rows() const
+    {
+        return row_offsets_.size() - 1 ;
+    }
+
+    int CsrMatrix::nb_nonzeros() const
+    {
+        int nnz = overflow_.size() ;
+        for( int i = 0; i < row_sizes_.size(); ++i ) nnz += row_sizes_[i] ;
+        return nnz ;
+    }
+
+    void CsrMatrix::mult( const std::vector< double >& x, std::vector< double >& y ) const
+    {
+        assert( overflow_.empty() ) ;
+        const int n = nb_rows() ;
+        y.resize( n ) ;
+        ThreadPool::current().parallel_for( n, SPMV_GRAIN, [&]( int begin, int end ) {
+            for( int i = begin; i < end; ++i ) {
+                double s = 0. ;
+                const int row_end = row_offsets_[i] + row_sizes_[i] ;
+                for( int k = row_offsets_[i]; k < row_end; ++k ) {
+                    s += vals_[k] * x[cols_[k]] ;
+                }
+                y[i] = s ;
+            }
+        } ) ;
+    }
+
+    void CsrMatrix::diagonal( std::vector< double >& d ) const
+    {
+        d.assign( nb_rows(), 0. ) ;
+        for( int i = 0; i < nb_rows(); ++i ) {
+            for( int k = row_offsets_[i]; k < row_offsets_[i] + row_sizes_[i]; ++k ) {
+                if( cols_[k] == i ) d[i] += vals_[k] ;
+            }
+        }
+    }
+
+    double CsrMatrix::diagonal_entry( int i ) const
+    {
+        double d = 0. ;
+        for( int k = row_offsets_[i]; k < row_offsets_[i] + row_sizes_[i]; ++k ) {
+            if( cols_[k] == i ) d += vals_[k] ;
+        }
+        return d ;
+    }
+
+    const std::vector< int >& CsrMatrix::row_offsets() const
+    {
+        return row_offsets_ ;
+    }
+
+    int CsrMatrix::row_size( int i ) const
+    {
+        return row_sizes_[i] ;
+    }
+
+    const std::vector< int >& CsrMatrix::cols() const
+    {
+        return cols_ ;
+    }
+
+    const std::vector< double >& CsrMatrix::vals() const
+    {
+        return vals_ ;
+    }
+
+    size_t CsrMatrix::memory_bytes() const
+    {
+        return ( row_offsets_.capacity() + row_sizes_.capacity() + cols_.capacity() ) * sizeof( int )
+            + vals_.capacity() * sizeof( double ) + overflow_.capacity() * sizeof( Entry ) ;
+    }
+
 }
@@ -2,6 +2,9 @@
 
 #include "mesh.h"
 
+#include <string>
+#include <vector>
+
 namespace FEM2A {
 
     /**
@@ -33,15 +36,57 @@ namespace FEM2A {
             int width_ ;
     } ;
 
+    /**
+     * \brief LinearOperator is the interface used by the iterative
+     *        solvers of FEM2A (LinearSolver): a square operator that can
+     *        be applied to a vector and whose diagonal is known. It can
+     *        be an assembled SparseMatrix or a matrix-free operator.
+     */
+    class LinearOperator {
+        public:
+            virtual ~LinearOperator() {}
+
+            virtual int nb_rows() const = 0 ;
+
+            /**
+             * \brief Computes y = A x.
+             */
+            virtual void mult( const std::vector< double >& x, std::vector< double >& y ) const = 0 ;
+
+            /**
+             * \brief Computes Y = A X for k vectors stored interleaved
+             *        (X[k * i + c] is the i-th value of the c-th vector).
+             *        The default implementation calls mult() k times.
+             */
+            virtual void mult_multiple( int k, const std::vector< double >& X, std::vector< double >& Y ) const ;
+
+            /**
+             * \brief Fills d with the diagonal coefficients of A.
+             */
+            virtual void diagonal( std::vector< double >& d ) const = 0 ;
+
+            /**
+             * \return the diagonal coefficient of row i. The default
+             *         implementation extracts the whole diagonal.
+             */
+            virtual double diagonal_entry( int i ) const ;
+    } ;
+
     /**
      * \brief SparseMatrix is used to store (large) matrices mainly
      *        composed of zeros. Only the non-zero coefficients are
      *        stored (see the CSR -compressed row storage- format).
      */
-    class SparseMatrix {
+    class SparseMatrix : public LinearOperator {
         public:
-            SparseMatrix( int nb_rows ) ;
+            /* the coefficients of a row */
+            typedef ResourceVector< int > Columns ;
+            typedef ResourceVector< double > Values ;
+
+            /* the rows in the memory of resource (see MemoryResource) */
+            SparseMatrix( int nb_rows, MemoryResource& resource = MemoryResource::default_resource() ) ;
             int nb_rows() const ;
+            MemoryResource& resource() const ;
 
             /**
              * \brief Adds val to the (i,j) coefficient if it exists
@@ -67,20 +112,124 @@ namespace FEM2A {
              * \return a reference to a vector containing the indices
              * of the non-zero coefficients in row i.
              */
-            const std::vector< int > & get_cols_at_line( int i ) const ;
+            const Columns& get_cols_at_line( int i ) const ;
 
             /**
              * \param i row index
              * \return a reference to a vector containing the values
              * of the non-zero coefficients in row i.
              */
-            const std::vector< double > & get_vals_at_line( int i ) const ;
+            const Values& get_vals_at_line( int i ) const ;
+
+            /**
+             * \brief Computes the product y = M x.
+             */
+            void mult( const std::vector< double >& x, std::vector< double >& y ) const ;
+
+            /**
+             * \brief Computes Y = M X for k vectors stored interleaved
+             *        (X[k * i + c] is the i-th value of the c-th vector),
+             *        traversing the matrix once.
+             */
+            void mult_multiple( int k, const std::vector< double >& X, std::vector< double >& Y ) const ;
+
+            void diagonal( std::vector< double >& d ) const ;
+            double diagonal_entry( int i ) const ;
+
+            /**
+             * \return the number of bytes allocated by the matrix.
+             */
+            size_t memory_bytes() const ;
+
+            /**
+             * \brief Sets all the stored coefficients to val, keeping the
+             *        sparsity pattern.
+             */
+            void fill( double val ) ;
 
             void print() const ;
 
         private:
-            std::vector< std::vector< int > > cols_at_line_ ;
-            std::vector< std::vector< double > > val_at_line_ ;
+            ResourceVector< Columns > cols_at_line_ ;
+            ResourceVector< Values > val_at_line_ ;
+    } ;
+
+    /**
+     * \brief Copies the rows of A, in their order, to compressed row
+     *        arrays: row i is cols[row_offsets[i] .. row_offsets[i + 1])
+     *        with its values converted to T (double or float). The CSR
+     *        copies of CsrMatrix, MixedPrecisionSolver and SystemCache
+     *        are built with it.
+     */
+    template< class T >
+    void build_csr(
+        const SparseMatrix& A,
+        std::vector< int >& row_offsets,
+        std::vector< int >& cols,
+        std::vector< T >& vals ) ;
+
+    /**
+     * \brief CsrMatrix stores a sparse matrix in three contiguous arrays
+     *        (compressed row storage). Its rows are preallocated with a
+     *        given capacity, filled with add() and then compressed.
+     *
+     * Unlike SparseMatrix it does not allocate per row, so it can be
+     * filled by streaming assembly without reallocation.
+     */
+    class CsrMatrix : public LinearOperator {
+        public:
+            CsrMatrix() ;
+
+            /**
+             * \brief Copies the coefficients of a SparseMatrix.
+             */
+            explicit CsrMatrix( const SparseMatrix& A ) ;
+
+            /**
+             * \brief Clears the matrix and reserves capacities[i] entries
+             *        for row i.
+             */
+            void reserve( const std::vector< int >& capacities ) ;
+
+            /**
+             * \brief M(i,j) += val. Entries that do not fit in the capacity
+             *        of their row are kept aside until compress().
+             */
+            void add( int i, int j, double val ) ;
+
+            /**
+             * \brief Packs the rows at the beginning of the arrays, merges
+             *        the entries kept aside and sorts the columns of each
+             *        row. The unused capacity stays allocated.
+             */
+            void compress() ;
+
+            int nb_rows() const ;
+            int nb_nonzeros() const ;
+            void mult( const std::vector< double >& x, std::vector< double >& y ) const ;
+            void diagonal( std::vector< double >& d ) const ;
+            double diagonal_entry( int i ) const ;
+
+            /* row i: cols()[row_offsets()[i] .. row_offsets()[i] + row_size(i)) */
+            const std::vector< int >& row_offsets() const ;
+            int row_size( int i ) const ;
+            const std::vector< int >& cols() const ;
+            const std::vector< double >& vals() const ;
+
+            size_t memory_bytes() const ;
+
+        private:
+            struct Entry {
+                int i ;
+                int j ;
+                double val ;
+            } ;
+
+            std::vector< int > row_offsets_ ;
+            std::vector< int > row_sizes_ ;
+            std::vector< int > cols_ ;
+            std::vector< double > vals_ ;
+            std::vector< Entry > overflow_ ;
     } ;
 
     /**
@@ -88,19 +237,274 @@ namespace FEM2A {
      */
     double dot( vec2 x, vec2 y ) ;
 
+    /**
+     * \brief State of an iterative solve, given to the progress callback
+     *        at each iteration.
+     */
+    struct SolverProgress {
+        int iteration ;
+        int max_iterations ;
+        double residual ; /* ||Ax-b|| / ||b|| */
+        double elapsed ;  /* seconds since the beginning of the solve */
+    } ;
+
+    /**
+     * \brief Callback called at each iteration of solve().
+     * \return false to stop the solver (only honoured by the in-tree
+     *         PCG method: OpenNL cannot be interrupted).
+     */
+    typedef bool (*ProgressCallback)( const SolverProgress& progress, void* user_data ) ;
+
+    /**
+     * \brief Progress callback appending the residual norms to the
+     *        std::vector< double > given as user_data.
+     */
+    bool record_residual_history( const SolverProgress& progress, void* history ) ;
+
+    /**
+     * \brief SolverConfig gathers the parameters given to OpenNL by
+     *        solve(): iterative method, preconditioner, stopping
+     *        criterion and verbosity.
+     *
+     * The default values reproduce the historical behaviour of solve()
+     * (OpenNL default solver, threshold 1e-12, 1e6 iterations) without
+     * printing anything. PCG is a conjugate gradient implemented in
+     * FEM2A itself (no or Jacobi preconditioner) which can be stopped
+     * by the progress callback.
+     */
+    struct SolverConfig {
+        enum Method { DEFAULT, CG, BICGSTAB, GMRES, PCG } ;
+        enum Preconditioner { NONE, JACOBI, SSOR } ;
+
+        SolverConfig() ;
+
+        /**
+         * \brief Builds a configuration from command line arguments:
+         *        --solver <default|cg|bicgstab|gmres|pcg>,
+         *        --precond <none|jacobi|ssor>, --tol <threshold>,
+         *        --tol-mesh <factor>, --max-iter <n>, --auto-tune,
+         *        --mixed, -v/--verbose.
+         *        Unknown values keep the default setting.
+         */
+        static SolverConfig from_arguments(
+            const std::vector< std::string >& arguments ) ;
+
+        std::string name() const ;
+
+        /**
+         * \brief Ties the threshold to the discretization error of P1
+         *        elements: if discretization_factor > 0, the threshold
+         *        becomes discretization_factor * h^2 where h is the longest
+         *        triangle edge of M. Solving further than the O(h^2) error
+         *        of the discrete solution does not improve it.
+         *        Since the penalty terms of the Dirichlet conditions dominate
+         *        ||b||, the factor has to be small: on geothermie_0_1.mesh,
+         *        1e-9 keeps the error of the solution unchanged, 1e-5
+         *        multiplies it by about 1500 (--bench tolerance).
+         */
+        void adapt_to_mesh( const Mesh& M ) ;
+
+        Method method ;
+        Preconditioner preconditioner ;
+        double threshold ;
+        double discretization_factor ;
+        int max_iterations ;
+        bool verbose ;
+
+        ProgressCallback progress ;
+        void* progress_data ;
+
+        /**
+         * If true, the first system of a given size and sparsity pattern
+         * is solved with every candidate (method, preconditioner) pair and
+         * the fastest one is stored in tuning_cache for the next runs.
+         */
+        bool auto_tune ;
+        std::string tuning_cache ;
+
+        /**
+         * If true, the PCG method runs with a MixedPrecisionSolver: float
+         * matrix and preconditioner, refined in double.
+         */
+        bool mixed_precision ;
+    } ;
+
+    /**
+     * \brief LinearPreconditioner replaces the Jacobi preconditioner of a
+     *        LinearSolver. It must be symmetric positive definite for the
+     *        conjugate gradient to converge.
+     */
+    class LinearPreconditioner {
+        public:
+            virtual ~LinearPreconditioner() {}
+
+            /**
+             * \brief Computes z = P^{-1} r.
+             */
+            virtual void apply( const std::vector< double >& r, std::vector< double >& z ) const = 0 ;
+
+            /**
+             * \brief Called after the coefficients of the rows (and, A
+             *        being symmetric, columns) changed_rows of the matrix P
+             *        was built from have been modified in place (see
+             *        LinearSolver::update_preconditioner). The default does
+             *        nothing: P then still approximates the old matrix,
+             *        which only slows the convergence down.
+             */
+            virtual void update( const std::vector< int >& ) {}
+    } ;
+
+    /**
+     * \brief LinearSolver keeps a system operator and its preconditioner
+     *        to solve Ax=b for many right hand sides with the in-tree PCG
+     *        (SolverConfig::PCG) method.
+     *
+     * OpenNL rebuilds its matrix at every solve and cannot change the
+     * right hand side of a built system; LinearSolver builds the Jacobi
+     * preconditioner once, uses x as the initial guess (warm start) and
+     * keeps its work vectors between calls. A must outlive the solver.
+     */
+    class LinearSolver {
+        public:
+            LinearSolver( const LinearOperator& A, const SolverConfig& config ) ;
+
+            /**
+             * \brief Solves Ax=b starting from x if it has the right size,
+             *        from 0 otherwise.
+             * \return true if the solver has converged.
+             */
+            bool solve( const std::vector< double >& b, std::vector< double >& x ) ;
+
+            /**
+             * \brief Solves AX=B for k right hand sides stored interleaved
+             *        (see SparseMatrix::mult_multiple). The k conjugate
+             *        gradients run side by side and share each traversal
+             *        of A. X is the initial guess if it has the right size.
+             * \return true if all the systems have converged.
+             */
+            bool solve_multiple( int k, const std::vector< double >& B, std::vector< double >& X ) ;
+
+            /**
+             * \brief Rebuilds the preconditioner after the values of A
+             *        have been modified.
+             */
+            void update_preconditioner() ;
+
+            /**
+             * \brief Same as above when only the rows changed_rows of A
+             *        have been modified: the Jacobi preconditioner is
+             *        updated on these rows only, and the preconditioner
+             *        given to set_preconditioner() is passed the update.
+             */
+            void update_preconditioner( const std::vector< int >& changed_rows ) ;
+
+            /**
+             * \brief Uses P (which must outlive the solver) instead of the
+             *        preconditioner of the config in solve(); NULL goes back
+             *        to it. solve_multiple() always uses Jacobi.
+             */
+            void set_preconditioner( LinearPreconditioner* P ) ;
+
+            /* Statistics of the last call to solve() */
+            int iterations() const ;
+            double residual() const ;
+
+        private:
+            /* z = P^{-1} r */
+            void precondition( const std::vector< double >& r, std::vector< double >& z ) const ;
+
+            const LinearOperator& A_ ;
+            SolverConfig config_ ;
+            std::vector< double > inv_diag_ ;
+            LinearPreconditioner* preconditioner_ ;
+            std::vector< double > r_, z_, p_, q_ ;
+            int iterations_ ;
+            double residual_ ;
+    } ;
+
+    /**
+     * \brief MixedPrecisionSolver solves Ax=b with a copy of A whose values
+     *        and Jacobi preconditioner are stored in float (compressed
+     *        rows), halving the bytes read by the products.
+     *
+     * The inner conjugate gradient runs in single precision on the
+     * correction equation A d = r and only reduces the residual by
+     * inner_threshold (or less for the last refinement). An outer
+     * iterative refinement loop computes the residual r = b - Ax with the
+     * double matrix and updates x += d in double until ||r||/||b||
+     * reaches the threshold of the config.
+     */
+    class MixedPrecisionSolver {
+        public:
+            /**
+             * \param A The double matrix, must outlive the solver
+             * \param config threshold, max_iterations (inner iterations
+             *        summed over the refinements), preconditioner (none or
+             *        Jacobi) and verbose are used
+             */
+            MixedPrecisionSolver( const SparseMatrix& A, const SolverConfig& config ) ;
+
+            /**
+             * \brief Solves Ax=b starting from x if it has the right size,
+             *        from 0 otherwise.
+             * \return true if the solver has converged.
+             */
+            bool solve( const std::vector< double >& b, std::vector< double >& x ) ;
+
+            /* Statistics of the last call to solve() */
+            int iterations() const ;
+            int refinements() const ;
+            double residual() const ;
+
+            /**
+             * \return the number of bytes of the float matrix and
+             *         preconditioner.
+             */
+            size_t memory_bytes() const ;
+
+            static const double inner_threshold ;
+
+        private:
+            /* q = A_f p */
+            void mult_float( const std::vector< float >& p, std::vector< float >& q ) const ;
+
+            const SparseMatrix& A_ ;
+            SolverConfig config_ ;
+            /* A in float, see build_csr */
+            std::vector< int > row_offsets_ ;
+            std::vector< int > cols_ ;
+            std::vector< float > vals_ ;
+            std::vector< float > inv_diag_ ;
+            std::vector< float > r_, z_, p_, q_, d_ ;
+            int iterations_ ;
+            int refinements_ ;
+            double residual_ ;
+    } ;
+
     /**
      * \brief  Solve the linear system Ax=b
      *
      * \param A a square sparse matrix
      * \param b the right hand side vector
      * \param x the solution
+     * \param config the solver parameters
+     *
+     * OpenNL has a single current context per process: the OpenNL methods
+     * run one at a time, a concurrent call waits. PCG solves run in
+     * parallel.
      *
      * \return true if the solver has converged.
      */
     bool solve(
             const SparseMatrix& A,
             const std::vector<double>& b,
-            std::vector<double>& x);
+            std::vector<double>& x,
+            const SolverConfig& config = SolverConfig() );
+
+    /**
+     * \return the length of the longest edge of the triangles of M.
+     */
+    double mesh_size( const Mesh& M ) ;
 
     /**
      * \brief Basic test of the OpenNL library
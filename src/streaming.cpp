@@ -0,0 +1,240 @@
+#include "streaming.h"
+#include "fem.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace FEM2A {
+
+    static double seconds_since( std::chrono::steady_clock::time_point start )
+    {
+        return std::chrono::duration< double >(
+            std::chrono::steady_clock::now() - start ).count() ;
+    }
+
+    /**
+     * First pass: reads the vertices, flags the Dirichlet vertices, counts
+     * the triangles of each vertex and sets the position of the first
+     * triangle in the file (-1 if there is no triangle section). Returns
+     * false if a number cannot be read or an edge or a triangle refers to
+     * a vertex outside [1, nb vertices].
+     */
+    static bool scan_mesh(
+        std::ifstream& ifs,
+        const std::vector< bool >& attribute_is_dirichlet,
+        std::vector< vertex >& vertices,
+        std::vector< char >& is_dirichlet,
+        std::vector< int >& nb_triangles_at_vertex,
+        int& nb_triangles,
+        std::streampos& triangles_start )
+    {
+        triangles_start = -1 ;
+        int dim = 2 ;
+        nb_triangles = 0 ;
+        std::string keyword ;
+        while( ifs >> keyword ) {
+            if( keyword == "Dimension" ) {
+                if( !( ifs >> dim ) ) return false ;
+            } else if( keyword == "Vertices" ) {
+                int n ;
+                if( !( ifs >> n ) || n < 0 ) return false ;
+                vertices.resize( n ) ;
+                is_dirichlet.resize( n, 0 ) ;
+                nb_triangles_at_vertex.resize( n, 0 ) ;
+                double trash ;
+                int attribute ;
+                for( int v = 0; v < n; ++v ) {
+                    ifs >> vertices[v].x >> vertices[v].y ;
+                    if( dim == 3 ) ifs >> trash ;
+                    if( !( ifs >> attribute ) ) return false ;
+                }
+            } else if( keyword == "Edges" ) {
+                const int nb_vertices = vertices.size() ;
+                int n, a, b, attribute ;
+                if( !( ifs >> n ) ) return false ;
+                for( int e = 0; e < n; ++e ) {
+                    if( !( ifs >> a >> b >> attribute ) ) return false ;
+                    if( a < 1 || a > nb_vertices || b < 1 || b > nb_vertices ) return false ;
+                    if( attribute >= 0 && attribute < attribute_is_dirichlet.size()
+                        && attribute_is_dirichlet[attribute] ) {
+                        is_dirichlet[a - 1] = 1 ;
+                        is_dirichlet[b - 1] = 1 ;
+                    }
+                }
+            } else if( keyword == "Triangles" ) {
+                const int nb_vertices = vertices.size() ;
+                if( !( ifs >> nb_triangles ) ) return false ;
+                triangles_start = ifs.tellg() ;
+                int v[3], attribute ;
+                for( int t = 0; t < nb_triangles; ++t ) {
+                    if( !( ifs >> v[0] >> v[1] >> v[2] >> attribute ) ) return false ;
+                    for( int i = 0; i < 3; ++i ) {
+                        if( v[i] < 1 || v[i] > nb_vertices ) return false ;
+                        ++nb_triangles_at_vertex[v[i] - 1] ;
+                    }
+                }
+            }
+        }
+        return true ;
+    }
+
+    /* Ke and Fe of a triangle, computed from its vertices */
+    static void assemble_triangle(
+        const vertex* p,
+        const Quadrature& quadrature,
+        double (*diffusion_coef)(vertex),
+        double (*source_term)(vertex),
+        double Ke[3][3],
+        double Fe[3] )
+    {
+        const double twice_area = std::fabs(
+            ( p[1].x - p[0].x ) * ( p[2].y - p[0].y ) - ( p[2].x - p[0].x ) * ( p[1].y - p[0].y ) ) ;
+        double k = 0. ;
+        Fe[0] = Fe[1] = Fe[2] = 0. ;
+        for( int q = 0; q < quadrature.nb_points(); ++q ) {
+            const vertex xi = quadrature.point( q ) ;
+            const double phi[3] = { 1 - xi.x - xi.y, xi.x, xi.y } ;
+            vertex x ;
+            x.x = phi[0] * p[0].x + phi[1] * p[1].x + phi[2] * p[2].x ;
+            x.y = phi[0] * p[0].y + phi[1] * p[1].y + phi[2] * p[2].y ;
+            k += quadrature.weight( q ) * diffusion_coef( x ) ;
+            const double f = quadrature.weight( q ) * source_term( x ) * twice_area ;
+            for( int i = 0; i < 3; ++i ) Fe[i] += f * phi[i] ;
+        }
+        /* Ke_ij = k / (2 |T|) e_i . e_j, e_i being the edge opposite to i */
+        double e[3][2] ;
+        for( int i = 0; i < 3; ++i ) {
+            e[i][0] = p[( i + 2 ) % 3].x - p[( i + 1 ) % 3].x ;
+            e[i][1] = p[( i + 2 ) % 3].y - p[( i + 1 ) % 3].y ;
+        }
+        for( int i = 0; i < 3; ++i ) {
+            for( int j = 0; j < 3; ++j ) {
+                Ke[i][j] = k / twice_area * ( e[i][0] * e[j][0] + e[i][1] * e[j][1] ) ;
+            }
+        }
+    }
+
+    bool assemble_streaming(
+        const std::string& mesh_filename,
+        double (*diffusion_coef)(vertex),
+        double (*source_term)(vertex),
+        const std::vector< bool >& attribute_is_dirichlet,
+        double (*dirichlet_fct)(vertex),
+        std::vector< vertex >& vertices,
+        CsrMatrix& K,
+        std::vector< double >& F,
+        StreamingReport* report,
+        int chunk_size,
+        int queue_capacity )
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+        std::ifstream ifs( mesh_filename.c_str() ) ;
+        if( !ifs.is_open() ) {
+            std::cout << "Error while opening the file, check the name" << std::endl ;
+            return false ;
+        }
+
+        std::vector< char > is_dirichlet ;
+        std::vector< int > row_capacities ;
+        int nb_triangles = 0 ;
+        std::streampos triangles_start ;
+        if( !scan_mesh( ifs, attribute_is_dirichlet, vertices, is_dirichlet, row_capacities,
+            nb_triangles, triangles_start ) ) {
+            std::cout << "Error: " << mesh_filename << " is not a valid mesh or refers to unknown vertices"
+                << std::endl ;
+            return false ;
+        }
+        const int n = vertices.size() ;
+        /* a vertex inside a manifold mesh has as many neighbors as triangles,
+         * one more on the border; rows exceeding the bound are merged later */
+        for( int v = 0; v < n; ++v ) {
+            row_capacities[v] += row_capacities[v] > 0 ? 2 : 1 ;
+        }
+        K.reserve( row_capacities ) ;
+        std::vector< int >().swap( row_capacities ) ;
+        F.assign( n, 0. ) ;
+        const double scan_time = seconds_since( start ) ;
+
+        /* second pass: the parser thread reads the triangles by chunks */
+        BoundedQueue< std::vector< int > > queue( queue_capacity ) ;
+        double parse_time = 0. ;
+        int nb_chunks = 0 ;
+        ifs.clear() ;
+        ifs.seekg( triangles_start ) ;
+        std::thread parser( [&]() {
+            std::chrono::steady_clock::time_point parse_start = std::chrono::steady_clock::now() ;
+            for( int first = 0; triangles_start != std::streampos( -1 ) && first < nb_triangles;
+                first += chunk_size ) {
+                const int size = std::min( chunk_size, nb_triangles - first ) ;
+                std::vector< int > chunk( 3 * size ) ;
+                int attribute ;
+                for( int t = 0; t < size; ++t ) {
+                    ifs >> chunk[3 * t] >> chunk[3 * t + 1] >> chunk[3 * t + 2] >> attribute ;
+                }
+                ++nb_chunks ;
+                if( !queue.push( chunk ) ) break ;
+            }
+            queue.close() ;
+            parse_time = seconds_since( parse_start ) ;
+        } ) ;
+
+        const Quadrature quadrature = Quadrature::get_quadrature( 2 ) ;
+        double assembly_time = 0. ;
+        bool valid = true ;
+        std::vector< int > chunk ;
+        while( queue.pop( chunk ) ) {
+            std::chrono::steady_clock::time_point chunk_start = std::chrono::steady_clock::now() ;
+            for( int t = 0; t < chunk.size() / 3; ++t ) {
+                int v[3] ;
+                vertex p[3] ;
+                bool known = true ;
+                for( int i = 0; i < 3; ++i ) {
+                    v[i] = chunk[3 * t + i] - 1 ;
+                    known = known && v[i] >= 0 && v[i] < n ;
+                }
+                if( !known ) {
+                    valid = false ;
+                    continue ;
+                }
+                for( int i = 0; i < 3; ++i ) p[i] = vertices[v[i]] ;
+                double Ke[3][3], Fe[3] ;
+                assemble_triangle( p, quadrature, diffusion_coef, source_term, Ke, Fe ) ;
+                for( int i = 0; i < 3; ++i ) {
+                    for( int j = 0; j < 3; ++j ) K.add( v[i], v[j], Ke[i][j] ) ;
+                    F[v[i]] += Fe[i] ;
+                }
+            }
+            assembly_time += seconds_since( chunk_start ) ;
+        }
+        parser.join() ;
+        if( !valid ) {
+            std::cout << "Error: " << mesh_filename << " refers to unknown vertices" << std::endl ;
+            return false ;
+        }
+
+        for( int v = 0; v < is_dirichlet.size(); ++v ) {
+            if( !is_dirichlet[v] ) continue ;
+            K.add( v, v, dirichlet_penalty ) ;
+            F[v] += dirichlet_penalty * dirichlet_fct( vertices[v] ) ;
+        }
+        K.compress() ;
+
+        if( report != NULL ) {
+            report->nb_vertices = n ;
+            report->nb_triangles = nb_triangles ;
+            report->nb_chunks = nb_chunks ;
+            report->max_queued_chunks = queue.max_size() ;
+            report->nb_full_waits = queue.nb_full_waits() ;
+            report->scan_time = scan_time ;
+            report->parse_time = parse_time ;
+            report->assembly_time = assembly_time ;
+            report->total_time = seconds_since( start ) ;
+        }
+        return true ;
+    }
+
+}
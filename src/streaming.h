@@ -0,0 +1,56 @@
+#pragma once
+
+#include "mesh.h"
+#include "solver.h"
+
+#include <string>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief Statistics of assemble_streaming().
+     */
+    struct StreamingReport {
+        int nb_vertices ;
+        int nb_triangles ;
+        int nb_chunks ;
+        int max_queued_chunks ; /* largest number of parsed chunks waiting */
+        int nb_full_waits ;     /* times the parser waited for the assembly */
+        double scan_time ;      /* seconds of the first pass */
+        double parse_time ;     /* seconds of the parser thread */
+        double assembly_time ;  /* seconds spent assembling the chunks */
+        double total_time ;
+    } ;
+
+    /**
+     * \brief Assembles the P1 system of -div(k grad u) = f with u = g on
+     *        the Dirichlet edges (penalty method) directly from a medit
+     *        .mesh file, without building a Mesh.
+     *
+     * A first pass keeps the vertex coordinates, flags the Dirichlet
+     * vertices and counts the triangles around each vertex, which bounds
+     * the size of the rows: K is preallocated once with these bounds.
+     * In the second pass a parser thread reads the triangles by chunks of
+     * chunk_size and hands them through a BoundedQueue of queue_capacity
+     * chunks to the calling thread, which assembles them into K and F while
+     * the next chunks are parsed. Only the vertices, K and F stay in memory.
+     *
+     * \param vertices Filled with the vertex coordinates
+     * \return false if the file could not be read or refers to unknown
+     *         vertices.
+     */
+    bool assemble_streaming(
+        const std::string& mesh_filename,
+        double (*diffusion_coef)(vertex),
+        double (*source_term)(vertex),
+        const std::vector< bool >& attribute_is_dirichlet,
+        double (*dirichlet_fct)(vertex),
+        std::vector< vertex >& vertices,
+        CsrMatrix& K,
+        std::vector< double >& F,
+        StreamingReport* report = NULL,
+        int chunk_size = 8192,
+        int queue_capacity = 4 ) ;
+
+}
@@ -0,0 +1,211 @@
+#include "sweep.h"
+
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <atomic>
+#include <assert.h>
+
+namespace FEM2A {
+
+    /****************************************************************/
+    /* Implementation of SweepEngine */
+    /****************************************************************/
+    SweepEngine::SweepEngine(
+        const Mesh& M,
+        const std::vector< bool >& attribute_is_dirichlet,
+        const SolverConfig& config,
+        ThreadPool& pool )
+        : mesh_( M ), attribute_is_dirichlet_( attribute_is_dirichlet ),
+        config_( config ), pool_( pool ), pattern_( M.nb_vertices() ),
+        quadrature_( Quadrature::get_quadrature( 2 ) ), writer_( NULL )
+    {
+        const int nt = M.nb_triangles() ;
+        const int nq = quadrature_.nb_points() ;
+        ShapeFunctions shape_functions( 2, 1 ) ;
+
+        phi_.resize( 3 * nq ) ;
+        for( int q = 0; q < nq; ++q ) {
+            for( int i = 0; i < 3; ++i ) {
+                phi_[3 * q + i] = shape_functions.evaluate( i, quadrature_.point( q ) ) ;
+            }
+        }
+
+        jacobian_.resize( nt ) ;
+        gradients_.resize( 3 * nt ) ;
+        points_.resize( nq * nt ) ;
+        for( int t = 0; t < nt; ++t ) {
+            ElementMapping mapping( M, false, t ) ;
+            vertex center = quadrature_.point( 0 ) ;
+            jacobian_[t] = mapping.jacobian( center ) ;
+            const Mat< 3, 2 > G = shape_functions.evaluate_grads( center )
+                * inverse( mapping.jacobian_matrix_2x2( center ) ) ;
+            for( int i = 0; i < 3; ++i ) {
+                gradients_[3 * t + i] = vec2{ G( i, 0 ), G( i, 1 ) } ;
+                for( int j = 0; j < 3; ++j ) {
+                    pattern_.add( M.get_triangle_vertex_index( t, i ),
+                        M.get_triangle_vertex_index( t, j ), 0. ) ;
+                }
+            }
+            for( int q = 0; q < nq; ++q ) {
+                points_[nq * t + q] = mapping.transform( quadrature_.point( q ) ) ;
+            }
+        }
+
+        std::vector< bool > seen( M.nb_vertices(), false ) ;
+        for( int e = 0; e < M.nb_edges(); ++e ) {
+            if( !attribute_is_dirichlet_[M.get_edge_attribute( e )] ) continue ;
+            for( int i = 0; i < 2; ++i ) {
+                const int v = M.get_edge_vertex_index( e, i ) ;
+                if( !seen[v] ) {
+                    seen[v] = true ;
+                    dirichlet_vertices_.push_back( v ) ;
+                }
+            }
+        }
+    }
+
+    int SweepEngine::add_scenario( const Scenario& scenario )
+    {
+        const int index = scenarios_.size() ;
+        scenarios_.push_back( scenario ) ;
+        std::string& name = scenarios_.back().name ;
+        if( name.empty() ) name = "scenario" ;
+        else if( !names_.count( name ) ) {
+            names_.insert( name ) ;
+            solutions_.push_back( std::vector< double >() ) ;
+            return index ;
+        }
+        /* a suffix may give an earlier name ("a", "a_2", "a"): suffixed again */
+        do {
+            std::ostringstream unique ;
+            unique << name << "_" << index ;
+            name = unique.str() ;
+        } while( names_.count( name ) ) ;
+        names_.insert( name ) ;
+        solutions_.push_back( std::vector< double >() ) ;
+        return index ;
+    }
+
+    int SweepEngine::nb_scenarios() const
+    {
+        return scenarios_.size() ;
+    }
+
+    const std::string& SweepEngine::name( int i ) const
+    {
+        return scenarios_[i].name ;
+    }
+
+    const std::vector< double >& SweepEngine::solution( int i ) const
+    {
+        return solutions_[i] ;
+    }
+
+    bool SweepEngine::solve_group( const std::vector< int >& members )
+    {
+        const int n = mesh_.nb_vertices() ;
+        const int nt = mesh_.nb_triangles() ;
+        const int nq = quadrature_.nb_points() ;
+        const int k = members.size() ;
+        const Scenario& first = scenarios_[members[0]] ;
+
+        SparseMatrix K( pattern_ ) ;
+        std::vector< double > F( (size_t)n * k, 0. ) ;
+        for( int t = 0; t < nt; ++t ) {
+            int v[3] ;
+            for( int i = 0; i < 3; ++i ) v[i] = mesh_.get_triangle_vertex_index( t, i ) ;
+            const vec2* grad = &gradients_[3 * t] ;
+            double coef = 0. ;
+            for( int q = 0; q < nq; ++q ) {
+                coef += quadrature_.weight( q ) * first.diffusion( points_[nq * t + q] ) ;
+            }
+            coef *= jacobian_[t] ;
+            for( int i = 0; i < 3; ++i ) {
+                for( int j = 0; j < 3; ++j ) {
+                    K.add( v[i], v[j], coef * dot( grad[i], grad[j] ) ) ;
+                }
+            }
+            for( int c = 0; c < k; ++c ) {
+                const ScalarField& source = scenarios_[members[c]].source ;
+                for( int q = 0; q < nq; ++q ) {
+                    const double w = quadrature_.weight( q ) * jacobian_[t]
+                        * source( points_[nq * t + q] ) ;
+                    for( int i = 0; i < 3; ++i ) {
+                        F[(size_t)k * v[i] + c] += w * phi_[3 * q + i] ;
+                    }
+                }
+            }
+        }
+        for( int d = 0; d < dirichlet_vertices_.size(); ++d ) {
+            const int v = dirichlet_vertices_[d] ;
+            K.add( v, v, dirichlet_penalty ) ;
+            for( int c = 0; c < k; ++c ) {
+                F[(size_t)k * v + c] += dirichlet_penalty
+                    * scenarios_[members[c]].dirichlet( mesh_.get_vertex( v ) ) ;
+            }
+        }
+
+        /* the right hand sides together with PCG, one by one otherwise */
+        const bool multiple = config_.method == SolverConfig::PCG && !config_.mixed_precision
+            && !config_.auto_tune ;
+        bool converged = true ;
+        std::vector< double > U, f( multiple ? 0 : n ) ;
+        if( multiple ) converged = LinearSolver( K, config_ ).solve_multiple( k, F, U ) ;
+        for( int c = 0; c < k; ++c ) {
+            std::vector< double >& u = solutions_[members[c]] ;
+            if( multiple ) {
+                u.resize( n ) ;
+                for( int i = 0; i < n; ++i ) u[i] = U[(size_t)k * i + c] ;
+            } else {
+                for( int i = 0; i < n; ++i ) f[i] = F[(size_t)k * i + c] ;
+                if( !solve( K, f, u, config_ ) ) converged = false ;
+            }
+            if( writer_ ) {
+                writer_->write( std::move( u ), writer_prefix_ + "_" + scenarios_[members[c]].name ) ;
+            }
+        }
+        return converged ;
+    }
+
+    bool SweepEngine::run()
+    {
+        std::map< int, std::vector< int > > by_lhs ;
+        for( int s = 0; s < scenarios_.size(); ++s ) {
+            by_lhs[scenarios_[s].lhs_key].push_back( s ) ;
+        }
+        std::vector< std::vector< int > > groups ;
+        for( std::map< int, std::vector< int > >::const_iterator it = by_lhs.begin();
+            it != by_lhs.end(); ++it ) {
+            groups.push_back( it->second ) ;
+        }
+
+        /* groups may have very different sizes: one task per group, balanced by stealing */
+        std::atomic< bool > all_converged( true ) ;
+        pool_.parallel_for( groups.size(), 1, [&]( int begin, int end ) {
+            for( int g = begin; g < end; ++g ) {
+                if( !solve_group( groups[g] ) ) all_converged = false ;
+            }
+        } ) ;
+        if( config_.verbose ) {
+            std::cout << scenarios_.size() << " scenarios solved in "
+                << groups.size() << " groups" << std::endl ;
+        }
+        return all_converged ;
+    }
+
+    void SweepEngine::set_writer( AsyncWriter* writer, const std::string& prefix )
+    {
+        writer_ = writer ;
+        writer_prefix_ = prefix ;
+    }
+
+    void SweepEngine::save( const std::string& prefix ) const
+    {
+        mesh_.save( prefix + ".mesh" ) ;
+        for( int s = 0; s < scenarios_.size(); ++s ) {
+            save_solution( solutions_[s], prefix + "_" + scenarios_[s].name + ".bb" ) ;
+        }
+    }
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "solver.h"
+#include "parallel.h"
+#include "async_writer.h"
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief One Poisson problem -div(k grad u) = f with u = g on the
+     *        Dirichlet edges, to be solved by a SweepEngine.
+     *
+     * Scenarios with the same lhs_key must have the same diffusion
+     * coefficient: they share the stiffness matrix and are solved
+     * together as a single multi right hand side system.
+     */
+    struct Scenario {
+        std::string name ;
+        int lhs_key ;
+        ScalarField diffusion ;
+        ScalarField source ;
+        ScalarField dirichlet ;
+    } ;
+
+    /**
+     * \brief SweepEngine solves many scenarios on one mesh.
+     *
+     * The mesh, its sparsity pattern and the geometry of its triangles
+     * (jacobians, shape function gradients, quadrature points) are built
+     * once and shared read-only by all the scenarios. Groups of scenarios
+     * sharing a left hand side are dispatched over a ThreadPool; each
+     * group assembles its matrix once and solves all its right hand
+     * sides with LinearSolver::solve_multiple if the method is PCG, one
+     * after the other with solve() for the other methods of the config.
+     */
+    class SweepEngine {
+        public:
+            /**
+             * \param M The mesh, must outlive the engine
+             * \param attribute_is_dirichlet Edge attributes where the
+             *        Dirichlet function of the scenarios is imposed
+             * \param config The solver of the groups (see solve()); PCG
+             *        solves the right hand sides of a group together
+             * \param pool The threads the groups are dispatched to
+             */
+            SweepEngine(
+                const Mesh& M,
+                const std::vector< bool >& attribute_is_dirichlet,
+                const SolverConfig& config,
+                ThreadPool& pool = ThreadPool::global() ) ;
+
+            /**
+             * \brief Adds a scenario. An empty name is replaced by
+             *        "scenario_<index>" and a name already used gets
+             *        "_<index>" appended, again until it is unused, so
+             *        that outputs never collide.
+             * \return the index of the scenario
+             */
+            int add_scenario( const Scenario& scenario ) ;
+
+            int nb_scenarios() const ;
+            const std::string& name( int i ) const ;
+
+            /**
+             * \brief Solves all the scenarios.
+             * \return true if all the solves have converged.
+             */
+            bool run() ;
+
+            const std::vector< double >& solution( int i ) const ;
+
+            /**
+             * \brief Writes <prefix>.mesh once and <prefix>_<name>.bb for
+             *        each scenario.
+             */
+            void save( const std::string& prefix ) const ;
+
+            /**
+             * \brief Hands each solution to writer, as <prefix>_<name>,
+             *        as soon as its group is solved, so that the outputs
+             *        overlap with the solves of the other groups. The
+             *        solutions are moved to the writer: solution() is
+             *        then empty. NULL (the default) keeps them.
+             */
+            void set_writer( AsyncWriter* writer, const std::string& prefix ) ;
+
+        private:
+            bool solve_group( const std::vector< int >& members ) ;
+
+            const Mesh& mesh_ ;
+            std::vector< bool > attribute_is_dirichlet_ ;
+            std::vector< int > dirichlet_vertices_ ;
+            SolverConfig config_ ;
+            ThreadPool& pool_ ;
+            SparseMatrix pattern_ ;
+
+            /* geometry of the triangles, computed once */
+            Quadrature quadrature_ ;
+            std::vector< double > phi_ ;      /* phi_i at quadrature point q: 3 * q + i */
+            std::vector< double > jacobian_ ; /* |J| per triangle */
+            std::vector< vec2 > gradients_ ;  /* 3 world gradients per triangle */
+            std::vector< vertex > points_ ;   /* world quadrature points per triangle */
+
+            std::vector< Scenario > scenarios_ ;
+            std::set< std::string > names_ ;      /* of the scenarios */
+            std::vector< std::vector< double > > solutions_ ;
+            AsyncWriter* writer_ ;
+            std::string writer_prefix_ ;
+    } ;
+
+}
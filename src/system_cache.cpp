@@ -0,0 +1,336 @@
+#include "system_cache.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <sstream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace FEM2A {
+
+    uint64_t content_hash( const void* data, size_t n, uint64_t h )
+    {
+        const unsigned char* bytes = static_cast< const unsigned char* >( data ) ;
+        for( size_t i = 0; i < n; ++i ) {
+            h ^= bytes[i] ;
+            h *= 1099511628211ULL ;
+        }
+        return h ;
+    }
+
+    uint64_t mesh_content_hash( const Mesh& M )
+    {
+        int sizes[3] = { M.nb_vertices(), M.nb_triangles(), M.nb_edges() } ;
+        uint64_t h = content_hash( sizes, sizeof( sizes ) ) ;
+        for( int v = 0; v < M.nb_vertices(); ++v ) {
+            const vertex p = M.get_vertex( v ) ;
+            const double xy[2] = { p.x, p.y } ;
+            h = content_hash( xy, sizeof( xy ), h ) ;
+        }
+        for( int t = 0; t < M.nb_triangles(); ++t ) {
+            const int triangle[4] = { M.get_triangle_vertex_index( t, 0 ), M.get_triangle_vertex_index( t, 1 ),
+                M.get_triangle_vertex_index( t, 2 ), M.get_triangle_attribute( t ) } ;
+            h = content_hash( triangle, sizeof( triangle ), h ) ;
+        }
+        for( int e = 0; e < M.nb_edges(); ++e ) {
+            const int edge[3] = { M.get_edge_vertex_index( e, 0 ), M.get_edge_vertex_index( e, 1 ),
+                M.get_edge_attribute( e ) } ;
+            h = content_hash( edge, sizeof( edge ), h ) ;
+        }
+        return h ;
+    }
+
+    /* checksum of the files: 8 bytes per step, a few GB/s */
+    static uint64_t checksum( const char* data, size_t n )
+    {
+        uint64_t h = n ^ 0x9e3779b97f4a7c15ULL ;
+        size_t i = 0 ;
+        for( ; i + 8 <= n; i += 8 ) {
+            uint64_t word ;
+            memcpy( &word, data + i, 8 ) ;
+            h = ( h ^ word ) * 0xff51afd7ed558ccdULL ;
+            h ^= h >> 32 ;
+        }
+        return content_hash( data + i, n - i, h ) ;
+    }
+
+    /****************************************************************/
+    /* Implementation of SystemKey */
+    /****************************************************************/
+    SystemKey::SystemKey()
+        : mesh_hash( 0 ), element_order( 1 ), quadrature_order( 2 )
+    {
+    }
+
+    std::string SystemKey::to_string() const
+    {
+        std::ostringstream out ;
+        out << "mesh=" << std::hex << mesh_hash << std::dec << " order=" << element_order
+            << " quadrature=" << quadrature_order << " coefficients=" << coefficients ;
+        return out.str() ;
+    }
+
+    uint64_t SystemKey::hash() const
+    {
+        const std::string text = to_string() ;
+        return content_hash( text.data(), text.size() ) ;
+    }
+
+    /****************************************************************/
+    /* File layout */
+    /****************************************************************/
+    static const char system_magic[8] = { 'F', 'E', 'M', '2', 'A', 'S', 'C', '1' } ;
+    static const uint32_t system_version = 1 ;
+    static const uint32_t endianness_tag = 0x01020304 ;
+
+    enum Section { ROW_OFFSETS, COLS, VALS, RHS, INV_DIAG, NB_SECTIONS } ;
+
+    struct SystemFileHeader {
+        char magic[8] ;
+        uint32_t version ;
+        uint32_t endianness ;
+        uint64_t key_hash ;
+        uint64_t key_length ;
+        uint64_t nb_rows ;
+        uint64_t nb_nonzeros ;
+        uint64_t offsets[NB_SECTIONS] ;
+        uint64_t file_size ;
+        uint64_t payload_checksum ;  /* bytes after the header */
+        uint64_t header_checksum ;   /* bytes before this field */
+    } ;
+
+    static uint64_t align8( uint64_t offset )
+    {
+        return ( offset + 7 ) & ~(uint64_t)7 ;
+    }
+
+    /****************************************************************/
+    /* Implementation of MappedSystem */
+    /****************************************************************/
+    MappedSystem::MappedSystem( void* address, size_t size )
+        : address_( address ), size_( size ), nb_rows_( 0 ), nb_nonzeros_( 0 ),
+        row_offsets_( NULL ), cols_( NULL ), vals_( NULL ), rhs_( NULL )
+    {
+        jacobi_.inv_diag = NULL ;
+    }
+
+    MappedSystem::~MappedSystem()
+    {
+        munmap( address_, size_ ) ;
+    }
+
+    int MappedSystem::nb_rows() const
+    {
+        return nb_rows_ ;
+    }
+
+    int MappedSystem::nb_nonzeros() const
+    {
+        return nb_nonzeros_ ;
+    }
+
+    void MappedSystem::mult( const std::vector< double >& x, std::vector< double >& y ) const
+    {
+        y.resize( nb_rows_ ) ;
+        for( int i = 0; i < nb_rows_; ++i ) {
+            double sum = 0. ;
+            for( int k = row_offsets_[i]; k < row_offsets_[i + 1]; ++k ) {
+                sum += vals_[k] * x[cols_[k]] ;
+            }
+            y[i] = sum ;
+        }
+    }
+
+    void MappedSystem::diagonal( std::vector< double >& d ) const
+    {
+        d.assign( nb_rows_, 0. ) ;
+        for( int i = 0; i < nb_rows_; ++i ) {
+            for( int k = row_offsets_[i]; k < row_offsets_[i + 1]; ++k ) {
+                if( cols_[k] == i ) d[i] += vals_[k] ;
+            }
+        }
+    }
+
+    const double* MappedSystem::rhs() const
+    {
+        return rhs_ ;
+    }
+
+    LinearPreconditioner& MappedSystem::preconditioner()
+    {
+        return jacobi_ ;
+    }
+
+    size_t MappedSystem::file_bytes() const
+    {
+        return size_ ;
+    }
+
+    void MappedSystem::Jacobi::apply( const std::vector< double >& r, std::vector< double >& z ) const
+    {
+        z.resize( r.size() ) ;
+        for( int i = 0; i < r.size(); ++i ) z[i] = inv_diag[i] * r[i] ;
+    }
+
+    /****************************************************************/
+    /* Implementation of SystemCache */
+    /****************************************************************/
+    SystemCache::SystemCache( const std::string& directory, bool verify )
+        : directory_( directory ), verify_( verify ), nb_hits_( 0 ), nb_misses_( 0 ),
+        nb_rejected_( 0 )
+    {
+        mkdir( directory_.c_str(), 0755 ) ;
+    }
+
+    std::string SystemCache::filename( const SystemKey& key ) const
+    {
+        char name[32] ;
+        snprintf( name, sizeof( name ), "%016llx.fsc", (unsigned long long)key.hash() ) ;
+        return directory_ + "/" + name ;
+    }
+
+    bool SystemCache::store( const SystemKey& key, const SparseMatrix& K, const std::vector< double >& F )
+    {
+        const int n = K.nb_rows() ;
+        if( F.size() != n ) return false ;
+        const std::string key_text = key.to_string() ;
+
+        /* rows in the order of SparseMatrix: same products, bit for bit */
+        std::vector< int > row_offsets, cols ;
+        std::vector< double > vals ;
+        build_csr( K, row_offsets, cols, vals ) ;
+        const uint64_t nnz = row_offsets[n] ;
+        std::vector< double > inv_diag( n, 1. ) ;
+        for( int i = 0; i < n; ++i ) {
+            const double d = K.diagonal_entry( i ) ;
+            if( d != 0. ) inv_diag[i] = 1. / d ;
+        }
+
+        SystemFileHeader header ;
+        memset( &header, 0, sizeof( header ) ) ;
+        memcpy( header.magic, system_magic, 8 ) ;
+        header.version = system_version ;
+        header.endianness = endianness_tag ;
+        header.key_hash = key.hash() ;
+        header.key_length = key_text.size() ;
+        header.nb_rows = n ;
+        header.nb_nonzeros = nnz ;
+        const void* data[NB_SECTIONS] = { row_offsets.data(), cols.data(), vals.data(), F.data(), inv_diag.data() } ;
+        const uint64_t bytes[NB_SECTIONS] = { ( n + 1 ) * sizeof( int ), nnz * sizeof( int ),
+            nnz * sizeof( double ), n * sizeof( double ), n * sizeof( double ) } ;
+        uint64_t offset = align8( sizeof( header ) + key_text.size() ) ;
+        for( int s = 0; s < NB_SECTIONS; ++s ) {
+            header.offsets[s] = offset ;
+            offset = align8( offset + bytes[s] ) ;
+        }
+        header.file_size = offset ;
+
+        std::vector< char > file( header.file_size, 0 ) ;
+        memcpy( file.data() + sizeof( header ), key_text.data(), key_text.size() ) ;
+        for( int s = 0; s < NB_SECTIONS; ++s ) {
+            memcpy( file.data() + header.offsets[s], data[s], bytes[s] ) ;
+        }
+        header.payload_checksum = checksum( file.data() + sizeof( header ), file.size() - sizeof( header ) ) ;
+        header.header_checksum = checksum( (const char*)&header, offsetof( SystemFileHeader, header_checksum ) ) ;
+        memcpy( file.data(), &header, sizeof( header ) ) ;
+
+        const std::string final_name = filename( key ) ;
+        std::ostringstream temporary ;
+        temporary << final_name << ".tmp." << getpid() << "." << this ;
+        FILE* out = fopen( temporary.str().c_str(), "wb" ) ;
+        if( out == NULL ) return false ;
+        const bool written = fwrite( file.data(), 1, file.size(), out ) == file.size() ;
+        if( fclose( out ) != 0 || !written || rename( temporary.str().c_str(), final_name.c_str() ) != 0 ) {
+            std::remove( temporary.str().c_str() ) ;
+            return false ;
+        }
+        return true ;
+    }
+
+    std::unique_ptr< MappedSystem > SystemCache::load( const SystemKey& key )
+    {
+        std::unique_ptr< MappedSystem > system ;
+        const int fd = open( filename( key ).c_str(), O_RDONLY ) ;
+        if( fd < 0 ) {
+            ++nb_misses_ ;
+            return system ;
+        }
+        struct stat status ;
+        void* address = MAP_FAILED ;
+        if( fstat( fd, &status ) == 0 && status.st_size >= sizeof( SystemFileHeader ) ) {
+            address = mmap( NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0 ) ;
+        }
+        close( fd ) ;
+        if( address == MAP_FAILED ) {
+            ++nb_rejected_ ;
+            return system ;
+        }
+        system.reset( new MappedSystem( address, status.st_size ) ) ;
+        const char* file = static_cast< const char* >( address ) ;
+        SystemFileHeader header ;
+        memcpy( &header, file, sizeof( header ) ) ;
+
+        /* header: format, version, key, sizes */
+        const std::string key_text = key.to_string() ;
+        bool valid = memcmp( header.magic, system_magic, 8 ) == 0
+            && header.version == system_version && header.endianness == endianness_tag
+            && header.header_checksum == checksum( file, offsetof( SystemFileHeader, header_checksum ) )
+            && header.file_size == (uint64_t)status.st_size
+            && header.key_hash == key.hash() && header.key_length == key_text.size()
+            && memcmp( file + sizeof( header ), key_text.data(), key_text.size() ) == 0
+            && header.nb_rows > 0 && header.nb_rows < ( 1u << 31 ) && header.nb_nonzeros < ( 1u << 31 ) ;
+        const uint64_t n = header.nb_rows ;
+        const uint64_t nnz = header.nb_nonzeros ;
+        const uint64_t bytes[NB_SECTIONS] = { ( n + 1 ) * sizeof( int ), nnz * sizeof( int ),
+            nnz * sizeof( double ), n * sizeof( double ), n * sizeof( double ) } ;
+        for( int s = 0; valid && s < NB_SECTIONS; ++s ) {
+            valid = header.offsets[s] % 8 == 0 && header.offsets[s] >= sizeof( header ) + header.key_length
+                && header.offsets[s] + bytes[s] <= header.file_size ;
+        }
+        const int* row_offsets = reinterpret_cast< const int* >( file + header.offsets[ROW_OFFSETS] ) ;
+        for( uint64_t i = 0; valid && i < n; ++i ) valid = row_offsets[i] <= row_offsets[i + 1] ;
+        valid = valid && row_offsets[0] == 0 && row_offsets[n] == nnz ;
+        /* even without the checksum: the products index x with the columns */
+        const int* cols = reinterpret_cast< const int* >( file + header.offsets[COLS] ) ;
+        for( uint64_t k = 0; valid && k < nnz; ++k ) valid = cols[k] >= 0 && cols[k] < n ;
+        if( valid && verify_ ) {
+            valid = header.payload_checksum == checksum( file + sizeof( header ), header.file_size - sizeof( header ) ) ;
+        }
+        if( !valid ) {
+            ++nb_rejected_ ;
+            system.reset() ;
+            return system ;
+        }
+
+        system->nb_rows_ = n ;
+        system->nb_nonzeros_ = nnz ;
+        system->row_offsets_ = row_offsets ;
+        system->cols_ = cols ;
+        system->vals_ = reinterpret_cast< const double* >( file + header.offsets[VALS] ) ;
+        system->rhs_ = reinterpret_cast< const double* >( file + header.offsets[RHS] ) ;
+        system->jacobi_.inv_diag = reinterpret_cast< const double* >( file + header.offsets[INV_DIAG] ) ;
+        ++nb_hits_ ;
+        return system ;
+    }
+
+    int SystemCache::nb_hits() const
+    {
+        return nb_hits_ ;
+    }
+
+    int SystemCache::nb_misses() const
+    {
+        return nb_misses_ ;
+    }
+
+    int SystemCache::nb_rejected() const
+    {
+        return nb_rejected_ ;
+    }
+
+}
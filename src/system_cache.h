@@ -0,0 +1,136 @@
+#pragma once
+
+#include "mesh.h"
+#include "solver.h"
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief 64 bits FNV-1a hash of n bytes. h continues a previous hash,
+     *        to hash several arrays as one.
+     */
+    uint64_t content_hash( const void* data, size_t n, uint64_t h = 14695981039346656037ULL ) ;
+
+    /**
+     * \brief Hash of the coordinates, connectivity and attributes of the
+     *        triangles and edges of M: equal for a same mesh, whether it
+     *        was loaded, generated or wrapped.
+     */
+    uint64_t mesh_content_hash( const Mesh& M ) ;
+
+    /**
+     * \brief Everything an assembled system depends on. The coefficients
+     *        (k, f, g) are functions: the caller names them with a string
+     *        that must change whenever one of them does.
+     */
+    struct SystemKey {
+        SystemKey() ;
+
+        uint64_t mesh_hash ;
+        int element_order ;     /* 1 for P1 */
+        int quadrature_order ;
+        std::string coefficients ;
+
+        std::string to_string() const ;
+        uint64_t hash() const ;
+    } ;
+
+    /**
+     * \brief MappedSystem is an assembled system (matrix, right hand side
+     *        and Jacobi preconditioner) read back from a SystemCache file.
+     *        The arrays are views of the mapped file: nothing is parsed or
+     *        copied, the pages are read when the solver first touches them.
+     */
+    class MappedSystem : public LinearOperator {
+        public:
+            ~MappedSystem() ;
+
+            int nb_rows() const ;
+            int nb_nonzeros() const ;
+            void mult( const std::vector< double >& x, std::vector< double >& y ) const ;
+            void diagonal( std::vector< double >& d ) const ;
+
+            /* nb_rows() values */
+            const double* rhs() const ;
+
+            /* the Jacobi preconditioner stored with the matrix */
+            LinearPreconditioner& preconditioner() ;
+
+            size_t file_bytes() const ;
+
+        private:
+            friend class SystemCache ;
+
+            class Jacobi : public LinearPreconditioner {
+                public:
+                    void apply( const std::vector< double >& r, std::vector< double >& z ) const ;
+                    const double* inv_diag ;
+            } ;
+
+            MappedSystem( void* address, size_t size ) ;
+            MappedSystem( const MappedSystem& ) ;
+            MappedSystem& operator=( const MappedSystem& ) ;
+
+            void* address_ ;
+            size_t size_ ;
+            int nb_rows_ ;
+            int nb_nonzeros_ ;
+            const int* row_offsets_ ;
+            const int* cols_ ;
+            const double* vals_ ;
+            const double* rhs_ ;
+            Jacobi jacobi_ ;
+    } ;
+
+    /**
+     * \brief SystemCache stores assembled systems in a directory, one
+     *        binary file per key (<key hash>.fsc), so that a later run with
+     *        the same mesh and coefficients maps the file instead of
+     *        assembling. Layout (native endianness, 8 bytes aligned):
+     *          header   "FEM2ASC1", version, endianness tag, key hash,
+     *                   sizes, section offsets, file size, checksums
+     *          key      SystemKey::to_string()
+     *          sections row offsets (int), columns (int), values,
+     *                   right hand side, inverse diagonal (double)
+     *
+     * load() rejects a file of another version or endianness, for another
+     * key (hash collision), truncated, or whose checksum does not match;
+     * store() writes a temporary file renamed at the end, so concurrent
+     * runs never map a partial file.
+     */
+    class SystemCache {
+        public:
+            /**
+             * \param directory Created if needed
+             * \param verify Checksum of the whole file at each load (reads
+             *        all the pages once); the header, the row offsets and
+             *        the columns are always checked
+             */
+            explicit SystemCache( const std::string& directory, bool verify = true ) ;
+
+            std::string filename( const SystemKey& key ) const ;
+
+            bool store( const SystemKey& key, const SparseMatrix& K, const std::vector< double >& F ) ;
+
+            /* NULL if the file is absent or rejected */
+            std::unique_ptr< MappedSystem > load( const SystemKey& key ) ;
+
+            int nb_hits() const ;
+            int nb_misses() const ;
+            int nb_rejected() const ;
+
+        private:
+            std::string directory_ ;
+            bool verify_ ;
+            std::atomic< int > nb_hits_ ;
+            std::atomic< int > nb_misses_ ;
+            std::atomic< int > nb_rejected_ ;
+    } ;
+
+}
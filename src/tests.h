@@ -3,13 +3,44 @@
 #include "mesh.h"
 #include "fem.h"
 #include "solver.h"
+#include "matrix_free.h"
+#include "transient.h"
+#include "sweep.h"
+#include "streaming.h"
+#include "partition.h"
+#include "schwarz.h"
+#include "assembler.h"
+#include "incremental.h"
+#include "material.h"
+#include "compression.h"
+#include "vtu.h"
+#include "async_writer.h"
+#include "archive.h"
+#include "problem.h"
+#include "fem2a_c.h"
+#include "server.h"
+#include "system_cache.h"
+#include "adjoint.h"
+#include "reduced_basis.h"
+#include "pipeline.h"
+#include "parallel.h"
+#include "allocator.h"
 
 #include <assert.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <cstdio>
+#include <stdint.h>
 #include <iomanip>
 #include <cmath>
 #include <algorithm>
 #include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include <sys/stat.h>
 
 namespace FEM2A {
     namespace Tests {
@@ -126,6 +157,29 @@ namespace FEM2A {
             		return v.x + v.y;
        	 	}
 		
+		/* the Poisson system of the tests, assembled triangle by triangle
+		 * with the quadrature: stiffness of the materials, load of the
+		 * source (none if NULL), penalty on the edges whose attribute is
+		 * flagged in dirichlet with the values of g (0 if NULL) */
+		void poisson_system( const Mesh& M, const MaterialTable& materials, double (*source)(vertex),
+			const std::vector< bool >& dirichlet, double (*g)(vertex), SparseMatrix& K, std::vector< double >& F ) {
+			Quadrature quad = Quadrature::get_quadrature(2);
+			ShapeFunctions SF(2, 1);
+			F.assign( M.nb_vertices(), 0. );
+			std::vector< double > Fe( 3 ), values( M.nb_vertices(), 0. );
+			for ( int t = 0; t < M.nb_triangles(); ++t ) {
+				Mat< 3, 3 > Ke;
+				ElementMapping EL( M, false, t );
+				assemble_elementary_matrix( EL, SF, quad, materials, M.get_triangle_attribute( t ), Ke );
+				local_to_global_matrix( M, t, Ke, K );
+				if ( source == NULL ) continue;
+				assemble_elementary_vector( EL, SF, quad, source, Fe );
+				local_to_global_vector( M, false, t, Fe, F );
+			}
+			for ( int v = 0; g != NULL && v < M.nb_vertices(); ++v ) values[v] = g( M.get_vertex( v ) );
+			apply_dirichlet_boundary_conditions( M, dirichlet, values, K, F );
+		}
+
 		bool test_ass_elmt_matrix() {
 			Mesh carre;
 			carre.load("data/square.mesh");
@@ -147,6 +201,1564 @@ namespace FEM2A {
 		}
 		
 		
+		bool test_solver_config() {
+			Mesh carre;
+			carre.load("data/square.mesh");
+			std::vector< bool > attribute_dirichlet(2, false);
+			attribute_dirichlet[1] = true;
+			carre.set_attribute(unit_fct, 1, true);
+			SparseMatrix K(carre.nb_vertices());
+			std::vector< double > F;
+			poisson_system( carre, MaterialTable( 1. ), NULL, attribute_dirichlet, xy_fct, K, F );
+
+			std::vector< double > reference;
+			solve( K, F, reference );
+			const SolverConfig::Method methods[] = {
+				SolverConfig::CG, SolverConfig::CG, SolverConfig::BICGSTAB, SolverConfig::GMRES };
+			const SolverConfig::Preconditioner precond[] = {
+				SolverConfig::JACOBI, SolverConfig::SSOR, SolverConfig::JACOBI, SolverConfig::NONE };
+			for ( int c = 0; c < 4; ++c ) {
+				SolverConfig config;
+				config.method = methods[c];
+				config.preconditioner = precond[c];
+				std::vector< double > u;
+				if ( !solve( K, F, u, config ) ) return false;
+				double diff = 0.;
+				for ( int v = 0; v < u.size(); ++v ) {
+					diff = std::max( diff, std::fabs( u[v] - reference[v] ) );
+				}
+				std::cout << config.name() << " : max diff " << diff << std::endl;
+				if ( diff > 1e-6 ) return false;
+			}
+			return true;
+		}
+		
+		/* progress callback stopping the solve after *last iterations */
+		bool stop_at_iteration( const SolverProgress& progress, void* last ) {
+			return progress.iteration < *static_cast< int* >( last );
+		}
+
+		bool test_solver_progress() {
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			std::vector< bool > dirichlet( carre.get_bdr_attr_max() + 1, true );
+			SparseMatrix K( carre.nb_vertices() );
+			std::vector< double > F;
+			poisson_system( carre, MaterialTable( 1. ), unit_fct, dirichlet, xy_fct, K, F );
+
+			/* one residual per iteration, from ||b|| at x = 0 */
+			SolverConfig config;
+			config.method = SolverConfig::PCG;
+			config.preconditioner = SolverConfig::JACOBI;
+			config.threshold = 1e-10;
+			std::vector< double > history, x;
+			config.progress = record_residual_history;
+			config.progress_data = &history;
+			LinearSolver solver( K, config );
+			bool ok = solver.solve( F, x ) && history.size() == solver.iterations()
+				&& std::fabs( history[0] - 1. ) < 1e-12 && history.back() > config.threshold
+				&& solver.residual() <= config.threshold;
+
+			/* early stop by the callback */
+			int last = 5;
+			config.progress = stop_at_iteration;
+			config.progress_data = &last;
+			LinearSolver stopped( K, config );
+			x.clear();
+			ok = ok && !stopped.solve( F, x ) && stopped.iterations() == last
+				&& stopped.residual() > config.threshold;
+
+			/* OpenNL solves from two threads: each its own history */
+			config.method = SolverConfig::CG;
+			config.progress = record_residual_history;
+			std::vector< double > histories[2], solutions[2];
+			bool converged[2];
+			std::vector< std::thread > threads;
+			for ( int k = 0; k < 2; ++k ) {
+				threads.push_back( std::thread( [&, k, config]() mutable {
+					config.progress_data = &histories[k];
+					converged[k] = solve( K, F, solutions[k], config );
+				} ) );
+			}
+			for ( int k = 0; k < 2; ++k ) threads[k].join();
+			ok = ok && converged[0] && converged[1] && solutions[0] == solutions[1]
+				&& !histories[0].empty() && histories[0] == histories[1];
+
+			/* the threshold follows the mesh size */
+			config.discretization_factor = 1e-5;
+			config.adapt_to_mesh( carre );
+			const double h = mesh_size( carre );
+			ok = ok && std::fabs( config.threshold - 1e-5 * h * h ) < 1e-20;
+			std::cout << history.size() << " PCG residuals, stopped after " << stopped.iterations()
+				<< " iterations, " << histories[0].size() << " OpenNL residuals per thread, h = "
+				<< h << std::endl;
+			return ok;
+		}
+
+		bool test_mass_matrix() {
+			Mesh carre;
+			carre.load("data/square.mesh");
+			Quadrature quad = Quadrature::get_quadrature(2);
+			ShapeFunctions SF(2, 1);
+			// the sum of all the coefficients of M is the area of the domain
+			double area = 0.;
+			for ( int t = 0; t < carre.nb_triangles(); ++t ) {
+				DenseMatrix Me;
+				ElementMapping EL( carre, false, t );
+				assemble_elementary_mass_matrix( EL, SF, quad, Me );
+				for ( int i = 0; i < 3; ++i ) {
+					for ( int j = 0; j < 3; ++j ) area += Me.get(i, j);
+				}
+			}
+			std::cout << "area : " << area << std::endl;
+			return std::fabs( area - 1. ) < 1e-9;
+		}
+
+		/* max |u - v| */
+		double max_difference( const std::vector< double >& u, const std::vector< double >& v ) {
+			double difference = 0.;
+			for ( int i = 0; i < u.size(); ++i ) difference = std::max( difference, std::fabs( u[i] - v[i] ) );
+			return difference;
+		}
+
+		/* explicit solution at final_time with steps of dt */
+		std::vector< double > explicit_heat( const Mesh& M, const std::vector< bool >& dirichlet,
+			ExplicitHeatSolver::Scheme scheme, double dt, double final_time ) {
+			ExplicitHeatSolver heat( M, unit_fct, unit_fct, dirichlet, xy_fct, scheme );
+			heat.set_time_step( dt );
+			const int nb_steps = (int)std::floor( final_time / dt + 0.5 );
+			for ( int n = 0; n < nb_steps; ++n ) heat.step();
+			return heat.solution();
+		}
+
+		bool test_explicit_heat() {
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			const int nv = carre.nb_vertices();
+			std::vector< bool > dirichlet( carre.get_bdr_attr_max() + 1, true );
+			ExplicitHeatSolver heat( carre, unit_fct, unit_fct, dirichlet, xy_fct );
+
+			/* largest eigenvalue of M_L^-1 K on the free vertices, by power
+			 * iterations: the computed step is below its limit 2 / lambda */
+			SparseMatrix K( nv );
+			std::vector< double > F;
+			poisson_system( carre, MaterialTable( 1. ), NULL, std::vector< bool >( dirichlet.size(), false ), NULL, K, F );
+			std::vector< double > lumped( nv, 0. );
+			std::vector< char > fixed( nv, 0 );
+			Quadrature quad = Quadrature::get_quadrature(2);
+			ShapeFunctions SF(2, 1);
+			for ( int t = 0; t < carre.nb_triangles(); ++t ) {
+				Mat< 3, 3 > Me;
+				assemble_elementary_mass_matrix( ElementMapping( carre, false, t ), SF, quad, Me );
+				for ( int i = 0; i < 9; ++i ) lumped[carre.get_triangle_vertex_index( t, i / 3 )] += Me[i];
+			}
+			for ( int e = 0; e < carre.nb_edges(); ++e ) {
+				if ( !dirichlet[carre.get_edge_attribute( e )] ) continue;
+				for ( int i = 0; i < 2; ++i ) fixed[carre.get_edge_vertex_index( e, i )] = 1;
+			}
+			std::vector< double > x( nv ), y;
+			for ( int i = 0; i < nv; ++i ) x[i] = fixed[i] ? 0. : std::sin( 1. + i );
+			double lambda = 0.;
+			for ( int it = 0; it < 2000; ++it ) {
+				K.mult( x, y );
+				double norm = 0.;
+				for ( int i = 0; i < nv; ++i ) {
+					y[i] = fixed[i] ? 0. : y[i] / lumped[i];
+					norm += y[i] * y[i];
+				}
+				norm = std::sqrt( norm );
+				double x_norm = 0.;
+				for ( int i = 0; i < nv; ++i ) x_norm += x[i] * x[i];
+				lambda = norm / std::sqrt( x_norm );
+				for ( int i = 0; i < nv; ++i ) x[i] = y[i] / norm;
+			}
+			const double limit = 2. / lambda;
+			bool ok = heat.stable_time_step() <= limit && heat.stable_time_step() > 0.2 * limit
+				&& std::fabs( heat.time_step() - 0.9 * heat.stable_time_step() ) < 1e-15;
+
+			/* beyond the limit, forward Euler blows up */
+			ExplicitHeatSolver unstable( carre, unit_fct, unit_fct, dirichlet, xy_fct );
+			unstable.set_time_step( 1.5 * limit );
+			for ( int n = 0; n < 200; ++n ) unstable.step();
+			double largest = 0.;
+			for ( int i = 0; i < nv; ++i ) largest = std::max( largest, std::fabs( unstable.solution()[i] ) );
+			ok = ok && !( largest < 1e3 );
+
+			/* order in time: the errors against a fine RK2 solution divide
+			 * by 2 (forward Euler) and by 4 (RK2) when dt is halved */
+			const double T = 0.05;
+			const double dt = T / std::ceil( T / heat.time_step() );
+			const std::vector< double > reference = explicit_heat( carre, dirichlet, ExplicitHeatSolver::RK2, dt / 8., T );
+			double errors[2][2];
+			const ExplicitHeatSolver::Scheme schemes[2] = { ExplicitHeatSolver::FORWARD_EULER, ExplicitHeatSolver::RK2 };
+			for ( int s = 0; s < 2; ++s ) {
+				for ( int h = 0; h < 2; ++h ) {
+					errors[s][h] = max_difference( explicit_heat( carre, dirichlet, schemes[s], dt / ( 1 << h ), T ), reference );
+				}
+			}
+			const double ratio_euler = errors[0][0] / errors[0][1], ratio_rk2 = errors[1][0] / errors[1][1];
+			ok = ok && ratio_euler > 1.8 && ratio_euler < 2.2 && ratio_rk2 > 3.5 && ratio_rk2 < 4.5;
+
+			/* same solution as the implicit solver, up to the lumping */
+			SolverConfig config;
+			config.method = SolverConfig::PCG;
+			config.preconditioner = SolverConfig::JACOBI;
+			config.threshold = 1e-12;
+			ImplicitHeatSolver implicit( carre, unit_fct, unit_fct, dirichlet, xy_fct, 0.5, dt / 8., config );
+			for ( int n = 0; n < (int)std::floor( T / ( dt / 8. ) + 0.5 ); ++n ) ok = ok && implicit.step();
+			double u_max = 0.;
+			for ( int i = 0; i < nv; ++i ) u_max = std::max( u_max, std::fabs( reference[i] ) );
+			const double implicit_difference = max_difference( implicit.solution(), reference ) / u_max;
+			ok = ok && std::fabs( implicit.time() - T ) < 1e-12 && implicit_difference < 5e-3;
+
+			std::cout << "stable dt " << heat.stable_time_step() << ", limit " << limit
+				<< ", unstable max " << largest << std::endl;
+			std::cout << "error ratios forward Euler " << ratio_euler << ", RK2 " << ratio_rk2
+				<< ", relative difference with the implicit solver " << implicit_difference << std::endl;
+			return ok;
+		}
+
+		double sweep_k2( vertex v ) { return 2. + v.x; }
+		double sweep_source( vertex v ) { return std::sin( 3. * v.x ) + v.y; }
+
+		bool test_sweep() {
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			const int nv = carre.nb_vertices();
+			std::vector< bool > dirichlet( carre.get_bdr_attr_max() + 1, true );
+			SolverConfig config;
+			config.method = SolverConfig::PCG;
+			config.preconditioner = SolverConfig::JACOBI;
+			config.threshold = 1e-12;
+
+			/* 2 left hand sides with 3 scenarios each; names made unique */
+			double (*diffusions[2])(vertex) = { unit_fct, sweep_k2 };
+			double (*sources[3])(vertex) = { unit_fct, sweep_source, zero_fct };
+			double (*boundaries[3])(vertex) = { zero_fct, xy_fct, xy_fct };
+			const char* names[3] = { "a", "a", "" };
+			SweepEngine sweep( carre, dirichlet, config );
+			for ( int d = 0; d < 2; ++d ) {
+				for ( int c = 0; c < 3; ++c ) {
+					Scenario scenario;
+					scenario.name = names[c];
+					scenario.lhs_key = d;
+					scenario.diffusion = diffusions[d];
+					scenario.source = sources[c];
+					scenario.dirichlet = boundaries[c];
+					sweep.add_scenario( scenario );
+				}
+			}
+			bool ok = sweep.nb_scenarios() == 6 && sweep.name( 0 ) == "a" && sweep.name( 1 ) == "a_1"
+				&& sweep.name( 2 ) == "scenario_2" && sweep.name( 3 ) == "a_3" && sweep.run();
+
+			/* a suffixed name already taken is suffixed again */
+			SweepEngine collisions( carre, dirichlet, config );
+			const char* colliding[4] = { "a", "a_2", "a", "scenario_3" };
+			for ( int c = 0; c < 4; ++c ) {
+				Scenario scenario;
+				scenario.name = colliding[c];
+				collisions.add_scenario( scenario );
+			}
+			collisions.add_scenario( Scenario() );
+			ok = ok && collisions.name( 1 ) == "a_2" && collisions.name( 2 ) == "a_2_2"
+				&& collisions.name( 3 ) == "scenario_3" && collisions.name( 4 ) == "scenario_4";
+			for ( int i = 0; i < collisions.nb_scenarios(); ++i ) {
+				for ( int j = 0; j < i; ++j ) ok = ok && collisions.name( i ) != collisions.name( j );
+			}
+
+			/* each scenario against its own system solved alone, and
+			 * solve_multiple against the one at a time solves */
+			double difference = 0., multiple_difference = 0.;
+			for ( int d = 0; d < 2; ++d ) {
+				SparseMatrix K( nv );
+				std::vector< double > F, B( 3 * nv ), X;
+				std::vector< std::vector< double > > single( 3 );
+				for ( int c = 0; c < 3; ++c ) {
+					SparseMatrix K_c( nv );
+					poisson_system( carre, MaterialTable( diffusions[d] ), sources[c], dirichlet, boundaries[c], K_c, F );
+					ok = ok && LinearSolver( K_c, config ).solve( F, single[c] );
+					difference = std::max( difference, max_difference( sweep.solution( 3 * d + c ), single[c] ) );
+					if ( c == 0 ) K = K_c;
+					for ( int i = 0; i < nv; ++i ) B[3 * i + c] = F[i];
+				}
+				ok = ok && LinearSolver( K, config ).solve_multiple( 3, B, X );
+				for ( int c = 0; c < 3; ++c ) {
+					for ( int i = 0; i < nv; ++i ) {
+						multiple_difference = std::max( multiple_difference, std::fabs( X[3 * i + c] - single[c][i] ) );
+					}
+				}
+			}
+
+			/* another method of the config is used, one right hand side at a time */
+			config.method = SolverConfig::CG;
+			SweepEngine opennl( carre, dirichlet, config );
+			for ( int s = 0; s < sweep.nb_scenarios(); ++s ) {
+				Scenario scenario;
+				scenario.lhs_key = s / 3;
+				scenario.diffusion = diffusions[s / 3];
+				scenario.source = sources[s % 3];
+				scenario.dirichlet = boundaries[s % 3];
+				opennl.add_scenario( scenario );
+			}
+			ok = ok && opennl.run();
+			double method_difference = 0.;
+			for ( int s = 0; s < sweep.nb_scenarios(); ++s ) {
+				method_difference = std::max( method_difference, max_difference( opennl.solution( s ), sweep.solution( s ) ) );
+			}
+			std::cout << "sweep vs single solves " << difference << ", solve_multiple vs single solves "
+				<< multiple_difference << ", OpenNL CG vs PCG " << method_difference << std::endl;
+			return ok && difference < 1e-9 && multiple_difference < 1e-9 && method_difference < 1e-7;
+		}
+
+		bool test_matrix_free() {
+			Mesh carre;
+			carre.load("data/square.mesh");
+			double (*coef)(vertex) = []( vertex v ) { return 1. + v.x; };
+			std::vector< bool > dirichlet( carre.get_bdr_attr_max() + 1, true );
+			// assembled stiffness matrix with the penalty
+			SparseMatrix K( carre.nb_vertices() );
+			std::vector< double > F;
+			poisson_system( carre, MaterialTable( coef ), NULL, dirichlet, NULL, K, F );
+
+			MatrixFreeStiffness A( carre, coef, dirichlet );
+			std::vector< double > x( carre.nb_vertices() ), y_csr, y_free, d_csr, d_free;
+			for ( int i = 0; i < x.size(); ++i ) x[i] = std::sin( 7. * i );
+			K.mult( x, y_csr );
+			A.mult( x, y_free );
+			K.diagonal( d_csr );
+			A.diagonal( d_free );
+			double err = 0.;
+			for ( int i = 0; i < x.size(); ++i ) {
+				err = std::max( err, std::fabs( y_csr[i] - y_free[i] ) );
+				err = std::max( err, std::fabs( d_csr[i] - d_free[i] ) );
+			}
+			std::cout << A.nb_colors() << " colors, max difference with the assembled matrix : "
+				<< err << std::endl;
+			return err < 1e-9;
+		}
+
+		bool test_mixed_precision() {
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			double (*coef)(vertex) = []( vertex v ) { return 1. + v.x; };
+			std::vector< bool > dirichlet( carre.get_bdr_attr_max() + 1, true );
+			SparseMatrix K( carre.nb_vertices() );
+			std::vector< double > F;
+			poisson_system( carre, MaterialTable( coef ), unit_fct, dirichlet,
+				[]( vertex v ) { return v.x; }, K, F );
+
+			SolverConfig config;
+			config.method = SolverConfig::PCG;
+			config.preconditioner = SolverConfig::JACOBI;
+			config.threshold = 1e-12;
+			std::vector< double > x_double, x_mixed;
+			LinearSolver( K, config ).solve( F, x_double );
+			MixedPrecisionSolver mixed( K, config );
+			const bool converged = mixed.solve( F, x_mixed );
+			double err = 0.;
+			for ( int i = 0; i < x_double.size(); ++i ) {
+				err = std::max( err, std::fabs( x_double[i] - x_mixed[i] ) );
+			}
+			std::cout << mixed.refinements() << " refinements, residual " << mixed.residual()
+				<< ", max difference with the double solve : " << err << std::endl;
+			return converged && err < 1e-7;
+		}
+
+		bool test_streaming_assembly() {
+			double (*coef)(vertex) = []( vertex v ) { return 1. + v.x; };
+			double (*source)(vertex) = []( vertex v ) { return v.y; };
+			double (*g)(vertex) = []( vertex v ) { return v.x * v.y; };
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			std::vector< bool > dirichlet( carre.get_bdr_attr_max() + 1, false );
+			dirichlet[1] = true;
+			dirichlet[3] = true;
+			SparseMatrix K( carre.nb_vertices() );
+			std::vector< double > F;
+			poisson_system( carre, MaterialTable( coef ), source, dirichlet, g, K, F );
+
+			// small chunks and queue to exercise the producer/consumer
+			std::vector< vertex > vertices;
+			CsrMatrix K_stream;
+			std::vector< double > F_stream;
+			StreamingReport report;
+			if ( !assemble_streaming( "data/square_fine.mesh", coef, source, dirichlet, g,
+				vertices, K_stream, F_stream, &report, 100, 2 ) ) return false;
+
+			/* vertex 0 in an edge, in a triangle, a truncated triangle: rejected */
+			const std::string header = "MeshVersionFormatted 2\nDimension 2\nVertices 3\n"
+				"0 0 1\n1 0 1\n0 1 1\n";
+			const std::string broken[3] = {
+				header + "Edges 1\n0 2 1\nTriangles 1\n1 2 3 1\nEnd\n",
+				header + "Edges 1\n1 2 1\nTriangles 1\n1 0 3 1\nEnd\n",
+				header + "Edges 1\n1 2 1\nTriangles 1\n1 2\n" };
+			bool rejected = true;
+			for ( int b = 0; b < 3; ++b ) {
+				std::ofstream( "test_streaming.mesh" ) << broken[b];
+				std::vector< vertex > broken_vertices;
+				CsrMatrix K_broken;
+				std::vector< double > F_broken;
+				rejected = rejected && !assemble_streaming( "test_streaming.mesh", coef, source, dirichlet, g,
+					broken_vertices, K_broken, F_broken );
+			}
+			std::remove( "test_streaming.mesh" );
+
+			std::vector< double > x( carre.nb_vertices() ), y, y_stream;
+			for ( int i = 0; i < x.size(); ++i ) x[i] = std::sin( 3. * i );
+			K.mult( x, y );
+			K_stream.mult( x, y_stream );
+			double err = 0.;
+			for ( int i = 0; i < x.size(); ++i ) {
+				err = std::max( err, std::fabs( y[i] - y_stream[i] ) );
+				err = std::max( err, std::fabs( F[i] - F_stream[i] ) );
+			}
+			/* the copy of the SparseMatrix: same sorted rows */
+			const CsrMatrix K_copy( K );
+			const bool same_rows = K_copy.nb_nonzeros() == K_stream.nb_nonzeros()
+				&& K_copy.cols() == K_stream.cols() && K_copy.row_offsets() == K_stream.row_offsets();
+			std::cout << report.nb_chunks << " chunks, " << K_stream.nb_nonzeros()
+				<< " non-zeros, max difference with Mesh::load : " << err << ", same rows as the copy "
+				<< same_rows << ", broken files rejected " << rejected << std::endl;
+			return err < 1e-9 && same_rows && rejected && vertices.size() == carre.nb_vertices();
+		}
+
+		bool test_schwarz() {
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			std::vector< bool > dirichlet( carre.get_bdr_attr_max() + 1, true );
+			SparseMatrix K( carre.nb_vertices() );
+			std::vector< double > F;
+			poisson_system( carre, MaterialTable( unit_fct ), unit_fct, dirichlet, NULL, K, F );
+
+			std::vector< int > triangle_part, vertex_part;
+			partition_mesh( carre, 3, INERTIAL_BISECTION, triangle_part );
+			PartitionQuality quality = partition_quality( carre, 3, triangle_part );
+			vertex_partition( carre, triangle_part, vertex_part );
+			std::cout << "edge cut " << quality.edge_cut << ", parts of "
+				<< quality.min_size << " to " << quality.max_size << " triangles" << std::endl;
+
+			SolverConfig config;
+			config.method = SolverConfig::PCG;
+			config.preconditioner = SolverConfig::JACOBI;
+			config.threshold = 1e-12;
+			std::vector< double > x_jacobi, x_schwarz;
+			LinearSolver jacobi( K, config );
+			jacobi.solve( F, x_jacobi );
+			std::vector< int > fixed;
+			dirichlet_vertices( carre, dirichlet, fixed );
+			AdditiveSchwarz schwarz( K, vertex_part, 3, 2, true, fixed );
+			LinearSolver solver( K, config );
+			solver.set_preconditioner( &schwarz );
+			const bool converged = solver.solve( F, x_schwarz );
+			double err = 0.;
+			for ( int i = 0; i < x_jacobi.size(); ++i ) {
+				err = std::max( err, std::fabs( x_jacobi[i] - x_schwarz[i] ) );
+			}
+			std::cout << jacobi.iterations() << " Jacobi iterations, " << solver.iterations()
+				<< " Schwarz iterations, max difference " << err << std::endl;
+			return converged && quality.max_size - quality.min_size <= 1
+				&& solver.iterations() < jacobi.iterations() && err < 1e-8;
+		}
+
+		bool test_small_matrix() {
+			/* constexpr: evaluated by the compiler */
+			constexpr Mat< 2, 2 > A = 2. * ( to_vec( vec2{ 1., 0. } ) * to_vec( vec2{ 1., 0. } ).transpose() );
+			static_assert( A( 0, 0 ) == 2. && det( A ) == 0., "constexpr Mat" );
+			Mat< 3, 3 > B;
+			for ( int i = 0; i < 3; ++i ) {
+				for ( int j = 0; j < 3; ++j ) B( i, j ) = 1. / ( i + j + 1 ) + ( i == j );
+			}
+			const Mat< 3, 3 > I3 = B * inverse( B );
+			double err = 0.;
+			for ( int i = 0; i < 3; ++i ) {
+				for ( int j = 0; j < 3; ++j ) err = std::max( err, std::fabs( I3( i, j ) - ( i == j ) ) );
+			}
+			/* Mat and DenseMatrix elementary matrices on every triangle */
+			Mesh carre;
+			carre.load("data/square.mesh");
+			Quadrature quad = Quadrature::get_quadrature(2);
+			ShapeFunctions SF(2, 1);
+			for ( int t = 0; t < carre.nb_triangles(); ++t ) {
+				ElementMapping EL( carre, false, t );
+				Mat< 3, 3 > Ke;
+				assemble_elementary_matrix( EL, SF, quad, unit_fct, Ke );
+				DenseMatrix inv_J = EL.jacobian_matrix( quad.point( 0 ) ).invert_2x2();
+				for ( int i = 0; i < 3; ++i ) {
+					for ( int j = 0; j < 3; ++j ) {
+						vec2 grad_i = inv_J.transpose().mult_2x2_2( SF.evaluate_grad( i, quad.point( 0 ) ) );
+						vec2 grad_j = inv_J.transpose().mult_2x2_2( SF.evaluate_grad( j, quad.point( 0 ) ) );
+						const double ref = 0.5 * dot( grad_i, grad_j ) * EL.jacobian( quad.point( 0 ) );
+						err = std::max( err, std::fabs( Ke( i, j ) - ref ) );
+					}
+				}
+			}
+			std::cout << "max error of the small matrices " << err << std::endl;
+			return err < 1e-12;
+		}
+
+		bool test_assembler() {
+			Mesh carre;
+			carre.load("data/square.mesh");
+			Quadrature quad = Quadrature::get_quadrature(2);
+			ShapeFunctions SF(2, 1);
+			/* P1: same system as the run-time functions */
+			SparseMatrix K_ref(carre.nb_vertices()), K(carre.nb_vertices());
+			std::vector< double > F_ref(carre.nb_vertices(), 0.), F(carre.nb_vertices(), 0.);
+			std::vector< double > Fe(3, 0.);
+			for ( int t = 0; t < carre.nb_triangles(); ++t ) {
+				ElementMapping EL( carre, false, t );
+				Mat< 3, 3 > Ke;
+				assemble_elementary_matrix( EL, SF, quad, unit_fct, Ke );
+				local_to_global_matrix( carre, t, Ke, K_ref );
+				assemble_elementary_vector( EL, SF, quad, unit_fct, Fe );
+				local_to_global_vector( carre, false, t, Fe, F_ref );
+			}
+			P1StiffnessAssembler( unit_fct ).assemble( carre, K );
+			P1SourceAssembler( unit_fct ).assemble( carre, F );
+			std::vector< double > x(carre.nb_vertices()), y_ref, y;
+			for ( int i = 0; i < x.size(); ++i ) x[i] = std::cos( 1. * i );
+			K_ref.mult( x, y_ref );
+			K.mult( x, y );
+			double err = 0.;
+			for ( int i = 0; i < x.size(); ++i ) {
+				err = std::max( err, std::fabs( y[i] - y_ref[i] ) + std::fabs( F[i] - F_ref[i] ) );
+			}
+			/* P2: u = x at the 6 nodes gives u^T Ke u = |T|, sum(Me) = |T| */
+			const P2StiffnessAssembler P2K( unit_fct );
+			const P2MassAssembler P2M( unit_fct );
+			for ( int t = 0; t < carre.nb_triangles(); ++t ) {
+				vertex v[3];
+				for ( int i = 0; i < 3; ++i ) v[i] = carre.get_triangle_vertex( t, i );
+				Vec< 6 > u;
+				for ( int i = 0; i < 3; ++i ) {
+					u[i] = v[i].x;
+					u[3 + i] = 0.5 * ( v[i].x + v[(i + 1) % 3].x );
+				}
+				Mat< 6, 6 > Ke, Me;
+				P2K.element( carre, t, Ke );
+				P2M.element( carre, t, Me );
+				double mass = 0.;
+				for ( int i = 0; i < 36; ++i ) mass += Me[i];
+				const double area = 0.5 * std::fabs( ElementMapping( carre, false, t ).jacobian( quad.point(0) ) );
+				err = std::max( err, std::fabs( dot( u, Ke * u ) - area ) + std::fabs( mass - area ) );
+			}
+			/* segments: the boundary mass matrix sums to the perimeter */
+			SparseMatrix B(carre.nb_vertices());
+			P1BoundaryMassAssembler( unit_fct ).assemble( carre, B );
+			std::vector< double > ones(carre.nb_vertices(), 1.), Bx;
+			B.mult( ones, Bx );
+			double perimeter = 0.;
+			for ( int i = 0; i < Bx.size(); ++i ) perimeter += Bx[i];
+			err = std::max( err, std::fabs( perimeter - 4. ) );
+			std::cout << "max error of the assemblers " << err << std::endl;
+			return err < 1e-10;
+		}
+
+		bool test_incremental_assembly() {
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			std::vector< bool > dirichlet( carre.get_bdr_attr_max() + 1, true );
+			double (*coef)(vertex) = []( vertex v ) { return 1.; };
+			double (*coef_10)(vertex) = []( vertex v ) { return 10.; };
+			double (*left)(vertex) = []( vertex v ) { return 0.3 - v.x; };
+
+			IncrementalStiffness inc( carre, MaterialTable( coef ), dirichlet );
+			std::vector< int > triangle_part, vertex_part;
+			partition_mesh( carre, 4, INERTIAL_BISECTION, triangle_part );
+			vertex_partition( carre, triangle_part, vertex_part );
+			std::vector< int > fixed;
+			dirichlet_vertices( carre, dirichlet, fixed );
+			AdditiveSchwarz schwarz( inc.matrix(), vertex_part, 4, 1, true, fixed );
+			SolverConfig config;
+			config.method = SolverConfig::PCG;
+			config.preconditioner = SolverConfig::JACOBI;
+			config.threshold = 1e-12;
+			LinearSolver solver( inc.matrix(), config );
+			solver.set_preconditioner( &schwarz );
+			inc.add_update_hook( [&]( const std::vector< int >& rows ) {
+				solver.update_preconditioner( rows );
+			} );
+
+			/* the left part of the square becomes attribute 2, k = 10 */
+			carre.set_attribute( left, 2, false );
+			const int moved = inc.refresh_attributes();
+			inc.set_coefficient( 2, coef_10 );
+			const int recomputed = inc.update();
+
+			MaterialTable materials( coef );
+			materials.set_function( 2, coef_10 );
+			SparseMatrix K( carre.nb_vertices() );
+			std::vector< double > F;
+			poisson_system( carre, materials, unit_fct, dirichlet, NULL, K, F );
+
+			std::vector< double > x( carre.nb_vertices() ), y, y_ref;
+			for ( int i = 0; i < x.size(); ++i ) x[i] = std::cos( 1. * i );
+			inc.matrix().mult( x, y );
+			K.mult( x, y_ref );
+			double err = 0.;
+			for ( int i = 0; i < x.size(); ++i ) err = std::max( err, std::fabs( y[i] - y_ref[i] ) );
+
+			std::vector< double > x_inc, x_ref;
+			const bool converged = solver.solve( F, x_inc );
+			LinearSolver reference( K, config );
+			reference.solve( F, x_ref );
+			double err_solution = 0.;
+			for ( int i = 0; i < x_ref.size(); ++i ) {
+				err_solution = std::max( err_solution, std::fabs( x_inc[i] - x_ref[i] ) );
+			}
+			std::cout << moved << " triangles moved, " << recomputed << " of " << carre.nb_triangles()
+				<< " recomputed, " << inc.changed_rows().size() << " rows and "
+				<< schwarz.nb_updated_subdomains() << " subdomains updated" << std::endl;
+			std::cout << "max difference with the full assembly " << err
+				<< ", of the solutions " << err_solution << std::endl;
+			return converged && moved > 0 && moved == recomputed && err < 1e-10 && err_solution < 1e-8;
+		}
+
+		bool test_material_table() {
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			double (*left)(vertex) = []( vertex v ) { return 0.5 - v.x; };
+			double (*coef_1)(vertex) = []( vertex v ) { return 1.; };
+			double (*coef_10)(vertex) = []( vertex v ) { return 10.; };
+			double (*coef_x)(vertex) = []( vertex v ) { return 1. + v.x; };
+			carre.set_attribute( left, 2, false );
+			Quadrature quad = Quadrature::get_quadrature(2);
+			ShapeFunctions SF(2, 1);
+			std::vector< double > x( carre.nb_vertices() );
+			for ( int i = 0; i < x.size(); ++i ) x[i] = std::cos( 1. * i );
+			double err = 0.;
+			/* all constant, then constant and function-valued materials */
+			for ( int mixed = 0; mixed < 2; ++mixed ) {
+				MaterialTable materials( 1. );
+				if ( mixed ) materials.set_function( 2, coef_x );
+				else materials.set_constant( 2, 10. );
+				SparseMatrix K( carre.nb_vertices() ), K_ref( carre.nb_vertices() );
+				assemble_stiffness( carre, materials, K );
+				for ( int t = 0; t < carre.nb_triangles(); ++t ) {
+					Mat< 3, 3 > Ke;
+					ElementMapping EL( carre, false, t );
+					const bool in_2 = carre.get_triangle_attribute( t ) == 2;
+					assemble_elementary_matrix( EL, SF, quad, in_2 ? ( mixed ? coef_x : coef_10 ) : coef_1, Ke );
+					local_to_global_matrix( carre, t, Ke, K_ref );
+				}
+				std::vector< double > y, y_ref;
+				K.mult( x, y );
+				K_ref.mult( x, y_ref );
+				for ( int i = 0; i < x.size(); ++i ) err = std::max( err, std::fabs( y[i] - y_ref[i] ) );
+				err = std::max( err, std::fabs( materials.evaluate( 2, vertex{ 0.25, 0. } ) - ( mixed ? 1.25 : 10. ) ) );
+				err = std::max( err, std::fabs( materials.evaluate( 7, vertex{ 0.25, 0. } ) - 1. ) );
+			}
+			std::cout << "max difference with the quadrature " << err << std::endl;
+			return err < 1e-10;
+		}
+		
+		/* data after the '_' of the AppendedData of a .vtu */
+		std::string vtu_appended_data( const std::string& filename ) {
+			std::ifstream in( filename.c_str(), std::ios::binary );
+			std::stringstream content;
+			content << in.rdbuf();
+			const std::string s = content.str();
+			const size_t start = s.find( '_', s.find( "<AppendedData" ) );
+			return start == std::string::npos ? std::string() : s.substr( start + 1 );
+		}
+
+		bool test_vtu() {
+			/* LZ4 round trip on incompressible, repetitive and tiny data */
+			bool ok = true;
+			std::vector< std::vector< char > > inputs;
+			std::vector< double > smooth( 50000 );
+			for ( int i = 0; i < smooth.size(); ++i ) smooth[i] = std::sin( 0.001 * i );
+			inputs.push_back( std::vector< char >( (char*)smooth.data(), (char*)( smooth.data() + smooth.size() ) ) );
+			inputs.push_back( std::vector< char >( 100000, 0 ) );
+			std::vector< char > random( 70000 );
+			srand( 1 );
+			for ( int i = 0; i < random.size(); ++i ) random[i] = rand() % 256;
+			inputs.push_back( random );
+			for ( int n = 0; n < 20; ++n ) inputs.push_back( std::vector< char >( random.begin(), random.begin() + n ) );
+			for ( int k = 0; k < inputs.size(); ++k ) {
+				std::vector< char > compressed;
+				lz4_compress( inputs[k].data(), inputs[k].size(), compressed );
+				std::vector< char > back( inputs[k].size() );
+				ok = ok && lz4_decompress( compressed.data(), compressed.size(), back.data(), back.size() )
+					&& back == inputs[k];
+			}
+			std::vector< char > zeros_compressed;
+			lz4_compress( inputs[1].data(), inputs[1].size(), zeros_compressed );
+			std::cout << "lz4 round trips " << ( ok ? "ok" : "FAILED" ) << ", 100000 zeros in "
+				<< zeros_compressed.size() << " bytes" << std::endl;
+
+			/* raw file: the first array is u, the second the gradient of u */
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			const int nv = carre.nb_vertices();
+			const int nt = carre.nb_triangles();
+			std::vector< double > u( nv );
+			for ( int i = 0; i < nv; ++i ) {
+				const vertex v = carre.get_vertex( i );
+				u[i] = 2. * v.x - 3. * v.y;
+			}
+			VtuWriter writer( carre );
+			writer.add_point_field( "u", u );
+			writer.add_gradient( "grad_u", u );
+			writer.add_triangle_attributes();
+			writer.write( "test_vtu.vtu" );
+			std::string data = vtu_appended_data( "test_vtu.vtu" );
+			uint64_t size = 0;
+			double err = 0.;
+			if ( data.size() >= 16 + nv * 8 + 24 * nt ) {
+				memcpy( &size, data.data(), 8 );
+				ok = ok && size == nv * sizeof( double ) && memcmp( data.data() + 8, u.data(), size ) == 0;
+				memcpy( &size, data.data() + 8 + nv * 8, 8 );
+				ok = ok && size == 3 * nt * sizeof( double );
+				for ( int t = 0; t < nt; ++t ) {
+					double g[3];
+					memcpy( g, data.data() + 16 + nv * 8 + 24 * t, 24 );
+					err = std::max( err, std::fabs( g[0] - 2. ) + std::fabs( g[1] + 3. ) + std::fabs( g[2] ) );
+				}
+			} else {
+				ok = false;
+			}
+
+			/* compressed file: header of u then its LZ4 blocks */
+			writer.set_compression( true );
+			writer.write( "test_vtu.vtu" );
+			data = vtu_appended_data( "test_vtu.vtu" );
+			uint64_t header[3];
+			memcpy( header, data.data(), sizeof( header ) );
+			std::vector< double > u_back( nv );
+			size_t position = ( 3 + header[0] ) * 8;
+			for ( uint64_t b = 0; ok && b < header[0]; ++b ) {
+				uint64_t compressed_size;
+				memcpy( &compressed_size, data.data() + ( 3 + b ) * 8, 8 );
+				const size_t begin = b * header[1];
+				const size_t block = std::min< size_t >( header[1], nv * sizeof( double ) - begin );
+				ok = ok && lz4_decompress( data.data() + position, compressed_size, (char*)u_back.data() + begin, block );
+				position += compressed_size;
+			}
+			ok = ok && header[2] == ( nv * sizeof( double ) ) % header[1] && u_back == u;
+			std::remove( "test_vtu.vtu" );
+			std::cout << "vtu arrays " << ( ok ? "ok" : "FAILED" ) << ", gradient error " << err << std::endl;
+			return ok && err < 1e-10;
+		}
+		
+		bool test_async_writer() {
+			Mesh carre;
+			carre.load("data/square_fine.mesh");
+			const int nv = carre.nb_vertices();
+			const int nb_files = 12;
+			/* budget of 2 solutions: write() has to wait for the I/O thread */
+			AsyncWriter writer( carre, AsyncWriter::MEDIT, 2 * nv * sizeof( double ) );
+			bool moved = true;
+			std::vector< std::vector< double > > expected( nb_files );
+			for ( int k = 0; k < nb_files; ++k ) {
+				std::vector< double > u( nv );
+				for ( int i = 0; i < nv; ++i ) u[i] = std::sin( 0.01 * i + k );
+				expected[k] = u;
+				std::ostringstream name;
+				name << "test_async_" << k;
+				writer.write( std::move( u ), name.str() );
+				moved = moved && u.empty();
+			}
+			/* the output never runs on the computing thread, even while
+			 * it waits in the pool */
+			std::atomic< bool > io_thread( true );
+			const std::thread::id caller = std::this_thread::get_id();
+			writer.submit( [&io_thread, caller]() {
+				io_thread = std::this_thread::get_id() != caller;
+				return true;
+			} );
+			ThreadPool::global().parallel_for( 1000, []( int, int ) {} );
+			const bool written = writer.flush();
+			/* same content as the synchronous save_solution */
+			bool same = true;
+			for ( int k = 0; k < nb_files; ++k ) {
+				std::ostringstream name;
+				name << "test_async_" << k;
+				save_solution( expected[k], name.str() + "_sync.bb" );
+				std::ifstream a( ( name.str() + ".bb" ).c_str() ), b( ( name.str() + "_sync.bb" ).c_str() );
+				std::stringstream sa, sb;
+				sa << a.rdbuf();
+				sb << b.rdbuf();
+				same = same && sa.str() == sb.str() && !sa.str().empty();
+				std::remove( ( name.str() + ".bb" ).c_str() );
+				std::remove( ( name.str() + "_sync.bb" ).c_str() );
+			}
+			const bool bounded = writer.max_queued_bytes() <= 2 * nv * sizeof( double );
+			std::cout << writer.nb_written() << " files written, max queued "
+				<< writer.max_queued_bytes() << " bytes, blocked " << writer.blocked_time()
+				<< " s" << std::endl;
+			std::cout << "moved " << moved << ", same files " << same << ", bounded " << bounded
+				<< ", on the I/O thread " << io_thread << std::endl;
+			return written && moved && same && bounded && io_thread && writer.nb_written() == nb_files + 1;
+		}
+		
+		bool test_archive() {
+			/* bit exact on special values, with and without prediction */
+			std::vector< double > special;
+			special.push_back( 0. );
+			special.push_back( -0. );
+			special.push_back( 1e-310 );
+			special.push_back( -1e308 );
+			special.push_back( INFINITY );
+			special.push_back( -INFINITY );
+			special.push_back( NAN );
+			for ( int i = 0; i < 1000; ++i ) special.push_back( std::exp( 0.01 * i ) * ( i % 3 - 1 ) );
+			std::vector< double > shifted( special.size() );
+			for ( int i = 0; i < special.size(); ++i ) shifted[i] = special[i] * 1.0000001;
+			std::vector< char > compressed;
+			std::vector< double > back( special.size() );
+			bool exact = true;
+			for ( int temporal = 0; temporal < 2; ++temporal ) {
+				const double* previous = temporal ? special.data() : NULL;
+				compress_doubles( shifted.data(), previous, shifted.size(), compressed );
+				exact = exact && decompress_doubles( compressed.data(), compressed.size(), previous,
+					shifted.size(), back.data() )
+					&& memcmp( back.data(), shifted.data(), shifted.size() * sizeof( double ) ) == 0;
+			}
+			const bool truncated = !decompress_doubles( compressed.data(), compressed.size() / 2, special.data(),
+				shifted.size(), back.data() );
+
+			/* snapshots read in random order across keyframes */
+			const int n = 5000;
+			const int nb_snapshots = 30;
+			std::vector< std::vector< double > > snapshots( nb_snapshots, std::vector< double >( n ) );
+			for ( int k = 0; k < nb_snapshots; ++k ) {
+				for ( int i = 0; i < n; ++i ) snapshots[k][i] = std::sin( 0.001 * i ) * std::exp( -0.05 * k );
+			}
+			{
+				SolutionArchiveWriter writer( "test_archive.fsa", n, 7 );
+				for ( int k = 0; k < nb_snapshots; ++k ) writer.append( snapshots[k], 0.1 * k );
+			}
+			SolutionArchiveReader reader( "test_archive.fsa" );
+			bool random_access = reader.is_open() && reader.nb_snapshots() == nb_snapshots;
+			srand( 2 );
+			std::vector< double > x;
+			for ( int r = 0; r < 60 && random_access; ++r ) {
+				const int k = r < nb_snapshots ? r : rand() % nb_snapshots;
+				random_access = reader.read( k, x ) && x == snapshots[k] && reader.time( k ) == 0.1 * k;
+			}
+			/* an archive without its index is rejected */
+			std::ifstream in( "test_archive.fsa", std::ios::binary );
+			std::stringstream content;
+			content << in.rdbuf();
+			const std::string data = content.str();
+			std::ofstream( "test_archive.fsa", std::ios::binary ).write( data.data(), data.size() - 10 );
+			const bool rejected = !SolutionArchiveReader( "test_archive.fsa" ).is_open();
+			std::remove( "test_archive.fsa" );
+			std::cout << "bit exact " << exact << ", truncated detected " << truncated
+				<< ", random access " << random_access << ", broken archive rejected " << rejected << std::endl;
+			return exact && truncated && random_access && rejected;
+		}
+		
+		static double library_source( double x, double y, void* ) { return 1.; }
+		static double library_boundary( double x, double y, void* scale ) {
+			return *static_cast< double* >( scale ) * ( x + y );
+		}
+		
+		bool test_library() {
+			/* arrays of the caller, as an application would hold them */
+			Mesh grid;
+			grid.generate_grid( 30, 30 );
+			std::vector< double > coordinates;
+			std::vector< int > triangles, edges, edge_attributes;
+			for ( int v = 0; v < grid.nb_vertices(); ++v ) {
+				coordinates.push_back( grid.get_vertex( v ).x );
+				coordinates.push_back( grid.get_vertex( v ).y );
+			}
+			for ( int t = 0; t < grid.nb_triangles(); ++t ) {
+				for ( int i = 0; i < 3; ++i ) triangles.push_back( grid.get_triangle_vertex_index( t, i ) );
+			}
+			for ( int e = 0; e < grid.nb_edges(); ++e ) {
+				for ( int i = 0; i < 2; ++i ) edges.push_back( grid.get_edge_vertex_index( e, i ) );
+				edge_attributes.push_back( grid.get_edge_attribute( e ) );
+			}
+			fem2a_mesh* mesh = fem2a_mesh_wrap( grid.nb_vertices(), coordinates.data(),
+				grid.nb_triangles(), triangles.data(), grid.nb_edges(), edges.data(),
+				NULL, edge_attributes.data() );
+			fem2a_problem* problem = fem2a_problem_create( mesh );
+			double scale = 1.;
+			bool ok = mesh != NULL && problem != NULL
+				&& fem2a_problem_set_source( problem, library_source, NULL ) == FEM2A_OK
+				&& fem2a_problem_set_tolerance( problem, 1e-10 ) == FEM2A_OK;
+			for ( int a = 1; a <= 4; ++a ) {
+				ok = ok && fem2a_problem_set_dirichlet( problem, a, library_boundary, &scale ) == FEM2A_OK;
+			}
+			ok = ok && fem2a_problem_solve( problem ) == FEM2A_OK;
+			int size = 0;
+			const double* u = fem2a_problem_solution( problem, &size );
+			const int first_iterations = fem2a_problem_iterations( problem );
+
+			/* same problem through the C++ API on an owned mesh */
+			PoissonProblem reference( grid );
+			SolverConfig config = reference.solver_config();
+			config.threshold = 1e-10;
+			reference.set_solver_config( config );
+			reference.set_source( []( vertex ) { return 1.; } );
+			for ( int a = 1; a <= 4; ++a ) {
+				reference.set_dirichlet( a, []( vertex v ) { return v.x + v.y; } );
+			}
+			ok = ok && reference.solve() && size == reference.size();
+			double difference = 0.;
+			for ( int i = 0; ok && i < size; ++i ) {
+				difference = std::max( difference, std::abs( u[i] - reference.solution()[i] ) );
+			}
+
+			/* new Dirichlet values: same view, warm started solve */
+			scale = 2.;
+			ok = ok && fem2a_problem_set_dirichlet( problem, 1, library_boundary, &scale ) == FEM2A_OK
+				&& fem2a_problem_solve( problem ) == FEM2A_OK;
+			const bool same_view = fem2a_problem_solution( problem, NULL ) == u;
+
+			/* errors are codes, not crashes */
+			const int bad_triangle[3] = { 0, 1, grid.nb_vertices() };
+			const bool errors = fem2a_mesh_wrap( 3, coordinates.data(), 1, bad_triangle, 0, NULL, NULL, NULL ) == NULL
+				&& fem2a_problem_set_tolerance( problem, -1. ) == FEM2A_ERROR_INVALID_ARGUMENT
+				&& fem2a_problem_solve( NULL ) == FEM2A_ERROR_INVALID_ARGUMENT
+				&& strlen( fem2a_last_error() ) > 0;
+			fem2a_problem_free( problem );
+			fem2a_mesh_free( mesh );
+			std::cout << "C API vs C++ API max difference " << difference << ", " << first_iterations
+				<< " iterations, same view " << same_view << ", errors reported " << errors << std::endl;
+			return ok && difference < 1e-9 && same_view && errors;
+		}
+		
+		bool test_server() {
+			Mesh grid;
+			grid.generate_grid( 20, 20 );
+			grid.save( "test_server.mesh" );
+			const std::string dirichlet = " g=1:0 g=2:0 g=3:0 g=4:0 tol=1e-12";
+			JobDescription job, other_k, invalid;
+			std::string error;
+			bool parsed = job.parse( "mesh=test_server.mesh f=1" + dirichlet, error )
+				&& other_k.parse( "mesh=test_server.mesh k=1:3 f=1" + dirichlet, error )
+				&& !invalid.parse( "mesh=test_server.mesh k=1", error )
+				&& !invalid.parse( "f=1", error );
+
+			/* a cached system only changes its right hand side: u is linear in f */
+			JobRunner runner( 2, 2 );
+			std::vector< double > u1, u2, u3, fresh;
+			const JobResult r1 = runner.run( job, &u1 );
+			job.source = 2.;
+			const JobResult r2 = runner.run( job, &u2 );
+			double linearity = 0.;
+			for ( int i = 0; i < u1.size(); ++i ) linearity = std::max( linearity, std::abs( u2[i] - 2. * u1[i] ) );
+			const bool cached = r1.ok && !r1.mesh_cached && !r1.system_cached
+				&& r2.ok && r2.mesh_cached && r2.system_cached;
+
+			/* new coefficients: same mesh and pattern, new system, same result as a fresh runner */
+			const JobResult r3 = runner.run( other_k, &u3 );
+			JobRunner( 1, 1 ).run( other_k, &fresh );
+			double difference = u3.size() == fresh.size() ? 0. : 1.;
+			for ( int i = 0; i < u3.size() && i < fresh.size(); ++i ) {
+				difference = std::max( difference, std::abs( u3[i] - fresh[i] ) );
+			}
+			/* capacity 2: the third system evicts the least recently used one */
+			JobDescription third = other_k;
+			third.tolerance = 1e-11;
+			runner.run( third );
+			job.source = 1.;
+			const bool evicted = r3.mesh_cached && !r3.system_cached && !runner.run( job ).system_cached;
+
+			/* the daemon: concurrent clients, errors and commands */
+			SolverServer server( runner, 2 );
+			bool served = server.listen( "test_server.sock" );
+			std::vector< bool > client_ok( 4, false );
+			std::vector< std::thread > clients;
+			for ( int c = 0; c < 4; ++c ) {
+				clients.push_back( std::thread( [&, c]() {
+					std::vector< std::string > lines, answers;
+					for ( int k = 0; k < 3; ++k ) {
+						std::ostringstream line;
+						line << "mesh=test_server.mesh f=" << c + k << dirichlet;
+						lines.push_back( line.str() );
+					}
+					bool ok = submit_jobs( "test_server.sock", lines, answers );
+					for ( int k = 0; ok && k < answers.size(); ++k ) ok = answers[k].compare( 0, 3, "ok " ) == 0;
+					client_ok[c] = ok;
+				} ) );
+			}
+			for ( int c = 0; c < 4; ++c ) clients[c].join();
+			for ( int c = 0; c < 4; ++c ) served = served && client_ok[c];
+			std::vector< std::string > lines, answers;
+			lines.push_back( "mesh=missing.mesh" );
+			lines.push_back( "stats" );
+			lines.push_back( "shutdown" );
+			served = served && submit_jobs( "test_server.sock", lines, answers )
+				&& answers[0].compare( 0, 6, "error " ) == 0 && answers[2] == "ok";
+			server.wait();
+			std::remove( "test_server.mesh" );
+			if ( answers.size() > 1 ) std::cout << answers[1] << std::endl;
+			std::cout << "parsed " << parsed << ", cached " << cached << ", linearity " << linearity
+				<< ", difference with a fresh runner " << difference << ", evicted " << evicted
+				<< ", served " << served << std::endl;
+			return parsed && cached && linearity < 1e-8 && difference < 1e-8 && evicted && served;
+		}
+		
+		static double cache_source( vertex v ) { return std::sin( 3. * v.x ) * v.y; }
+		
+		bool test_system_cache() {
+			Mesh grid;
+			grid.generate_grid( 30, 30 );
+			SystemCache cache( "test_system_cache" );
+			PoissonProblem assembled( grid );
+			assembled.set_source( cache_source );
+			assembled.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			assembled.set_system_cache( &cache, "f=sin(3x)y g1=x" );
+			bool ok = assembled.solve() && !assembled.system_from_cache();
+
+			/* a new run maps the file: no assembly, same solution bit for bit */
+			PoissonProblem mapped( grid );
+			mapped.set_source( cache_source );
+			mapped.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			mapped.set_system_cache( &cache, "f=sin(3x)y g1=x" );
+			const bool hit = mapped.solve() && mapped.system_from_cache()
+				&& memcmp( mapped.solution(), assembled.solution(), grid.nb_vertices() * sizeof( double ) ) == 0
+				&& mapped.iterations() == assembled.iterations();
+
+			/* other coefficients: other file */
+			PoissonProblem other( grid );
+			other.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			other.set_system_cache( &cache, "f=0 g1=x" );
+			const bool miss = other.solve() && !other.system_from_cache() && cache.nb_misses() == 2;
+
+			/* damaged files are rejected, the system is assembled again */
+			SystemKey key;
+			key.mesh_hash = mesh_content_hash( grid );
+			key.coefficients = "f=sin(3x)y g1=x";
+			const std::string filename = cache.filename( key );
+			std::ifstream in( filename.c_str(), std::ios::binary );
+			std::stringstream content;
+			content << in.rdbuf();
+			in.close();
+			const std::string original = content.str();
+			std::string flipped = original;
+			flipped[flipped.size() / 2] ^= 1;
+			std::string version = original;
+			version[8] = 2;
+			const std::string damaged[3] = { flipped, version, original.substr( 0, original.size() - 8 ) };
+			bool rejected = true;
+			for ( int d = 0; d < 3; ++d ) {
+				std::ofstream( filename.c_str(), std::ios::binary ).write( damaged[d].data(), damaged[d].size() );
+				rejected = rejected && !cache.load( key );
+			}
+			/* without the checksum, a column out of range is still rejected */
+			SystemCache unverified( "test_system_cache", false );
+			std::string column = original;
+			uint64_t cols_offset;
+			memcpy( &cols_offset, original.data() + 56, sizeof( cols_offset ) ); // header offsets[COLS]
+			const int nb_vertices = grid.nb_vertices();
+			memcpy( &column[cols_offset], &nb_vertices, sizeof( nb_vertices ) );
+			std::ofstream( filename.c_str(), std::ios::binary ).write( column.data(), column.size() );
+			rejected = rejected && !unverified.load( key ) && unverified.nb_rejected() == 1;
+			PoissonProblem repaired( grid );
+			repaired.set_source( cache_source );
+			repaired.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			repaired.set_system_cache( &cache, key.coefficients );
+			rejected = rejected && repaired.solve() && !repaired.system_from_cache() && cache.nb_rejected() == 4
+				&& memcmp( repaired.solution(), assembled.solution(), grid.nb_vertices() * sizeof( double ) ) == 0
+				&& (bool)cache.load( key );
+
+			key.coefficients = "f=0 g1=x";
+			std::remove( cache.filename( key ).c_str() );
+			std::remove( filename.c_str() );
+			rmdir( "test_system_cache" );
+			std::cout << "stored " << ok << ", hit bit exact " << hit << ", miss " << miss
+				<< ", damaged files rejected " << rejected << std::endl;
+			return ok && hit && miss && rejected;
+		}
+		
+		static double adjoint_region( vertex v ) { return 0.5 - v.y; }
+		static double adjoint_scale = 1.;
+		static double adjoint_conductivity( vertex v ) { return adjoint_scale * ( 1. + v.x ); }
+		
+		/* J of the solution for the diffusion table, solved to 1e-13 */
+		static double adjoint_output( const Mesh& M, const MaterialTable& materials, const LinearFunctional& J ) {
+			PoissonProblem problem( M );
+			SolverConfig config = problem.solver_config();
+			config.threshold = 1e-13;
+			problem.set_solver_config( config );
+			problem.set_diffusion( materials );
+			problem.set_source( []( vertex v ) { return 1. + v.x * v.y; } );
+			problem.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			problem.set_dirichlet( 3, []( vertex ) { return 0.; } );
+			problem.solve();
+			return J.evaluate( problem.solution() );
+		}
+		
+		bool test_adjoint() {
+			/* two constant materials and a function one, scaled */
+			Mesh grid;
+			grid.generate_grid( 24, 24 );
+			grid.set_attribute( adjoint_region, 2, false );
+			std::vector< double > k( 3, 0. );
+			k[1] = 1.5;
+			k[2] = 0.3;
+			MaterialTable materials( adjoint_conductivity );
+			materials.set_constant( 1, k[1] );
+			materials.set_constant( 2, k[2] );
+
+			vertex p;
+			p.x = 0.37;
+			p.y = 0.61;
+			LinearFunctional probe = probe_functional( grid, p );
+			LinearFunctional flux = flux_functional( grid, 3, []( vertex ) { return 0.; } );
+			LinearFunctional both = probe;
+			both.add( flux, 0.1 );
+
+			PoissonProblem problem( grid );
+			SolverConfig config = problem.solver_config();
+			config.threshold = 1e-13;
+			problem.set_solver_config( config );
+			problem.set_diffusion( materials );
+			problem.set_source( []( vertex v ) { return 1. + v.x * v.y; } );
+			problem.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			problem.set_dirichlet( 3, []( vertex ) { return 0.; } );
+			bool ok = problem.solve() && probe.vertices.size() == 3;
+			AdjointSensitivity sensitivity( problem );
+			ok = ok && sensitivity.compute( both ) && sensitivity.gradient().size() == 3;
+
+			/* central finite differences on k_1, k_2 (the attribute 0 is unused) */
+			double error = 0.;
+			for ( int a = 1; a <= 2 && ok; ++a ) {
+				const double h = 1e-5 * k[a];
+				MaterialTable plus = materials, minus = materials;
+				plus.set_constant( a, k[a] + h );
+				minus.set_constant( a, k[a] - h );
+				const double fd = ( adjoint_output( grid, plus, both ) - adjoint_output( grid, minus, both ) ) / ( 2. * h );
+				error = std::max( error, std::abs( fd - sensitivity.gradient()[a] ) / std::abs( fd ) );
+				std::cout << "attribute " << a << ": adjoint " << sensitivity.gradient()[a]
+					<< ", finite differences " << fd << std::endl;
+			}
+			/* a function material: derivative with respect to its scale */
+			PoissonProblem function_problem( grid );
+			function_problem.set_solver_config( config );
+			function_problem.set_diffusion( MaterialTable( adjoint_conductivity ) );
+			function_problem.set_source( []( vertex v ) { return 1. + v.x * v.y; } );
+			function_problem.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			function_problem.set_dirichlet( 3, []( vertex ) { return 0.; } );
+			AdjointSensitivity function_sensitivity( function_problem );
+			ok = ok && function_problem.solve() && function_sensitivity.compute( probe );
+			const double h = 1e-5;
+			adjoint_scale = 1. + h;
+			const double J_plus = adjoint_output( grid, MaterialTable( adjoint_conductivity ), probe );
+			adjoint_scale = 1. - h;
+			const double J_minus = adjoint_output( grid, MaterialTable( adjoint_conductivity ), probe );
+			adjoint_scale = 1.;
+			const double fd_scale = ( J_plus - J_minus ) / ( 2. * h );
+			/* the scale is shared by the attributes 1 and 2 */
+			const double adjoint_total = function_sensitivity.gradient()[1] + function_sensitivity.gradient()[2];
+			const double scale_error = std::abs( fd_scale - adjoint_total ) / std::abs( fd_scale );
+			std::cout << "function material: adjoint " << adjoint_total
+				<< ", finite differences " << fd_scale << std::endl;
+			std::cout << "max relative error " << error << ", " << scale_error << std::endl;
+			return ok && error < 1e-5 && scale_error < 1e-5;
+		}
+		
+		static double reduced_region( vertex v ) { return v.x - 0.5; }
+		
+		static double relative_difference( const std::vector< double >& u, const double* v ) {
+			double difference = 0., norm = 0.;
+			for ( int i = 0; i < u.size(); ++i ) {
+				difference += ( u[i] - v[i] ) * ( u[i] - v[i] );
+				norm += v[i] * v[i];
+			}
+			return std::sqrt( difference / norm );
+		}
+		
+		bool test_reduced_basis() {
+			Mesh grid;
+			grid.generate_grid( 20, 20 );
+			grid.set_attribute( reduced_region, 2, false );
+			std::vector< int > attributes( 1, 1 );
+			attributes.push_back( 2 );
+			std::vector< ScalarField > sources;
+			sources.push_back( []( vertex ) { return 1.; } );
+			sources.push_back( []( vertex v ) { return std::sin( 3. * v.x ) * v.y; } );
+			ReducedBasis model( grid, MaterialTable( 1. ), attributes, sources );
+			model.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			model.set_dirichlet( 3, []( vertex ) { return 0.; } );
+
+			/* training set: k in [0.5, 2], s in [-1, 1] */
+			std::srand( 11 );
+			std::vector< ReducedParameters > training( 30 );
+			bool ok = true;
+			for ( int i = 0; i < training.size(); ++i ) {
+				training[i].diffusion.push_back( 0.5 + 1.5 * std::rand() / RAND_MAX );
+				training[i].diffusion.push_back( 0.5 + 1.5 * std::rand() / RAND_MAX );
+				training[i].source.push_back( -1. + 2. * std::rand() / RAND_MAX );
+				training[i].source.push_back( -1. + 2. * std::rand() / RAND_MAX );
+				ok = ok && model.add_snapshot( training[i] );
+			}
+			const int size = model.build( 1e-9 );
+			std::cout << "basis of " << size << " vectors, sigma " << model.singular_values()[0]
+				<< " ... " << model.singular_values()[size - 1] << std::endl;
+
+			/* reduced solutions against full solves, and the indicator
+			 * against the scaled residual computed with the full matrix */
+			PoissonProblem reference( grid );
+			reference.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+			reference.set_dirichlet( 3, []( vertex ) { return 0.; } );
+			reference.assemble();
+			double error = 0., indicator_error = 0.;
+			for ( int t = 0; t < 10 && ok; ++t ) {
+				ReducedParameters p;
+				p.diffusion.push_back( 0.5 + 1.5 * std::rand() / RAND_MAX );
+				p.diffusion.push_back( 0.5 + 1.5 * std::rand() / RAND_MAX );
+				p.source.push_back( -1. + 2. * std::rand() / RAND_MAX );
+				p.source.push_back( -1. + 2. * std::rand() / RAND_MAX );
+				std::vector< double > c, u;
+				const double indicator = model.reduced_solve( p, c );
+				model.reconstruct( c, u );
+
+				PoissonProblem full( grid );
+				full.set_diffusion( 1, p.diffusion[0] );
+				full.set_diffusion( 2, p.diffusion[1] );
+				const double s0 = p.source[0], s1 = p.source[1];
+				full.set_source( [s0, s1]( vertex v ) { return s0 + s1 * std::sin( 3. * v.x ) * v.y; } );
+				full.set_dirichlet( 1, []( vertex v ) { return v.x; } );
+				full.set_dirichlet( 3, []( vertex ) { return 0.; } );
+				ok = ok && full.solve();
+				error = std::max( error, relative_difference( u, full.solution() ) );
+
+				/* D is the diagonal at k = 1 */
+				std::vector< double > Ku( u.size() ), d;
+				full.matrix().mult( u, Ku );
+				reference.matrix().diagonal( d );
+				double residual = 0., norm = 0.;
+				for ( int i = 0; i < u.size(); ++i ) {
+					residual += ( full.rhs()[i] - Ku[i] ) * ( full.rhs()[i] - Ku[i] ) / ( d[i] * d[i] );
+					norm += u[i] * u[i];
+				}
+				indicator_error = std::max( indicator_error, std::abs( indicator - std::sqrt( residual / norm ) ) );
+			}
+			std::cout << "reduced vs full: max relative error " << error
+				<< ", indicator vs residual " << indicator_error << std::endl;
+			ok = ok && error < 1e-6 && indicator_error < 5e-8;
+
+			/* a basis too small: the indicator sends solve() to the full problem */
+			model.build( 1e-9, 1 );
+			std::vector< double > u;
+			ok = ok && model.solve( training[3], u ) && model.used_full_solve() && model.nb_full_solves() == 1;
+			std::cout << "1 vector: estimated error " << model.estimated_error() << ", full solve "
+				<< model.used_full_solve() << std::endl;
+
+			/* calibrated on 5 samples, the estimate bounds the error of 10 others */
+			model.build( 1e-9, 4 );
+			std::vector< ReducedParameters > samples( 15 );
+			for ( int i = 0; i < samples.size(); ++i ) {
+				samples[i].diffusion.push_back( 0.5 + 1.5 * std::rand() / RAND_MAX );
+				samples[i].diffusion.push_back( 0.5 + 1.5 * std::rand() / RAND_MAX );
+				samples[i].source.push_back( -1. + 2. * std::rand() / RAND_MAX );
+				samples[i].source.push_back( -1. + 2. * std::rand() / RAND_MAX );
+			}
+			const double effectivity = model.calibrate(
+				std::vector< ReducedParameters >( samples.begin(), samples.begin() + 5 ) );
+			model.set_tolerance( 0. );
+			double worst = 0.;
+			for ( int i = 5; i < samples.size(); ++i ) {
+				std::vector< double > c, reduced;
+				const double estimate = effectivity * model.reduced_solve( samples[i], c );
+				model.reconstruct( c, reduced );
+				ok = ok && model.solve( samples[i], u );
+				worst = std::max( worst, relative_difference( reduced, u.data() ) / estimate );
+			}
+			std::cout << "4 vectors: effectivity " << effectivity << ", error / estimate at most "
+				<< worst << std::endl;
+			ok = ok && effectivity > 1. && worst <= 1.;
+
+			model.set_tolerance( 1e-6 );
+			const int nb_full_solves = model.nb_full_solves();
+			model.build( 1e-9 );
+			model.calibrate( std::vector< ReducedParameters >( samples.begin(), samples.begin() + 5 ) );
+			ok = ok && model.solve( training[3], u ) && !model.used_full_solve()
+				&& model.nb_full_solves() == nb_full_solves;
+			std::cout << "full basis: effectivity " << model.effectivity() << ", estimated error "
+				<< model.estimated_error() << std::endl;
+			return ok;
+		}
+		
+		bool test_pipeline() {
+			/* a batch of grids, one missing file among them */
+			mkdir( "test_pipeline", 0755 );
+			std::vector< std::string > filenames;
+			for ( int k = 1; k <= 5; ++k ) {
+				Mesh grid;
+				grid.generate_grid( 10 * k, 10 * k );
+				std::ostringstream name;
+				name << "test_pipeline/grid_" << k << ".mesh";
+				grid.save( name.str() );
+				filenames.push_back( name.str() );
+			}
+			filenames.insert( filenames.begin() + 2, "test_pipeline/missing.mesh" );
+			bool ok = MeshPipeline::list_meshes( "test_pipeline" ).size() == 5;
+
+			PipelineConfig config;
+			config.queue_capacity = 1;
+			config.solve_threads = 2;
+			config.output_directory = "test_pipeline/out";
+			MeshPipeline pipeline( config );
+			MeshPipeline sequential( config );
+			ok = ok && !pipeline.run( filenames ) && !sequential.run_sequential( filenames );
+			std::cout << pipeline.report() << std::endl;
+
+			/* same results, in the order of the files, the missing one reported */
+			for ( int i = 0; i < filenames.size(); ++i ) {
+				const PipelineResult& r = pipeline.results()[i];
+				const PipelineResult& s = sequential.results()[i];
+				ok = ok && r.filename == filenames[i] && r.ok == ( i != 2 ) && r.ok == s.ok
+					&& r.iterations == s.iterations && r.nb_vertices == s.nb_vertices;
+				std::cout << r.filename << ": " << ( r.ok ? "ok" : r.error ) << ", "
+					<< r.nb_vertices << " vertices, " << r.iterations << " iterations" << std::endl;
+			}
+			std::ifstream solution( "test_pipeline/out/grid_3.bb" );
+			std::string header;
+			std::getline( solution, header );
+			ok = ok && header == " 2 1 961 2";
+
+			for ( int k = 1; k <= 5; ++k ) {
+				std::ostringstream name;
+				name << "grid_" << k;
+				std::remove( ( "test_pipeline/" + name.str() + ".mesh" ).c_str() );
+				std::remove( ( "test_pipeline/out/" + name.str() + ".bb" ).c_str() );
+			}
+			rmdir( "test_pipeline/out" );
+			rmdir( "test_pipeline" );
+			return ok;
+		}
+
+		bool test_scheduler() {
+			/* more threads than cores: the steals and the sleeps are exercised */
+			ThreadPool pool( 4 );
+			bool ok = pool.nb_threads() == 4;
+
+			/* each index once, in ranges aligned on the grain */
+			const int n = 100003;
+			std::vector< int > hits( n, 0 );
+			std::atomic< bool > aligned( true );
+			pool.parallel_for( n, 1000, [&]( int begin, int end ) {
+				if ( begin % 1000 != 0 || ( end != n && end - begin != 1000 ) ) aligned = false;
+				for ( int i = begin; i < end; ++i ) ++hits[i];
+			} );
+			ok = ok && aligned && std::count( hits.begin(), hits.end(), 1 ) == n;
+
+			/* nested loops */
+			std::atomic< long > sum( 0 );
+			pool.parallel_for( 64, 1, [&]( int begin, int end ) {
+				for ( int i = begin; i < end; ++i ) {
+					pool.parallel_for( 1000, 10, [&]( int b, int e ) {
+						long s = 0;
+						for ( int j = b; j < e; ++j ) s += j;
+						sum += s;
+					} );
+				}
+			} );
+			ok = ok && sum == 64L * 999 * 1000 / 2;
+
+			/* a diamond repeated: each task after its dependencies */
+			TaskGraph graph;
+			std::vector< int > order( 40, -1 );
+			std::atomic< int > clock( 0 );
+			for ( int k = 0; k < 10; ++k ) {
+				const std::vector< int > top = k == 0 ? std::vector< int >() : std::vector< int >( 1, 4 * k - 1 );
+				const int a = graph.add( [&, k]() { order[4 * k] = clock++; }, top );
+				const int b = graph.add( [&, k]() { order[4 * k + 1] = clock++; }, std::vector< int >( 1, a ) );
+				const int c = graph.add( [&, k]() { order[4 * k + 2] = clock++; }, std::vector< int >( 1, a ) );
+				std::vector< int > both;
+				both.push_back( b );
+				both.push_back( c );
+				graph.add( [&, k]() { order[4 * k + 3] = clock++; }, both );
+			}
+			graph.run( pool );
+			for ( int k = 0; k < 10; ++k ) {
+				ok = ok && order[4 * k] < order[4 * k + 1] && order[4 * k] < order[4 * k + 2]
+					&& order[4 * k + 1] < order[4 * k + 3] && order[4 * k + 2] < order[4 * k + 3]
+					&& ( k == 0 || order[4 * k - 1] < order[4 * k] );
+			}
+			ok = ok && graph.nb_tasks() == 40 && clock == 40;
+
+			/* every spawned task counted once */
+			pool.reset_statistics();
+			std::atomic< int > nb_run( 0 );
+			for ( int i = 0; i < 500; ++i ) pool.spawn( [&]() { ++nb_run; } );
+			pool.wait_until( [&]() { return nb_run == 500; } );
+			const ThreadPool::Statistics stats = pool.statistics();
+			ok = ok && stats.total_tasks() == 500 && stats.imbalance() >= 1.;
+			std::cout << pool.report() << std::endl;
+
+			/* the product does not depend on the threads */
+			Mesh grid;
+			grid.generate_grid( 120, 120 );
+			SparseMatrix K( grid.nb_vertices() );
+			assemble_stiffness( grid, MaterialTable( 1. ), K );
+			std::vector< double > x( grid.nb_vertices() ), y1, y2( grid.nb_vertices() );
+			for ( int i = 0; i < x.size(); ++i ) x[i] = std::sin( 0.01 * i );
+			K.mult( x, y1 );
+			for ( int i = 0; i < x.size(); ++i ) {
+				for ( int k = 0; k < K.get_cols_at_line( i ).size(); ++k ) {
+					y2[i] += K.get_vals_at_line( i )[k] * x[K.get_cols_at_line( i )[k]];
+				}
+			}
+			ok = ok && y1 == y2;
+			std::cout << "scheduler " << ( ok ? "ok" : "FAILED" ) << std::endl;
+			return ok;
+		}
+
+		double deterministic_source( vertex v ) {
+			return std::sin( 7. * v.x ) * std::exp( v.y ) + 1.;
+		}
+
+		bool test_deterministic() {
+			/* values of very different magnitudes: the order of the sum shows */
+			const int n = 250007;
+			std::vector< double > x( n );
+			for ( int i = 0; i < n; ++i ) x[i] = std::sin( 1e-3 * i ) * std::pow( 10., i % 17 - 8 );
+			const auto partial = [&]( int begin, int end ) {
+				double s = 0.;
+				for ( int i = begin; i < end; ++i ) s += x[i];
+				return s;
+			};
+			long double exact = 0.;
+			for ( int i = 0; i < n; ++i ) exact += x[i];
+
+			Mesh grid;
+			grid.generate_grid( 90, 90 );
+			SolverConfig config;
+			config.method = SolverConfig::PCG;
+			config.preconditioner = SolverConfig::JACOBI;
+			config.threshold = 1e-10;
+
+			bool ok = true;
+			double reference_sum = 0.;
+			std::vector< double > reference_u;
+			int reference_iterations = 0;
+			const int nb_threads[5] = { 1, 2, 3, 4, 7 };
+			for ( int k = 0; k < 5; ++k ) {
+				ThreadPool pool( nb_threads[k] );
+				ok = ok && pool.deterministic();
+				const double s = pool.sum( n, partial );
+
+				/* the whole solve inside the pool: assembly, products and dots */
+				std::vector< double > u;
+				int iterations = 0;
+				std::atomic< bool > done( false );
+				pool.spawn( [&]() {
+					PoissonProblem problem( grid );
+					problem.set_solver_config( config );
+					problem.set_source( deterministic_source );
+					for ( int a = 1; a <= 4; ++a ) {
+						problem.set_dirichlet( a, []( vertex v ) { return v.x * v.y; } );
+					}
+					problem.solve();
+					u.assign( problem.solution(), problem.solution() + problem.size() );
+					iterations = problem.iterations();
+					done = true;
+				} );
+				pool.wait_until( [&]() { return done.load(); } );
+
+				if ( k == 0 ) {
+					reference_sum = s;
+					reference_u = u;
+					reference_iterations = iterations;
+				}
+				/* the same bits */
+				const bool same = memcmp( &s, &reference_sum, sizeof( double ) ) == 0
+					&& u.size() == reference_u.size()
+					&& memcmp( u.data(), reference_u.data(), u.size() * sizeof( double ) ) == 0
+					&& iterations == reference_iterations;
+				ok = ok && same;
+				std::cout << nb_threads[k] << " thread(s): sum " << std::setprecision( 17 ) << s
+					<< std::setprecision( 6 ) << ", " << iterations << " iterations, "
+					<< ( same ? "identical" : "DIFFERENT" ) << std::endl;
+			}
+			const double error = std::fabs( (double)( reference_sum - exact ) ) / std::fabs( (double)exact );
+			std::cout << "relative error of the blocked sum " << error << std::endl;
+			ok = ok && error < 1e-13;
+			std::cout << "deterministic " << ( ok ? "ok" : "FAILED" ) << std::endl;
+			return ok;
+		}
+
+		bool test_allocator() {
+			Mesh reference;
+			reference.generate_grid( 60, 60 );
+			SparseMatrix K_reference( reference.nb_vertices() );
+			assemble_stiffness( reference, MaterialTable( 2. ), K_reference );
+			bool ok = &reference.resource() == &MemoryResource::default_resource()
+				&& &K_reference.resource() == &MemoryResource::default_resource();
+
+			/* small chunks: the arenas take several of them */
+			HeapResource heap;
+			ArenaResource arena( 256 << 10 );
+			HugePageResource huge_pages( 2 << 20 );
+			NumaResource numa( 256 << 10 );
+			MemoryResource* resources[4] = { &heap, &arena, &huge_pages, &numa };
+			for ( int r = 0; r < 4; ++r ) {
+				MemoryResource& resource = *resources[r];
+				{
+					Mesh mesh( resource );
+					mesh.generate_grid( 60, 60 );
+					SparseMatrix K( mesh.nb_vertices(), resource );
+					assemble_stiffness( mesh, MaterialTable( 2. ), K );
+					const Mesh copy( mesh );
+					ok = ok && &mesh.resource() == &resource && &copy.resource() == &resource
+						&& &K.resource() == &resource && &K.get_cols_at_line( 0 ).get_allocator().resource() == &resource;
+
+					/* the same mesh and matrix as with the heap */
+					ok = ok && copy.nb_triangles() == reference.nb_triangles();
+					for ( int v = 0; v < mesh.nb_vertices(); ++v ) {
+						ok = ok && mesh.get_vertex( v ).x == reference.get_vertex( v ).x
+							&& K.get_cols_at_line( v ) == K_reference.get_cols_at_line( v )
+							&& K.get_vals_at_line( v ) == K_reference.get_vals_at_line( v );
+					}
+					ok = ok && resource.allocated_bytes() > 0 && resource.peak_bytes() >= resource.allocated_bytes()
+						&& resource.reserved_bytes() >= resource.allocated_bytes();
+					std::cout << resource.report() << std::endl;
+				}
+				/* everything given back, even if the arenas keep their chunks */
+				ok = ok && resource.allocated_bytes() == 0;
+			}
+			ok = ok && heap.reserved_bytes() == 0 && arena.reserved_bytes() >= ( 256 << 10 );
+			arena.release();
+			ok = ok && arena.reserved_bytes() == 0;
+
+			/* the huge pages are aligned on 2 MB */
+			ResourceVector< double > big( 1 << 20, 1., Allocator< double >( huge_pages ) );
+			ok = ok && reinterpret_cast< uintptr_t >( big.data() ) % HugePageResource::HUGE_PAGE == 0;
+
+			/* a default resource for the containers built without one */
+			MemoryResource::set_default( &arena );
+			Quadrature quadrature = Quadrature::get_quadrature( 4 );
+			Mesh mesh;
+			ok = ok && &quadrature.wxy_.get_allocator().resource() == &arena && &mesh.resource() == &arena
+				&& quadrature.nb_points() == 6;
+			MemoryResource::set_default( NULL );
+			ok = ok && &MemoryResource::default_resource() == &reference.resource();
+
+			/* freed blocks of any size are reused: rows growing again and
+			 * again stay within a few chunks */
+			ArenaResource reused( 1 << 20 );
+			for ( int k = 0; k < 1000; ++k ) {
+				ResourceVector< double > row( ( Allocator< double >( reused ) ) );
+				for ( int i = 0; i < 10000 + k; ++i ) row.push_back( i );
+				ResourceVector< char > odd( 13 + k % 7, 'a', Allocator< char >( reused ) );
+			}
+			const bool bounded = reused.reserved_bytes() <= 4 << 20;
+			std::cout << "rows grown 1000 times: " << reused.reserved_bytes() << " bytes reserved" << std::endl;
+
+			/* tests of the library with each resource as the default */
+			bool library = true;
+			for ( int r = 1; r < 4; ++r ) {
+				const size_t allocated = resources[r]->allocated_bytes();
+				MemoryResource::set_default( resources[r] );
+				library = library && test_solver_config() && test_streaming_assembly() && test_schwarz()
+					&& test_incremental_assembly() && test_sweep() && test_system_cache()
+					&& resources[r]->allocated_bytes() == allocated;
+				MemoryResource::set_default( NULL );
+			}
+			std::cout << "allocator " << ( ok ? "ok" : "FAILED" ) << ", reuse bounded " << bounded
+				<< ", library tests on the arenas " << library << std::endl;
+			return ok && bounded && library;
+		}
+		
 		/*bool test_ass_elmt_vector() {
 			Mesh carre;
 			carre.load("data/square.mesh");
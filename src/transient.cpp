@@ -0,0 +1,338 @@
+#include "transient.h"
+
+#include <iostream>
+#include <chrono>
+#include <assert.h>
+#include <cmath>
+#include <algorithm>
+
+namespace FEM2A {
+
+    static double seconds_since( std::chrono::steady_clock::time_point start )
+    {
+        return std::chrono::duration< double >(
+            std::chrono::steady_clock::now() - start ).count() ;
+    }
+
+    /****************************************************************/
+    /* Implementation of ImplicitHeatSolver */
+    /****************************************************************/
+    ImplicitHeatSolver::ImplicitHeatSolver(
+        const Mesh& M,
+        double (*diffusion_coef)(vertex),
+        double (*source_term)(vertex),
+        const std::vector< bool >& attribute_is_dirichlet,
+        double (*dirichlet_fct)(vertex),
+        double theta,
+        double dt,
+        const SolverConfig& config )
+        : mesh_( M ), theta_( theta ), dt_( dt ), verbose_( config.verbose ),
+        A_( M.nb_vertices() ), B_( M.nb_vertices() ),
+        f_( M.nb_vertices(), 0. ), u_( M.nb_vertices(), 0. ),
+        rhs_( M.nb_vertices(), 0. ), solver_( A_, config ), assembly_time_( 0. )
+    {
+        assert( theta >= 0. && theta <= 1. ) ;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+
+        Quadrature quadrature = Quadrature::get_quadrature( 2 ) ;
+        ShapeFunctions shape_functions( 2, 1 ) ;
+        std::vector< double > Fe( shape_functions.nb_functions() ) ;
+        for( int t = 0; t < M.nb_triangles(); ++t ) {
+            ElementMapping mapping( M, false, t ) ;
+            Mat< 3, 3 > Ke, Me ;
+            assemble_elementary_matrix( mapping, shape_functions, quadrature, diffusion_coef, Ke ) ;
+            assemble_elementary_mass_matrix( mapping, shape_functions, quadrature, Me ) ;
+            Mat< 3, 3 > Ae = Me, Be = Me ;
+            Ae += ( theta_ * dt_ ) * Ke ;
+            Be += ( -( 1. - theta_ ) * dt_ ) * Ke ;
+            local_to_global_matrix( M, t, Ae, A_ ) ;
+            local_to_global_matrix( M, t, Be, B_ ) ;
+
+            assemble_elementary_vector( mapping, shape_functions, quadrature, source_term, Fe ) ;
+            for( int i = 0; i < Fe.size(); ++i ) Fe[i] *= dt_ ;
+            local_to_global_vector( M, false, t, Fe, f_ ) ;
+        }
+
+        std::vector< double > imposed_values( M.nb_vertices() ) ;
+        for( int v = 0; v < M.nb_vertices(); ++v ) {
+            imposed_values[v] = dirichlet_fct( M.get_vertex( v ) ) ;
+        }
+        apply_dirichlet_boundary_conditions( M, attribute_is_dirichlet, imposed_values, A_, f_ ) ;
+        solver_.update_preconditioner() ;
+
+        assembly_time_ = seconds_since( start ) ;
+        report_.step = 0 ;
+        report_.time = 0. ;
+        report_.iterations = 0 ;
+        report_.residual = 0. ;
+        report_.rhs_time = 0. ;
+        report_.solve_time = 0. ;
+        if( verbose_ ) {
+            std::cout << "theta-scheme (theta = " << theta_ << ", dt = " << dt_
+                << "): " << M.nb_vertices() << " unknowns assembled in "
+                << assembly_time_ << " s" << std::endl ;
+        }
+    }
+
+    void ImplicitHeatSolver::set_initial_condition( double (*initial_fct)(vertex) )
+    {
+        for( int v = 0; v < mesh_.nb_vertices(); ++v ) {
+            u_[v] = initial_fct( mesh_.get_vertex( v ) ) ;
+        }
+        report_.step = 0 ;
+        report_.time = 0. ;
+    }
+
+    bool ImplicitHeatSolver::step()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+        B_.mult( u_, rhs_ ) ;
+        for( int i = 0; i < rhs_.size(); ++i ) {
+            rhs_[i] += f_[i] ;
+        }
+        report_.rhs_time = seconds_since( start ) ;
+
+        /* u_ holds u^n: the solve is warm-started from the last step */
+        start = std::chrono::steady_clock::now() ;
+        const bool converged = solver_.solve( rhs_, u_ ) ;
+        report_.solve_time = seconds_since( start ) ;
+
+        report_.step += 1 ;
+        report_.time += dt_ ;
+        report_.iterations = solver_.iterations() ;
+        report_.residual = solver_.residual() ;
+        if( verbose_ ) {
+            std::cout << "step " << report_.step << " t = " << report_.time
+                << ": " << report_.iterations << " iterations, rhs "
+                << report_.rhs_time << " s, solve " << report_.solve_time
+                << " s" << std::endl ;
+        }
+        return converged ;
+    }
+
+    const std::vector< double >& ImplicitHeatSolver::solution() const
+    {
+        return u_ ;
+    }
+
+    double ImplicitHeatSolver::time() const
+    {
+        return report_.time ;
+    }
+
+    const StepReport& ImplicitHeatSolver::last_report() const
+    {
+        return report_ ;
+    }
+
+    double ImplicitHeatSolver::assembly_time() const
+    {
+        return assembly_time_ ;
+    }
+
+    /****************************************************************/
+    /* Implementation of ExplicitHeatSolver */
+    /****************************************************************/
+    ExplicitHeatSolver::ExplicitHeatSolver(
+        const Mesh& M,
+        double (*diffusion_coef)(vertex),
+        double (*source_term)(vertex),
+        const std::vector< bool >& attribute_is_dirichlet,
+        double (*dirichlet_fct)(vertex),
+        Scheme scheme,
+        double cfl_safety,
+        ThreadPool& pool )
+        : mesh_( M ), scheme_( scheme ), pool_( pool ), nb_vertices_( M.nb_vertices() ),
+        nb_triangles_( M.nb_triangles() ), stable_dt_( 0. ), dt_( 0. )
+    {
+        const int nv = nb_vertices_ ;
+        const int nt = nb_triangles_ ;
+        v0_.resize( nt ) ; v1_.resize( nt ) ; v2_.resize( nt ) ;
+        k00_.resize( nt ) ; k01_.resize( nt ) ; k02_.resize( nt ) ;
+        k11_.resize( nt ) ; k12_.resize( nt ) ; k22_.resize( nt ) ;
+        local_.resize( 3 * nt ) ;
+        f_.assign( nv, 0. ) ;
+        std::vector< double > lumped_mass( nv, 0. ) ;
+        std::vector< double > abs_row_sum( nv, 0. ) ;
+
+        Quadrature quadrature = Quadrature::get_quadrature( 2 ) ;
+        ShapeFunctions shape_functions( 2, 1 ) ;
+        std::vector< double > Fe( shape_functions.nb_functions() ) ;
+        for( int t = 0; t < nt; ++t ) {
+            ElementMapping mapping( M, false, t ) ;
+            Mat< 3, 3 > Ke, Me ;
+            assemble_elementary_matrix( mapping, shape_functions, quadrature, diffusion_coef, Ke ) ;
+            assemble_elementary_mass_matrix( mapping, shape_functions, quadrature, Me ) ;
+            assemble_elementary_vector( mapping, shape_functions, quadrature, source_term, Fe ) ;
+            local_to_global_vector( M, false, t, Fe, f_ ) ;
+
+            v0_[t] = M.get_triangle_vertex_index( t, 0 ) ;
+            v1_[t] = M.get_triangle_vertex_index( t, 1 ) ;
+            v2_[t] = M.get_triangle_vertex_index( t, 2 ) ;
+            k00_[t] = Ke( 0, 0 ) ; k01_[t] = Ke( 0, 1 ) ; k02_[t] = Ke( 0, 2 ) ;
+            k11_[t] = Ke( 1, 1 ) ; k12_[t] = Ke( 1, 2 ) ; k22_[t] = Ke( 2, 2 ) ;
+            for( int i = 0; i < 3; ++i ) {
+                const int global = M.get_triangle_vertex_index( t, i ) ;
+                for( int j = 0; j < 3; ++j ) {
+                    lumped_mass[global] += Me( i, j ) ;
+                    abs_row_sum[global] += std::fabs( Ke( i, j ) ) ;
+                }
+            }
+        }
+
+        /* vertex -> contributions adjacency, as a CSR structure */
+        vertex_offsets_.assign( nv + 1, 0 ) ;
+        for( int t = 0; t < nt; ++t ) {
+            vertex_offsets_[v0_[t] + 1]++ ;
+            vertex_offsets_[v1_[t] + 1]++ ;
+            vertex_offsets_[v2_[t] + 1]++ ;
+        }
+        for( int v = 0; v < nv; ++v ) {
+            vertex_offsets_[v + 1] += vertex_offsets_[v] ;
+        }
+        vertex_slots_.resize( 3 * nt ) ;
+        std::vector< int > fill( vertex_offsets_.begin(), vertex_offsets_.end() - 1 ) ;
+        for( int t = 0; t < nt; ++t ) {
+            vertex_slots_[fill[v0_[t]]++] = t ;
+            vertex_slots_[fill[v1_[t]]++] = nt + t ;
+            vertex_slots_[fill[v2_[t]]++] = 2 * nt + t ;
+        }
+
+        inv_mass_.resize( nv ) ;
+        double lambda_max = 0. ;
+        for( int v = 0; v < nv; ++v ) {
+            inv_mass_[v] = lumped_mass[v] > 0. ? 1. / lumped_mass[v] : 0. ;
+            lambda_max = std::max( lambda_max, abs_row_sum[v] * inv_mass_[v] ) ;
+        }
+        stable_dt_ = lambda_max > 0. ? 2. / lambda_max : 1. ;
+        dt_ = cfl_safety * stable_dt_ ;
+
+        is_dirichlet_.assign( nv, 0 ) ;
+        dirichlet_values_.assign( nv, 0. ) ;
+        for( int e = 0; e < M.nb_edges(); ++e ) {
+            if( !attribute_is_dirichlet[M.get_edge_attribute( e )] ) continue ;
+            for( int i = 0; i < 2; ++i ) {
+                const int v = M.get_edge_vertex_index( e, i ) ;
+                is_dirichlet_[v] = 1 ;
+                dirichlet_values_[v] = dirichlet_fct( M.get_vertex( v ) ) ;
+            }
+        }
+
+        u_.assign( nv, 0. ) ;
+        for( int v = 0; v < nv; ++v ) {
+            if( is_dirichlet_[v] ) u_[v] = dirichlet_values_[v] ;
+        }
+        k1_.resize( nv ) ; k2_.resize( nv ) ; u1_.resize( nv ) ;
+        report_.step = 0 ;
+        report_.time = 0. ;
+        report_.iterations = 0 ;
+        report_.residual = 0. ;
+        report_.rhs_time = 0. ;
+        report_.solve_time = 0. ;
+    }
+
+    double ExplicitHeatSolver::stable_time_step() const
+    {
+        return stable_dt_ ;
+    }
+
+    double ExplicitHeatSolver::time_step() const
+    {
+        return dt_ ;
+    }
+
+    void ExplicitHeatSolver::set_time_step( double dt )
+    {
+        dt_ = dt ;
+    }
+
+    void ExplicitHeatSolver::set_initial_condition( double (*initial_fct)(vertex) )
+    {
+        for( int v = 0; v < nb_vertices_; ++v ) {
+            u_[v] = is_dirichlet_[v] ? dirichlet_values_[v]
+                : initial_fct( mesh_.get_vertex( v ) ) ;
+        }
+        report_.step = 0 ;
+        report_.time = 0. ;
+    }
+
+    void ExplicitHeatSolver::apply_stiffness( const std::vector< double >& u, std::vector< double >& y )
+    {
+        const int nt = nb_triangles_ ;
+        y.resize( nb_vertices_ ) ;
+        double* local = &local_[0] ;
+        const double* uu = &u[0] ;
+        pool_.parallel_for( nt, [&]( int begin, int end ) {
+            const int* v0 = &v0_[0] ; const int* v1 = &v1_[0] ; const int* v2 = &v2_[0] ;
+            const double* k00 = &k00_[0] ; const double* k01 = &k01_[0] ;
+            const double* k02 = &k02_[0] ; const double* k11 = &k11_[0] ;
+            const double* k12 = &k12_[0] ; const double* k22 = &k22_[0] ;
+            for( int t = begin; t < end; ++t ) {
+                const double u0 = uu[v0[t]], u1 = uu[v1[t]], u2 = uu[v2[t]] ;
+                local[t] = k00[t] * u0 + k01[t] * u1 + k02[t] * u2 ;
+                local[nt + t] = k01[t] * u0 + k11[t] * u1 + k12[t] * u2 ;
+                local[2 * nt + t] = k02[t] * u0 + k12[t] * u1 + k22[t] * u2 ;
+            }
+        } ) ;
+        pool_.parallel_for( nb_vertices_, [&]( int begin, int end ) {
+            for( int v = begin; v < end; ++v ) {
+                double s = 0. ;
+                for( int k = vertex_offsets_[v]; k < vertex_offsets_[v + 1]; ++k ) {
+                    s += local[vertex_slots_[k]] ;
+                }
+                y[v] = s ;
+            }
+        } ) ;
+    }
+
+    void ExplicitHeatSolver::compute_rate( const std::vector< double >& u, std::vector< double >& rate )
+    {
+        apply_stiffness( u, rate ) ;
+        pool_.parallel_for( nb_vertices_, [&]( int begin, int end ) {
+            for( int v = begin; v < end; ++v ) {
+                rate[v] = is_dirichlet_[v] ? 0. : inv_mass_[v] * ( f_[v] - rate[v] ) ;
+            }
+        } ) ;
+    }
+
+    void ExplicitHeatSolver::step()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+        const double dt = dt_ ;
+        compute_rate( u_, k1_ ) ;
+        if( scheme_ == FORWARD_EULER ) {
+            pool_.parallel_for( nb_vertices_, [&]( int begin, int end ) {
+                for( int v = begin; v < end; ++v ) u_[v] += dt * k1_[v] ;
+            } ) ;
+        } else {
+            pool_.parallel_for( nb_vertices_, [&]( int begin, int end ) {
+                for( int v = begin; v < end; ++v ) u1_[v] = u_[v] + dt * k1_[v] ;
+            } ) ;
+            compute_rate( u1_, k2_ ) ;
+            pool_.parallel_for( nb_vertices_, [&]( int begin, int end ) {
+                for( int v = begin; v < end; ++v ) {
+                    u_[v] += 0.5 * dt * ( k1_[v] + k2_[v] ) ;
+                }
+            } ) ;
+        }
+        report_.step += 1 ;
+        report_.time += dt ;
+        report_.solve_time = seconds_since( start ) ;
+    }
+
+    const std::vector< double >& ExplicitHeatSolver::solution() const
+    {
+        return u_ ;
+    }
+
+    double ExplicitHeatSolver::time() const
+    {
+        return report_.time ;
+    }
+
+    const StepReport& ExplicitHeatSolver::last_report() const
+    {
+        return report_ ;
+    }
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "mesh.h"
+#include "fem.h"
+#include "solver.h"
+#include "parallel.h"
+
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief Cost of one time step of a transient solver.
+     */
+    struct StepReport {
+        int step ;
+        double time ;
+        int iterations ;
+        double residual ;
+        double rhs_time ;   /* seconds spent building the right hand side */
+        double solve_time ; /* seconds spent in the linear solver */
+    } ;
+
+    /**
+     * \brief ImplicitHeatSolver integrates the heat equation
+     *        du/dt - div(k grad u) = f with P1 elements and the
+     *        theta-scheme (theta = 1: backward Euler, theta = 0.5:
+     *        Crank-Nicolson):
+     *
+     *        (M + theta dt K) u^{n+1} = (M - (1-theta) dt K) u^n + dt F
+     *
+     * M + theta dt K (with the Dirichlet penalty) and M - (1-theta) dt K
+     * are assembled once by the constructor, together with the
+     * preconditioner. A step is then one sparse product and one PCG
+     * solve warm-started from the previous solution.
+     */
+    class ImplicitHeatSolver {
+        public:
+            /**
+             * \param M The mesh, must outlive the solver
+             * \param diffusion_coef The diffusion coefficient k(x,y)
+             * \param source_term The source f(x,y), constant in time
+             * \param attribute_is_dirichlet Edge attributes where
+             *        dirichlet_fct is imposed
+             * \param dirichlet_fct The imposed value, constant in time
+             * \param theta Implicitation parameter in [0.5, 1]
+             * \param dt The time step
+             * \param config Threshold, preconditioner and verbosity of the
+             *        PCG solver (the method is always SolverConfig::PCG)
+             */
+            ImplicitHeatSolver(
+                const Mesh& M,
+                double (*diffusion_coef)(vertex),
+                double (*source_term)(vertex),
+                const std::vector< bool >& attribute_is_dirichlet,
+                double (*dirichlet_fct)(vertex),
+                double theta,
+                double dt,
+                const SolverConfig& config ) ;
+
+            /**
+             * \brief Sets the solution at t = 0 (default: 0 everywhere).
+             */
+            void set_initial_condition( double (*initial_fct)(vertex) ) ;
+
+            /**
+             * \brief Advances the solution from t to t + dt.
+             * \return true if the linear solver has converged.
+             */
+            bool step() ;
+
+            const std::vector< double >& solution() const ;
+            double time() const ;
+
+            /* Cost of the last step and of the initial assembly */
+            const StepReport& last_report() const ;
+            double assembly_time() const ;
+
+        private:
+            const Mesh& mesh_ ;
+            double theta_ ;
+            double dt_ ;
+            bool verbose_ ;
+            SparseMatrix A_ ; /* M + theta dt K + penalty */
+            SparseMatrix B_ ; /* M - (1 - theta) dt K */
+            std::vector< double > f_ ; /* dt F + penalty terms */
+            std::vector< double > u_ ;
+            std::vector< double > rhs_ ;
+            LinearSolver solver_ ;
+            StepReport report_ ;
+            double assembly_time_ ;
+    } ;
+
+    /**
+     * \brief ExplicitHeatSolver integrates the heat equation with a
+     *        lumped (diagonal) mass matrix and an explicit scheme:
+     *
+     *        u^{n+1} = u^n + dt M_L^{-1} (F - K u^n)    (forward Euler)
+     *
+     * or the two stages Heun (RK2) variant. No linear system is solved:
+     * K u is applied element by element from the elementary matrices
+     * computed once, then gathered at the vertices, both loops running
+     * on a ThreadPool. Dirichlet values are imposed strongly.
+     *
+     * The time step defaults to cfl_safety times the stability limit
+     * 2 / lambda_max(M_L^{-1} K), lambda_max being bounded with the
+     * Gershgorin circles of the elementary matrices.
+     */
+    class ExplicitHeatSolver {
+        public:
+            enum Scheme { FORWARD_EULER, RK2 } ;
+
+            /**
+             * \param M The mesh, must outlive the solver
+             * \param diffusion_coef The diffusion coefficient k(x,y)
+             * \param source_term The source f(x,y), constant in time
+             * \param attribute_is_dirichlet Edge attributes where
+             *        dirichlet_fct is imposed
+             * \param dirichlet_fct The imposed value, constant in time
+             * \param scheme FORWARD_EULER or RK2
+             * \param cfl_safety Fraction of the stable time step used
+             * \param pool The threads running the element and vertex loops
+             */
+            ExplicitHeatSolver(
+                const Mesh& M,
+                double (*diffusion_coef)(vertex),
+                double (*source_term)(vertex),
+                const std::vector< bool >& attribute_is_dirichlet,
+                double (*dirichlet_fct)(vertex),
+                Scheme scheme = FORWARD_EULER,
+                double cfl_safety = 0.9,
+                ThreadPool& pool = ThreadPool::global() ) ;
+
+            /**
+             * \return the largest stable time step (without safety factor)
+             */
+            double stable_time_step() const ;
+            double time_step() const ;
+            void set_time_step( double dt ) ;
+
+            void set_initial_condition( double (*initial_fct)(vertex) ) ;
+
+            /**
+             * \brief Advances the solution from t to t + dt.
+             */
+            void step() ;
+
+            /**
+             * \brief Computes y = K u element by element, without the
+             *        assembled stiffness matrix.
+             */
+            void apply_stiffness( const std::vector< double >& u, std::vector< double >& y ) ;
+
+            const std::vector< double >& solution() const ;
+            double time() const ;
+            const StepReport& last_report() const ;
+
+        private:
+            /* rate = M_L^{-1} (F - K u), 0 at Dirichlet vertices */
+            void compute_rate( const std::vector< double >& u, std::vector< double >& rate ) ;
+
+            const Mesh& mesh_ ;
+            Scheme scheme_ ;
+            ThreadPool& pool_ ;
+            int nb_vertices_ ;
+            int nb_triangles_ ;
+
+            /* per triangle: vertex indices and upper part of Ke (SoA) */
+            std::vector< int > v0_, v1_, v2_ ;
+            std::vector< double > k00_, k01_, k02_, k11_, k12_, k22_ ;
+            /* (K u) restricted to each triangle: local vertex a of triangle
+             * t is stored at a * nb_triangles_ + t */
+            std::vector< double > local_ ;
+            /* for each vertex, the positions in local_ of its contributions */
+            std::vector< int > vertex_offsets_ ;
+            std::vector< int > vertex_slots_ ;
+
+            std::vector< double > inv_mass_ ;
+            std::vector< double > f_ ;
+            std::vector< char > is_dirichlet_ ;
+            std::vector< double > dirichlet_values_ ;
+
+            std::vector< double > u_, k1_, k2_, u1_ ;
+            double stable_dt_ ;
+            double dt_ ;
+            StepReport report_ ;
+    } ;
+
+}
@@ -0,0 +1,262 @@
+#include "vtu.h"
+#include "compression.h"
+
+#include <stdint.h>
+#include <assert.h>
+#include <fstream>
+#include <algorithm>
+
+namespace FEM2A {
+
+    /* uncompressed size of the blocks of a compressed array */
+    static const size_t vtu_block_size = 1 << 16 ;
+
+    /****************************************************************/
+    /* Implementation of VtuWriter */
+    /****************************************************************/
+    VtuWriter::VtuWriter( const Mesh& M )
+        : mesh_( M ), compress_( false )
+    {
+    }
+
+    void VtuWriter::add_point_field( const std::string& name,
+        const std::vector< double >& values, int nb_components )
+    {
+        assert( values.size() == (size_t)mesh_.nb_vertices() * nb_components ) ;
+        Field f ;
+        f.name = name ;
+        f.nb_components = nb_components ;
+        f.on_points = true ;
+        f.values = &values ;
+        fields_.push_back( f ) ;
+    }
+
+    void VtuWriter::add_cell_field( const std::string& name,
+        const std::vector< double >& values, int nb_components )
+    {
+        assert( values.size() == (size_t)mesh_.nb_triangles() * nb_components ) ;
+        Field f ;
+        f.name = name ;
+        f.nb_components = nb_components ;
+        f.on_points = false ;
+        f.values = &values ;
+        fields_.push_back( f ) ;
+    }
+
+    void VtuWriter::add_cell_field_copy( const std::string& name,
+        const std::vector< double >& values, int nb_components )
+    {
+        assert( values.size() == (size_t)mesh_.nb_triangles() * nb_components ) ;
+        Field f ;
+        f.name = name ;
+        f.nb_components = nb_components ;
+        f.on_points = false ;
+        f.values = NULL ;
+        fields_.push_back( f ) ;
+        fields_.back().owned = values ;
+    }
+
+    void VtuWriter::add_triangle_attributes()
+    {
+        std::vector< double > attributes( mesh_.nb_triangles() ) ;
+        for( int t = 0; t < mesh_.nb_triangles(); ++t ) {
+            attributes[t] = mesh_.get_triangle_attribute( t ) ;
+        }
+        add_cell_field_copy( "attribute", attributes ) ;
+    }
+
+    void VtuWriter::add_gradient( const std::string& name, const std::vector< double >& u )
+    {
+        assert( u.size() == (size_t)mesh_.nb_vertices() ) ;
+        std::vector< double > gradient( 3 * mesh_.nb_triangles(), 0. ) ;
+        for( int t = 0; t < mesh_.nb_triangles(); ++t ) {
+            const vertex p0 = mesh_.get_triangle_vertex( t, 0 ) ;
+            const vertex p1 = mesh_.get_triangle_vertex( t, 1 ) ;
+            const vertex p2 = mesh_.get_triangle_vertex( t, 2 ) ;
+            const double u0 = u[mesh_.get_triangle_vertex_index( t, 0 )] ;
+            const double du1 = u[mesh_.get_triangle_vertex_index( t, 1 )] - u0 ;
+            const double du2 = u[mesh_.get_triangle_vertex_index( t, 2 )] - u0 ;
+            /* solves ( p1 - p0, p2 - p0 )^T grad = ( du1, du2 ) */
+            const double a = p1.x - p0.x, b = p1.y - p0.y ;
+            const double c = p2.x - p0.x, d = p2.y - p0.y ;
+            const double det = a * d - b * c ;
+            gradient[3 * t] = ( d * du1 - b * du2 ) / det ;
+            gradient[3 * t + 1] = ( a * du2 - c * du1 ) / det ;
+        }
+        add_cell_field_copy( name, gradient, 3 ) ;
+    }
+
+    void VtuWriter::clear_fields()
+    {
+        fields_.clear() ;
+    }
+
+    void VtuWriter::set_compression( bool compress )
+    {
+        compress_ = compress ;
+    }
+
+    namespace {
+        struct VtuArray {
+            std::string name ;
+            const char* type ;
+            int nb_components ;
+            const char* data ;
+            size_t nb_bytes ;
+            std::vector< char > encoded ; /* only if compressed */
+            uint64_t offset ;             /* in the appended data */
+            uint64_t appended_size ;
+        } ;
+
+        void add_array( std::vector< VtuArray >& arrays, const std::string& name,
+            const char* type, int nb_components, const void* data, size_t nb_bytes )
+        {
+            VtuArray a ;
+            a.name = name ;
+            a.type = type ;
+            a.nb_components = nb_components ;
+            a.data = static_cast< const char* >( data ) ;
+            a.nb_bytes = nb_bytes ;
+            a.offset = 0 ;
+            a.appended_size = 0 ;
+            arrays.push_back( a ) ;
+        }
+
+        /* header [nb_blocks, block_size, last_block_size, compressed sizes]
+         * then the compressed blocks */
+        void compress_array( VtuArray& a )
+        {
+            const uint64_t nb_blocks = ( a.nb_bytes + vtu_block_size - 1 ) / vtu_block_size ;
+            std::vector< uint64_t > header( 3 + nb_blocks ) ;
+            header[0] = nb_blocks ;
+            header[1] = vtu_block_size ;
+            header[2] = a.nb_bytes % vtu_block_size ;
+            std::vector< char > blocks ;
+            std::vector< char > block ;
+            for( uint64_t b = 0; b < nb_blocks; ++b ) {
+                const size_t begin = b * vtu_block_size ;
+                const size_t size = std::min( vtu_block_size, a.nb_bytes - begin ) ;
+                lz4_compress( a.data + begin, size, block ) ;
+                header[3 + b] = block.size() ;
+                blocks.insert( blocks.end(), block.begin(), block.end() ) ;
+            }
+            const char* h = reinterpret_cast< const char* >( header.data() ) ;
+            a.encoded.assign( h, h + header.size() * sizeof( uint64_t ) ) ;
+            a.encoded.insert( a.encoded.end(), blocks.begin(), blocks.end() ) ;
+        }
+
+        void write_data_array( std::ostream& out, const VtuArray& a, const char* indent )
+        {
+            out << indent << "<DataArray type=\"" << a.type << "\" Name=\"" << a.name
+                << "\" NumberOfComponents=\"" << a.nb_components
+                << "\" format=\"appended\" offset=\"" << a.offset << "\"/>\n" ;
+        }
+    }
+
+    bool VtuWriter::write( const std::string& filename ) const
+    {
+        const int nv = mesh_.nb_vertices() ;
+        const int nt = mesh_.nb_triangles() ;
+
+        /* geometry in the layout of VTK */
+        std::vector< double > points( 3 * nv, 0. ) ;
+        for( int i = 0; i < nv; ++i ) {
+            const vertex v = mesh_.get_vertex( i ) ;
+            points[3 * i] = v.x ;
+            points[3 * i + 1] = v.y ;
+        }
+        std::vector< int32_t > connectivity( 3 * nt ) ;
+        std::vector< int32_t > offsets( nt ) ;
+        for( int t = 0; t < nt; ++t ) {
+            for( int k = 0; k < 3; ++k ) {
+                connectivity[3 * t + k] = mesh_.get_triangle_vertex_index( t, k ) ;
+            }
+            offsets[t] = 3 * ( t + 1 ) ;
+        }
+        const std::vector< uint8_t > types( nt, 5 ) ; /* VTK_TRIANGLE */
+
+        std::vector< VtuArray > arrays ;
+        std::vector< int > point_fields, cell_fields ;
+        for( int f = 0; f < fields_.size(); ++f ) {
+            const std::vector< double >& values =
+                fields_[f].values ? *fields_[f].values : fields_[f].owned ;
+            ( fields_[f].on_points ? point_fields : cell_fields ).push_back( arrays.size() ) ;
+            add_array( arrays, fields_[f].name, "Float64", fields_[f].nb_components,
+                values.data(), values.size() * sizeof( double ) ) ;
+        }
+        const int first_geometry = arrays.size() ;
+        add_array( arrays, "Points", "Float64", 3, points.data(), points.size() * sizeof( double ) ) ;
+        add_array( arrays, "connectivity", "Int32", 1, connectivity.data(), connectivity.size() * sizeof( int32_t ) ) ;
+        add_array( arrays, "offsets", "Int32", 1, offsets.data(), offsets.size() * sizeof( int32_t ) ) ;
+        add_array( arrays, "types", "UInt8", 1, types.data(), types.size() ) ;
+
+        uint64_t offset = 0 ;
+        for( int a = 0; a < arrays.size(); ++a ) {
+            if( compress_ ) {
+                compress_array( arrays[a] ) ;
+                arrays[a].appended_size = arrays[a].encoded.size() ;
+            } else {
+                arrays[a].appended_size = sizeof( uint64_t ) + arrays[a].nb_bytes ;
+            }
+            arrays[a].offset = offset ;
+            offset += arrays[a].appended_size ;
+        }
+
+        std::ofstream out( filename.c_str(), std::ios::binary ) ;
+        if( !out.is_open() ) return false ;
+        out << "<?xml version=\"1.0\"?>\n"
+            << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"LittleEndian\""
+            << " header_type=\"UInt64\"" ;
+        if( compress_ ) out << " compressor=\"vtkLZ4DataCompressor\"" ;
+        out << ">\n<UnstructuredGrid>\n"
+            << "<Piece NumberOfPoints=\"" << nv << "\" NumberOfCells=\"" << nt << "\">\n" ;
+        out << "<PointData>\n" ;
+        for( int k = 0; k < point_fields.size(); ++k ) write_data_array( out, arrays[point_fields[k]], "  " ) ;
+        out << "</PointData>\n<CellData>\n" ;
+        for( int k = 0; k < cell_fields.size(); ++k ) write_data_array( out, arrays[cell_fields[k]], "  " ) ;
+        out << "</CellData>\n<Points>\n" ;
+        write_data_array( out, arrays[first_geometry], "  " ) ;
+        out << "</Points>\n<Cells>\n" ;
+        for( int a = first_geometry + 1; a < arrays.size(); ++a ) write_data_array( out, arrays[a], "  " ) ;
+        out << "</Cells>\n</Piece>\n</UnstructuredGrid>\n"
+            << "<AppendedData encoding=\"raw\">\n_" ;
+        for( int a = 0; a < arrays.size(); ++a ) {
+            if( compress_ ) {
+                out.write( arrays[a].encoded.data(), arrays[a].encoded.size() ) ;
+            } else {
+                const uint64_t size = arrays[a].nb_bytes ;
+                out.write( reinterpret_cast< const char* >( &size ), sizeof( size ) ) ;
+                out.write( arrays[a].data, arrays[a].nb_bytes ) ;
+            }
+        }
+        out << "\n</AppendedData>\n</VTKFile>\n" ;
+        return out.good() ;
+    }
+
+    /****************************************************************/
+    /* Implementation of PvdWriter */
+    /****************************************************************/
+    PvdWriter::PvdWriter( const std::string& filename )
+        : filename_( filename )
+    {
+    }
+
+    bool PvdWriter::add( double time, const std::string& vtu_filename )
+    {
+        times_.push_back( time ) ;
+        files_.push_back( vtu_filename ) ;
+        std::ofstream out( filename_.c_str() ) ;
+        if( !out.is_open() ) return false ;
+        out.precision( 17 ) ;
+        out << "<?xml version=\"1.0\"?>\n"
+            << "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\"LittleEndian\">\n"
+            << "<Collection>\n" ;
+        for( int k = 0; k < times_.size(); ++k ) {
+            out << "  <DataSet timestep=\"" << times_[k] << "\" group=\"\" part=\"0\" file=\""
+                << files_[k] << "\"/>\n" ;
+        }
+        out << "</Collection>\n</VTKFile>\n" ;
+        return out.good() ;
+    }
+
+}
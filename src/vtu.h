@@ -0,0 +1,101 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <string>
+#include <vector>
+
+namespace FEM2A {
+
+    /**
+     * \brief VtuWriter writes a mesh and its fields in the VTK XML
+     *        UnstructuredGrid format (.vtu), readable by ParaView and VisIt.
+     *
+     * All the arrays are stored as raw little-endian binary in a single
+     * appended block (no base64, no text formatting), each prefixed by its
+     * size on 64 bits. With set_compression( true ), each array is cut in
+     * blocks of 64 KiB compressed with the in-tree LZ4 coder (see
+     * compression.h), in the layout VTK expects from vtkLZ4DataCompressor.
+     *
+     * Point fields have one value (or nb_components values) per vertex,
+     * cell fields one per triangle. The fields added by reference must
+     * stay valid until write().
+     */
+    class VtuWriter {
+        public:
+            /**
+             * \param M The mesh, must outlive the object
+             */
+            explicit VtuWriter( const Mesh& M ) ;
+
+            void add_point_field( const std::string& name,
+                const std::vector< double >& values, int nb_components = 1 ) ;
+            void add_cell_field( const std::string& name,
+                const std::vector< double >& values, int nb_components = 1 ) ;
+
+            /**
+             * \brief Adds the attributes of the triangles as the cell
+             *        field "attribute".
+             */
+            void add_triangle_attributes() ;
+
+            /**
+             * \brief Adds the gradient of the P1 field u (one value per
+             *        vertex), constant on each triangle, as a cell field of
+             *        3 components (z = 0, as VTK expects for vectors).
+             */
+            void add_gradient( const std::string& name, const std::vector< double >& u ) ;
+
+            /**
+             * \brief Adds a copy of values as a cell field, for the fields
+             *        computed on the fly (error indicators...).
+             */
+            void add_cell_field_copy( const std::string& name,
+                const std::vector< double >& values, int nb_components = 1 ) ;
+
+            /* removes the fields, keeps the mesh */
+            void clear_fields() ;
+
+            void set_compression( bool compress ) ;
+
+            /**
+             * \return false if the file cannot be written
+             */
+            bool write( const std::string& filename ) const ;
+
+        private:
+            struct Field {
+                std::string name ;
+                int nb_components ;
+                bool on_points ;
+                const std::vector< double >* values ; /* NULL if owned */
+                std::vector< double > owned ;
+            } ;
+
+            const Mesh& mesh_ ;
+            std::vector< Field > fields_ ;
+            bool compress_ ;
+    } ;
+
+    /**
+     * \brief PvdWriter writes the .pvd collection of a time series of .vtu
+     *        files. The collection is rewritten at each add(), so that it
+     *        stays readable if the run stops.
+     */
+    class PvdWriter {
+        public:
+            explicit PvdWriter( const std::string& filename ) ;
+
+            /**
+             * \param vtu_filename The .vtu of this time, relative to the
+             *        directory of the .pvd
+             */
+            bool add( double time, const std::string& vtu_filename ) ;
+
+        private:
+            std::string filename_ ;
+            std::vector< double > times_ ;
+            std::vector< std::string > files_ ;
+    } ;
+
+}